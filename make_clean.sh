@@ -22,6 +22,12 @@ cd ../../..
 cd source/cclib/Release
 make clean
 cd ../../..
+cd source/ccbench/Debug
+make clean
+cd ../../..
+cd source/ccbench/Release
+make clean
+cd ../../..
 cd source/ccnode/Debug
 make clean
 cd ../../..
@@ -15,6 +15,9 @@ cd ../../..
 cd source/cclib/Debug
 make all
 cd ../../..
+cd source/ccbench/Debug
+make all
+cd ../../..
 cd source/ccnode/Debug
 make all
 cd ../../..
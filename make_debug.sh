@@ -11,7 +11,7 @@ export CPPFLAGS="-Og -g3 -pthread -fPIC -fstack-protector-strong -Wno-misleading
 export CXXFLAGS="-Wno-deprecated-copy"
 export LDFLAGS="-fstack-protector"
 export LDLIBS="-lpthread -ldl"
-rm -f ccnode.exe ccwallet.exe cctracker.exe cctx64.dll
+rm -f ccnode.exe ccwallet.exe cctracker.exe ccbench.exe cctx64.dll
 find source -type f \( -name \*.exe -o -name \*.dll -o -name \*.a \) -delete
 cd source/3rdparty/Debug
 make all
@@ -25,6 +25,9 @@ cd ../../..
 cd source/cclib/Debug
 make all
 cd ../../..
+cd source/ccbench/Debug
+make all
+cd ../../..
 cd source/ccnode/Debug
 make all
 cd ../../..
@@ -15,6 +15,9 @@ cd ../../..
 cd source/cclib/Release
 make all
 cd ../../..
+cd source/ccbench/Release
+make all
+cd ../../..
 cd source/ccnode/Release
 make all
 cd ../../..
@@ -0,0 +1,46 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+# Add inputs and outputs from these tool invocations to the build variables 
+CPP_SRCS += \
+../src/benchalloc.cpp \
+../src/benchblock.cpp \
+../src/benchnet.cpp \
+../src/benchproof.cpp \
+../src/benchutil.cpp \
+../src/ccbench.cpp 
+
+CPP_DEPS += \
+./src/benchalloc.d \
+./src/benchblock.d \
+./src/benchnet.d \
+./src/benchproof.d \
+./src/benchutil.d \
+./src/ccbench.d 
+
+OBJS += \
+./src/benchalloc.o \
+./src/benchblock.o \
+./src/benchnet.o \
+./src/benchproof.o \
+./src/benchutil.o \
+./src/ccbench.o 
+
+
+# Each subdirectory must supply rules for building sources it contributes
+src/%.o: ../src/%.cpp src/subdir.mk
+	@echo 'Building file: $<'
+	@echo 'Invoking: Cross G++ Compiler'
+	g++ -std=c++11 -DBOOST_BIND_GLOBAL_PLACEHOLDERS=1 -I$(CREDACASH_BUILD)/source -I$(CREDACASH_BUILD)/source/ccnode/src -I$(CREDACASH_BUILD)/source/cclib/src -I$(CREDACASH_BUILD)/source/cccommon/src -I$(CREDACASH_BUILD)/source/3rdparty/src -I$(CREDACASH_BUILD)/depends -I$(CREDACASH_BUILD)/depends/gmp -I$(CREDACASH_BUILD)/depends/boost -fno-omit-frame-pointer -fno-optimize-sibling-calls -Wall -Wextra -c -fmessage-length=0 -Wno-unused-parameter $(CPPFLAGS) $(CXXFLAGS) -isystem $(CREDACASH_BUILD)/depends/boost -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+
+clean: clean-src
+
+clean-src:
+	-$(RM) ./src/benchalloc.d ./src/benchalloc.o ./src/benchblock.d ./src/benchblock.o ./src/benchnet.d ./src/benchnet.o ./src/benchproof.d ./src/benchproof.o ./src/benchutil.d ./src/benchutil.o ./src/ccbench.d ./src/ccbench.o
+
+.PHONY: clean-src
+
@@ -0,0 +1,35 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+ASM_SRCS := 
+C++M_SRCS := 
+C++_SRCS := 
+CCM_SRCS := 
+CC_SRCS := 
+CPP_SRCS := 
+CXXM_SRCS := 
+CXX_SRCS := 
+C_SRCS := 
+C_UPPER_SRCS := 
+OBJ_SRCS := 
+O_SRCS := 
+SX_SRCS := 
+S_UPPER_SRCS := 
+C++M_DEPS := 
+C++_DEPS := 
+CCM_DEPS := 
+CC_DEPS := 
+CPP_DEPS := 
+CXXM_DEPS := 
+CXX_DEPS := 
+C_DEPS := 
+C_UPPER_DEPS := 
+EXECUTABLES := 
+OBJS := 
+
+# Every subdirectory with source files must be described here
+SUBDIRS := \
+import-ccnode \
+src \
+
@@ -0,0 +1,207 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * benchalloc.cpp
+*/
+
+#include "ccbench.h"
+#include "benchutil.hpp"
+#include "benchalloc.hpp"
+
+#include <SmartBuf.hpp>
+
+/*
+
+Measures the throughput of allocating and freeing SmartBuf's from malloc and from the size class slabs, each with a fully
+zeroed buffer (as every SmartBuf was allocated before the slabs were added) and with only the header and aux area zeroed
+(as the relay and transaction servers now allocate the objects they read from the network), so the gain from each change
+can be seen separately.  Each thread keeps a window of live buffers and repeatedly replaces a random one with a new
+buffer of random size up to the shape size, and writes the first and last bytes of the buffer.  The threads are created
+before timing starts and are reused for every run, so thread creation isn't timed.  Each timed run starts when the
+threads are released and ends when all of them have finished.  Throughput is reported in allocations per second.
+
+*/
+
+#define ALLOC_OPS_PER_THREAD	20000
+#define ALLOC_WINDOW			256
+
+struct AllocRun
+{
+	unsigned size;
+	bool zero_data;						// set before round is incremented
+	atomic<unsigned> round;
+	atomic<unsigned> ndone;
+	atomic<unsigned> nfailed;
+	atomic<bool> stop;
+
+	AllocRun(unsigned _size)
+	 :	size(_size),
+		zero_data(false),
+		round(0),
+		ndone(0),
+		nfailed(0),
+		stop(false)
+	{ }
+};
+
+static void alloc_thread_proc(AllocRun& run, unsigned seed)
+{
+	vector<SmartBuf> window(ALLOC_WINDOW);
+
+	mt19937 rng(seed);
+
+	unsigned round = 0;
+
+	while (true)
+	{
+		while (run.round.load() == round && !run.stop.load())
+			this_thread::yield();
+
+		if (run.stop.load())
+			break;
+
+		round = run.round.load();
+
+		for (unsigned i = 0; i < ALLOC_OPS_PER_THREAD; ++i)
+		{
+			auto r = rng();
+			auto bufsize = r % run.size + 1;
+
+			auto& smartobj = window[(r >> 20) % ALLOC_WINDOW];
+
+			smartobj = SmartBuf(bufsize, run.zero_data);
+			if (!smartobj)
+			{
+				run.nfailed.fetch_add(1);
+
+				continue;
+			}
+
+			auto data = smartobj.data();
+			data[0] = 1;
+			data[bufsize - 1] = 1;
+		}
+
+		for (auto& smartobj : window)
+			smartobj = SmartBuf();
+
+		run.ndone.fetch_add(1);
+	}
+}
+
+// returns the elapsed microseconds
+
+static double run_alloc(AllocRun& run, unsigned nthreads, bool slabs, bool zero_data)
+{
+	SmartBuf::SetUseSlabs(slabs);
+
+	run.zero_data = zero_data;
+	run.ndone = 0;
+
+	BenchTimer timer;
+
+	run.round.fetch_add(1);
+
+	while (run.ndone.load() < nthreads)
+		this_thread::yield();
+
+	return timer.ElapsedUsec();
+}
+
+static void bench_alloc_size(BenchReport& report, unsigned size, unsigned nthreads)
+{
+	static const struct
+	{
+		const char *name;
+		bool slabs;
+		bool zero_data;
+	} variants[] =
+	{
+		{ "malloc-zero",	false,	true },
+		{ "malloc-nozero",	false,	false },
+		{ "slab-zero",		true,	true },
+		{ "slab-nozero",	true,	false },
+	};
+
+	auto shape = to_string(size) + "-bytes-" + to_string(nthreads) + "-threads";
+	auto nallocs = nthreads * ALLOC_OPS_PER_THREAD;
+
+	vector<BenchResult> results;
+
+	for (auto& v : variants)
+	{
+		results.emplace_back("alloc", v.name, shape, nallocs);
+		results.back().notes = "sizes 1 to " + to_string(size) + " bytes; items are allocations";
+	}
+
+	AllocRun run(size);
+
+	vector<thread*> threads;
+
+	for (unsigned i = 0; i < nthreads; ++i)
+		threads.push_back(new thread(alloc_thread_proc, std::ref(run), rand()));
+
+	bench_reset_peak_mem();
+
+	for (int i = -g_params.warmup; i < g_params.iterations && !g_shutdown; ++i)
+	{
+		for (unsigned j = 0; j < results.size(); ++j)
+		{
+			run.nfailed = 0;
+
+			auto elapsed = run_alloc(run, nthreads, variants[j].slabs, variants[j].zero_data);
+
+			if (run.nfailed.load())
+				++results[j].nfailed;
+
+			if (i >= 0)
+				results[j].AddSample(elapsed);
+		}
+	}
+
+	run.stop = true;
+
+	for (auto t : threads)
+	{
+		t->join();
+		delete t;
+	}
+
+	for (auto& result : results)
+	{
+		result.peak_rss_kb = bench_peak_mem_kb();
+
+		report.Add(result);
+	}
+}
+
+void bench_alloc(BenchReport& report)
+{
+	if (!bench_test_enabled("alloc"))
+		return;
+
+	unsigned nthreads = g_params.alloc_threads;
+	if (!nthreads)
+		nthreads = max(thread::hardware_concurrency(), 1U);
+
+	vector<string> sizes;
+	boost::split(sizes, g_params.alloc_sizes, boost::is_any_of(","));
+
+	for (auto& s : sizes)
+	{
+		auto size = atoi(s.c_str());
+		if (size < 1 || g_shutdown)
+			continue;
+
+		bench_alloc_size(report, size, 1);
+
+		if (nthreads > 1)
+			bench_alloc_size(report, size, nthreads);
+	}
+
+	SmartBuf::SetUseSlabs(true);
+
+	SmartBuf::LogAllocStats();
+}
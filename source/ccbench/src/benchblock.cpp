@@ -0,0 +1,674 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * benchblock.cpp
+*/
+
+#include "ccbench.h"
+#include "benchutil.hpp"
+#include "benchproof.hpp"
+#include "benchblock.hpp"
+
+#include <transaction.h>
+#include <transaction.hpp>
+#include <txview.hpp>
+#include <CCobjects.hpp>
+#include <SmartBuf.hpp>
+#include <SpinLock.hpp>
+#include <CCthread.hpp>
+#include <blocktxcheck.hpp>
+#include <txpool.hpp>
+#include <blockscore.hpp>
+
+/*
+
+Measures the latency of the per-tx phase of block validation in ccnode against the number of tx's in the block.  The
+block is split and checked by ccnode's own BlockTxCheckPool, first with no pool threads, and then with a pool of threads
+that each have their own TxPay.  Each tx is read from the block through a TxView, its serialnums are collected, and it is
+copied into its own object buffer with its object id set (BlockTxCheckPool::CheckPlainTx).  The database checks of
+exchange tx's, the serialnum conflict checks and proof verification that follow in ccnode are not included.
+
+If block-placement is set, the pool is run again with its threads pinned to the given CPU's, the same as the ccnode
+validate thread role, to show the effect of thread placement on validation throughput.
+
+*/
+
+#define WIRE_BUFSIZE	(32*1024)
+
+class BenchBlockTxChecker : public BlockTxChecker
+{
+	unique_ptr<TxPay> m_ptx;
+
+public:
+
+	BenchBlockTxChecker()
+	 :	m_ptx(new TxPay)
+	{
+		CCASSERT(m_ptx);
+	}
+
+	int Check(BlockTxCheck& check)
+	{
+		auto rc = BlockTxCheckPool::CheckPlainTx(check);
+		if (rc <= 0)
+			return rc;
+
+		// not a plain txpay; ccnode would also check its Xtx against the database
+
+		auto& tx = *m_ptx;
+
+		rc = tx_from_wire(tx, (char*)check.wire, check.txsize);
+		if (rc)
+			return -1;
+
+		check.serialnums.clear();
+
+		for (unsigned i = 0; i < tx.nin; ++i)
+			check.serialnums.push_back(tx.inputs[i].S_serialnum);
+
+		rc = BlockTxCheckPool::ExtractTx(check.wire, check.txsize, check.smartobj);
+		if (rc)
+			return -1;
+
+		return 0;
+	}
+};
+
+// if pchecks is not NULL, it is set to the location and size of each tx in the block
+
+static void make_block(unsigned ntx, const vector<unsigned>& keys, vector<char>& block, vector<BlockTxCheck> *pchecks = NULL)
+{
+	unique_ptr<TxPay> ptx(new TxPay);
+	CCASSERT(ptx);
+
+	vector<char> wire(WIRE_BUFSIZE);
+
+	block.clear();
+
+	vector<uint32_t> offsets;
+
+	for (unsigned i = 0; i < ntx; ++i)
+	{
+		make_synthetic_tx(*ptx, keys[i % keys.size()], i);
+
+		auto rc = txpay_to_wire(string(), *ptx, 0, NULL, 0, wire.data(), wire.size());
+		if (rc)
+			throw runtime_error("error encoding synthetic block transaction");
+
+		auto txsize = *(uint32_t*)wire.data();
+
+		offsets.push_back(block.size());
+
+		block.insert(block.end(), wire.data(), wire.data() + txsize);
+	}
+
+	if (!pchecks)
+		return;
+
+	pchecks->clear();
+	pchecks->resize(ntx);
+
+	for (unsigned i = 0; i < ntx; ++i)
+	{
+		(*pchecks)[i].wire = block.data() + offsets[i];
+		(*pchecks)[i].txsize = *(uint32_t*)(*pchecks)[i].wire;
+	}
+}
+
+// returns the number of tx's that failed
+
+static unsigned check_block(BlockTxCheckPool& pool, BlockTxChecker& checker, const vector<char>& block)
+{
+	auto ntx = pool.Split(block.data(), block.data() + block.size());
+
+	pool.Run(checker);
+
+	unsigned nfailed = 0;
+
+	for (unsigned i = 0; i < ntx; ++i)
+	{
+		if (pool.GetCheck(i).result)
+			++nfailed;
+	}
+
+	return nfailed;
+}
+
+void bench_block(BenchReport& report)
+{
+	if (!bench_test_enabled("block"))
+		return;
+
+	vector<unsigned> keys;
+
+	bench_enabled_keys(keys);
+
+	if (keys.empty())
+		return;
+
+	vector<string> counts;
+	boost::split(counts, g_params.block_txs, boost::is_any_of(","));
+
+	unsigned nthreads = g_params.block_threads;
+	if (!nthreads)
+		nthreads = max(thread::hardware_concurrency(), 1U);
+
+	auto factory = []{ return new BenchBlockTxChecker; };
+
+	BlockTxCheckPool serial_pool;
+	BlockTxCheckPool pool;
+
+	serial_pool.Init(1, factory, NULL);
+	pool.Init(nthreads, factory, NULL);
+
+	unique_ptr<BlockTxCheckPool> pinned_pool;
+
+	if (g_params.block_placement.length())
+	{
+		CCThreadRoles::Configure(string("validate=") + g_params.block_placement, g_params.block_numa_local, {"validate"});
+
+		pinned_pool.reset(new BlockTxCheckPool);
+		pinned_pool->Init(nthreads, factory, "validate");
+	}
+
+	BenchBlockTxChecker checker;
+
+	vector<char> block;
+
+	for (auto& count : counts)
+	{
+		auto ntx = atoi(count.c_str());
+		if (ntx < 1 || g_shutdown)
+			continue;
+
+		make_block(ntx, keys, block);
+
+		auto shape = to_string(ntx) + "-tx";
+
+		BenchResult serial("block", "check-serial", shape, ntx);
+		BenchResult parallel("block", "check-parallel", shape, ntx);
+
+		parallel.notes = "threads " + to_string(pool.NThreads());
+
+		BenchResult pinned("block", "check-parallel-pinned", shape, ntx);
+
+		if (pinned_pool)
+			pinned.notes = "threads " + to_string(pinned_pool->NThreads()) + " placement " + CCThreadRoles::ConfigString();
+
+		bench_reset_peak_mem();
+
+		for (int i = -g_params.warmup; i < g_params.iterations && !g_shutdown; ++i)
+		{
+			BenchTimer timer;
+
+			auto nfailed = check_block(serial_pool, checker, block);
+
+			auto elapsed = timer.ElapsedUsec();
+
+			serial.nfailed += nfailed;
+
+			if (i >= 0)
+				serial.AddSample(elapsed);
+
+			timer.Start();
+
+			nfailed = check_block(pool, checker, block);
+
+			elapsed = timer.ElapsedUsec();
+
+			parallel.nfailed += nfailed;
+
+			if (i >= 0)
+				parallel.AddSample(elapsed);
+
+			if (!pinned_pool)
+				continue;
+
+			timer.Start();
+
+			nfailed = check_block(*pinned_pool, checker, block);
+
+			elapsed = timer.ElapsedUsec();
+
+			pinned.nfailed += nfailed;
+
+			if (i >= 0)
+				pinned.AddSample(elapsed);
+		}
+
+		serial.peak_rss_kb = parallel.peak_rss_kb = pinned.peak_rss_kb = bench_peak_mem_kb();
+
+		report.Add(serial);
+		report.Add(parallel);
+
+		if (pinned_pool)
+			report.Add(pinned);
+	}
+}
+
+/*
+
+Measures the time a witness in ccnode spends choosing the tx's for one block from a backlog of pending tx's, using the
+witness's own TxCandidatePool.  The arrival order benchmark decodes each pending tx in arrival order until the block is
+full, which is what the witness did for every block before it kept a pool of decoded candidates.  The donation order
+benchmarks measure adding the backlog to a candidate pool once (TxCandidatePool::Add, which decodes each tx the same way
+as Witness::DecodeCandidate), and then ordering the pool for a new block (TxCandidatePool::SelectOrder), with the oldest
+tenth of the tx's past the age floor, and taking tx's in that order until the block is full.  The serialnum conflict
+checks are not included.
+
+*/
+
+#define SELECT_BLOCK_SIZE		(1024*1024)
+#define SELECT_AGE_FLOOR_SECS	60
+#define SELECT_AGE_SHARE		(SELECT_BLOCK_SIZE/4)
+
+// the synthetic backlog holds only plain txpays, which don't need the database
+
+class BenchTxSource : public TxCandidateSource
+{
+public:
+	int ExtractXtx(TxPay& txbuf, const void *txwire, shared_ptr<Xtx>& xtx)
+	{
+		return -1;
+	}
+
+	bool IsValidObj(SmartBuf smartobj)
+	{
+		return true;
+	}
+};
+
+void bench_block_select(BenchReport& report)
+{
+	if (!bench_test_enabled("select"))
+		return;
+
+	vector<unsigned> keys;
+
+	bench_enabled_keys(keys);
+
+	if (keys.empty())
+		return;
+
+	vector<string> counts;
+	boost::split(counts, g_params.select_txs, boost::is_any_of(","));
+
+	unique_ptr<TxPay> ptx(new TxPay);
+	CCASSERT(ptx);
+
+	unique_ptr<TxCandidatePool> pool(new TxCandidatePool);
+	CCASSERT(pool);
+
+	BenchTxSource source;
+
+	vector<char> backlog;
+	vector<BlockTxCheck> wires;
+	vector<SmartBuf> objs;
+	vector<unsigned> order;
+
+	for (auto& count : counts)
+	{
+		auto ntx = atoi(count.c_str());
+		if (ntx < 1 || g_shutdown)
+			continue;
+
+		make_block(ntx, keys, backlog, &wires);
+
+		// give each tx a random donation, and copy it into a SmartBuf the way the witness gets it from the ValidObjs table
+
+		objs.clear();
+
+		for (auto& wire : wires)
+		{
+			auto rc = tx_from_wire(*ptx, (char*)wire.wire, wire.txsize);
+			if (rc)
+				throw runtime_error("error decoding synthetic pending transaction");
+
+			ptx->donation_fp = rand() & TX_DONATION_MASK;
+
+			rc = txpay_to_wire(string(), *ptx, 0, NULL, 0, (char*)wire.wire, wire.txsize);
+			if (rc)
+				throw runtime_error("error encoding synthetic pending transaction");
+
+			objs.emplace_back();
+
+			rc = BlockTxCheckPool::ExtractTx(wire.wire, wire.txsize, objs.back());
+			if (rc)
+				throw runtime_error("error copying synthetic pending transaction");
+		}
+
+		auto shape = to_string(ntx) + "-pending";
+
+		BenchResult arrival("select", "arrival-order", shape, ntx);
+		BenchResult add("select", "donation-add", shape, ntx);
+		BenchResult choose("select", "donation-order", shape, ntx);
+
+		bench_reset_peak_mem();
+
+		unsigned nselected = 0;
+
+		for (int i = -g_params.warmup; i < g_params.iterations && !g_shutdown; ++i)
+		{
+			TxCandidatePool::Candidate candidate;
+			uint32_t nbytes = 0;
+			unsigned nfailed = 0;
+
+			BenchTimer timer;
+
+			for (auto& obj : objs)
+			{
+				if (pool->Decode(obj, candidate, source))
+				{
+					++nfailed;
+					continue;
+				}
+
+				if (nbytes + candidate.block_size > SELECT_BLOCK_SIZE)
+					break;
+
+				nbytes += candidate.block_size;
+			}
+
+			auto elapsed = timer.ElapsedUsec();
+
+			arrival.nfailed += nfailed;
+
+			if (i >= 0)
+				arrival.AddSample(elapsed);
+
+			pool->Init(false);
+			nfailed = 0;
+
+			timer.Start();
+
+			for (unsigned j = 0; j < objs.size(); ++j)
+			{
+				if (pool->Add(objs[j], j, source))
+					++nfailed;
+			}
+
+			elapsed = timer.ElapsedUsec();
+
+			add.nfailed += nfailed;
+
+			if (i >= 0)
+				add.AddSample(elapsed);
+
+			// treat the oldest tenth as past the age floor
+
+			auto aged_ticks = ccticks() - (SELECT_AGE_FLOOR_SECS + 1) * CCTICKS_PER_SEC;
+
+			for (unsigned j = 0; j < pool->Size(); ++j)
+			{
+				auto& pooled = pool->Get(j);
+
+				if (pooled.seqnum < ntx / 10)
+					pooled.arrival_ticks = aged_ticks;
+			}
+
+			pool->NewBlock();
+
+			timer.Start();
+
+			pool->SelectOrder(order, SELECT_AGE_FLOOR_SECS, SELECT_AGE_SHARE);
+
+			nbytes = 0;
+			nselected = 0;
+
+			for (auto index : order)
+			{
+				auto size = pool->Get(index).block_size;
+
+				if (nbytes + size > SELECT_BLOCK_SIZE)
+					continue;
+
+				nbytes += size;
+				++nselected;
+			}
+
+			elapsed = timer.ElapsedUsec();
+
+			if (i >= 0)
+				choose.AddSample(elapsed);
+		}
+
+		pool->Init(false);
+
+		choose.notes = "block " + to_string(SELECT_BLOCK_SIZE / 1024) + " KB selected " + to_string(nselected) + " tx's";
+
+		arrival.peak_rss_kb = add.peak_rss_kb = choose.peak_rss_kb = bench_peak_mem_kb();
+
+		report.Add(arrival);
+		report.Add(add);
+		report.Add(choose);
+	}
+}
+
+/*
+
+Measures the time a witness in ccnode spends scoring the valid blocks it could build on (Witness::UpdateSkipScores) on
+synthetic fork trees above the last indelible block.  The blocks are real Block objects chained through their prior
+pointers, and they are scored by ccnode's own SkipScorePool and Block::CalcSkipScoreBase.
+
+The uncached benchmark scores every block without the scores cached in the block aux data, so each block walks its chain
+back to the last indelible block.  The serial benchmark scores every block with a new genstamp on the calling thread
+only, so each block costs one step once its prior has been scored.  The pool benchmark does the same with block-threads
+threads, and the witness only wakes its pool threads when at least SKIP_SCORE_PARALLEL_MIN blocks are new, which should be
+set near the smallest block count at which the pool beats the serial benchmark.  The table benchmark scores only a tenth of
+the blocks as new blocks, which is the usual case between changes of the last indelible block.
+
+*/
+
+#define FORK_NWITNESSES		8
+#define FORK_MAX_DEPTH		6		// max levels above the last indelible block
+
+static SmartBuf make_fork_block(SmartBuf priorobj, unsigned witness)
+{
+	unsigned size = sizeof(CCObject::Preamble) + sizeof(CCObject::Header) + sizeof(BlockWireHeader);
+
+	auto smartobj = SmartBuf(size);
+	CCASSERT(smartobj);
+
+	auto block = (Block*)smartobj.data();
+
+	block->SetSize(sizeof(CCObject::Header) + sizeof(BlockWireHeader));
+	block->SetTag(CC_TAG_BLOCK);
+
+	auto wire = block->WireData();
+	wire->witness = witness;
+
+	auto auxp = block->SetupAuxBuf(smartobj);
+	CCASSERT(auxp);
+
+	auxp->blockchain_params.nwitnesses = FORK_NWITNESSES;
+	auxp->blockchain_params.next_nwitnesses = FORK_NWITNESSES;
+
+	if (priorobj)
+	{
+		auto prior = (Block*)priorobj.data();
+
+		wire->level.SetValue(prior->WireData()->level.GetValue() + 1);
+		auxp->skip = Block::ComputeSkip(prior->WireData()->witness, witness, FORK_NWITNESSES);
+
+		block->SetPriorBlock(priorobj);
+	}
+
+	return smartobj;
+}
+
+// the last indelible block is at index 0
+
+static void make_fork_tree(unsigned nblocks, vector<SmartBuf>& tree)
+{
+	tree.clear();
+	tree.reserve(nblocks + 1);
+
+	tree.push_back(make_fork_block(SmartBuf(), 0));
+
+	for (unsigned i = 1; i <= nblocks; ++i)
+	{
+		auto priorobj = tree[rand() % i];
+
+		while (((Block*)priorobj.data())->WireData()->level.GetValue() >= FORK_MAX_DEPTH)
+			priorobj = ((Block*)priorobj.data())->GetPriorBlock();
+
+		tree.push_back(make_fork_block(priorobj, rand() % FORK_NWITNESSES));
+	}
+}
+
+static unsigned fork_find_best(const vector<SkipScoreWork>& work, unsigned top_witness)
+{
+	uint64_t bestscore = 0;
+	unsigned best = 0;
+
+	for (unsigned i = 0; i < work.size(); ++i)
+	{
+		auto block = (Block*)work[i].smartobj.data();
+
+		auto score = block->FinishSkipScore(top_witness, false, work[i].score, work[i].scorebits);
+
+		if (score > bestscore)
+		{
+			bestscore = score;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+void bench_block_forks(BenchReport& report)
+{
+	if (!bench_test_enabled("forks"))
+		return;
+
+	vector<string> counts;
+	boost::split(counts, g_params.fork_blocks, boost::is_any_of(","));
+
+	unsigned nthreads = g_params.block_threads;
+	if (!nthreads)
+		nthreads = max(thread::hardware_concurrency(), 1U);
+
+	SkipScorePool pool;
+
+	pool.Init(nthreads, NULL);
+
+	vector<SmartBuf> tree;
+	vector<SkipScoreWork> work, table_work;
+	uint16_t genstamp = 0;
+
+	auto next_genstamp = [&genstamp]()
+	{
+		if (++genstamp == 0)
+			++genstamp;
+
+		return genstamp;
+	};
+
+	for (auto& count : counts)
+	{
+		auto nblocks = atoi(count.c_str());
+		if (nblocks < 1 || g_shutdown)
+			continue;
+
+		make_fork_tree(nblocks, tree);
+
+		work.resize(nblocks);
+
+		for (unsigned i = 0; i < work.size(); ++i)
+			work[i].smartobj = tree[i + 1];
+
+		unsigned nnew = max(nblocks / 10, 1);
+		unsigned top_witness = rand() % FORK_NWITNESSES;
+
+		auto shape = to_string(nblocks) + "-blocks";
+
+		BenchResult uncached("forks", "score-uncached", shape, nblocks);
+		BenchResult serial("forks", "score-serial", shape, nblocks);
+		BenchResult pooled("forks", "score-pool", shape, nblocks);
+		BenchResult table("forks", "score-table", shape, nblocks);
+
+		uncached.notes = "witnesses " + to_string(FORK_NWITNESSES) + " max depth " + to_string(FORK_MAX_DEPTH);
+		pooled.notes = "threads " + to_string(pool.NThreads());
+		table.notes = "new blocks per pass " + to_string(nnew);
+
+		bench_reset_peak_mem();
+
+		unsigned best = 0, nmismatch = 0;
+
+		for (int i = -g_params.warmup; i < g_params.iterations && !g_shutdown; ++i)
+		{
+			BenchTimer timer;
+
+			pool.Run(work, tree[0], 0, UINT_MAX);
+
+			best = fork_find_best(work, top_witness);
+
+			auto elapsed = timer.ElapsedUsec();
+
+			if (i >= 0)
+				uncached.AddSample(elapsed);
+
+			timer.Start();
+
+			pool.Run(work, tree[0], next_genstamp(), UINT_MAX);
+
+			nmismatch += (fork_find_best(work, top_witness) != best);
+
+			elapsed = timer.ElapsedUsec();
+
+			if (i >= 0)
+				serial.AddSample(elapsed);
+
+			timer.Start();
+
+			pool.Run(work, tree[0], next_genstamp(), 0);
+
+			nmismatch += (fork_find_best(work, top_witness) != best);
+
+			elapsed = timer.ElapsedUsec();
+
+			if (i >= 0)
+				pooled.AddSample(elapsed);
+
+			// the pool run left the scores of the older blocks cached, so only the newest blocks are scored
+			// a block's children were all made after it, so forgetting the scores of the newest blocks leaves every
+			// other cached score valid
+
+			table_work.assign(work.end() - nnew, work.end());
+
+			for (auto& entry : table_work)
+				((Block*)entry.smartobj.data())->AuxPtr()->witness_params.score_genstamp = 0;
+
+			timer.Start();
+
+			pool.Run(table_work, tree[0], genstamp, SKIP_SCORE_PARALLEL_MIN);
+
+			copy(table_work.begin(), table_work.end(), work.end() - nnew);
+
+			nmismatch += (fork_find_best(work, top_witness) != best);
+
+			elapsed = timer.ElapsedUsec();
+
+			if (i >= 0)
+				table.AddSample(elapsed);
+		}
+
+		serial.nfailed = pooled.nfailed = table.nfailed = nmismatch;		// each pass should find the same best block
+
+		uncached.peak_rss_kb = serial.peak_rss_kb = pooled.peak_rss_kb = table.peak_rss_kb = bench_peak_mem_kb();
+
+		report.Add(uncached);
+		report.Add(serial);
+		report.Add(pooled);
+		report.Add(table);
+	}
+
+	work.clear();
+	table_work.clear();
+	tree.clear();
+
+	pool.DeInit();
+}
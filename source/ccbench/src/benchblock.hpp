@@ -0,0 +1,15 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * benchblock.hpp
+*/
+
+#pragma once
+
+class BenchReport;
+
+void bench_block(BenchReport& report);
+void bench_block_select(BenchReport& report);
+void bench_block_forks(BenchReport& report);
@@ -0,0 +1,212 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * benchnet.cpp
+*/
+
+#include "ccbench.h"
+#include "benchutil.hpp"
+#include "benchnet.hpp"
+
+#include <boost/asio.hpp>
+
+/*
+
+Measures the throughput of sending messages made of a small header and a separate payload over a loopback TCP connection,
+first by copying the header and payload into one buffer and writing that (as the servers do when they format a reply
+into m_writebuf), and then by writing the header and payload buffers together in a single vectored write (as
+Connection::WriteAsync does with a WriteBuffers list).  Each timed operation sends a batch of messages and waits for the
+receiver to acknowledge that it has read all of them.  Throughput is reported in bytes per second.
+
+*/
+
+#define HEADER_SIZE		16
+#define BATCH_BYTES		(8 << 20)
+#define READ_BUFSIZE	(256*1024)
+
+using boost::asio::ip::tcp;
+
+class LoopbackPair
+{
+	boost::asio::io_service m_io_service;
+	tcp::socket m_receiver;
+	thread m_thread;
+	atomic<uint64_t> m_batch_bytes;
+
+	void ReceiveProc()
+	{
+		vector<char> buf(READ_BUFSIZE);
+		boost::system::error_code e;
+
+		while (true)
+		{
+			uint64_t nbytes = 0;
+
+			while (!m_batch_bytes.load() || nbytes < m_batch_bytes.load())
+			{
+				nbytes += m_receiver.read_some(boost::asio::buffer(buf.data(), buf.size()), e);
+				if (e)
+					return;
+			}
+
+			m_batch_bytes.store(0);
+
+			char ack = 0;
+			boost::asio::write(m_receiver, boost::asio::buffer(&ack, 1), e);
+			if (e)
+				return;
+		}
+	}
+
+public:
+	tcp::socket sender;
+
+	LoopbackPair()
+	 :	m_receiver(m_io_service),
+		m_batch_bytes(0),
+		sender(m_io_service)
+	{
+		tcp::acceptor acceptor(m_io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+
+		sender.connect(acceptor.local_endpoint());
+		acceptor.accept(m_receiver);
+
+		sender.set_option(tcp::no_delay(true));
+
+		m_thread = thread(&LoopbackPair::ReceiveProc, this);
+	}
+
+	~LoopbackPair()
+	{
+		boost::system::error_code e;
+
+		sender.shutdown(tcp::socket::shutdown_both, e);
+		m_receiver.shutdown(tcp::socket::shutdown_both, e);
+
+		m_thread.join();
+	}
+
+	void StartBatch(uint64_t nbytes)
+	{
+		m_batch_bytes.store(nbytes);
+	}
+
+	bool WaitForAck()
+	{
+		char ack;
+		boost::system::error_code e;
+
+		boost::asio::read(sender, boost::asio::buffer(&ack, 1), e);
+
+		return !!e;
+	}
+};
+
+static void bench_write_size(BenchReport& report, LoopbackPair& conn, unsigned size)
+{
+	unsigned nmsgs = max(BATCH_BYTES / (size + HEADER_SIZE), 1U);
+	unsigned batch_bytes = nmsgs * (size + HEADER_SIZE);
+
+	auto shape = to_string(size) + "-bytes";
+
+	BenchResult copy("write", "copy", shape, batch_bytes);
+	BenchResult vectored("write", "vectored", shape, batch_bytes);
+
+	copy.notes = vectored.notes = "messages per op " + to_string(nmsgs) + "; items are bytes";
+
+	vector<char> header(HEADER_SIZE, 1);
+	vector<char> payload(size, 2);
+	vector<char> msgbuf(HEADER_SIZE + size);
+
+	bench_reset_peak_mem();
+
+	for (int i = -g_params.warmup; i < g_params.iterations && !g_shutdown; ++i)
+	{
+		boost::system::error_code e;
+
+		conn.StartBatch(batch_bytes);
+
+		BenchTimer timer;
+
+		for (unsigned j = 0; j < nmsgs && !e; ++j)
+		{
+			memcpy(msgbuf.data(), header.data(), HEADER_SIZE);
+			memcpy(msgbuf.data() + HEADER_SIZE, payload.data(), size);
+
+			boost::asio::write(conn.sender, boost::asio::buffer(msgbuf.data(), msgbuf.size()), e);
+		}
+
+		if (e || conn.WaitForAck())
+		{
+			++copy.nfailed;
+
+			break;
+		}
+
+		auto elapsed = timer.ElapsedUsec();
+
+		if (i >= 0)
+			copy.AddSample(elapsed);
+
+		conn.StartBatch(batch_bytes);
+
+		timer.Start();
+
+		for (unsigned j = 0; j < nmsgs && !e; ++j)
+		{
+			array<boost::asio::const_buffer, 2> buffers =
+			{{
+				boost::asio::const_buffer(header.data(), HEADER_SIZE),
+				boost::asio::const_buffer(payload.data(), size)
+			}};
+
+			boost::asio::write(conn.sender, buffers, e);
+		}
+
+		if (e || conn.WaitForAck())
+		{
+			++vectored.nfailed;
+
+			break;
+		}
+
+		elapsed = timer.ElapsedUsec();
+
+		if (i >= 0)
+			vectored.AddSample(elapsed);
+	}
+
+	copy.peak_rss_kb = vectored.peak_rss_kb = bench_peak_mem_kb();
+
+	report.Add(copy);
+	report.Add(vectored);
+}
+
+void bench_write(BenchReport& report)
+{
+	if (!bench_test_enabled("write"))
+		return;
+
+	vector<string> sizes;
+	boost::split(sizes, g_params.write_sizes, boost::is_any_of(","));
+
+	try
+	{
+		LoopbackPair conn;
+
+		for (auto& s : sizes)
+		{
+			auto size = atoi(s.c_str());
+			if (size < 1 || g_shutdown)
+				continue;
+
+			bench_write_size(report, conn, size);
+		}
+	}
+	catch (const boost::system::system_error& e)
+	{
+		cerr << "WARNING: loopback write benchmark failed: " << e.what() << endl;
+	}
+}
@@ -0,0 +1,13 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * benchnet.hpp
+*/
+
+#pragma once
+
+class BenchReport;
+
+void bench_write(BenchReport& report);
@@ -0,0 +1,629 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * benchproof.cpp
+*/
+
+#include "ccbench.h"
+#include "benchutil.hpp"
+#include "benchproof.hpp"
+
+#include <snarkfront/snarkfront.hpp>
+
+#include <CCproof.h>
+#include <CCproof.hpp>
+#include <CompressProof.hpp>
+#include <zkkeys.hpp>
+#include <transaction.h>
+#include <transaction.hpp>
+#include <txview.hpp>
+#include <CCobjects.hpp>
+#include <CCcrypto.hpp>
+#include <CChash.hpp>
+
+using namespace snarkfront;
+
+/*
+
+The synthetic transactions built here have the input and output counts of each proof key, and random public values,
+but they are not constructed from real secrets or a real Merkle tree, so they do not satisfy the proof constraints.
+The proofs generated for them therefore fail verification, which does not affect the timings: proof generation and
+verification perform the same computation whether or not the constraints are satisfied.  Only key loading errors are
+counted as failures.
+
+*/
+
+#define WIRE_BUFSIZE	(32*1024)
+
+static ZKKeyStore keyshapes;	// used only to enumerate the key shapes; the proof library uses its own instance
+
+void bench_proof_init()
+{
+	CCProof_Init(g_params.proof_key_dir);
+
+	keyshapes.Init();
+}
+
+static bool bench_key_enabled(unsigned keyindex)
+{
+	if (g_params.keys.empty() || g_params.keys == "all")
+		return true;
+
+	vector<string> keys;
+	boost::split(keys, g_params.keys, boost::is_any_of(","));
+
+	for (auto& k : keys)
+	{
+		if (k.length() && (unsigned)atoi(k.c_str()) == keyindex)
+			return true;
+	}
+
+	return false;
+}
+
+void bench_enabled_keys(vector<unsigned>& keys)
+{
+	keys.clear();
+
+	for (unsigned keyindex = 0; keyindex < keyshapes.GetNKeys(); ++keyindex)
+	{
+		if (bench_key_enabled(keyindex))
+			keys.push_back(keyindex);
+	}
+}
+
+static void random_value(bigint_t& val, unsigned nbits)
+{
+	CCRandom(&val, sizeof(val));
+
+	bigint_mask(val, nbits);
+}
+
+void make_synthetic_tx(TxPay& tx, unsigned keyindex, uint64_t seed)
+{
+	tx_init(tx);
+
+	tx.tag_type = CC_TYPE_TXPAY;
+	tx.tx_type = CC_TYPE_TXPAY;
+	tx.no_precheck = 1;
+	tx.random_seed = seed;
+
+	keyshapes.SetTxCounts(keyindex, tx.nout, tx.nin, tx.nin_with_path);
+
+	random_value(tx.tx_merkle_root, TX_MERKLE_BITS);
+	random_value(tx.M_commitment_iv, TX_COMMIT_IV_BITS);
+
+	for (unsigned i = 0; i < tx.nout; ++i)
+	{
+		auto& txout = tx.outputs[i];
+
+		random_value(txout.M_address, TX_ADDRESS_BITS);
+		random_value(txout.M_commitment, TX_FIELD_BITS - 1);
+
+		txout.asset_mask = TX_ASSET_WIRE_MASK;
+		txout.amount_mask = TX_AMOUNT_MASK;
+
+		CCRandom(&txout.M_asset_enc, sizeof(txout.M_asset_enc));
+		CCRandom(&txout.M_amount_enc, sizeof(txout.M_amount_enc));
+
+		txout.M_asset_enc &= TX_ASSET_WIRE_MASK;
+		txout.M_amount_enc &= TX_AMOUNT_MASK;
+	}
+
+	for (unsigned i = 0; i < tx.nin; ++i)
+	{
+		auto& txin = tx.inputs[i];
+
+		txin.merkle_root = tx.tx_merkle_root;
+		txin.enforce_spend_secrets = 1;
+
+		random_value(txin.S_serialnum, TX_SERIALNUM_BITS - 1);
+		random_value(txin.S_hashkey, TX_HASHKEY_WIRE_BITS);
+
+		if (i < tx.nin_with_path)
+		{
+			txin.pathnum = i + 1;
+
+			for (auto& v : tx.inpaths[i].__M_merkle_path)
+				random_value(v, TX_MERKLE_BITS - 1);
+		}
+	}
+}
+
+// builds a mint transaction that satisfies the proof constraints, so its proof can be verified
+static int make_mint_tx(TxPay& tx, uint64_t seed)
+{
+	tx_init(tx);
+
+	tx.tag_type = CC_TYPE_MINT;
+	tx.tx_type = CC_TYPE_MINT;
+	tx.no_proof = 1;
+	tx.random_seed = seed;
+
+	tx.amount_bits = TX_AMOUNT_BITS;
+	tx.donation_bits = TX_DONATION_BITS;
+	tx.exponent_bits = TX_AMOUNT_EXPONENT_BITS;
+	tx.outvalmin = TX_CC_MINT_EXPONENT;
+	tx.outvalmax = TX_CC_MINT_EXPONENT;
+	tx.allow_restricted_addresses = true;
+
+	random_value(tx.tx_merkle_root, TX_MERKLE_BITS);
+
+	bigint_t donation, amount;
+	donation = TX_CC_MINT_DONATION;
+	amount = TX_CC_MINT_AMOUNT;
+	amount = amount - donation;
+
+	tx.donation_fp = tx_amount_encode(donation, true, TX_DONATION_BITS, TX_AMOUNT_EXPONENT_BITS);
+
+	tx.nout = 1;
+
+	auto& txout = tx.outputs[0];
+
+	random_value(txout.addrparams.__dest, TX_FIELD_BITS - 1);
+
+	txout.__amount_fp = tx_amount_encode(amount, false, TX_AMOUNT_BITS, TX_AMOUNT_EXPONENT_BITS, TX_CC_MINT_EXPONENT, TX_CC_MINT_EXPONENT);
+
+	char output[128] = {0};
+
+	auto rc = txpay_create_finish(string(), tx, output, sizeof(output));
+	if (rc)
+		cerr << "make_mint_tx error " << rc << " " << output << endl;
+
+	return rc;
+}
+
+// returns true if rc is a key error; see note at top of file
+static bool is_key_error(int rc)
+{
+	return rc == CCPROOF_ERR_NO_KEY || rc == CCPROOF_ERR_INSUFFICIENT_KEY || rc == CCPROOF_ERR_LOADING_KEY;
+}
+
+static string shape_name(const TxPay& tx)
+{
+	return to_string(tx.nout) + "-out-" + to_string(tx.nin_with_path) + "-in";
+}
+
+static string workspace_notes()
+{
+	CCProof_WorkspaceStats stats;
+
+	CCProof_GetWorkspaceStats(stats);
+
+	ostringstream notes;
+
+	notes << "workspaces reused " << stats.reused << "/" << stats.acquired << " evicted " << stats.evicted << " pooled " << stats.pooled;
+	notes << " high water " << (stats.high_water_bytes + 1023) / 1024 << " KB";
+
+	return notes.str();
+}
+
+static void finish_result(BenchReport& report, BenchResult& result)
+{
+	result.peak_rss_kb = bench_peak_mem_kb();
+
+	report.Add(result);
+}
+
+static void bench_prove(BenchReport& report, TxPay& tx)
+{
+	BenchResult result("proof", "prove", shape_name(tx));
+
+	bench_reset_peak_mem();
+
+	for (int i = -g_params.warmup; i < g_params.iterations && !g_shutdown; ++i)
+	{
+		tx.random_seed = i;
+
+		BenchTimer timer;
+
+		auto rc = CCProof_GenProof(tx);
+
+		auto elapsed = timer.ElapsedUsec();
+
+		if (is_key_error(rc))
+			++result.nfailed;
+
+		if (i >= 0)
+			result.AddSample(elapsed);
+	}
+
+	result.keyid = tx.zkkeyid;
+	result.notes = workspace_notes();
+
+	finish_result(report, result);
+}
+
+static void bench_verify(BenchReport& report, TxPay& tx)
+{
+	BenchResult result("proof", "verify", shape_name(tx));
+
+	bench_reset_peak_mem();
+
+	for (int i = -g_params.warmup; i < g_params.iterations && !g_shutdown; ++i)
+	{
+		BenchTimer timer;
+
+		auto rc = CCProof_VerifyProof(tx);
+
+		auto elapsed = timer.ElapsedUsec();
+
+		if (is_key_error(rc))
+			++result.nfailed;
+
+		if (i >= 0)
+			result.AddSample(elapsed);
+	}
+
+	result.keyid = tx.zkkeyid;
+
+	finish_result(report, result);
+}
+
+static void bench_compress(BenchReport& report, TxPay& tx)
+{
+	if (TEST_SKIP_ZKPROOFS)
+		return;		// the placeholder proof can't be decompressed
+
+	Proof<ZKPAIRING> proof;
+	proof_vec_t vec;
+
+	BenchResult decompress("proof", "decompress", shape_name(tx));
+	BenchResult compress("proof", "compress", shape_name(tx));
+
+	decompress.keyid = tx.zkkeyid;
+	compress.keyid = tx.zkkeyid;
+
+	bench_reset_peak_mem();
+
+	for (int i = -g_params.warmup; i < g_params.iterations && !g_shutdown; ++i)
+	{
+		BenchTimer timer;
+
+		Vec2Proof(tx.zkproof, proof);
+
+		auto elapsed = timer.ElapsedUsec();
+
+		if (i >= 0)
+			decompress.AddSample(elapsed);
+
+		timer.Start();
+
+		Proof2Vec(vec, proof);
+
+		elapsed = timer.ElapsedUsec();
+
+		if (memcmp(&vec, &tx.zkproof, sizeof(vec)))
+			++compress.nfailed;
+
+		if (i >= 0)
+			compress.AddSample(elapsed);
+	}
+
+	finish_result(report, decompress);
+	finish_result(report, compress);
+}
+
+static void bench_wire(BenchReport& report, TxPay& tx, vector<char>& wire)
+{
+	auto shape = shape_name(tx);
+
+	BenchResult encode("wire", "encode", shape);
+	BenchResult decode("wire", "decode", shape);
+	BenchResult view("wire", "view", shape);
+	BenchResult objid("wire", "objid", shape);
+
+	encode.keyid = decode.keyid = view.keyid = objid.keyid = tx.zkkeyid;
+
+	unique_ptr<TxPay> ptx2(new TxPay);
+	CCASSERT(ptx2);
+
+	// the view result reads the values used by block validation and the witness directly from the wire
+
+	TxView txview;
+	bigint_t serialnums[TX_MAXIN];
+
+	ccoid_t oid;
+
+	bench_reset_peak_mem();
+
+	for (int i = -g_params.warmup; i < g_params.iterations * 100 && !g_shutdown; ++i)
+	{
+		BenchTimer timer;
+
+		auto rc = txpay_to_wire(string(), tx, 0, NULL, 0, wire.data(), wire.size());
+
+		auto elapsed = timer.ElapsedUsec();
+
+		if (rc)
+			++encode.nfailed;
+
+		if (i >= 0)
+			encode.AddSample(elapsed);
+
+		timer.Start();
+
+		rc = tx_from_wire(*ptx2, wire.data(), wire.size());
+
+		elapsed = timer.ElapsedUsec();
+
+		if (rc)
+			++decode.nfailed;
+
+		if (i >= 0)
+			decode.AddSample(elapsed);
+
+		timer.Start();
+
+		rc = txview.Init(wire.data(), wire.size());
+
+		uint64_t param_level = 0;
+
+		if (!rc)
+		{
+			param_level = txview.ParamLevel();
+
+			for (unsigned j = 0; j < txview.NIn(); ++j)
+				txview.GetSerialnum(j, serialnums[j]);
+		}
+
+		elapsed = timer.ElapsedUsec();
+
+		if (rc || param_level != tx.param_level || txview.NIn() != tx.nin)
+			++view.nfailed;
+		else
+		{
+			for (unsigned j = 0; j < tx.nin; ++j)
+			{
+				if (memcmp(&serialnums[j], &tx.inputs[j].S_serialnum, TX_SERIALNUM_BYTES))
+				{
+					++view.nfailed;
+					break;
+				}
+			}
+		}
+
+		if (i >= 0)
+			view.AddSample(elapsed);
+
+		timer.Start();
+
+		CCObject::ComputeMessageObjId(wire.data(), &oid);
+
+		elapsed = timer.ElapsedUsec();
+
+		if (i >= 0)
+			objid.AddSample(elapsed);
+	}
+
+	finish_result(report, encode);
+	finish_result(report, decode);
+	finish_result(report, view);
+	finish_result(report, objid);
+}
+
+static void bench_work(BenchReport& report, TxPay& tx, vector<char>& wire)
+{
+	// a difficulty of 1 is never met, so each call performs exactly work_iterations nonce trials
+
+	const unsigned nproofs = 1;
+
+	BenchResult result("wire", "work", shape_name(tx), g_params.work_iterations * nproofs);
+
+	result.keyid = tx.zkkeyid;
+
+	bench_reset_peak_mem();
+
+	for (int i = -g_params.warmup; i < g_params.iterations && !g_shutdown; ++i)
+	{
+		tx_reset_work(string(), unixtime(), wire.data(), wire.size());
+
+		BenchTimer timer;
+
+		auto rc = tx_set_work(string(), 0, nproofs, g_params.work_iterations, 1, wire.data(), wire.size());
+
+		auto elapsed = timer.ElapsedUsec();
+
+		if (rc < 0)
+			++result.nfailed;
+
+		if (i >= 0)
+			result.AddSample(elapsed);
+	}
+
+	finish_result(report, result);
+}
+
+void bench_proofs(BenchReport& report)
+{
+	unique_ptr<TxPay> ptx(new TxPay);
+	CCASSERT(ptx);
+
+	TxPay& tx = *ptx;
+
+	vector<char> wire(WIRE_BUFSIZE);
+
+	for (unsigned keyindex = 0; keyindex < keyshapes.GetNKeys() && !g_shutdown; ++keyindex)
+	{
+		if (!bench_key_enabled(keyindex))
+			continue;
+
+		make_synthetic_tx(tx, keyindex, keyindex);
+
+		if (g_params.trace_level >= 4)
+			cerr << "benchmarking key shape " << keyindex << " " << shape_name(tx) << endl;
+
+		if (bench_test_enabled("prove") || bench_test_enabled("verify") || bench_test_enabled("compress"))
+			bench_prove(report, tx);
+
+		if (bench_test_enabled("verify"))
+			bench_verify(report, tx);
+
+		if (bench_test_enabled("compress"))
+			bench_compress(report, tx);
+
+		if (bench_test_enabled("wire") || bench_test_enabled("work"))
+		{
+			auto rc = txpay_to_wire(string(), tx, 0, NULL, 0, wire.data(), wire.size());
+			if (rc)
+			{
+				cerr << "error encoding synthetic transaction for key shape " << keyindex << endl;
+
+				continue;
+			}
+		}
+
+		if (bench_test_enabled("wire"))
+			bench_wire(report, tx, wire);
+
+		if (bench_test_enabled("work"))
+			bench_work(report, tx, wire);
+	}
+}
+
+void bench_hashes(BenchReport& report)
+{
+	if (!bench_test_enabled("hash"))
+		return;
+
+	bigint_t val1, val2, hash;
+
+	random_value(val1, TX_MERKLE_BITS - 1);
+	random_value(val2, TX_MERKLE_BITS - 1);
+
+	BenchResult leaf("hash", "merkle-leaf", string(), g_params.hash_iterations);
+	BenchResult node("hash", "merkle-node", string(), g_params.hash_iterations);
+	BenchResult serialnum("hash", "serialnum", string(), g_params.hash_iterations);
+	BenchResult cchash("hash", "cchash", string(), g_params.hash_iterations);
+
+	// the CCHash inputs have the shape used to compute an output address
+
+	vector<CCHashInput> hashin(3);
+	hashin[0].SetValue(val1, TX_FIELD_BITS);
+	hashin[1].SetValue(bigint_t(1UL), TX_CHAIN_BITS);
+
+	cchash.notes = "inputs " + to_string(hashin.size()) + " outbits " + to_string(TX_ADDRESS_BITS);
+
+	bench_reset_peak_mem();
+
+	for (int i = -g_params.warmup; i < g_params.iterations && !g_shutdown; ++i)
+	{
+		BenchTimer timer;
+
+		for (int j = 0; j < g_params.hash_iterations; ++j)
+			tx_commit_tree_hash_leaf(val1, j, hash);
+
+		auto elapsed = timer.ElapsedUsec();
+
+		if (i >= 0)
+			leaf.AddSample(elapsed);
+
+		timer.Start();
+
+		for (int j = 0; j < g_params.hash_iterations; ++j)
+		{
+			tx_commit_tree_hash_node(val1, val2, hash, false);
+			val1 = hash;
+		}
+
+		elapsed = timer.ElapsedUsec();
+
+		if (i >= 0)
+			node.AddSample(elapsed);
+
+		timer.Start();
+
+		for (int j = 0; j < g_params.hash_iterations; ++j)
+			compute_serialnum(val2, val1, j, hash);
+
+		elapsed = timer.ElapsedUsec();
+
+		if (i >= 0)
+			serialnum.AddSample(elapsed);
+
+		timer.Start();
+
+		for (int j = 0; j < g_params.hash_iterations; ++j)
+		{
+			hashin[2].SetValue(bigint_t((uint64_t)(j & ((1 << TX_PAYNUM_BITS) - 1))), TX_PAYNUM_BITS);
+			hash = CCHash::Hash(hashin, HASH_BASES_ADDRESS, TX_ADDRESS_BITS);
+		}
+
+		elapsed = timer.ElapsedUsec();
+
+		if (i >= 0)
+			cchash.AddSample(elapsed);
+	}
+
+	finish_result(report, leaf);
+	finish_result(report, node);
+	finish_result(report, serialnum);
+	finish_result(report, cchash);
+}
+
+void bench_workspace_soak(BenchReport& report)
+{
+	// Checks that reusing pooled proof workspaces doesn't change the proofs, by proving many transactions with key
+	// shapes in random order, and comparing each proof to the proof of the same transaction from a fresh workspace.
+	// The synthetic transactions don't satisfy the proof constraints, so each iteration also proves a mint transaction
+	// in a reused workspace, and checks that its proof verifies.
+
+	if (!bench_test_enabled("soak"))
+		return;
+
+	vector<unsigned> keys;
+
+	bench_enabled_keys(keys);
+
+	if (keys.empty())
+		return;
+
+	unique_ptr<TxPay> ptx(new TxPay);
+	CCASSERT(ptx);
+
+	TxPay& tx = *ptx;
+
+	BenchResult result("proof", "workspace-soak");
+
+	bench_reset_peak_mem();
+
+	for (int i = 0; i < g_params.soak_iterations && !g_shutdown; ++i)
+	{
+		auto keyindex = keys[rand() % keys.size()];
+
+		make_synthetic_tx(tx, keyindex, i);
+
+		BenchTimer timer;
+
+		auto rc = CCProof_CheckWorkspace(tx);
+
+		if (rc)
+		{
+			++result.nfailed;
+
+			cerr << "workspace soak mismatch; iteration " << i << " key shape " << keyindex << " " << shape_name(tx) << " result " << rc << endl;
+		}
+
+		rc = make_mint_tx(tx, i);
+
+		if (!rc)
+			rc = CCProof_CheckWorkspace(tx, true);
+
+		auto elapsed = timer.ElapsedUsec();
+
+		if (rc)
+		{
+			++result.nfailed;
+
+			cerr << "workspace soak mint failed; iteration " << i << " result " << rc << endl;
+		}
+
+		result.AddSample(elapsed);
+	}
+
+	result.notes = workspace_notes();
+
+	finish_result(report, result);
+}
@@ -0,0 +1,20 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * benchproof.hpp
+*/
+
+#pragma once
+
+class BenchReport;
+struct TxPay;
+
+void bench_proof_init();
+void bench_enabled_keys(vector<unsigned>& keys);
+void make_synthetic_tx(TxPay& tx, unsigned keyindex, uint64_t seed);
+
+void bench_proofs(BenchReport& report);
+void bench_hashes(BenchReport& report);
+void bench_workspace_soak(BenchReport& report);
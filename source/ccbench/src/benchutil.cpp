@@ -0,0 +1,235 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * benchutil.cpp
+*/
+
+#include "ccbench.h"
+#include "benchutil.hpp"
+
+#include <CCproof.h>
+
+BenchResult::BenchResult(const string& _group, const string& _name, const string& _shape, unsigned _items_per_op)
+ :	group(_group),
+	name(_name),
+	shape(_shape),
+	keyid(-1),
+	items_per_op(_items_per_op),
+	nfailed(0),
+	peak_rss_kb(0)
+{ }
+
+double BenchResult::Percentile(double pct) const
+{
+	if (samples.empty())
+		return 0;
+
+	auto sorted = samples;
+	sort(sorted.begin(), sorted.end());
+
+	unsigned index = (unsigned)(pct / 100 * (sorted.size() - 1) + 0.5);
+	if (index >= sorted.size())
+		index = sorted.size() - 1;
+
+	return sorted[index];
+}
+
+double BenchResult::Total() const
+{
+	double total = 0;
+
+	for (auto v : samples)
+		total += v;
+
+	return total;
+}
+
+double BenchResult::Mean() const
+{
+	if (samples.empty())
+		return 0;
+
+	return Total() / samples.size();
+}
+
+double BenchResult::Throughput() const
+{
+	auto total = Total();
+
+	if (total <= 0)
+		return 0;
+
+	return (double)samples.size() * items_per_op * 1000000 / total;
+}
+
+bool BenchReport::Add(const BenchResult& result)
+{
+	results.push_back(result);
+
+	return result.nfailed > 0;
+}
+
+void BenchReport::Output(ostream& os, const string& format) const
+{
+	if (format == "json")
+		OutputJson(os);
+	else if (format == "csv")
+		OutputCsv(os);
+	else
+		OutputText(os);
+}
+
+void BenchReport::OutputText(ostream& os) const
+{
+	os << endl;
+	os << CCAPPNAME " v" CCVERSION;
+	if (TEST_SKIP_ZKPROOFS)
+		os << " (TEST_SKIP_ZKPROOFS build)";
+	os << endl << endl;
+
+	os << left << setw(10) << "group" << setw(16) << "name" << setw(18) << "shape" << right << setw(6) << "keyid" << setw(7) << "count" << setw(7) << "failed"
+		<< setw(14) << "p50 usec" << setw(14) << "p99 usec" << setw(14) << "mean usec" << setw(16) << "items/sec" << setw(14) << "peak rss KB" << "  notes" << endl;
+
+	for (auto& r : results)
+	{
+		os << left << setw(10) << r.group << setw(16) << r.name << setw(18) << (r.shape.length() ? r.shape : "-") << right << setw(6) << r.keyid << setw(7) << r.Count() << setw(7) << r.nfailed
+			<< fixed << setprecision(1) << setw(14) << r.Percentile(50) << setw(14) << r.Percentile(99) << setw(14) << r.Mean() << setw(16) << r.Throughput()
+			<< setw(14) << r.peak_rss_kb << "  " << r.notes << endl;
+	}
+
+	os << endl;
+
+	os.unsetf(ios::floatfield);
+}
+
+static string json_escape(const string& s)
+{
+	string out;
+
+	for (auto c : s)
+	{
+		switch (c)
+		{
+		case '"':	out += "\\\""; break;
+		case '\\':	out += "\\\\"; break;
+		case '\n':	out += "\\n"; break;
+		case '\r':	out += "\\r"; break;
+		case '\t':	out += "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+				out += buf;
+			}
+			else
+				out += c;
+		}
+	}
+
+	return out;
+}
+
+static string csv_escape(const string& s)
+{
+	string out;
+
+	for (auto c : s)
+	{
+		if (c == '"')
+			out += '"';		// a quote inside a quoted field is doubled
+
+		out += c;
+	}
+
+	return out;
+}
+
+void BenchReport::OutputJson(ostream& os) const
+{
+	os << "{\"program\":\"" CCEXENAME "\",\"version\":\"" CCVERSION "\",\"skip_zkproofs\":" << TEST_SKIP_ZKPROOFS;
+	os << ",\"hardware_concurrency\":" << thread::hardware_concurrency() << ",\"time\":" << unixtime() << ",\"results\":[";
+
+	for (unsigned i = 0; i < results.size(); ++i)
+	{
+		auto& r = results[i];
+
+		if (i)
+			os << ",";
+
+		os << endl << "{\"group\":\"" << json_escape(r.group) << "\",\"name\":\"" << json_escape(r.name) << "\",\"shape\":\"" << json_escape(r.shape) << "\",\"keyid\":" << r.keyid;
+		os << ",\"count\":" << r.Count() << ",\"failed\":" << r.nfailed << ",\"items_per_op\":" << r.items_per_op;
+		os << fixed << setprecision(3) << ",\"p50_usec\":" << r.Percentile(50) << ",\"p99_usec\":" << r.Percentile(99) << ",\"mean_usec\":" << r.Mean();
+		os << ",\"throughput\":" << r.Throughput() << ",\"peak_rss_kb\":" << r.peak_rss_kb << ",\"notes\":\"" << json_escape(r.notes) << "\"}";
+	}
+
+	os << endl << "]}" << endl;
+
+	os.unsetf(ios::floatfield);
+}
+
+void BenchReport::OutputCsv(ostream& os) const
+{
+	os << "group,name,shape,keyid,count,failed,items_per_op,p50_usec,p99_usec,mean_usec,throughput,peak_rss_kb,skip_zkproofs,notes" << endl;
+
+	for (auto& r : results)
+	{
+		os << r.group << "," << r.name << "," << r.shape << "," << r.keyid << "," << r.Count() << "," << r.nfailed << "," << r.items_per_op;
+		os << fixed << setprecision(3) << "," << r.Percentile(50) << "," << r.Percentile(99) << "," << r.Mean() << "," << r.Throughput();
+		os << "," << r.peak_rss_kb << "," << TEST_SKIP_ZKPROOFS << ",\"" << csv_escape(r.notes) << "\"" << endl;
+	}
+
+	os.unsetf(ios::floatfield);
+}
+
+bool bench_test_enabled(const string& name)
+{
+	if (g_params.tests.empty() || g_params.tests == "all")
+		return true;
+
+	vector<string> tests;
+	boost::split(tests, g_params.tests, boost::is_any_of(","));
+
+	for (auto& t : tests)
+	{
+		if (t == name)
+			return true;
+	}
+
+	return false;
+}
+
+void bench_reset_peak_mem()
+{
+#ifndef _WIN32
+	// writing "5" to clear_refs resets the peak resident set size (VmHWM) reported in /proc/self/status
+
+	int fd = open("/proc/self/clear_refs", O_WRONLY);
+	if (fd == -1)
+		return;
+
+	auto rc = write(fd, "5", 1);
+	(void)rc;
+	close(fd);
+#endif
+}
+
+uint64_t bench_peak_mem_kb()
+{
+#ifndef _WIN32
+	ifstream fs("/proc/self/status");
+	string line;
+
+	while (getline(fs, line))
+	{
+		if (line.compare(0, 6, "VmHWM:"))
+			continue;
+
+		return strtoull(line.c_str() + 6, NULL, 10);
+	}
+#endif
+
+	return 0;
+}
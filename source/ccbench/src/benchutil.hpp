@@ -0,0 +1,86 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * benchutil.hpp
+*/
+
+#pragma once
+
+// Each benchmark produces one BenchResult, which holds the elapsed time of every measured iteration
+// plus the peak resident memory observed while it ran.  BenchReport collects the results and writes
+// them as a text table for people, or as json or csv so that runs from different builds can be compared.
+
+class BenchTimer
+{
+	chrono::steady_clock::time_point t0;
+
+public:
+	BenchTimer()
+	{
+		Start();
+	}
+
+	void Start()
+	{
+		t0 = chrono::steady_clock::now();
+	}
+
+	double ElapsedUsec() const
+	{
+		return chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+	}
+};
+
+class BenchResult
+{
+public:
+	string group;		// e.g., "proof"
+	string name;		// e.g., "prove"
+	string shape;		// e.g., "2-out-1-in", or empty when not specific to a key shape
+
+	int keyid;
+	unsigned items_per_op;		// number of items (hashes, nonces, etc) processed by one timed operation
+	unsigned nfailed;			// number of operations that returned an error
+	uint64_t peak_rss_kb;
+	string notes;				// additional statistics reported by the benchmark
+
+	vector<double> samples;		// elapsed microseconds per operation
+
+	BenchResult(const string& _group, const string& _name, const string& _shape = string(), unsigned _items_per_op = 1);
+
+	void AddSample(double usec)
+	{
+		samples.push_back(usec);
+	}
+
+	unsigned Count() const
+	{
+		return samples.size();
+	}
+
+	double Percentile(double pct) const;
+	double Mean() const;
+	double Total() const;
+	double Throughput() const;	// items per second
+};
+
+class BenchReport
+{
+	vector<BenchResult> results;
+
+	void OutputText(ostream& os) const;
+	void OutputJson(ostream& os) const;
+	void OutputCsv(ostream& os) const;
+
+public:
+	bool Add(const BenchResult& result);
+
+	void Output(ostream& os, const string& format) const;
+};
+
+bool bench_test_enabled(const string& name);
+
+void bench_reset_peak_mem();
+uint64_t bench_peak_mem_kb();
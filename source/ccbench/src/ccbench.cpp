@@ -0,0 +1,176 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * ccbench.cpp
+*/
+
+#define DECLARE_GLOBALS
+
+#include "ccbench.h"
+#include "benchutil.hpp"
+#include "benchproof.hpp"
+#include "benchblock.hpp"
+#include "benchnet.hpp"
+#include "benchalloc.hpp"
+
+#include <CCproof.h>
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+
+#define DEFAULT_TRACE_LEVEL	3
+
+static void check_config_values()
+{
+	if (g_params.iterations < 1 || g_params.iterations > 1000000)
+		throw range_error("iterations value not in valid range");
+
+	if (g_params.warmup < 0 || g_params.warmup > 1000000)
+		throw range_error("warmup value not in valid range");
+
+	if (g_params.hash_iterations < 1 || g_params.hash_iterations > 100000000)
+		throw range_error("hash-iterations value not in valid range");
+
+	if (g_params.work_iterations < 1 || g_params.work_iterations > (1 << 30))
+		throw range_error("work-iterations value not in valid range");
+
+	if (g_params.soak_iterations < 0 || g_params.soak_iterations > 100000000)
+		throw range_error("soak-iterations value not in valid range");
+
+	if (g_params.block_threads < 0 || g_params.block_threads > 2000)
+		throw range_error("block-threads value not in valid range");
+
+	if (g_params.alloc_threads < 0 || g_params.alloc_threads > 2000)
+		throw range_error("alloc-threads value not in valid range");
+
+	if (g_params.format != "text" && g_params.format != "json" && g_params.format != "csv")
+		throw range_error("format must be text, json or csv");
+}
+
+static int process_options(int argc, char **argv)
+{
+	namespace po = boost::program_options;
+
+	po::options_description basic_options("");
+	basic_options.add_options()
+		("help", "Display this message.")
+		("trace", po::value<int>(&g_params.trace_level)->default_value(DEFAULT_TRACE_LEVEL), "Trace level (0=none; 6=all).")
+		("proof-key-dir", po::wvalue<wstring>(&g_params.proof_key_dir), "Path to zero knowledge proof keys; if set to \"env\", the environment variable " KEY_PATH_ENV_VAR " is used (default: the subdirectory \"" ZK_KEY_DIR "\" in same directory as this program).")
+		("tests", po::value<string>(&g_params.tests)->default_value("all"), "Comma separated list of benchmarks to run: prove, verify, compress, wire, work, hash, soak, block, select, forks, write, alloc, or all.")
+		("keys", po::value<string>(&g_params.keys)->default_value("all"), "Comma separated list of proof key indexes to benchmark, or all.")
+		("iterations", po::value<int>(&g_params.iterations)->default_value(5), "Number of measured iterations of each benchmark"
+				" (the wire benchmarks run 100 times this number).")
+		("warmup", po::value<int>(&g_params.warmup)->default_value(1), "Number of unmeasured iterations run before each benchmark.")
+		("hash-iterations", po::value<int>(&g_params.hash_iterations)->default_value(10000), "Number of hashes computed in each iteration of the hash benchmarks.")
+		("work-iterations", po::value<int>(&g_params.work_iterations)->default_value(1 << 20), "Number of proof of work nonces tried in each iteration of the work benchmark.")
+		("soak-iterations", po::value<int>(&g_params.soak_iterations)->default_value(200), "Number of transactions checked by the proof workspace soak test.")
+		("block-txs", po::value<string>(&g_params.block_txs)->default_value("1,10,100,1000"), "Comma separated list of block sizes, in number of transactions, for the block validation benchmark.")
+		("select-txs", po::value<string>(&g_params.select_txs)->default_value("1000,10000"), "Comma separated list of pending transaction counts for the block transaction selection benchmark.")
+		("fork-blocks", po::value<string>(&g_params.fork_blocks)->default_value("100,300,1000,3000,10000"), "Comma separated list of block counts for the fork tree skip score benchmark.")
+		("block-threads", po::value<int>(&g_params.block_threads)->default_value(0), "Number of threads used by the parallel block validation and skip score benchmarks (0 = hardware concurrency).")
+		("block-placement", po::value<string>(&g_params.block_placement)->default_value(""), "CPU placement of the threads of a second, pinned run of the parallel block validation benchmark, as cpus[:nice[:sched]], "
+				"where cpus is a list of CPU numbers and ranges such as 0-7,16-23, and sched is other, batch or idle (default: no pinned run).")
+		("block-numa-local", po::value<bool>(&g_params.block_numa_local)->default_value(0), "Allocate the memory of the pinned block validation threads only from the NUMA nodes of their CPU's.")
+		("write-sizes", po::value<string>(&g_params.write_sizes)->default_value("1024,16384,262144,1048576"), "Comma separated list of payload sizes, in bytes, for the loopback write benchmark.")
+		("alloc-sizes", po::value<string>(&g_params.alloc_sizes)->default_value("256,4096,32768"), "Comma separated list of maximum buffer sizes, in bytes, for the SmartBuf allocation benchmark.")
+		("alloc-threads", po::value<int>(&g_params.alloc_threads)->default_value(0), "Number of threads used by the multi-threaded SmartBuf allocation benchmark (0 = hardware concurrency).")
+		("format", po::value<string>(&g_params.format)->default_value("text"), "Output format: text, json or csv.")
+		("output", po::wvalue<wstring>(&g_params.output_file), "Path to output file (default: standard output).")
+	;
+
+	po::options_description all;
+	all.add(basic_options);
+
+	po::store(po::parse_command_line(argc, argv, all), g_params.config_options);
+
+	if (g_params.config_options.count("help"))
+	{
+		cout << CCAPPNAME " v" CCVERSION << endl << endl;
+		cout << basic_options << endl;
+
+		return 1;
+	}
+
+	po::notify(g_params.config_options);
+
+	set_trace_level(g_params.trace_level);
+
+	check_config_values();
+
+	get_proof_key_dir(g_params.proof_key_dir, g_params.process_dir);
+
+	return 0;
+}
+
+#ifdef __MINGW64__
+int _dowildcard = 0;	// disable wildcard globbing
+#endif
+
+int main(int argc, char* argv[])
+{
+	srand(time(NULL));
+
+	set_handlers();
+
+	g_params.trace_level = DEFAULT_TRACE_LEVEL;
+	set_trace_level(g_params.trace_level);
+
+	g_params.process_dir = get_process_dir();
+	if (!g_params.process_dir.length())
+		return -1;
+
+	int result = 0;
+
+	try
+	{
+		auto rc = process_options(argc, argv);
+		if (rc) return rc;
+
+		bench_proof_init();
+
+		if (bench_test_enabled("verify"))
+		{
+			rc = CCProof_PreloadVerifyKeys();
+			if (rc)
+				cerr << "WARNING: unable to preload proof verification keys" << endl;
+		}
+
+		BenchReport report;
+
+		bench_hashes(report);
+		bench_proofs(report);
+		bench_workspace_soak(report);
+		bench_block(report);
+		bench_block_select(report);
+		bench_block_forks(report);
+		bench_write(report);
+		bench_alloc(report);
+
+		if (g_params.output_file.length())
+		{
+			boost::filesystem::ofstream fs;
+			fs.open(g_params.output_file, fstream::out | fstream::trunc);
+			if (!fs.is_open())
+				throw runtime_error(string("Unable to open output file \"") + w2s(g_params.output_file) + "\"");
+
+			report.Output(fs, g_params.format);
+		}
+		else
+			report.Output(cout, g_params.format);
+	}
+	catch (const exception& e)
+	{
+		cerr << "ERROR: " << e.what() << endl;
+
+		result = -1;
+	}
+
+	start_shutdown();
+	wait_for_shutdown();
+
+	finish_handlers();
+
+	return result;
+}
@@ -0,0 +1,52 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * ccbench.h
+*/
+
+#pragma once
+
+#define CCAPPNAME	"CredaCash Benchmark"
+#define CCVERSION	"1.00" //@@!
+#define CCEXENAME	"ccbench"
+
+#include <CCdef.h>
+#include <CCboost.hpp>
+#include <CCbigint.hpp>
+#include <apputil.h>
+#include <osutil.h>
+
+#include <boost/program_options/variables_map.hpp>
+
+DECLARE_EXTERN struct global_params_struct
+{
+	boost::program_options::variables_map config_options;
+
+	wstring process_dir;
+	wstring proof_key_dir;
+	wstring output_file;
+
+	string	tests;
+	string	keys;
+	string	format;
+	string	block_txs;
+	string	select_txs;
+	string	fork_blocks;
+	string	block_placement;
+	string	write_sizes;
+	string	alloc_sizes;
+
+	int		iterations;
+	int		warmup;
+	int		hash_iterations;
+	int		work_iterations;
+	int		soak_iterations;
+	int		block_threads;
+	int		alloc_threads;
+	int		trace_level;
+
+	bool	block_numa_local;
+
+} g_params;
@@ -4,6 +4,7 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
+../src/ccserver/buffer_pool.cpp \
 ../src/ccserver/connection.cpp \
 ../src/ccserver/connection_manager.cpp \
 ../src/ccserver/connection_registry.cpp \
@@ -12,6 +13,7 @@ CPP_SRCS += \
 ../src/ccserver/torservice.cpp 
 
 CPP_DEPS += \
+./src/ccserver/buffer_pool.d \
 ./src/ccserver/connection.d \
 ./src/ccserver/connection_manager.d \
 ./src/ccserver/connection_registry.d \
@@ -20,6 +22,7 @@ CPP_DEPS += \
 ./src/ccserver/torservice.d 
 
 OBJS += \
+./src/ccserver/buffer_pool.o \
 ./src/ccserver/connection.o \
 ./src/ccserver/connection_manager.o \
 ./src/ccserver/connection_registry.o \
@@ -40,7 +43,7 @@ src/ccserver/%.o: ../src/ccserver/%.cpp src/ccserver/subdir.mk
 clean: clean-src-2f-ccserver
 
 clean-src-2f-ccserver:
-	-$(RM) ./src/ccserver/connection.d ./src/ccserver/connection.o ./src/ccserver/connection_manager.d ./src/ccserver/connection_manager.o ./src/ccserver/connection_registry.d ./src/ccserver/connection_registry.o ./src/ccserver/server.d ./src/ccserver/server.o ./src/ccserver/service.d ./src/ccserver/service.o ./src/ccserver/torservice.d ./src/ccserver/torservice.o
+	-$(RM) ./src/ccserver/buffer_pool.d ./src/ccserver/buffer_pool.o ./src/ccserver/connection.d ./src/ccserver/connection.o ./src/ccserver/connection_manager.d ./src/ccserver/connection_manager.o ./src/ccserver/connection_registry.d ./src/ccserver/connection_registry.o ./src/ccserver/server.d ./src/ccserver/server.o ./src/ccserver/service.d ./src/ccserver/service.o ./src/ccserver/torservice.d ./src/ccserver/torservice.o
 
 .PHONY: clean-src-2f-ccserver
 
@@ -44,12 +44,17 @@
 // CC-Message
 #define CC_MSG_HAVE_BLOCK				0xCC4D0001
 #define CC_MSG_HAVE_TX					0xCC4D0002
+#define CC_MSG_COMPACT_BLOCKS_OK		0xCC4D0003	// sender can reply to CC_CMD_SEND_COMPACT_BLOCK
+#define CC_MSG_COMPACT_BLOCK			0xCC4D0004
+#define CC_MSG_BLOCK_TXS				0xCC4D0005
 
 // CC-Command
 #define CC_CMD_PING						0xCC4D0001
 #define CC_CMD_SEND_LEVELS				0xCC430002
 #define CC_CMD_SEND_BLOCK				0xCC430003
 #define CC_CMD_SEND_TX					0xCC430004
+#define CC_CMD_SEND_COMPACT_BLOCK		0xCC430005
+#define CC_CMD_SEND_BLOCK_TXS			0xCC430006
 
 // CC-Acknowledgment
 #define CC_ACK							0xCC530001
@@ -100,6 +105,7 @@
 #define CC_TAG_TX_QUERY_XMATCH_REQNUM	0xCC510007
 #define CC_TAG_TX_QUERY_XMATCH_MATCHNUM	0xCC510008
 #define CC_TAG_TX_QUERY_XMINING_INFO	0xCC510009
+#define CC_TAG_TX_QUERY_ADDRESS_WATCH	0xCC51000A
 
 #define CC_OID_SIZE				(128/8)
 #define CC_OID_TRACE_SIZE		10
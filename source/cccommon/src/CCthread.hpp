@@ -9,22 +9,72 @@
 #pragma once
 
 #include <thread>
+#include <string>
+#include <vector>
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 
+/*
+	A thread role names a group of threads that do the same kind of work, such as validating transactions or serving
+	one of the network services.  A thread calls CCThreadRoles::Apply with its role when it starts.  If a placement was
+	configured for the role, the thread is pinned to the role's CPU's, its nice value and scheduling class are set, and
+	if numa_local is set, its memory is allocated only from the NUMA nodes of those CPU's (the default policy prefers the
+	node the thread is running on, but falls back to other nodes when that node is short of memory).
+
+	A placement is configured with a spec of the form:
+
+		role=cpus[:nice[:sched]][;role=cpus[:nice[:sched]]...]
+
+	where cpus is a list of CPU numbers and ranges such as 0-7,16-23 (or * to leave the thread unpinned), nice is added
+	to the thread's nice value, and sched is other, batch or idle.
+*/
+
+struct CCThreadPlacement
+{
+	std::string role;
+	std::vector<unsigned> cpus;		// empty = not pinned
+	int nice;
+	int sched;						// -1 = unchanged
+	unsigned nthreads;				// threads started in this role
+	unsigned nerrors;				// threads on which the placement could not be fully applied
+};
+
+class CCThreadRoles
+{
+public:
+	/// Parses a placement spec; roles lists the valid role names; throws runtime_error on a bad spec
+	static void Configure(const std::string& spec, bool numa_local, const std::vector<std::string>& roles);
+
+	/// Called by a thread when it starts
+	static void Apply(const char *role);
+
+	static std::string ConfigString();
+	static std::string ReportString();
+};
+
 class CCThread
 	: private boost::noncopyable
 {
 public:
 	std::thread *m_pthread;
+	const char *m_role;
 
 	CCThread()
-		: m_pthread(NULL)
+		: m_pthread(NULL),
+		m_role(NULL)
 	{ }
 
 	virtual void Run(boost::function<void()> threadproc = NULL)
 	{
-		m_pthread = new std::thread(&CCThread::ThreadProc, this, threadproc);
+		m_pthread = new std::thread(&CCThread::Start, this, threadproc);
+	}
+
+	void Start(boost::function<void()> threadproc)
+	{
+		if (m_role)
+			CCThreadRoles::Apply(m_role);
+
+		ThreadProc(threadproc);
 	}
 
 	virtual void ThreadProc(boost::function<void()> threadproc)
@@ -58,11 +108,19 @@ public:
 class CCThreadFactory
 {
 public:
+	const char *m_role;
+
+	CCThreadFactory(const char *role = NULL)
+		: m_role(role)
+	{ }
+
 	virtual ~CCThreadFactory() = default;
 
 	virtual CCThread* NewThread() const
 	{
-		return new CCThread;
+		auto t = new CCThread;
+		t->m_role = m_role;
+		return t;
 	}
 };
 
@@ -70,9 +128,15 @@ template <typename CT>
 class CCThreadFactoryInstantiation : public CCThreadFactory
 {
 public:
+	CCThreadFactoryInstantiation(const char *role = NULL)
+		: CCThreadFactory(role)
+	{ }
+
 	CCThread* NewThread() const
 	{
-		return new CT;
+		auto t = new CT;
+		t->m_role = m_role;
+		return t;
 	}
 };
 
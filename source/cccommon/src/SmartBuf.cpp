@@ -8,12 +8,17 @@
 
 #include "CCdef.h"
 #include "SmartBuf.hpp"
+#include "SpinLock.hpp"
 
 #include <boost/log/trivial.hpp>
 
 using namespace boost::log::trivial;
 
+//#define USE_SMARTBUF_GUARD	0	// guard words catch buffer overruns and use after free, at the cost of a check on every access
+
+#ifndef USE_SMARTBUF_GUARD
 #define USE_SMARTBUF_GUARD		1
+#endif
 
 //!#define RTEST_DELAY_SMARTBUF_RELEASE	32
 
@@ -25,16 +30,284 @@ using namespace boost::log::trivial;
 #define SMARTBUF_GUARD_HI	0x41037396
 #define SMARTBUF_FREE		0x28472919
 
+// buffer layout: [guard] allocinfo refcount nauxptrs [pad] data... [guard]
+// the pad keeps the data, and the aux pointers at its start, 16-byte aligned with or without the guard words
+
+#define SMARTBUF_DATA_ALIGN			16
+#define SMARTBUF_GUARD_BYTES		(USE_SMARTBUF_GUARD * sizeof(uint32_t))
+#define SMARTBUF_REFCOUNT_OFFSET	(SMARTBUF_GUARD_BYTES + sizeof(allocinfo_t))
+#define SMARTBUF_NAUXPTRS_OFFSET	(SMARTBUF_REFCOUNT_OFFSET + sizeof(refcount_t))
+#define SMARTBUF_HEADER_END			(SMARTBUF_NAUXPTRS_OFFSET + sizeof(nauxptrs_t))
+#define SMARTBUF_HEADER_PAD			((SMARTBUF_DATA_ALIGN - SMARTBUF_HEADER_END % SMARTBUF_DATA_ALIGN) % SMARTBUF_DATA_ALIGN)
+#define SMARTBUF_DATA_OFFSET		(SMARTBUF_HEADER_END + SMARTBUF_HEADER_PAD)
+#define SMARTBUF_OVERHEAD			(SMARTBUF_DATA_OFFSET + SMARTBUF_GUARD_BYTES)
+
+#define SMARTBUF_AUX_ZERO_BYTES		32		// always zeroed, which covers the aux pointers and CCObject::Preamble
+
+#define SMARTBUF_SLAB_FLAG			0x80000000	// set in allocinfo when the buffer came from a slab
+
+#define SMARTBUF_SLAB_MIN_SIZE		64
+#define SMARTBUF_SLAB_MAX_SIZE		(32*1024)
+#define SMARTBUF_SLAB_NCLASSES		19			// 64, 96, 128, 192, ... 24K, 32K
+#define SMARTBUF_SLAB_BYTES			(256*1024)
+#define SMARTBUF_CACHE_BYTES		(64*1024)	// max bytes of each size class cached per thread
+
 std::atomic<int64_t> bytecount(0);
 std::atomic<unsigned> objcount(0);
 std::atomic<unsigned> maxobjcount(0);
 std::atomic<unsigned> maxrefcount(0);
 
+static std::atomic<bool> use_slabs(true);
+
+class SmartBufSlabs
+{
+	struct SizeClass
+	{
+		void *free_list;			// linked through the first word of each free buffer
+		unsigned nfree;
+		unsigned nslabs;
+		std::atomic<int64_t> ninuse;
+
+		FastSpinLock lock;
+
+		SizeClass()
+		 :	free_list(NULL),
+			nfree(0),
+			nslabs(0),
+			ninuse(0),
+			lock(__FILE__, __LINE__)
+		{ }
+	};
+
+	SizeClass m_classes[SMARTBUF_SLAB_NCLASSES];
+
+public:
+	struct ThreadCache
+	{
+		void *free_list[SMARTBUF_SLAB_NCLASSES];
+		unsigned nfree[SMARTBUF_SLAB_NCLASSES];
+
+		ThreadCache()
+		{
+			memset(&free_list, 0, sizeof(free_list));
+			memset(&nfree, 0, sizeof(nfree));
+		}
+
+		~ThreadCache();
+	};
+
+	static int Class(size_t nbytes)
+	{
+		if (nbytes > SMARTBUF_SLAB_MAX_SIZE)
+			return -1;
+
+		unsigned c = 0;
+
+		while (ClassSize(c) < nbytes)
+			++c;
+
+		return c;
+	}
+
+	static unsigned ClassSize(unsigned c)
+	{
+		return (SMARTBUF_SLAB_MIN_SIZE << (c / 2)) * (c & 1 ? 3 : 2) / 2;
+	}
+
+	static unsigned CacheMax(unsigned c)
+	{
+		return max(SMARTBUF_CACHE_BYTES / ClassSize(c), 4U);
+	}
+
+	void* Alloc(unsigned c);
+	void Free(unsigned c, void *p);
+
+	void Refill(unsigned c, ThreadCache& cache);
+	void Drain(unsigned c, ThreadCache& cache, unsigned n);
+
+	void LogStats();
+};
+
+// allocated and never freed, so SmartBuf's released during static destruction still have somewhere to go
+
+static SmartBufSlabs *g_smartbuf_slabs = new SmartBufSlabs;
+
+static thread_local SmartBufSlabs::ThreadCache t_smartbuf_cache;
+
+SmartBufSlabs::ThreadCache::~ThreadCache()
+{
+	for (unsigned c = 0; c < SMARTBUF_SLAB_NCLASSES; ++c)
+		g_smartbuf_slabs->Drain(c, *this, nfree[c]);
+}
+
+void* SmartBufSlabs::Alloc(unsigned c)
+{
+	auto& cache = t_smartbuf_cache;
+
+	if (!cache.nfree[c])
+		Refill(c, cache);
+
+	auto p = cache.free_list[c];
+	if (!p)
+		return NULL;
+
+	cache.free_list[c] = *(void**)p;
+	--cache.nfree[c];
+
+	m_classes[c].ninuse.fetch_add(1, std::memory_order_relaxed);
+
+	return p;
+}
+
+void SmartBufSlabs::Free(unsigned c, void *p)
+{
+	auto& cache = t_smartbuf_cache;
+
+	*(void**)p = cache.free_list[c];
+	cache.free_list[c] = p;
+	++cache.nfree[c];
+
+	m_classes[c].ninuse.fetch_sub(1, std::memory_order_relaxed);
+
+	if (cache.nfree[c] > CacheMax(c))
+		Drain(c, cache, CacheMax(c) / 2);
+}
+
+void SmartBufSlabs::Refill(unsigned c, ThreadCache& cache)
+{
+	// moves a batch of free buffers from the shared list to the thread's cache, carving a new slab if needed
+
+	auto& sc = m_classes[c];
+	auto batch = CacheMax(c) / 2;
+
+	{
+		lock_guard<FastSpinLock> lock(sc.lock);
+
+		while (sc.nfree && cache.nfree[c] < batch)
+		{
+			auto p = sc.free_list;
+			sc.free_list = *(void**)p;
+			--sc.nfree;
+
+			*(void**)p = cache.free_list[c];
+			cache.free_list[c] = p;
+			++cache.nfree[c];
+		}
+	}
+
+	if (cache.nfree[c])
+		return;
+
+	auto slab = (uint8_t*)malloc(SMARTBUF_SLAB_BYTES);
+	if (!slab)
+	{
+		BOOST_LOG_TRIVIAL(error) << "SmartBufSlabs::Refill malloc failed for slab of class size " << ClassSize(c);
+
+		return;
+	}
+
+	auto size = ClassSize(c);
+	auto nbufs = SMARTBUF_SLAB_BYTES / size;
+
+	lock_guard<FastSpinLock> lock(sc.lock);
+
+	++sc.nslabs;
+
+	for (unsigned i = 0; i < nbufs; ++i)
+	{
+		auto p = slab + i * size;
+
+		if (i < batch)
+		{
+			*(void**)p = cache.free_list[c];
+			cache.free_list[c] = p;
+			++cache.nfree[c];
+		}
+		else
+		{
+			*(void**)p = sc.free_list;
+			sc.free_list = p;
+			++sc.nfree;
+		}
+	}
+}
+
+void SmartBufSlabs::Drain(unsigned c, ThreadCache& cache, unsigned n)
+{
+	// moves n free buffers from the thread's cache to the shared list
+
+	if (!n)
+		return;
+
+	auto& sc = m_classes[c];
+
+	lock_guard<FastSpinLock> lock(sc.lock);
+
+	for (unsigned i = 0; i < n && cache.free_list[c]; ++i)
+	{
+		auto p = cache.free_list[c];
+		cache.free_list[c] = *(void**)p;
+		--cache.nfree[c];
+
+		*(void**)p = sc.free_list;
+		sc.free_list = p;
+		++sc.nfree;
+	}
+}
+
+void SmartBufSlabs::LogStats()
+{
+	uint64_t reserved = 0;
+
+	for (unsigned c = 0; c < SMARTBUF_SLAB_NCLASSES; ++c)
+	{
+		auto& sc = m_classes[c];
+
+		unsigned nslabs, nfree;
+
+		{
+			lock_guard<FastSpinLock> lock(sc.lock);
+
+			nslabs = sc.nslabs;
+			nfree = sc.nfree;
+		}
+
+		if (!nslabs)
+			continue;
+
+		auto nbufs = (uint64_t)nslabs * (SMARTBUF_SLAB_BYTES / ClassSize(c));
+		auto ninuse = sc.ninuse.load();
+
+		reserved += (uint64_t)nslabs * SMARTBUF_SLAB_BYTES;
+
+		BOOST_LOG_TRIVIAL(info) << "SmartBuf class size " << ClassSize(c) << " slabs " << nslabs << " buffers " << nbufs
+			<< " in use " << ninuse << " occupancy " << (ninuse > 0 ? ninuse * 100 / nbufs : 0) << "%"
+			<< " shared free " << nfree << " thread cached " << nbufs - ninuse - nfree;
+	}
+
+	BOOST_LOG_TRIVIAL(info) << "SmartBuf objects " << objcount.load() << " bytes in use " << bytecount.load() << " slab bytes reserved " << reserved;
+}
+
 int64_t SmartBuf::ByteTotal()
 {
 	return bytecount;
 }
 
+unsigned SmartBuf::ObjTotal()
+{
+	return objcount;
+}
+
+void SmartBuf::SetUseSlabs(bool slabs)
+{
+	use_slabs.store(slabs);
+}
+
+void SmartBuf::LogAllocStats()
+{
+	g_smartbuf_slabs->LogStats();
+}
+
 #if TRACE_SMARTBUF
 SmartBuf::SmartBuf()
 	: buf(NULL)
@@ -44,7 +317,7 @@ SmartBuf::SmartBuf()
 }
 #endif
 
-SmartBuf::SmartBuf(size_t bufsize)
+SmartBuf::SmartBuf(size_t bufsize, bool zero_data)
 	: buf(NULL)
 {
 	if (!bufsize || bufsize > 258*1024*1024)
@@ -54,28 +327,55 @@ SmartBuf::SmartBuf(size_t bufsize)
 		return;
 	}
 
-	auto msize = bufsize;
-	msize += sizeof(refcount_t) + sizeof(nauxptrs_t) + 2 * USE_SMARTBUF_GUARD * sizeof(uint32_t);
+	static_assert(SMARTBUF_DATA_OFFSET % SMARTBUF_DATA_ALIGN == 0, "SmartBuf data is not aligned");
 
-	auto bufp = (uint8_t*)malloc(msize);
+	auto msize = bufsize + SMARTBUF_OVERHEAD;
 
-	buf.store(bufp);
+	int c = -1;
+	if (use_slabs.load())
+		c = SmartBufSlabs::Class(msize);
 
-	auto usize = size(bufp);
+	uint8_t *bufp;
+	allocinfo_t allocinfo;
+
+	if (c >= 0)
+	{
+		bufp = (uint8_t*)g_smartbuf_slabs->Alloc(c);
+		allocinfo = SMARTBUF_SLAB_FLAG | c;
+	}
+	else
+	{
+		bufp = (uint8_t*)malloc(msize);
+		allocinfo = 0;
+		if (bufp)
+		#ifdef _WIN32
+			allocinfo = _msize(bufp);
+		#else
+			allocinfo = malloc_usable_size(bufp);
+		#endif
+	}
 
-	if (TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "SmartBuf " << (uintptr_t)this << " malloc'ed bufp " << (uintptr_t)bufp << " size " << bufsize << " useable size " << usize << " sizeof(refcount_t) " << sizeof(refcount_t) << " required alignment " << std::alignment_of<refcount_t>::value << " size of bufp " << sizeof(buf);
+	if (TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "SmartBuf " << (uintptr_t)this << " allocated bufp " << (uintptr_t)bufp << " size " << bufsize << " size class " << c << " sizeof(refcount_t) " << sizeof(refcount_t) << " required alignment " << std::alignment_of<refcount_t>::value << " size of bufp " << sizeof(buf);
 
 	if (!bufp)
 		return;
 
+	*(allocinfo_t*)(bufp + SMARTBUF_GUARD_BYTES) = allocinfo;
+
+	buf.store(bufp);
+
 	auto asize = alloc_size(bufp);
+	auto usize = size(bufp);
 
 	CCASSERT(asize >= msize);
 	CCASSERT(usize >= bufsize);
 
-	memset(bufp, 0, asize);
+	if (zero_data)
+		memset(bufp + SMARTBUF_REFCOUNT_OFFSET, 0, asize - SMARTBUF_REFCOUNT_OFFSET);
+	else
+		memset(bufp + SMARTBUF_REFCOUNT_OFFSET, 0, SMARTBUF_DATA_OFFSET - SMARTBUF_REFCOUNT_OFFSET + min(usize, (size_t)SMARTBUF_AUX_ZERO_BYTES));
 
-	if (0 && TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "SmartBuf " << (uintptr_t)this << " zero'ed bufp " << (uintptr_t)bufp << " size " << asize;
+	if (0 && TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "SmartBuf " << (uintptr_t)this << " zero'ed bufp " << (uintptr_t)bufp << " size " << asize << " zero data " << zero_data;
 
 	if (USE_SMARTBUF_GUARD)
 	{
@@ -154,11 +454,12 @@ void SmartBuf::CheckGuard(const uint8_t* bufp, bool refcount_iszero) const
 
 size_t SmartBuf::alloc_size(const uint8_t* bufp)
 {
-#ifdef _WIN32
-	return _msize((void*)bufp);
-#else
-	return malloc_usable_size((void*)bufp);
-#endif
+	auto allocinfo = *(const allocinfo_t*)(bufp + SMARTBUF_GUARD_BYTES);
+
+	if (allocinfo & SMARTBUF_SLAB_FLAG)
+		return SmartBufSlabs::ClassSize(allocinfo & ~SMARTBUF_SLAB_FLAG);
+
+	return allocinfo;
 }
 
 std::size_t SmartBuf::size() const
@@ -179,7 +480,7 @@ size_t SmartBuf::size(const uint8_t* bufp)
 	if (!asize)
 		return 0;
 
-	asize -= sizeof(refcount_t) + sizeof(nauxptrs_t) + 2 * USE_SMARTBUF_GUARD * sizeof(uint32_t);
+	asize -= SMARTBUF_OVERHEAD;
 
 	return asize;
 }
@@ -194,21 +495,21 @@ uint8_t* SmartBuf::data(int refcount_iszero) const
 
 	if (USE_SMARTBUF_GUARD && refcount_iszero >= 0) CheckGuard(bufp, refcount_iszero);
 
-	return bufp + sizeof(refcount_t) + sizeof(nauxptrs_t) + USE_SMARTBUF_GUARD * sizeof(uint32_t);
+	return bufp + SMARTBUF_DATA_OFFSET;
 }
 
 void SmartBuf::SetAuxPtrCount(unsigned count)
 {
 	auto bufp = buf.load();
 
-	*((nauxptrs_t*)(bufp + sizeof(refcount_t) + USE_SMARTBUF_GUARD * sizeof(uint32_t))) = count;
+	*((nauxptrs_t*)(bufp + SMARTBUF_NAUXPTRS_OFFSET)) = count;
 }
 
 unsigned SmartBuf::GetAuxPtrCount() const
 {
 	auto bufp = buf.load();
 
-	auto count = *((nauxptrs_t*)(bufp + sizeof(refcount_t) + USE_SMARTBUF_GUARD * sizeof(uint32_t)));
+	auto count = *((nauxptrs_t*)(bufp + SMARTBUF_NAUXPTRS_OFFSET));
 
 	if (count > 20)
 	{
@@ -223,12 +524,12 @@ unsigned SmartBuf::GetAuxPtrCount() const
 
 void SmartBuf::SetRefCount(const uint8_t* bufp, unsigned count)
 {
-	*((refcount_t*)(bufp + USE_SMARTBUF_GUARD * sizeof(uint32_t))) = count;
+	*((refcount_t*)(bufp + SMARTBUF_REFCOUNT_OFFSET)) = count;
 }
 
 unsigned SmartBuf::GetRefCount(const uint8_t* bufp)
 {
-	return ((refcount_t*)(bufp + USE_SMARTBUF_GUARD * sizeof(uint32_t)))->load();
+	return ((refcount_t*)(bufp + SMARTBUF_REFCOUNT_OFFSET))->load();
 }
 
 unsigned SmartBuf::IncRef()
@@ -239,7 +540,7 @@ unsigned SmartBuf::IncRef()
 
 	//if (TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "SmartBuf " << (uintptr_t)this << " IncRef bufp " << (uintptr_t)bufp;
 
-	auto refcount = ((refcount_t*)(bufp + USE_SMARTBUF_GUARD * sizeof(uint32_t)))->fetch_add(1) + 1;
+	auto refcount = ((refcount_t*)(bufp + SMARTBUF_REFCOUNT_OFFSET))->fetch_add(1) + 1;
 
 	if (!refcount)
 	{
@@ -277,7 +578,7 @@ unsigned SmartBuf::DecRef(bool test_delay)
 
 	if (USE_SMARTBUF_GUARD) CheckGuard(bufp);
 
-	auto refcount = ((refcount_t*)(bufp + USE_SMARTBUF_GUARD * sizeof(uint32_t)))->fetch_sub(1) - 1;
+	auto refcount = ((refcount_t*)(bufp + SMARTBUF_REFCOUNT_OFFSET))->fetch_sub(1) - 1;
 
 	if (0 && TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "SmartBuf " << (uintptr_t)this << " DecRef bufp " << (uintptr_t)bufp << " to refcount " << refcount;
 
@@ -317,7 +618,12 @@ unsigned SmartBuf::DecRef(bool test_delay)
 			}
 		}
 
-		free(bufp);
+		auto allocinfo = *(allocinfo_t*)(bufp + SMARTBUF_GUARD_BYTES);
+
+		if (allocinfo & SMARTBUF_SLAB_FLAG)
+			g_smartbuf_slabs->Free(allocinfo & ~SMARTBUF_SLAB_FLAG, bufp);
+		else
+			free(bufp);
 
 		bytecount -= asize;
 
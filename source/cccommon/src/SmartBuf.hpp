@@ -19,8 +19,14 @@
 #define TRACE_SMARTBUF		0
 #endif
 
+// Buffers up to 32 KB are carved from slabs in power of two and 1.5 x power of two size classes.  Each thread keeps a
+// small cache of free buffers of each class, and moves them to or from a shared free list in batches, so most
+// allocations and frees take no lock.  Slab memory is kept for reuse and not returned to the heap.  Larger buffers
+// are allocated with malloc.
+
 class SmartBuf
 {
+	typedef std::uint32_t allocinfo_t;			// slab size class, or size of a malloc'ed buffer
 	typedef std::atomic<std::uint32_t> refcount_t;
 	typedef volatile std::uint32_t nauxptrs_t;	// volatile in case a SmartBuf instance is accessed from more than one thread
 
@@ -31,6 +37,13 @@ class SmartBuf
 public:
 
 	static int64_t ByteTotal();
+	static unsigned ObjTotal();
+
+	/// Buffers allocated after this call come from the slabs if true, or from malloc if false
+	static void SetUseSlabs(bool use_slabs);
+
+	/// Logs the number of slabs and buffers in use in each size class
+	static void LogAllocStats();
 
 #if TRACE_SMARTBUF
 	SmartBuf();
@@ -40,7 +53,9 @@ public:
 	{ }
 #endif
 
-	SmartBuf(std::size_t bufsize);
+	/// If zero_data is false, only the header and the aux pointer area at the front of the data are zeroed,
+	/// so the caller must write every byte of the data that it later reads
+	SmartBuf(std::size_t bufsize, bool zero_data = true);
 
 	void CheckGuard(const std::uint8_t* bufp, bool refcount_iszero = false) const;
 
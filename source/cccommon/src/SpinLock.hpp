@@ -11,149 +11,387 @@
 #include <atomic>
 #include <mutex>
 #include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
 #include <CCassert.h>
 
 #include "CCticks.hpp"
 
-#define TRACE_SPINLOCK	0
-
 //!#define RTEST_CUZZ_SPINLOCK		64
 
 #ifndef RTEST_CUZZ_SPINLOCK
 #define RTEST_CUZZ_SPINLOCK		0	// don't test
 #endif
 
-class FastSpinLock
-{
-	std::atomic_flag mutex;
+//#define SPINLOCK_MAX_SPINS		0	// park immediately
+
+#ifndef SPINLOCK_MAX_SPINS
+#define SPINLOCK_MAX_SPINS		100		// times to retry with backoff before parking the thread
+#endif
+
+#define SPINLOCK_MAX_BACKOFF	64		// maximum pause instructions between retries
+
+/*
+	Contention profiler for FastSpinLock and SpinLock
 
-	#if TRACE_SPINLOCK
-	std::string file;
-	unsigned line;
-	std::uint64_t max_spin;
-	#endif
+	While enabled, each unlock records the time the thread waited to acquire the lock and the time it held it, summed
+	per lock site (the __FILE__ and __LINE__ passed to the lock constructor).  Report writes the sites with the highest
+	total wait time.  While disabled, the cost is one relaxed load per lock and unlock.
+*/
 
+class SpinLockProfiler
+{
 public:
+	static const unsigned NSITES = 1024;
 
-	FastSpinLock(const char *_file, unsigned _line)
+	struct Site
+	{
+		std::atomic<std::uint64_t> key;			// zero if unused
+		std::atomic<const char*> file;
+		std::atomic<unsigned> line;
+		std::atomic<std::uint64_t> nlocks;
+		std::atomic<std::uint64_t> ncontended;
+		std::atomic<std::uint64_t> nparked;
+		std::atomic<std::uint64_t> wait_ns;
+		std::atomic<std::uint64_t> max_wait_ns;
+		std::atomic<std::uint64_t> hold_ns;
+		std::atomic<std::uint64_t> max_hold_ns;
+	};
+
+	static bool IsEnabled()
 	{
-		mutex.clear();
+		return Enabled().load(std::memory_order_relaxed);
+	}
 
-		#if TRACE_SPINLOCK
-		file = _file;
-		line = _line;
-		max_spin = 0;
-		#endif
+	static void Enable(bool enable)
+	{
+		Enabled().store(enable);
 	}
 
-	~FastSpinLock()
+	static std::uint64_t Now()
 	{
-		CCASSERTZ(mutex.test_and_set());
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 	}
 
-	void lock()
+	static void Record(const char *file, unsigned line, std::uint64_t wait_ns, std::uint64_t hold_ns, bool contended, bool parked)
 	{
-		#if TRACE_SPINLOCK
-		//std::cout << "FastSpinLock " << (uintptr_t)this << " locking..." << std::endl;
-		auto t0 = highres_ticks();
-		std::uint64_t spin = 0;
-		#endif
+		auto site = FindSite(file, line);
+		if (!site)
+			return;
 
-		while (mutex.test_and_set())
-		#if TRACE_SPINLOCK
-			++spin;
-		#endif
-			;;;
+		site->nlocks.fetch_add(1, std::memory_order_relaxed);
 
-		#if TRACE_SPINLOCK
-		auto dt = highres_ticks() - t0;
-		if (spin > max_spin)
-			max_spin = spin;
-		if (spin >= max_spin/10*9 && report_highres_ticks(dt))
-			std::cout << "FastSpinLock " << (uintptr_t)this << " " << file << " " << line << " locked in " << dt << " spin " << spin << " max_spin " << max_spin << std::endl;
-		#endif
+		if (contended)
+			site->ncontended.fetch_add(1, std::memory_order_relaxed);
+
+		if (parked)
+			site->nparked.fetch_add(1, std::memory_order_relaxed);
+
+		site->wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+		site->hold_ns.fetch_add(hold_ns, std::memory_order_relaxed);
+
+		StoreMax(site->max_wait_ns, wait_ns);
+		StoreMax(site->max_hold_ns, hold_ns);
 	}
 
-	void unlock()
+	/// Writes one line for each of the nsites sites with the highest total wait time
+	static void Report(std::ostream& out, unsigned nsites)
 	{
-		//if (TRACE_SPINLOCK) std::cout << "FastSpinLock " << (uintptr_t)this << " unlocking" << std::endl;
+		auto sites = Sites();
+		std::vector<const Site*> hot;
 
-		mutex.clear();
+		for (unsigned i = 0; i < NSITES; ++i)
+		{
+			if (sites[i].file.load() && sites[i].nlocks.load())
+				hot.push_back(&sites[i]);
+		}
 
-		//if (RandTest(RTEST_CUZZ_SPINLOCK)) usleep(rand() & 63);
+		std::sort(hot.begin(), hot.end(), [](const Site *a, const Site *b)
+		{
+			return a->wait_ns.load() > b->wait_ns.load();
+		});
+
+		if (hot.size() > nsites)
+			hot.resize(nsites);
+
+		for (auto site : hot)
+		{
+			auto nlocks = site->nlocks.load();
+
+			out << "lock site " << site->file.load() << ":" << site->line.load()
+				<< " locks " << nlocks << " contended " << site->ncontended.load() << " parked " << site->nparked.load()
+				<< " wait ms total " << site->wait_ns.load() / 1000000 << " mean us " << site->wait_ns.load() / nlocks / 1000 << " max us " << site->max_wait_ns.load() / 1000
+				<< " hold ms total " << site->hold_ns.load() / 1000000 << " mean us " << site->hold_ns.load() / nlocks / 1000 << " max us " << site->max_hold_ns.load() / 1000
+				<< std::endl;
+		}
+	}
+
+private:
+	static std::atomic<bool>& Enabled()
+	{
+		static std::atomic<bool> enabled(false);
+
+		return enabled;
+	}
+
+	static Site* Sites()
+	{
+		static Site sites[NSITES];	// zero initialized
+
+		return sites;
+	}
+
+	static Site* FindSite(const char *file, unsigned line)
+	{
+		std::uint64_t key = ((std::uint64_t)(std::uintptr_t)file << 16) ^ line;
+		if (!key)
+			return NULL;
+
+		auto sites = Sites();
+		auto hash = key * 0x9E3779B97F4A7C15ULL;
+
+		for (unsigned i = 0; i < NSITES; ++i)
+		{
+			auto site = &sites[(hash >> 40) % NSITES];
+			++hash;
+
+			auto k = site->key.load();
+			if (k == key)
+				return site;
+
+			if (!k)
+			{
+				if (site->key.compare_exchange_strong(k, key))
+				{
+					site->line.store(line);
+					site->file.store(file);
+
+					return site;
+				}
+
+				if (k == key)
+					return site;
+			}
+		}
+
+		return NULL;	// table full
+	}
+
+	static void StoreMax(std::atomic<std::uint64_t>& max, std::uint64_t val)
+	{
+		auto cur = max.load(std::memory_order_relaxed);
+
+		while (val > cur && !max.compare_exchange_weak(cur, val, std::memory_order_relaxed))
+			;;;
 	}
 };
 
+/*
+	FastSpinLock is a non-recursive lock that spins for a short time with exponential backoff, and then parks the thread
+	on a futex until the lock is released, so a thread waiting on a lock that is held across non-trivial work does not
+	keep a core busy that the holder may need.
 
-class SpinLock	// re-entrant
+	m_state is 0 when unlocked, 1 when locked, and 2 when locked and a thread may be parked waiting for it.
+*/
+
+class FastSpinLock
 {
-	std::atomic_flag mutex;
-	std::atomic<std::uint32_t> count;
-	std::atomic<std::thread::id> threadid;	// value only used when count > 0
+	std::atomic<std::uint32_t> m_state;
+
+	const char *m_file;
+	unsigned m_line;
+
+	// used only by the profiler, and only accessed while locked
+	std::uint64_t m_lock_ns;
+	std::uint64_t m_wait_ns;
+	bool m_contended;
+	bool m_parked;
+
+	static void Pause()
+	{
+		#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+		#elif defined(__aarch64__)
+		asm volatile("yield");
+		#endif
+	}
+
+	void Park()
+	{
+		#ifdef __linux__
+		syscall(SYS_futex, (std::uint32_t*)&m_state, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+		#else
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+		#endif
+	}
+
+	void Wake()
+	{
+		#ifdef __linux__
+		syscall(SYS_futex, (std::uint32_t*)&m_state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+		#endif
+	}
+
+	void LockSlow(bool profile)
+	{
+		std::uint64_t t0 = (profile ? SpinLockProfiler::Now() : 0);
+		bool parked = false;
+		unsigned backoff = 1;
+
+		for (unsigned i = 0; i < SPINLOCK_MAX_SPINS; ++i)
+		{
+			for (unsigned j = 0; j < backoff; ++j)
+				Pause();
+
+			if (backoff < SPINLOCK_MAX_BACKOFF)
+				backoff *= 2;
+
+			std::uint32_t expected = 0;
+			if (m_state.load(std::memory_order_relaxed) == 0 && m_state.compare_exchange_weak(expected, 1, std::memory_order_acquire))
+				goto locked;
+		}
+
+		while (m_state.exchange(2, std::memory_order_acquire))
+		{
+			parked = true;
+
+			Park();
+		}
+
+	locked:
+
+		if (profile)
+		{
+			m_lock_ns = SpinLockProfiler::Now();
+			m_wait_ns = m_lock_ns - t0;
+			m_contended = true;
+			m_parked = parked;
+		}
+	}
 
 public:
 
-	SpinLock()
-	 :	count(0)
+	FastSpinLock(const char *_file, unsigned _line)
+	 :	m_state(0),
+		m_file(_file),
+		m_line(_line),
+		m_lock_ns(0)
 	{
-		mutex.clear();
+		static_assert(sizeof(m_state) == sizeof(std::uint32_t), "futex requires a 32-bit word");
 	}
 
-	~SpinLock()
+	~FastSpinLock()
 	{
-		CCASSERTZ(mutex.test_and_set());
-		CCASSERTZ(count.load());
+		CCASSERTZ(m_state.load());
 	}
 
 	void lock()
 	{
-		while (true)
+		bool profile = SpinLockProfiler::IsEnabled();
+
+		std::uint32_t expected = 0;
+		if (!m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+			return LockSlow(profile);
+
+		if (profile)
+		{
+			m_lock_ns = SpinLockProfiler::Now();
+			m_wait_ns = 0;
+			m_contended = false;
+			m_parked = false;
+		}
+	}
+
+	bool try_lock()
+	{
+		std::uint32_t expected = 0;
+		if (!m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+			return false;
+
+		if (SpinLockProfiler::IsEnabled())
 		{
-			while (mutex.test_and_set())
-				;;;
+			m_lock_ns = SpinLockProfiler::Now();
+			m_wait_ns = 0;
+			m_contended = false;
+			m_parked = false;
+		}
 
-			//if (TRACE_SPINLOCK) std::cout << "thread " << std::this_thread::get_id() << " SpinLock lock " << (std::uintptr_t)this << " owning thread " << threadid.load() << " count " << count.load() << std::endl;
+		return true;
+	}
 
-			if (!count.load())
-			{
-				count.store(1);
-				threadid.store(std::this_thread::get_id());
-				mutex.clear();
-				return;
-			}
+	void unlock()
+	{
+		if (m_lock_ns)
+		{
+			if (SpinLockProfiler::IsEnabled())
+				SpinLockProfiler::Record(m_file, m_line, m_wait_ns, SpinLockProfiler::Now() - m_lock_ns, m_contended, m_parked);
 
-			if (threadid.load() == std::this_thread::get_id())
-			{
-				count.fetch_add(1);
-				mutex.clear();
-				return;
-			}
+			m_lock_ns = 0;
+		}
+
+		if (m_state.exchange(0, std::memory_order_release) == 2)
+			Wake();
 
-			mutex.clear();
+		//if (RandTest(RTEST_CUZZ_SPINLOCK)) usleep(rand() & 63);
+	}
+};
 
-			std::atomic<std::uint32_t> spinner;
+class SpinLock	// re-entrant
+{
+	FastSpinLock m_lock;
+	std::uint32_t m_count;					// only accessed by the owning thread
+	std::atomic<std::thread::id> m_threadid;	// id of the owning thread, or default id when unlocked
 
-			for (unsigned i = 0; i < 20; ++i)
-				spinner.fetch_add(1);
+public:
+
+	SpinLock(const char *_file = __FILE__, unsigned _line = __LINE__)
+	 :	m_lock(_file, _line),
+		m_count(0),
+		m_threadid(std::thread::id())
+	{ }
+
+	~SpinLock()
+	{
+		CCASSERTZ(m_count);
+	}
+
+	void lock()
+	{
+		if (m_threadid.load(std::memory_order_relaxed) == std::this_thread::get_id())
+		{
+			++m_count;
+			return;
 		}
+
+		m_lock.lock();
+
+		m_threadid.store(std::this_thread::get_id(), std::memory_order_relaxed);
+		m_count = 1;
 	}
 
 	void unlock()
 	{
-			while (mutex.test_and_set())
-				;;;
+		CCASSERT(m_threadid.load(std::memory_order_relaxed) == std::this_thread::get_id());
 
-			//if (TRACE_SPINLOCK) std::cout << "thread " << std::this_thread::get_id() << " SpinLock unlock " << (std::uintptr_t)this << " owning thread " << threadid.load() << " count " << count.load() << std::endl;
+		CCASSERT(m_count);
 
-			CCASSERT(threadid.load() == std::this_thread::get_id());
+		if (--m_count)
+			return;
 
-			CCASSERT(count.fetch_sub(1));
+		m_threadid.store(std::thread::id(), std::memory_order_relaxed);
 
-			mutex.clear();
+		m_lock.unlock();
 
-			if (RandTest(RTEST_CUZZ_SPINLOCK)) usleep(rand() & 63);
+		if (RandTest(RTEST_CUZZ_SPINLOCK)) usleep(rand() & 63);
 	}
 };
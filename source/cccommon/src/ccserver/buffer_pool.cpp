@@ -0,0 +1,144 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * buffer_pool.cpp
+*/
+
+#include "CCdef.h"
+#include "CCboost.hpp"
+#include "buffer_pool.hpp"
+#include "connection.hpp"
+
+CCServer::BufferPool g_connbufpool;
+
+namespace CCServer {
+
+unsigned BufferPool::SizeClass(unsigned nbytes)
+{
+	unsigned c = 0;
+
+	while (c < NCLASSES - 1 && ((size_t)1 << (c + MIN_CLASS)) < nbytes)
+		++c;
+
+	CCASSERT(((size_t)1 << (c + MIN_CLASS)) >= nbytes);
+
+	return c;
+}
+
+void BufferPool::SetMaxPooledBytes(uint64_t nbytes)
+{
+	lock_guard<FastSpinLock> lock(m_buffer_pool_lock);
+
+	m_max_pooled_bytes = nbytes;
+
+	for (int c = NCLASSES - 1; c >= 0 && m_stats.pooled_bytes > m_max_pooled_bytes; --c)
+	{
+		while (m_free_buffers[c].size() && m_stats.pooled_bytes > m_max_pooled_bytes)
+		{
+			m_free_buffers[c].pop_back();
+			m_stats.pooled_bytes -= (size_t)1 << (c + MIN_CLASS);
+		}
+	}
+}
+
+void BufferPool::Acquire(vector<char>& buf, unsigned nbytes)
+{
+	CCASSERT(buf.empty());
+
+	if (!nbytes)
+		return;
+
+	auto c = SizeClass(nbytes);
+	size_t classbytes = (size_t)1 << (c + MIN_CLASS);
+	bool hit = false;
+
+	{
+		lock_guard<FastSpinLock> lock(m_buffer_pool_lock);
+
+		++m_stats.acquires;
+
+		if (m_free_buffers[c].size())
+		{
+			buf.swap(m_free_buffers[c].back());
+			m_free_buffers[c].pop_back();
+
+			m_stats.pooled_bytes -= classbytes;
+			m_stats.outstanding_bytes += classbytes;
+			++m_stats.hits;
+
+			hit = true;
+		}
+	}
+
+	if (!hit)
+	{
+		// allocate outside the lock; the full class size is allocated so the buffer can be reused for any size in the class
+
+		buf.resize(classbytes);
+
+		lock_guard<FastSpinLock> lock(m_buffer_pool_lock);
+
+		m_stats.outstanding_bytes += classbytes;
+	}
+
+	CCASSERT(buf.capacity() == classbytes);
+
+	buf.resize(nbytes);		// never reallocates since nbytes <= capacity
+
+	if (TRACE_CCSERVER) BOOST_LOG_TRIVIAL(trace) << "BufferPool::Acquire nbytes " << nbytes << " class size " << classbytes << " hit " << hit;
+}
+
+void BufferPool::Release(vector<char>& buf)
+{
+	size_t classbytes = buf.capacity();
+
+	if (!classbytes)
+		return;
+
+	auto c = SizeClass(classbytes);
+
+	if (classbytes == ((size_t)1 << (c + MIN_CLASS)))
+	{
+		lock_guard<FastSpinLock> lock(m_buffer_pool_lock);
+
+		++m_stats.releases;
+		m_stats.outstanding_bytes -= classbytes;
+
+		if (m_stats.pooled_bytes + classbytes <= m_max_pooled_bytes)
+		{
+			m_free_buffers[c].emplace_back();
+			m_free_buffers[c].back().swap(buf);
+
+			m_stats.pooled_bytes += classbytes;
+		}
+		else
+			++m_stats.discards;
+	}
+
+	// if the buffer wasn't pooled, free it outside the lock
+
+	vector<char>().swap(buf);
+}
+
+void BufferPool::GetStats(BufferPoolStats& stats)
+{
+	lock_guard<FastSpinLock> lock(m_buffer_pool_lock);
+
+	stats = m_stats;
+}
+
+void BufferPool::LogStats()
+{
+	BufferPoolStats stats;
+
+	GetStats(stats);
+
+	BOOST_LOG_TRIVIAL(info) << "BufferPool acquires " << stats.acquires << " hits " << stats.hits
+		<< " hit rate " << (stats.acquires ? stats.hits * 100 / stats.acquires : 0) << "%"
+		<< " releases " << stats.releases << " discards " << stats.discards
+		<< " pooled bytes " << stats.pooled_bytes << " outstanding bytes " << stats.outstanding_bytes << " max pooled bytes " << m_max_pooled_bytes;
+}
+
+} // namespace CCServer
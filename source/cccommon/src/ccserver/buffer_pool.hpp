@@ -0,0 +1,75 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * buffer_pool.hpp
+*/
+
+#pragma once
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+#include <SpinLock.hpp>
+
+using namespace std;
+
+namespace CCServer {
+
+struct BufferPoolStats
+{
+	uint64_t acquires;				// buffers requested
+	uint64_t hits;					// requests satisfied from the pool
+	uint64_t releases;				// buffers returned
+	uint64_t discards;				// returned buffers freed because the pool was full
+	uint64_t pooled_bytes;			// bytes held in the pool
+	uint64_t outstanding_bytes;		// bytes in buffers currently borrowed
+};
+
+/// Pool of connection read and write buffers
+///
+/// Buffers are grouped into power of two size classes.  A buffer is borrowed when a connection is taken from its
+/// ConnectionManager's free list and returned when the connection is freed, so idle connections hold no buffer memory.
+/// A returned buffer is kept for reuse unless that would put the total size of the pooled buffers over the cap.
+
+class BufferPool
+	: private boost::noncopyable
+{
+public:
+	BufferPool()
+	 :	m_max_pooled_bytes(64 << 20),
+		m_buffer_pool_lock(__FILE__, __LINE__)
+	{
+		memset(&m_stats, 0, sizeof(m_stats));
+	}
+
+	void SetMaxPooledBytes(uint64_t nbytes);
+
+	/// Sets buf to a buffer with size nbytes
+	void Acquire(vector<char>& buf, unsigned nbytes);
+
+	/// Returns buf to the pool and leaves it empty
+	void Release(vector<char>& buf);
+
+	void GetStats(BufferPoolStats& stats);
+
+	void LogStats();
+
+protected:
+	static unsigned SizeClass(unsigned nbytes);
+
+	static const unsigned MIN_CLASS = 12;		// 4 KB
+	static const unsigned NCLASSES = 20;		// up to 2 GB
+
+	vector<vector<char>> m_free_buffers[NCLASSES];
+
+	uint64_t m_max_pooled_bytes;
+	BufferPoolStats m_stats;
+
+	FastSpinLock m_buffer_pool_lock;
+};
+
+} // namespace CCServer
+
+extern CCServer::BufferPool g_connbufpool;
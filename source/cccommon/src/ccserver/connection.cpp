@@ -11,6 +11,7 @@
 #include "connection.hpp"
 #include "connection_manager.hpp"
 #include "connection_registry.hpp"
+#include "buffer_pool.hpp"
 #include "socks.hpp"
 
 #define TRACE_CCSERVER_OPSCOUNT		0
@@ -86,8 +87,10 @@ Connection::Connection(ConnectionManagerBase& manager, boost::asio::io_service&
 		m_noclose(connfac.m_noclose),
 		m_socket(io_service),
 		m_incoming(0),
-		m_readbuf(connfac.m_conn_nreadbuf),
-		m_writebuf(connfac.m_conn_nwritebuf),
+		m_tor_connect_ticks(0),
+		m_tor_pooled(0),
+		m_nreadbuf(connfac.m_conn_nreadbuf),
+		m_nwritebuf(connfac.m_conn_nwritebuf),
 		m_pread(NULL),
 		m_maxread(0),
 		m_nred(0),
@@ -95,13 +98,18 @@ Connection::Connection(ConnectionManagerBase& manager, boost::asio::io_service&
 		m_stopping(-9999),
 		m_ops_pending(0)
 {
-	CCASSERT(m_headersize <= m_readbuf.size() - 1);
+	CCASSERT(m_headersize <= m_nreadbuf - 1);
 
-	CCASSERT(m_readbuf.size() == connfac.m_conn_nreadbuf);
-	CCASSERT(m_writebuf.size() == connfac.m_conn_nwritebuf);
+	// when the manager pools buffers, they are borrowed when the connection is taken from the free list
 
-	CCASSERT(m_readbuf.capacity() == connfac.m_conn_nreadbuf);
-	CCASSERT(m_writebuf.capacity() == connfac.m_conn_nwritebuf);
+	if (!manager.UsesBufferPool())
+	{
+		m_readbuf.resize(m_nreadbuf);
+		m_writebuf.resize(m_nwritebuf);
+
+		CCASSERT(m_readbuf.capacity() == connfac.m_conn_nreadbuf);
+		CCASSERT(m_writebuf.capacity() == connfac.m_conn_nwritebuf);
+	}
 
 	m_conn_index = g_connregistry.RegisterConn(this, connfac.m_register);
 
@@ -126,6 +134,26 @@ void Connection::InitNewConnection()
 	m_write_in_progress.clear();
 	m_pread = m_readbuf.data();
 	m_nred = 0;
+	m_outgoing_host.clear();
+}
+
+void Connection::AcquireBuffers()
+{
+	if (m_readbuf.empty())
+		g_connbufpool.Acquire(m_readbuf, m_nreadbuf);
+
+	if (m_writebuf.empty())
+		g_connbufpool.Acquire(m_writebuf, m_nwritebuf);
+
+	m_pread = m_readbuf.data();
+}
+
+void Connection::ReleaseBuffers()
+{
+	g_connbufpool.Release(m_readbuf);
+	g_connbufpool.Release(m_writebuf);
+
+	m_pread = NULL;
 }
 
 /*
@@ -324,10 +352,21 @@ void Connection::HandleConnectOutgoingTor(unsigned proxy_port, const string& hos
 	if (TRACE_CCSERVER) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " Connection::HandleConnectOutgoingTor torproxy port " << proxy_port << " host " << host << " toruser " << toruser;
 
 	m_conn_state = CONN_CONNECTING;
+	m_outgoing_host = host;
 
 	if (SetTimer(TOR_TIMEOUT))
 		return;
 
+	m_tor_connect_ticks = ccticks();
+	m_tor_pooled = g_sockspool.Lease(m_socket, host, toruser);
+
+	if (m_tor_pooled)
+	{
+		BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " using pooled torproxy connection to host " << host;
+
+		return StartConnection();
+	}
+
 	auto dest = Socks::ConnectPoint(proxy_port);
 
 	boost::system::error_code e;
@@ -417,6 +456,8 @@ void Connection::HandleTorProxyRead(const string host, const boost::system::erro
 
 	BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " Connection::HandleTorProxyRead ok";
 
+	g_sockspool.RecordSetupTime(ccticks_elapsed(m_tor_connect_ticks, ccticks()), false);
+
 	StartConnection();
 }
 
@@ -709,8 +750,23 @@ void Connection::HandleReadComplete()
 	event_condition_variable.notify_all();
 }
 
-//@@! add a function parameter that determines if timer is cancelled?
-bool Connection::WriteAsync(const char *function, boost::asio::const_buffer buffer, WriteHandler handler, bool already_own_mutex)
+void WriteBuffers::Consume(size_t nbytes)
+{
+	unsigned i = 0;
+
+	while (i < buffers.size() && nbytes >= boost::asio::buffer_size(buffers[i]))
+		nbytes -= boost::asio::buffer_size(buffers[i++]);
+
+	buffers.erase(buffers.begin(), buffers.begin() + i);
+
+	if (buffers.size())
+		buffers[0] = buffers[0] + nbytes;
+}
+
+// acquires the right to write, then calls start_write to start the async_write
+
+template <typename StartWrite>
+bool Connection::WriteAsyncWithLock(const char *function, bool already_own_mutex, StartWrite start_write)
 {
 	{
 		// if multiple threads are trying to write, then queuing up on this mutex should help prevent thread starvation
@@ -765,7 +821,7 @@ bool Connection::WriteAsync(const char *function, boost::asio::const_buffer buff
 
 		//auto part = boost::asio::buffer(buffer.data(), min(buffer.size(), size_t(64*1024)));
 
-		boost::asio::async_write(m_socket, buffer, boost::bind(&Connection::CheckWriteComplete, this, function, buffer, handler, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+		start_write();
 	}
 
 	if (RandTest(RTEST_CUZZ_CONN)) sleep(1);
@@ -773,6 +829,25 @@ bool Connection::WriteAsync(const char *function, boost::asio::const_buffer buff
 	return false;
 }
 
+//@@! add a function parameter that determines if timer is cancelled?
+bool Connection::WriteAsync(const char *function, boost::asio::const_buffer buffer, WriteHandler handler, bool already_own_mutex)
+{
+	return WriteAsyncWithLock(function, already_own_mutex, [&]
+	{
+		boost::asio::async_write(m_socket, buffer, boost::bind(&Connection::CheckWriteComplete, this, function, buffer, handler, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+	});
+}
+
+bool Connection::WriteAsync(const char *function, shared_ptr<WriteBuffers> buffers, WriteHandler handler, bool already_own_mutex)
+{
+	return WriteAsyncWithLock(function, already_own_mutex, [&]
+	{
+		auto total_size = buffers->TotalSize();
+
+		boost::asio::async_write(m_socket, buffers->buffers, boost::bind(&Connection::CheckWriteBuffersComplete, this, function, buffers, total_size, handler, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+	});
+}
+
 void Connection::CheckWriteComplete(const char *function, boost::asio::const_buffer buffer, WriteHandler handler, const boost::system::error_code& e, size_t bytes_transferred)
 {
 	if (e)
@@ -812,6 +887,47 @@ void Connection::CheckWriteComplete(const char *function, boost::asio::const_buf
 	}
 }
 
+void Connection::CheckWriteBuffersComplete(const char *function, shared_ptr<WriteBuffers> buffers, size_t total_size, WriteHandler handler, const boost::system::error_code& e, size_t bytes_transferred)
+{
+	if (e)
+	{
+		BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " " << function << " CheckWriteBuffersComplete bytes_transferred " << bytes_transferred << " error " << e << " " << e.message();
+
+		return handler(e, bytes_transferred);
+	}
+
+	if (RandTest(RTEST_WRITE_ERRORS))
+	{
+		BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " " << function << " simulating write error";
+
+		return handler(boost::system::errc::make_error_code(boost::system::errc::address_family_not_supported), bytes_transferred);
+	}
+
+	if (bytes_transferred < total_size)
+	{
+		BOOST_LOG_TRIVIAL(warning) << Name() << " Conn " << m_conn_index << " " << function << " CheckWriteBuffersComplete bytes_transferred " << bytes_transferred << " total size " << total_size;
+
+		// the write that used this list has completed, so it can be modified
+
+		buffers->Consume(bytes_transferred);
+
+		auto rc = WriteAsync(function, buffers, handler, true);
+		if (rc)
+		{
+			BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " " << function << " CheckWriteBuffersComplete requeue WriteAsync failed";
+
+			return handler(boost::system::errc::make_error_code(boost::system::errc::argument_list_too_long), bytes_transferred);
+		}
+	}
+	else
+	{
+		if (!total_size)
+			BOOST_LOG_TRIVIAL(warning) << Name() << " Conn " << m_conn_index << " " << function << " CheckWriteBuffersComplete total size = 0";
+
+		return handler(e, bytes_transferred);
+	}
+}
+
 void Connection::HandleWriteSmartBuf(const boost::system::error_code& e, SmartBuf buf, AutoCount pending_op_counter)
 {
 	Connection::HandleWrite(e, std::move(pending_op_counter));	// don't need to increment op count
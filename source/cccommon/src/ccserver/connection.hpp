@@ -74,6 +74,35 @@ typedef function<void(const boost::system::error_code& e, size_t bytes)> WriteHa
 typedef function<void(const boost::system::error_code& e)> TimerHandler;
 typedef function<void()> PostHandler;
 
+/// List of buffers for a vectored write
+/// The buffers are sent in order in a single write; SmartBufs added to the list stay referenced until the write completes
+class WriteBuffers
+{
+public:
+	vector<boost::asio::const_buffer> buffers;
+	vector<SmartBuf> smartbufs;
+
+	void Add(const void *data, size_t size)
+	{
+		buffers.push_back(boost::asio::const_buffer(data, size));
+	}
+
+	void Add(const SmartBuf& buf, size_t offset, size_t size)
+	{
+		smartbufs.push_back(buf);
+
+		Add(buf.data() + offset, size);
+	}
+
+	size_t TotalSize() const
+	{
+		return boost::asio::buffer_size(buffers);
+	}
+
+	/// Drop the first nbytes, after a partial write
+	void Consume(size_t nbytes);
+};
+
 /// Represents a single Connection from a client.
 class Connection
 	: public RefCounted
@@ -108,6 +137,10 @@ public:
 	/// Initialize member values for a new connection
 	virtual void InitNewConnection();
 
+	/// Borrow or return the data buffers (used when the ConnectionManager pools buffers)
+	void AcquireBuffers();
+	void ReleaseBuffers();
+
 	/// Reference Counting
 	bool IncRef();
 	void DecRef();
@@ -170,6 +203,10 @@ public:
 	bool WriteAsync(const char *function, boost::asio::const_buffer buffer, WriteHandler handler, bool already_own_mutex = false);
 	void CheckWriteComplete(const char *function, boost::asio::const_buffer buffer, WriteHandler handler, const boost::system::error_code& e, size_t bytes_transferred);
 
+	/// Write a list of buffers in a single operation, without copying them into one buffer
+	bool WriteAsync(const char *function, shared_ptr<WriteBuffers> buffers, WriteHandler handler, bool already_own_mutex = false);
+	void CheckWriteBuffersComplete(const char *function, shared_ptr<WriteBuffers> buffers, size_t total_size, WriteHandler handler, const boost::system::error_code& e, size_t bytes_transferred);
+
 	/// Handle completion of a write operation.
 	virtual void HandleWrite(const boost::system::error_code& e, AutoCount pending_op_counter);
 	void HandleWriteSmartBuf(const boost::system::error_code& e, SmartBuf buf, AutoCount pending_op_counter);
@@ -213,6 +250,9 @@ protected:
 
 	virtual void StartConnection();
 
+	template <typename StartWrite>
+	bool WriteAsyncWithLock(const char *function, bool already_own_mutex, StartWrite start_write);
+
 	/// The manager for this Connection.
 	ConnectionManagerBase& m_connection_manager;
 
@@ -235,10 +275,15 @@ protected:
 	/// Socket for the Connection.
 	boost::asio::ip::tcp::socket m_socket;
 	bool m_incoming;					// flags incoming connection
+	uint32_t m_tor_connect_ticks;		// when the torproxy connect started, for the setup time histogram
+	bool m_tor_pooled;					// the torproxy connection was taken from g_sockspool, so its setup time wasn't measured
+	string m_outgoing_host;				// host of an outgoing connection, so the derived class can track how its peers perform
 
 	/// Local data buffers
 	vector<char> m_readbuf;
 	vector<char> m_writebuf;
+	unsigned m_nreadbuf;
+	unsigned m_nwritebuf;
 
 	/// Buffer tracking
 	char *m_pread;
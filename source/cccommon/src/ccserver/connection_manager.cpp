@@ -58,27 +58,34 @@ void ConnectionManager::FreeConnection(pconnection_t connection)
 
 	if (TRACE_CCSERVER) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << connection->m_conn_index << " ConnectionManager::FreeConnection";
 
-	bool was_freed = false;
+	bool was_freed = ReturnFreeConnection(connection);
 
-	{
-		lock_guard<FastSpinLock> lock(m_conn_mgr_lock);
+	if (was_freed && m_free_callback_obj && !g_shutdown)
+		m_free_callback_obj->HandleFreeConnection();
 
-		if (!connection->m_is_free)
-		{
-			connection->m_is_free = true;
-			was_freed = true;
+	if (TRACE_CCSERVER) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << connection->m_conn_index << " ConnectionManager::FreeConnection done";
+}
 
-			m_free_connections.push_back(connection);
+bool ConnectionManager::ReturnFreeConnection(pconnection_t connection)
+{
+	// the connection isn't in the free list yet, so no other thread can be using its buffers
 
-			if (connection->m_incoming)
-				--m_incoming_count;
-		}
-	}
+	if (!connection->m_is_free)
+		connection->ReleaseBuffers();
 
-	if (was_freed && m_free_callback_obj && !g_shutdown)
-		m_free_callback_obj->HandleFreeConnection();
+	lock_guard<FastSpinLock> lock(m_conn_mgr_lock);
 
-	if (TRACE_CCSERVER) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << connection->m_conn_index << " ConnectionManager::FreeConnection done";
+	if (connection->m_is_free)
+		return false;
+
+	connection->m_is_free = true;
+
+	m_free_connections.push_back(connection);
+
+	if (connection->m_incoming)
+		--m_incoming_count;
+
+	return true;
 }
 
 void ConnectionManager::SetFreeConnectionHandler(Server *p)
@@ -88,26 +95,48 @@ void ConnectionManager::SetFreeConnectionHandler(Server *p)
 
 pconnection_t ConnectionManager::GetFreeConnection(bool incoming)
 {
-	lock_guard<FastSpinLock> lock(m_conn_mgr_lock);
+	pconnection_t connection;
 
-	if (TRACE_CCSERVER) BOOST_LOG_TRIVIAL(trace) << Name() << " ConnectionManager::GetFreeConnection free " << m_free_connections.size() << " next " << (m_free_connections.size() ? (uintptr_t)m_free_connections.back() : 0) << " incoming " << incoming << " count " << m_incoming_count << " max " << m_maxincoming;
+	{
+		lock_guard<FastSpinLock> lock(m_conn_mgr_lock);
 
-	if (!m_free_connections.size())
-		return NULL;
+		if (TRACE_CCSERVER) BOOST_LOG_TRIVIAL(trace) << Name() << " ConnectionManager::GetFreeConnection free " << m_free_connections.size() << " next " << (m_free_connections.size() ? (uintptr_t)m_free_connections.back() : 0) << " incoming " << incoming << " count " << m_incoming_count << " max " << m_maxincoming;
 
-	if (incoming)
-	{
-		if (m_incoming_count >= m_maxincoming)
+		if (!m_free_connections.size())
 			return NULL;
 
-		++m_incoming_count;
+		if (incoming)
+		{
+			if (m_incoming_count >= m_maxincoming)
+				return NULL;
+
+			++m_incoming_count;
+			++m_incoming_total;
+		}
+
+		connection = m_free_connections.back();
+		m_free_connections.pop_back();
+
+		connection->m_is_free = false;
+		connection->m_incoming = incoming;	// need to set this now to keep count of incoming and outgoing connections
+	}
+
+	// borrow the buffers outside the lock since this may allocate memory
+
+	try
+	{
+		connection->AcquireBuffers();
 	}
+	catch (const bad_alloc& e)
+	{
+		BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << connection->m_conn_index << " ConnectionManager::GetFreeConnection unable to allocate connection buffers";
 
-	auto connection = m_free_connections.back();
-	m_free_connections.pop_back();
+		// return the connection without calling the free connection handler, which would just try again
 
-	connection->m_is_free = false;
-	connection->m_incoming = incoming;	// need to set this now to keep count of incoming and outgoing connections
+		ReturnFreeConnection(connection);
+
+		return NULL;
+	}
 
 	return connection;
 }
@@ -121,6 +150,23 @@ unsigned ConnectionManager::GetOutgoingConnectionCount()
 	return m_connections.size() - m_free_connections.size() - m_incoming_count;
 }
 
+unsigned ConnectionManager::GetActiveConnectionCount()
+{
+	lock_guard<FastSpinLock> lock(m_conn_mgr_lock);
+
+	return m_connections.size() - m_free_connections.size();
+}
+
+void ConnectionManager::GetStats(ConnectionStats& stats)
+{
+	lock_guard<FastSpinLock> lock(m_conn_mgr_lock);
+
+	stats.nconns = m_connections.size();
+	stats.nactive = m_connections.size() - m_free_connections.size();
+	stats.nincoming = m_incoming_count;
+	stats.incoming_total = m_incoming_total;
+}
+
 void ConnectionManager::StopAllConnections()
 {
 	for (auto connection : m_connections)
@@ -20,6 +20,14 @@ namespace CCServer {
 
 class Server;
 
+struct ConnectionStats
+{
+	unsigned nconns;				// connections in the pool
+	unsigned nactive;				// connections in use
+	unsigned nincoming;				// incoming connections in use
+	uint64_t incoming_total;		// incoming connections handed out since startup
+};
+
 /// Manages a pool of connections
 
 class ConnectionManagerBase
@@ -42,6 +50,12 @@ public:
 
 	virtual void FreeConnection(pconnection_t connection)
 	{ }
+
+	/// If true, connections borrow their buffers from g_connbufpool while in use
+	virtual bool UsesBufferPool() const
+	{
+		return false;
+	}
 };
 
 class ConnectionManager : public ConnectionManagerBase
@@ -53,6 +67,7 @@ public:
 		m_free_callback_obj(NULL),
 		m_maxincoming(0),
 		m_incoming_count(0),
+		m_incoming_total(0),
 		m_conn_mgr_lock(__FILE__, __LINE__)
 	{ }
 
@@ -67,9 +82,18 @@ public:
 
 	unsigned GetOutgoingConnectionCount();
 
+	unsigned GetActiveConnectionCount();
+
+	void GetStats(ConnectionStats& stats);
+
 	/// Return Connection to free pool
 	void FreeConnection(pconnection_t connection);
 
+	bool UsesBufferPool() const
+	{
+		return true;
+	}
+
 	/// Stop all connections
 	void StopAllConnections();
 
@@ -86,8 +110,11 @@ protected:
 	/// Free connections
 	vector<Connection *> m_free_connections;
 
+	bool ReturnFreeConnection(pconnection_t connection);
+
 	unsigned m_maxincoming;
 	unsigned m_incoming_count;
+	uint64_t m_incoming_total;
 	FastSpinLock m_conn_mgr_lock;
 };
 
@@ -141,7 +141,7 @@ void Server::StartAcceptWithLock(bool new_connection_used)
 	{
 		if (TRACE_CCSERVER) BOOST_LOG_TRIVIAL(trace) << Name() << " Server::StartAccept fetching new connection";
 
-		m_new_connection = m_connection_manager.GetFreeConnection(true);
+		m_new_connection = GetFreeIncomingConnection();
 	}
 
 	if (!m_new_connection)
@@ -164,6 +164,56 @@ void Server::StartAcceptWithLock(bool new_connection_used)
 	if (TRACE_CCSERVER) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_new_connection->m_conn_index << " Server::StartAccept now accepting";
 }
 
+pconnection_t Server::GetFreeIncomingConnection()
+{
+	if (m_accept_reactors.empty())
+		return m_connection_manager.GetFreeConnection(true);
+
+	// the accepted socket is assigned to the io_service of the connection's server,
+	// so handing the connection to the server with the fewest connections in use balances the load across the io_services
+
+	const unsigned nreactors = m_accept_reactors.size();
+
+	vector<unsigned> nactive(nreactors);
+
+	for (unsigned i = 0; i < nreactors; ++i)
+		nactive[i] = m_accept_reactors[i]->GetConnectionManager().GetActiveConnectionCount();
+
+	for (unsigned tries = 0; tries < nreactors; ++tries)
+	{
+		unsigned best = 0;
+
+		for (unsigned i = 1; i < nreactors; ++i)
+		{
+			if (nactive[i] < nactive[best])
+				best = i;
+		}
+
+		if (nactive[best] == (unsigned)(-1))
+			break;
+
+		auto connection = m_accept_reactors[best]->GetConnectionManager().GetFreeConnection(true);
+
+		if (connection)
+		{
+			if (TRACE_CCSERVER) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << connection->m_conn_index << " Server::GetFreeIncomingConnection using reactor " << best << " with " << nactive[best] << " active connections";
+
+			return connection;
+		}
+
+		nactive[best] = -1;		// this server has no free incoming connections, so try the next
+	}
+
+	return NULL;
+}
+
+void Server::SetAcceptReactors(const vector<Server*>& reactors)
+{
+	lock_guard<mutex> lock(m_new_connection_lock);
+
+	m_accept_reactors = reactors;
+}
+
 void Server::HandleAccept(const boost::system::error_code& e)
 {
 	if (e) BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_new_connection->m_conn_index << " Server::HandleAccept after error " << e << " " << e.message();
@@ -201,7 +251,7 @@ void Server::HandleFreeConnection()
 	StartAccept();
 }
 
-pconnection_t Server::Connect(const string& host, unsigned port, bool use_tor)
+pconnection_t Server::Connect(const string& host, unsigned port, bool use_tor, const string& toruser)
 {
 	auto connection = m_connection_manager.GetFreeConnection();
 
@@ -217,9 +267,8 @@ pconnection_t Server::Connect(const string& host, unsigned port, bool use_tor)
 	connection->InitNewConnection();
 
 	int rc;
-	static const string null;
 	if (use_tor)
-		rc = connection->Post("Server::Connect", boost::bind(&Connection::HandleConnectOutgoingTor, connection, port, host, ref(null), AutoCount(connection)));
+		rc = connection->Post("Server::Connect", boost::bind(&Connection::HandleConnectOutgoingTor, connection, port, host, toruser, AutoCount(connection)));
 	else
 		rc = connection->Post("Server::Connect", boost::bind(&Connection::HandleConnectOutgoing, connection, host, port, AutoCount(connection)));
 	if (rc)
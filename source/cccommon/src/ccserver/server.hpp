@@ -14,6 +14,7 @@
 #include <boost/noncopyable.hpp>
 
 #include <string>
+#include <vector>
 #include "../ccserver/connection.hpp"
 #include "../ccserver/connection_manager.hpp"
 
@@ -59,11 +60,14 @@ public:
 	atomic<int> m_startup_backlog;
 
 	/// Make outgoing connection
-	pconnection_t Connect(const string& host, unsigned port, bool use_tor = false);
+	pconnection_t Connect(const string& host, unsigned port, bool use_tor = false, const string& toruser = string());
 
 	/// Respond when a Connection becomes free
 	void HandleFreeConnection();
 
+	/// Hand accepted connections to the least loaded of these servers instead of only to this server
+	void SetAcceptReactors(const vector<Server*>& reactors);
+
 	void AsyncStop();
 
 private:
@@ -71,6 +75,9 @@ private:
 	void StartAccept(bool new_connection_used = false);
 	void StartAcceptWithLock(bool new_connection_used);
 
+	/// Get a free connection for the next accept
+	pconnection_t GetFreeIncomingConnection();
+
 	/// Handle completion of an asynchronous accept operation.
 	void HandleAccept(const boost::system::error_code& e);
 
@@ -96,6 +103,9 @@ private:
 	/// The next Connection to be accepted.
 	pconnection_t m_new_connection;
 	mutex m_new_connection_lock;
+
+	/// The servers that accepted connections are handed to (if empty, only this server)
+	vector<Server*> m_accept_reactors;
 };
 
 } // namespace CCServer
@@ -16,9 +16,9 @@ CCThreadFactory CCDefaultThreadFac;
 
 namespace CCServer {
 
-void Service::Start(const boost::asio::ip::tcp::endpoint& endpoint, unsigned nthreads, unsigned maxconns, unsigned maxincoming, unsigned backlog, const class ConnectionFactory& connfac, const class CCThreadFactory& threadfac)
+void Service::Start(const boost::asio::ip::tcp::endpoint& endpoint, unsigned nthreads, unsigned maxconns, unsigned maxincoming, unsigned backlog, const class ConnectionFactory& connfac, const class CCThreadFactory& threadfac, unsigned nreactors)
 {
-	BOOST_LOG_TRIVIAL(info) << Name() << " Service::Init nthreads " << nthreads << " maxconns " << maxconns << " maxincoming " << maxincoming << " backlog " << backlog;
+	BOOST_LOG_TRIVIAL(info) << Name() << " Service::Init nthreads " << nthreads << " maxconns " << maxconns << " maxincoming " << maxincoming << " backlog " << backlog << " nreactors " << nreactors;
 
 	if (maxconns < 1)
 	{
@@ -27,15 +27,30 @@ void Service::Start(const boost::asio::ip::tcp::endpoint& endpoint, unsigned nth
 		return;
 	}
 
-	// this was designed to that a number of servers can listen to the same port using SO_REUSEPORT
-	// the problem is the OS can send all connections to a single server, so it is only useful if all servers have multiple threads and connections
-	// so for now, we just use one server
+	// this was originally designed so that a number of servers could listen to the same port using SO_REUSEPORT
+	// the problem is the OS can send all connections to a single server, so instead, the first server accepts all incoming connections
+	// and hands each one to the least loaded server
 
-	const unsigned nservers = 1;
+	unsigned nservers = nreactors;
+
+	if (nservers > maxincoming)
+		nservers = maxincoming;
+
+	if (nservers < 1 || !endpoint.port())
+		nservers = 1;
 
 	unsigned threads_per_server = (nthreads + nservers - 1)/nservers;
 	unsigned connections_per_server = (maxconns + nservers - 1)/nservers;
 	unsigned incoming_connections_per_server = (maxincoming + nservers - 1)/nservers;
+	unsigned outgoing_connections = 0;
+
+	if (nservers > 1)
+	{
+		// outgoing connections are all made from the first server
+
+		outgoing_connections = (maxconns > maxincoming ? maxconns - maxincoming : 0);
+		connections_per_server = incoming_connections_per_server;
+	}
 
 	if (connections_per_server < 1)
 		connections_per_server = 1;
@@ -53,8 +68,23 @@ void Service::Start(const boost::asio::ip::tcp::endpoint& endpoint, unsigned nth
 		auto s = new Server(Name());
 		m_servers.push_back(s);
 
-		s->Init(endpoint, connections_per_server, incoming_connections_per_server, backlog, connfac);
+		// only the first server listens
 
+		s->Init((i ? boost::asio::ip::tcp::endpoint() : endpoint), connections_per_server + (i ? 0 : outgoing_connections), incoming_connections_per_server, backlog, connfac);
+	}
+
+	if (nservers > 1)
+	{
+		m_servers[0]->SetAcceptReactors(m_servers);
+
+		// when a connection becomes free in any server, the first server may be able to resume accepting
+
+		for (unsigned i = 1; i < nservers; ++i)
+			m_servers[i]->GetConnectionManager().SetFreeConnectionHandler(m_servers[0]);
+	}
+
+	for (auto s : m_servers)
+	{
 		for (unsigned j = 0; j < threads_per_server; ++j)
 		{
 			if (g_shutdown && j > 20)
@@ -69,13 +99,28 @@ void Service::Start(const boost::asio::ip::tcp::endpoint& endpoint, unsigned nth
 			t->Run(boost::bind(&Server::Run, s));
 			m_threads.push_back(t);
 		}
+	}
+
+	m_servers[0]->HandleFreeConnection();
+}
 
-		s->HandleFreeConnection();
+void Service::LogStats()
+{
+	for (unsigned i = 0; i < m_servers.size(); ++i)
+	{
+		ConnectionStats stats;
+
+		m_servers[i]->GetConnectionManager().GetStats(stats);
+
+		BOOST_LOG_TRIVIAL(info) << Name() << " Service server " << i << " of " << m_servers.size() << " connections " << stats.nconns << " active " << stats.nactive << " incoming " << stats.nincoming << " total incoming " << stats.incoming_total;
 	}
 }
 
 void Service::StartShutdown()
 {
+	if (m_servers.size() > 1)
+		LogStats();
+
 	for (auto s : m_servers)
 		s->AsyncStop();
 }
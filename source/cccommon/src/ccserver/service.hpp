@@ -35,7 +35,10 @@ public:
 	{ }
 
 	// Start service
-	void Start(const boost::asio::ip::tcp::endpoint& endpoint, unsigned nthreads, unsigned maxconns, unsigned maxincoming, unsigned backlog, const class ConnectionFactory& connfac, const class CCThreadFactory& threadfac = CCDefaultThreadFac);
+	//	if nreactors > 1, the service runs that many servers, each with its own io_service, threads and connections
+	//	the first server accepts all incoming connections and hands each to the server with the fewest connections in use
+	//	outgoing connections are made only from the first server
+	void Start(const boost::asio::ip::tcp::endpoint& endpoint, unsigned nthreads, unsigned maxconns, unsigned maxincoming, unsigned backlog, const class ConnectionFactory& connfac, const class CCThreadFactory& threadfac = CCDefaultThreadFac, unsigned nreactors = 1);
 
 	unsigned GetNServers()
 	{
@@ -47,6 +50,9 @@ public:
 		return *m_servers[i];
 	}
 
+	// Log the connection counts of each server
+	void LogStats();
+
 	// Commence service shutdown
 	void StartShutdown();
 
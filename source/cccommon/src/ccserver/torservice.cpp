@@ -139,6 +139,8 @@ void TorService::DumpConfig() const
 		cout << "   max incoming connections = " << max_inconns << endl;
 		cout << "   max outgoing connections = " << max_outconns << endl;
 		cout << "   threads per connection = " << threads_per_conn << endl;
+		if (nreactors > 1)
+			cout << "   reactors = " << nreactors << endl;
 
 		DumpExtraConfigBottom();
 	}
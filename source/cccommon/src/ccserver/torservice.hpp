@@ -33,6 +33,7 @@ public:
 	int max_outconns;
 	int max_inconns;
 	float threads_per_conn;
+	int nreactors;
 
 	static void SetPorts(vector<TorService*>& services, unsigned base_port);
 
@@ -54,7 +55,8 @@ public:
 		tor_advertise(false),
 		max_outconns(0),
 		max_inconns(0),
-		threads_per_conn(1)
+		threads_per_conn(1),
+		nreactors(1)
 	{ }
 
 	virtual ~TorService() = default;
@@ -7,6 +7,8 @@
 */
 
 #include "CCdef.h"
+#include "CCboost.hpp"
+#include "CCthread.hpp"
 #include "osutil.h"
 
 #include <boost/core/demangle.hpp>
@@ -15,6 +17,11 @@
 #include <execinfo.h>
 #endif
 
+#ifdef __linux__
+#include <sched.h>
+#include <dirent.h>
+#endif
+
 volatile bool g_shutdown = false;
 void (*g_shutdown_callback)() = NULL;
 
@@ -226,3 +233,366 @@ void set_nice(int _nice)
 	//cerr << "nice(" << _nice << ") returned " << rc << " errno " << errno << endl;
 #endif
 }
+
+#define THREAD_MAX_CPUS		1024
+#define THREAD_MAX_NODES	1024
+
+#ifndef MPOL_BIND
+#define MPOL_BIND			2		// from linux/mempolicy.h
+#endif
+
+enum
+{
+	THREAD_SCHED_OTHER,
+	THREAD_SCHED_BATCH,
+	THREAD_SCHED_IDLE
+};
+
+static const char* thread_sched_names[] = {"other", "batch", "idle"};
+
+static vector<CCThreadPlacement> thread_placements;
+static bool thread_numa_local;
+static mutex thread_placement_mutex;
+
+static void parse_thread_cpus(const string& str, vector<unsigned>& cpus)
+{
+	cpus.clear();
+
+	if (str == "*")
+		return;
+
+	istringstream in(str);
+	string range;
+
+	while (getline(in, range, ','))
+	{
+		auto p = range.c_str();
+		char *end;
+
+		auto first = strtoul(p, &end, 10);
+		auto last = first;
+
+		if (end != p && *end == '-')
+		{
+			p = end + 1;
+			last = strtoul(p, &end, 10);
+		}
+
+		if (end == p || *end || last < first || last >= THREAD_MAX_CPUS)
+			throw runtime_error("invalid cpu list \"" + str + "\"");
+
+		for (auto cpu = first; cpu <= last; ++cpu)
+			cpus.push_back(cpu);
+	}
+
+	if (cpus.empty())
+		throw runtime_error("invalid cpu list \"" + str + "\"");
+}
+
+static string thread_cpus_string(const vector<unsigned>& cpus)
+{
+	if (cpus.empty())
+		return "*";
+
+	ostringstream out;
+
+	for (unsigned i = 0; i < cpus.size(); )
+	{
+		auto j = i;
+
+		while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+			++j;
+
+		if (i)
+			out << ",";
+
+		out << cpus[i];
+
+		if (j > i)
+			out << "-" << cpus[j];
+
+		i = j + 1;
+	}
+
+	return out.str();
+}
+
+static string thread_placement_string(const CCThreadPlacement& placement)
+{
+	ostringstream out;
+
+	out << placement.role << "=" << thread_cpus_string(placement.cpus) << ":" << placement.nice << ":" << (placement.sched < 0 ? "unchanged" : thread_sched_names[placement.sched]);
+
+	return out.str();
+}
+
+#ifdef __linux__
+
+// sets the bits in nodemask of the NUMA nodes of cpus
+// returns the number of nodes found, which is zero on a kernel without NUMA support
+
+static unsigned thread_cpu_nodes(const vector<unsigned>& cpus, vector<unsigned long>& nodemask)
+{
+	const unsigned bits = sizeof(unsigned long) * CHAR_BIT;
+
+	nodemask.assign(THREAD_MAX_NODES / bits, 0);
+
+	unsigned nnodes = 0;
+
+	for (auto cpu : cpus)
+	{
+		auto path = "/sys/devices/system/cpu/cpu" + to_string(cpu);
+
+		auto dir = opendir(path.c_str());
+		if (!dir)
+			continue;
+
+		while (auto ent = readdir(dir))
+		{
+			if (strncmp(ent->d_name, "node", 4) || !isdigit(ent->d_name[4]))
+				continue;
+
+			auto node = strtoul(ent->d_name + 4, NULL, 10);
+
+			if (node < THREAD_MAX_NODES && !(nodemask[node / bits] & (1UL << (node % bits))))
+			{
+				nodemask[node / bits] |= 1UL << (node % bits);
+
+				++nnodes;
+			}
+		}
+
+		closedir(dir);
+	}
+
+	return nnodes;
+}
+
+#endif
+
+void CCThreadRoles::Configure(const string& spec, bool numa_local, const vector<string>& roles)
+{
+	lock_guard<mutex> lock(thread_placement_mutex);
+
+	thread_placements.clear();
+	thread_numa_local = numa_local;
+
+	string entry;
+
+	for (auto c : spec + ";")
+	{
+		if (c != ';' && !isspace(c))
+		{
+			entry.push_back(c);
+
+			continue;
+		}
+
+		if (entry.empty())
+			continue;
+
+		CCThreadPlacement placement;
+
+		placement.nice = 0;
+		placement.sched = -1;
+		placement.nthreads = 0;
+		placement.nerrors = 0;
+
+		auto eq = entry.find('=');
+		if (eq == string::npos)
+			throw runtime_error("invalid thread placement \"" + entry + "\"");
+
+		placement.role = entry.substr(0, eq);
+
+		if (find(roles.begin(), roles.end(), placement.role) == roles.end())
+			throw runtime_error("unknown thread role \"" + placement.role + "\"");
+
+		for (auto& other : thread_placements)
+		{
+			if (other.role == placement.role)
+				throw runtime_error("thread role \"" + placement.role + "\" placed more than once");
+		}
+
+		vector<string> fields;
+		istringstream in(entry.substr(eq + 1));
+		string field;
+
+		while (getline(in, field, ':'))
+			fields.push_back(field);
+
+		if (fields.empty() || fields.size() > 3)
+			throw runtime_error("invalid thread placement \"" + entry + "\"");
+
+		parse_thread_cpus(fields[0], placement.cpus);
+
+		if (fields.size() > 1 && !fields[1].empty())
+		{
+			char *end;
+
+			placement.nice = strtol(fields[1].c_str(), &end, 10);
+
+			if (*end || placement.nice < -20 || placement.nice > 19)
+				throw runtime_error("invalid nice value in thread placement \"" + entry + "\"");
+		}
+
+		if (fields.size() > 2)
+		{
+			for (unsigned i = 0; i < sizeof(thread_sched_names)/sizeof(thread_sched_names[0]); ++i)
+			{
+				if (fields[2] == thread_sched_names[i])
+					placement.sched = i;
+			}
+
+			if (placement.sched < 0)
+				throw runtime_error("invalid scheduling class in thread placement \"" + entry + "\"");
+		}
+
+		thread_placements.push_back(placement);
+
+		entry.clear();
+	}
+}
+
+void CCThreadRoles::Apply(const char *role)
+{
+	lock_guard<mutex> lock(thread_placement_mutex);
+
+	CCThreadPlacement *placement = NULL;
+
+	for (auto& p : thread_placements)
+	{
+		if (p.role == role)
+			placement = &p;
+	}
+
+	if (!placement)
+		return;
+
+	++placement->nthreads;
+
+	bool ok = true;
+	int err = 0;		// errno of the first call that failed
+
+#if defined(_WIN32)
+	if (placement->cpus.size())
+	{
+		DWORD_PTR mask = 0;
+
+		for (auto cpu : placement->cpus)
+		{
+			if (cpu < sizeof(mask) * CHAR_BIT)
+				mask |= (DWORD_PTR)1 << cpu;
+		}
+
+		if (!SetThreadAffinityMask(GetCurrentThread(), mask))
+		{
+			ok = false;
+			err = GetLastError();
+		}
+	}
+
+	if (placement->sched >= 0 || thread_numa_local)
+		ok = false;		// not supported
+#elif defined(__linux__)
+	if (placement->cpus.size())
+	{
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+
+		for (auto cpu : placement->cpus)
+		{
+			if (cpu < CPU_SETSIZE)
+				CPU_SET(cpu, &cpuset);
+		}
+
+		if (sched_setaffinity(0, sizeof(cpuset), &cpuset))
+		{
+			ok = false;
+			err = errno;
+		}
+
+		// bind the thread's allocations to the nodes of the pinned cpus
+		// the default policy allocates from the node the thread is running on when it allocates, and falls back to other
+		// nodes when that node is short of memory; binding keeps the thread's memory on its own nodes
+
+		vector<unsigned long> nodemask;
+
+		if (thread_numa_local && thread_cpu_nodes(placement->cpus, nodemask))
+		{
+			if (syscall(SYS_set_mempolicy, MPOL_BIND, nodemask.data(), THREAD_MAX_NODES + 1) && ok)
+			{
+				ok = false;
+				err = errno;
+			}
+		}
+	}
+
+	if (placement->sched >= 0)
+	{
+		static const int policies[] = {SCHED_OTHER, SCHED_BATCH, SCHED_IDLE};
+
+		struct sched_param param;
+		memset(&param, 0, sizeof(param));
+
+		if (sched_setscheduler(0, policies[placement->sched], &param) && ok)
+		{
+			ok = false;
+			err = errno;
+		}
+	}
+#else
+	if (placement->cpus.size() || placement->sched >= 0 || thread_numa_local)
+		ok = false;		// not supported
+#endif
+
+	set_nice(placement->nice);
+
+	if (!ok)
+	{
+		++placement->nerrors;
+
+		BOOST_LOG_TRIVIAL(warning) << "CCThreadRoles::Apply role " << role << " placement " << thread_placement_string(*placement) << " could not be fully applied; error " << err;
+	}
+	else
+		BOOST_LOG_TRIVIAL(debug) << "CCThreadRoles::Apply role " << role << " placement " << thread_placement_string(*placement) << " numa local " << thread_numa_local;
+}
+
+string CCThreadRoles::ConfigString()
+{
+	lock_guard<mutex> lock(thread_placement_mutex);
+
+	if (thread_placements.empty())
+		return "none";
+
+	string str;
+
+	for (auto& placement : thread_placements)
+	{
+		if (str.length())
+			str += ";";
+
+		str += thread_placement_string(placement);
+	}
+
+	if (thread_numa_local)
+		str += " numa local";
+
+	return str;
+}
+
+string CCThreadRoles::ReportString()
+{
+	lock_guard<mutex> lock(thread_placement_mutex);
+
+	ostringstream out;
+
+	out << "thread placement";
+
+	if (thread_placements.empty())
+		out << " none";
+
+	for (auto& placement : thread_placements)
+		out << "; " << thread_placement_string(placement) << " threads " << placement.nthreads << " errors " << placement.nerrors;
+
+	return out.str();
+}
@@ -13,6 +13,12 @@
 
 #define TOR_PROXY_TIMEOUT	140
 
+#define SOCKS_POOL_POLL_MS			200
+#define SOCKS_POOL_RETRY_SECS		30		// wait before retrying a warm destination after a failed connection
+#define SOCKS_POOL_STATS_SECS		(10*60)
+
+SocksPool g_sockspool;
+
 boost::asio::ip::basic_endpoint<boost::asio::ip::tcp> Socks::ConnectPoint(unsigned port)
 {
 	//static boost::asio::ip::address localhost = boost::asio::ip::address::from_string(LOCALHOST);
@@ -20,6 +26,15 @@ boost::asio::ip::basic_endpoint<boost::asio::ip::tcp> Socks::ConnectPoint(unsign
 	return boost::asio::ip::basic_endpoint<boost::asio::ip::tcp>(boost::asio::ip::address_v4::loopback(), port);
 }
 
+string Socks::IsolationUser()
+{
+	char user[21];
+	PseudoRandomLetters(user, sizeof(user) - 1);
+	user[sizeof(user) - 1] = 0;
+
+	return user;
+}
+
 string Socks::ConnectString(const string& dest, const string& toruser)
 {
 	static const char start[] = "\x04\x01\x01\xBB\x00\x00\x00\x01";	// socks4, connect, port 443, ip 0.0.0.1
@@ -28,12 +43,7 @@ string Socks::ConnectString(const string& dest, const string& toruser)
 	if (toruser.length())
 		result += toruser;					// proxy user id
 	else
-	{
-		char user[21];
-		PseudoRandomLetters(user, sizeof(user) - 1);
-		user[sizeof(user) - 1] = 0;
-		result += user;						// proxy user id
-	}
+		result += IsolationUser();			// proxy user id
 
 	result.push_back(0);
 	result += dest + ".onion";				// destination
@@ -42,43 +52,48 @@ string Socks::ConnectString(const string& dest, const string& toruser)
 	return result;
 }
 
-// socks4a reply should be 8 bytes. on success, 2nd byte should be 0x90
-
-boost::system::error_code Socks::SendString(boost::asio::ip::tcp::socket& socket, const unsigned port, const string& str, string& reply)
+boost::system::error_code Socks::ConnectProxy(boost::asio::ip::tcp::socket& socket, const unsigned port)
 {
-	size_t ntotal = 0;
 	boost::system::error_code e;
 
-	{
-		auto dest = ConnectPoint(port);
+	auto dest = ConnectPoint(port);
 
-		BOOST_LOG_TRIVIAL(trace) << "Socks::SendString torproxy synchronous connect localhost port " << port << "...";
+	BOOST_LOG_TRIVIAL(trace) << "Socks::ConnectProxy torproxy synchronous connect localhost port " << port << "...";
 
-		socket.connect(dest, e);	// !!! need to make this connect async?
+	socket.connect(dest, e);	// !!! need to make this connect async?
 
-		if (e)
-		{
-			BOOST_LOG_TRIVIAL(info) << "Socks::SendString torproxy connect error " << e << " " << e.message();
-			goto done;
-		}
+	if (e)
+		BOOST_LOG_TRIVIAL(info) << "Socks::ConnectProxy torproxy connect error " << e << " " << e.message();
+	else
+		BOOST_LOG_TRIVIAL(trace) << "Socks::ConnectProxy torproxy connected";
+
+	return e;
+}
 
-		BOOST_LOG_TRIVIAL(trace) << "Socks::SendString torproxy connected";
+// socks4a reply should be 8 bytes. on success, 2nd byte should be 0x90
+// if header_size is zero, the socket is already connected through the proxy and there is no socks reply
 
+boost::system::error_code Socks::Exchange(boost::asio::ip::tcp::socket& socket, const string& str, string& reply, unsigned header_size, bool header_only)
+{
+	size_t ntotal = 0;
+	boost::system::error_code e;
+
+	{
 		//BOOST_LOG_TRIVIAL(trace) << "sending " << s2hex(str);
 
 		boost::asio::write(socket, boost::asio::buffer(str), e);
 		if (e)
 		{
-			BOOST_LOG_TRIVIAL(error) << "Socks::SendString torproxy command write failed error " << e << " " << e.message();
+			BOOST_LOG_TRIVIAL(error) << "Socks::Exchange torproxy command write failed error " << e << " " << e.message();
 			goto done;
 		}
 
-		BOOST_LOG_TRIVIAL(trace) << "Socks::SendString torproxy command write done";
+		BOOST_LOG_TRIVIAL(trace) << "Socks::Exchange torproxy command write done";
 
 		socket.non_blocking(true, e);
 		if (e)
 		{
-			BOOST_LOG_TRIVIAL(error) << "Socks::SendString socket non_blocking failed error " << e << " " << e.message();
+			BOOST_LOG_TRIVIAL(error) << "Socks::Exchange socket non_blocking failed error " << e << " " << e.message();
 			goto done;
 		}
 
@@ -88,21 +103,23 @@ boost::system::error_code Socks::SendString(boost::asio::ip::tcp::socket& socket
 		{
 			if (g_shutdown)
 			{
-				BOOST_LOG_TRIVIAL(info) << "Socks::SendString shutting down";
+				BOOST_LOG_TRIVIAL(info) << "Socks::Exchange shutting down";
 				e.assign(boost::system::errc::no_such_process, boost::system::system_category());
 				goto done;
 			}
 
-			//BOOST_LOG_TRIVIAL(info) << "Socks::SendString recv have " << ntotal;
+			//BOOST_LOG_TRIVIAL(info) << "Socks::Exchange recv have " << ntotal;
 
 			auto nread = boost::asio::read(socket, boost::asio::buffer(&reply[ntotal], reply.size() - ntotal), boost::asio::transfer_at_least(1), e);
 
 			if (e && e != boost::asio::error::would_block && e != boost::asio::error::try_again && e != boost::asio::error::interrupted)
 			{
-				BOOST_LOG_TRIVIAL(info) << "Socks::SendString torproxy read failed after " << ntotal << " bytes; error " << e << " " << e.message();
+				BOOST_LOG_TRIVIAL(info) << "Socks::Exchange torproxy read failed after " << ntotal << " bytes; error " << e << " " << e.message();
 				goto done;
 			}
 
+			e.clear();
+
 			if (nread <= 0)
 			{
 				if (++count < TOR_PROXY_TIMEOUT)
@@ -112,32 +129,35 @@ boost::system::error_code Socks::SendString(boost::asio::ip::tcp::socket& socket
 					continue;
 				}
 
-				BOOST_LOG_TRIVIAL(info) << "Socks::SendString torproxy read timeout after " << ntotal << " bytes";
+				BOOST_LOG_TRIVIAL(info) << "Socks::Exchange torproxy read timeout after " << ntotal << " bytes";
 				e.assign(boost::system::errc::timed_out, boost::system::system_category());
 				goto done;
 			}
 
 			ntotal += nread;
 
-			BOOST_LOG_TRIVIAL(trace) << "Socks::SendString read nbytes " << nread << " total " << ntotal;
+			BOOST_LOG_TRIVIAL(trace) << "Socks::Exchange read nbytes " << nread << " total " << ntotal;
 
-			if (ntotal > 1 && reply[1] != 90)
+			if (header_size && ntotal > 1 && reply[1] != 90)
 			{
 				if (reply[1] == 91)
-					BOOST_LOG_TRIVIAL(info) << "Socks::SendString torproxy returned " << (unsigned)reply[1];
+					BOOST_LOG_TRIVIAL(info) << "Socks::Exchange torproxy returned " << (unsigned)reply[1];
 				else
-					BOOST_LOG_TRIVIAL(error) << "Socks::SendString torproxy returned error " << (unsigned)reply[1];
+					BOOST_LOG_TRIVIAL(error) << "Socks::Exchange torproxy returned error " << (unsigned)reply[1];
 				e.assign(reply[1], boost::system::generic_category());
 				goto done;
 			}
 
+			if (header_only && ntotal >= header_size)
+				goto done;
+
 			for (unsigned i = ntotal - nread; i < ntotal; ++i)
-				if (i >= SOCKS_REPLY_SIZE && reply[i] == 0)
+				if (i >= header_size && reply[i] == 0)
 					goto done;
 
 			if (ntotal >= reply.size())
 			{
-				BOOST_LOG_TRIVIAL(error) << "Socks::SendString read buffer overflow; read " << nread << " total " << ntotal << " size " << reply.size();
+				BOOST_LOG_TRIVIAL(error) << "Socks::Exchange read buffer overflow; read " << nread << " total " << ntotal << " size " << reply.size();
 				e.assign(boost::system::errc::value_too_large, boost::system::system_category());
 				goto done;
 			}
@@ -146,26 +166,425 @@ boost::system::error_code Socks::SendString(boost::asio::ip::tcp::socket& socket
 
 done:
 
+	reply.resize(ntotal);
+	reply.replace(0, header_size, "");
+
+	if (!e && ntotal < header_size)
+	{
+		BOOST_LOG_TRIVIAL(error) << "Socks::Exchange torproxy command returned only " << ntotal << " bytes";
+		e.assign(boost::system::errc::no_message, boost::system::system_category());
+	}
+
+	if (!e)
+	{
+		ntotal -= header_size;
+		BOOST_LOG_TRIVIAL(trace) << "Socks::Exchange read " << ntotal << " bytes: " << s2hex(reply);
+	}
+
+	return e;
+}
+
+boost::system::error_code Socks::SendString(boost::asio::ip::tcp::socket& socket, const unsigned port, const string& str, string& reply)
+{
+	auto e = ConnectProxy(socket, port);
+
+	if (!e)
+		e = Exchange(socket, str, reply, SOCKS_REPLY_SIZE, false);
+	else
+		reply.clear();
+
 	if (socket.is_open())
 	{
 		boost::system::error_code ec;
 		socket.close(ec);
 	}
 
-	reply.resize(ntotal);
-	reply.replace(0, SOCKS_REPLY_SIZE, "");
+	return e;
+}
+
+boost::system::error_code Socks::SendData(boost::asio::ip::tcp::socket& socket, const string& data, string& reply)
+{
+	auto e = Exchange(socket, data, reply, 0, false);
 
-	if (!e && ntotal < SOCKS_REPLY_SIZE)
+	if (socket.is_open())
 	{
-		BOOST_LOG_TRIVIAL(error) << "Socks::SendString torproxy command returned only " << ntotal << " bytes";
-		e.assign(boost::system::errc::no_message, boost::system::system_category());
+		boost::system::error_code ec;
+		socket.close(ec);
 	}
 
+	return e;
+}
+
+boost::system::error_code Socks::Connect(boost::asio::ip::tcp::socket& socket, const unsigned port, const string& dest, const string& toruser)
+{
+	string reply(SOCKS_REPLY_SIZE, 0);	// sized to read only the socks reply, and nothing the destination might send after it
+
+	auto e = ConnectProxy(socket, port);
+
+	if (!e)
+		e = Exchange(socket, ConnectString(dest, toruser), reply, SOCKS_REPLY_SIZE, true);
+
 	if (!e)
+		socket.non_blocking(false, e);
+
+	if (e && socket.is_open())
 	{
-		ntotal -= SOCKS_REPLY_SIZE;
-		BOOST_LOG_TRIVIAL(trace) << "Socks::SendString read " << ntotal << " bytes: " << s2hex(reply);
+		boost::system::error_code ec;
+		socket.close(ec);
 	}
 
 	return e;
 }
+
+void SocksPool::Start(unsigned proxy_port, unsigned max_idle_secs)
+{
+	if (m_thread.joinable())
+		return;
+
+	BOOST_LOG_TRIVIAL(info) << "SocksPool::Start torproxy port " << proxy_port << " max idle secs " << max_idle_secs;
+
+	m_proxy_port = proxy_port;
+	m_max_idle_secs = max_idle_secs;
+	m_stop = false;
+
+	m_thread = thread(&SocksPool::ThreadProc, this);
+}
+
+void SocksPool::Stop()
+{
+	m_stop = true;
+
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+
+		LogStats();
+	}
+
+	lock_guard<FastSpinLock> lock(m_socks_pool_lock);
+
+	m_destinations.clear();
+}
+
+SocksPool::Destination* SocksPool::FindDestination(const string& dest, const string& toruser)
+{
+	for (auto& d : m_destinations)
+	{
+		if (d.dest == dest && d.toruser == toruser)
+			return &d;
+	}
+
+	return NULL;
+}
+
+void SocksPool::Warm(const string& dest, const string& toruser, unsigned count, bool persistent)
+{
+	if (dest.empty() || toruser.empty() || !m_thread.joinable())
+		return;
+
+	BOOST_LOG_TRIVIAL(debug) << "SocksPool::Warm " << dest << " count " << count << " persistent " << persistent;
+
+	lock_guard<FastSpinLock> lock(m_socks_pool_lock);
+
+	auto d = FindDestination(dest, toruser);
+
+	if (d)
+	{
+		d->count = max(d->count, count);
+		d->leases_left = min(d->leases_left + count, 2 * d->count);	// allows for a lease already on its way from an earlier Warm
+		d->persistent |= persistent;
+
+		return;
+	}
+
+	m_destinations.emplace_back();
+
+	d = &m_destinations.back();
+
+	d->dest = dest;
+	d->toruser = toruser;
+	d->count = count;
+	d->leases_left = count;
+	d->persistent = persistent;
+	d->next_try_ticks = ccticks();
+}
+
+bool SocksPool::Lease(boost::asio::ip::tcp::socket& socket, const string& dest, const string& toruser)
+{
+	if (toruser.empty() || socket.is_open() || !m_thread.joinable())
+		return false;
+
+	shared_ptr<boost::asio::ip::tcp::socket> ready;
+	vector<shared_ptr<boost::asio::ip::tcp::socket>> expired;	// closed by the destructor after the lock is released
+
+	// the idle time is checked under the lock, but the socket is probed after the lock is released, since the probe is a system call
+
+	while (!ready)
+	{
+		shared_ptr<boost::asio::ip::tcp::socket> candidate;
+
+		{
+			lock_guard<FastSpinLock> lock(m_socks_pool_lock);
+
+			auto d = FindDestination(dest, toruser);
+			if (!d)
+				return false;
+
+			while (d->ready.size() && !candidate)
+			{
+				auto& front = d->ready.front();
+
+				if (ccticks_elapsed(front.ticks, ccticks()) <= (int32_t)(m_max_idle_secs * CCTICKS_PER_SEC))
+					candidate = front.socket;
+				else
+				{
+					expired.push_back(front.socket);
+
+					++m_stats.expired;
+				}
+
+				d->ready.pop_front();
+			}
+
+			if (!candidate)
+			{
+				++m_stats.misses;
+
+				return false;
+			}
+		}
+
+		if (IsAlive(*candidate))
+			ready = candidate;
+		else
+		{
+			expired.push_back(candidate);
+
+			lock_guard<FastSpinLock> lock(m_socks_pool_lock);
+
+			++m_stats.expired;
+		}
+	}
+
+	{
+		lock_guard<FastSpinLock> lock(m_socks_pool_lock);
+
+	#if BOOST_VERSION >= 107000
+		++m_stats.leases;
+	#else
+		++m_stats.misses;
+	#endif
+
+		auto d = FindDestination(dest, toruser);
+
+		if (d && !d->persistent && --d->leases_left == 0)
+			m_destinations.erase(m_destinations.begin() + (d - m_destinations.data()));
+	}
+
+#if BOOST_VERSION >= 107000
+
+	boost::system::error_code e;
+
+	auto fd = ready->release(e);
+	if (e)
+	{
+		BOOST_LOG_TRIVIAL(debug) << "SocksPool::Lease socket release failed " << dest << " error " << e << " " << e.message();
+
+		return false;
+	}
+
+	socket.assign(boost::asio::ip::tcp::v4(), fd, e);
+	if (e)
+	{
+		BOOST_LOG_TRIVIAL(error) << "SocksPool::Lease socket assign failed " << dest << " error " << e << " " << e.message();
+
+		return false;
+	}
+
+	BOOST_LOG_TRIVIAL(debug) << "SocksPool::Lease leased connection to " << dest;
+
+	return true;
+
+#else
+
+	// before Boost 1.70, a socket can't release its descriptor to be assigned to another io_service's socket,
+	// so the pooled connection is closed and the caller makes a new connection
+
+	BOOST_LOG_TRIVIAL(debug) << "SocksPool::Lease closing pooled connection to " << dest << "; Boost " << BOOST_LIB_VERSION << " can't transfer it";
+
+	return false;
+
+#endif
+}
+
+bool SocksPool::IsAlive(boost::asio::ip::tcp::socket& socket)
+{
+	boost::system::error_code e, ec;
+	char c;
+
+	socket.non_blocking(true, e);
+	if (e)
+		return false;
+
+	auto nread = socket.receive(boost::asio::buffer(&c, 1), boost::asio::ip::tcp::socket::message_peek, e);
+
+	socket.non_blocking(false, ec);
+
+	if (e == boost::asio::error::would_block || e == boost::asio::error::try_again)
+		return true;		// open, with nothing waiting to be read
+
+	return !e && nread > 0;	// eof or any other error means the connection is closed
+}
+
+void SocksPool::RecordSetupTime(uint32_t ms, bool pooled)
+{
+	lock_guard<FastSpinLock> lock(m_socks_pool_lock);
+
+	CountSetupTime(ms, pooled);
+}
+
+void SocksPool::CountSetupTime(uint32_t ms, bool pooled)
+{
+	unsigned bucket = 0;
+
+	for (uint32_t limit = 500; bucket < NBUCKETS - 1 && ms >= limit; limit *= 2)
+		++bucket;
+
+	if (pooled)
+		++m_stats.setup_pooled[bucket];
+	else
+		++m_stats.setup_direct[bucket];
+}
+
+void SocksPool::LogStats()
+{
+	Stats stats;
+
+	{
+		lock_guard<FastSpinLock> lock(m_socks_pool_lock);
+
+		stats = m_stats;
+	}
+
+	ostringstream direct, pooled;
+
+	for (unsigned i = 0; i < NBUCKETS; ++i)
+	{
+		direct << " " << stats.setup_direct[i];
+		pooled << " " << stats.setup_pooled[i];
+	}
+
+	BOOST_LOG_TRIVIAL(info) << "SocksPool leases " << stats.leases << " misses " << stats.misses << " expired " << stats.expired << " failed " << stats.failed
+		<< "; setup time histogram (<0.5 <1 <2 <4 <8 <16 <32 >=32 secs) direct" << direct.str() << " pooled" << pooled.str();
+}
+
+void SocksPool::ThreadProc()
+{
+	BOOST_LOG_TRIVIAL(trace) << "SocksPool::ThreadProc started";
+
+	auto last_stats_ticks = ccticks();
+
+	while (!g_shutdown && !m_stop.load())
+	{
+		if (ccticks_elapsed(last_stats_ticks, ccticks()) >= SOCKS_POOL_STATS_SECS * CCTICKS_PER_SEC)
+		{
+			LogStats();
+
+			last_stats_ticks = ccticks();
+		}
+
+		// drop expired connections and find a destination that needs another one
+
+		string dest, toruser;
+		bool need = false;
+
+		vector<shared_ptr<boost::asio::ip::tcp::socket>> expired;	// closed by the destructor after the lock is released
+
+		{
+			lock_guard<FastSpinLock> lock(m_socks_pool_lock);
+
+			for (unsigned i = 0; i < m_destinations.size(); )
+			{
+				auto& d = m_destinations[i];
+				bool drop = false;
+
+				for (auto it = d.ready.begin(); it != d.ready.end(); )
+				{
+					if (ccticks_elapsed(it->ticks, ccticks()) > (int32_t)(m_max_idle_secs * CCTICKS_PER_SEC) || !IsAlive(*it->socket))
+					{
+						expired.push_back(it->socket);
+						it = d.ready.erase(it);
+
+						++m_stats.expired;
+
+						drop = !d.persistent;
+					}
+					else
+						++it;
+				}
+
+				if (drop)
+				{
+					m_destinations.erase(m_destinations.begin() + i);
+
+					continue;
+				}
+
+				if (!need && d.ready.size() < d.count && ccticks_elapsed(d.next_try_ticks, ccticks()) >= 0)
+				{
+					dest = d.dest;
+					toruser = d.toruser;
+					need = true;
+				}
+
+				++i;
+			}
+		}
+
+		expired.clear();
+
+		if (!need)
+		{
+			usleep(SOCKS_POOL_POLL_MS * 1000);
+
+			continue;
+		}
+
+		// connections are set up one at a time, since each one builds a Tor circuit
+
+		auto socket = make_shared<boost::asio::ip::tcp::socket>(m_io_service);
+
+		auto t0 = ccticks();
+
+		auto e = Socks::Connect(*socket, m_proxy_port, dest, toruser);
+
+		auto elapsed = ccticks_elapsed(t0, ccticks());
+
+		lock_guard<FastSpinLock> lock(m_socks_pool_lock);
+
+		auto d = FindDestination(dest, toruser);
+
+		if (e)
+		{
+			BOOST_LOG_TRIVIAL(debug) << "SocksPool::ThreadProc connect to " << dest << " failed after " << elapsed << " ms error " << e << " " << e.message();
+
+			++m_stats.failed;
+
+			if (d && !d->persistent)
+				m_destinations.erase(m_destinations.begin() + (d - m_destinations.data()));
+			else if (d)
+				d->next_try_ticks = ccticks() + SOCKS_POOL_RETRY_SECS * CCTICKS_PER_SEC;
+
+			continue;
+		}
+
+		BOOST_LOG_TRIVIAL(trace) << "SocksPool::ThreadProc connected to " << dest << " in " << elapsed << " ms";
+
+		CountSetupTime(elapsed, true);
+
+		if (d && d->ready.size() < d->count)
+			d->ready.push_back(Ready{socket, ccticks()});
+	}
+
+	BOOST_LOG_TRIVIAL(trace) << "SocksPool::ThreadProc ended";
+}
@@ -9,7 +9,15 @@
 #pragma once
 
 #include <string>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
 #include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <SpinLock.hpp>
 
 #define SOCKS_REPLY_SIZE	8
 
@@ -19,11 +27,117 @@ private:
 	Socks();
 	~Socks();
 
+	static boost::system::error_code ConnectProxy(boost::asio::ip::tcp::socket& socket, const unsigned port);
+
+	static boost::system::error_code Exchange(boost::asio::ip::tcp::socket& socket, const std::string& str, std::string& reply, unsigned header_size, bool header_only);
+
 public:
 
 	static boost::asio::ip::basic_endpoint<boost::asio::ip::tcp> ConnectPoint(unsigned port);
 
+	static std::string IsolationUser();
+
 	static std::string ConnectString(const std::string& dest, const std::string& toruser);
 
 	static boost::system::error_code SendString(boost::asio::ip::tcp::socket& socket, const unsigned port, const std::string& str, std::string& reply);
+
+	/// Sends data on a socket already connected through the proxy, reads the reply, and closes the socket
+	static boost::system::error_code SendData(boost::asio::ip::tcp::socket& socket, const std::string& data, std::string& reply);
+
+	/// Connects the socket through the proxy to dest and leaves it open
+	static boost::system::error_code Connect(boost::asio::ip::tcp::socket& socket, const unsigned port, const std::string& dest, const std::string& toruser);
+};
+
+/// Pool of connections that have already been set up through the Tor proxy
+///
+/// A destination is kept warm by calling Warm with the Socks username that sets its circuit isolation.  A background
+/// thread connects to each warm destination and replaces connections that have been idle too long or were closed by the
+/// other end.  A caller that connects to the same destination with the same username is handed a ready connection
+/// instead of waiting for Tor to build a circuit.  Connections made with an empty (random) username are never pooled,
+/// so their isolation is unchanged.
+
+class SocksPool
+	: private boost::noncopyable
+{
+public:
+	SocksPool()
+	 :	m_proxy_port(0),
+		m_max_idle_secs(0),
+		m_stop(false),
+		m_socks_pool_lock(__FILE__, __LINE__)
+	{
+		memset(&m_stats, 0, sizeof(m_stats));
+	}
+
+	~SocksPool()
+	{
+		Stop();
+	}
+
+	void Start(unsigned proxy_port, unsigned max_idle_secs);
+	void Stop();
+
+	/// Keeps count connections to dest ready
+	/// If persistent is false, the destination is dropped once count more connections have been leased, or when a ready connection expires
+	void Warm(const std::string& dest, const std::string& toruser, unsigned count = 1, bool persistent = false);
+
+	/// Moves a ready connection into socket; returns true if one was available
+	bool Lease(boost::asio::ip::tcp::socket& socket, const std::string& dest, const std::string& toruser);
+
+	/// Records the time taken to set up a connection through the proxy
+	void RecordSetupTime(std::uint32_t ms, bool pooled);
+
+	void LogStats();
+
+protected:
+	static const unsigned NBUCKETS = 8;		// setup time buckets are < 500 ms, < 1 sec, < 2 sec, ... < 32 sec, and >= 32 sec
+
+	struct Ready
+	{
+		std::shared_ptr<boost::asio::ip::tcp::socket> socket;
+		std::uint32_t ticks;
+	};
+
+	struct Destination
+	{
+		std::string dest;
+		std::string toruser;
+		unsigned count;
+		unsigned leases_left;
+		bool persistent;
+		std::uint32_t next_try_ticks;
+		std::deque<Ready> ready;
+	};
+
+	struct Stats
+	{
+		std::uint64_t leases;
+		std::uint64_t misses;
+		std::uint64_t expired;
+		std::uint64_t failed;
+		std::uint64_t setup_direct[NBUCKETS];
+		std::uint64_t setup_pooled[NBUCKETS];
+	};
+
+	unsigned m_proxy_port;
+	unsigned m_max_idle_secs;
+	std::atomic<bool> m_stop;
+	std::thread m_thread;
+
+	boost::asio::io_service m_io_service;	// owns the ready sockets; never run since all operations on them are synchronous
+
+	std::vector<Destination> m_destinations;
+	Stats m_stats;
+
+	FastSpinLock m_socks_pool_lock;
+
+	void ThreadProc();
+
+	void CountSetupTime(std::uint32_t ms, bool pooled);		// caller must hold m_socks_pool_lock
+
+	Destination* FindDestination(const std::string& dest, const std::string& toruser);
+
+	static bool IsAlive(boost::asio::ip::tcp::socket& socket);
 };
+
+extern SocksPool g_sockspool;
@@ -13,7 +13,9 @@ CPP_SRCS += \
 ../src/map_values.cpp \
 ../src/payspec.cpp \
 ../src/transaction.cpp \
+../src/txcompact.cpp \
 ../src/txquery.cpp \
+../src/txview.cpp \
 ../src/xmatch.cpp \
 ../src/xtransaction-xpay.cpp \
 ../src/xtransaction-xreq.cpp \
@@ -33,7 +35,9 @@ CPP_DEPS += \
 ./src/map_values.d \
 ./src/payspec.d \
 ./src/transaction.d \
+./src/txcompact.d \
 ./src/txquery.d \
+./src/txview.d \
 ./src/xmatch.d \
 ./src/xtransaction-xpay.d \
 ./src/xtransaction-xreq.d \
@@ -54,7 +58,9 @@ OBJS += \
 ./src/map_values.o \
 ./src/payspec.o \
 ./src/transaction.o \
+./src/txcompact.o \
 ./src/txquery.o \
+./src/txview.o \
 ./src/xmatch.o \
 ./src/xtransaction-xpay.o \
 ./src/xtransaction-xreq.o \
@@ -81,7 +87,7 @@ src/%.o: ../src/%.c src/subdir.mk
 clean: clean-src
 
 clean-src:
-	-$(RM) ./src/CCbigint.d ./src/CCbigint.o ./src/CCproof.d ./src/CCproof.o ./src/amounts.d ./src/amounts.o ./src/encode.d ./src/encode.o ./src/encodings.d ./src/encodings.o ./src/jsoncmd.d ./src/jsoncmd.o ./src/jsonutil.d ./src/jsonutil.o ./src/map_values.d ./src/map_values.o ./src/payspec.d ./src/payspec.o ./src/transaction.d ./src/transaction.o ./src/txquery.d ./src/txquery.o ./src/xmatch.d ./src/xmatch.o ./src/xtransaction-xpay.d ./src/xtransaction-xpay.o ./src/xtransaction-xreq.d ./src/xtransaction-xreq.o ./src/xtransaction.d ./src/xtransaction.o ./src/zkkeys.d ./src/zkkeys.o
+	-$(RM) ./src/CCbigint.d ./src/CCbigint.o ./src/CCproof.d ./src/CCproof.o ./src/amounts.d ./src/amounts.o ./src/encode.d ./src/encode.o ./src/encodings.d ./src/encodings.o ./src/jsoncmd.d ./src/jsoncmd.o ./src/jsonutil.d ./src/jsonutil.o ./src/map_values.d ./src/map_values.o ./src/payspec.d ./src/payspec.o ./src/transaction.d ./src/transaction.o ./src/txcompact.d ./src/txcompact.o ./src/txquery.d ./src/txquery.o ./src/txview.d ./src/txview.o ./src/xmatch.d ./src/xmatch.o ./src/xtransaction-xpay.d ./src/xtransaction-xpay.o ./src/xtransaction-xreq.d ./src/xtransaction-xreq.o ./src/xtransaction.d ./src/xtransaction.o ./src/zkkeys.d ./src/zkkeys.o
 
 .PHONY: clean-src
 
@@ -1151,7 +1151,7 @@ static void bless_private_inputs(TxPayZK& zk, const TxPay& tx, int& badsel)
 
 static void breakout_bits(TxPayZK& zk)
 {
-	zk.publics.M_commitment_iv_bits = ZKHasher::extractBits(zk.publics.M_commitment_iv, TX_COMMIT_IV_BITS);
+	ZKHasher::extractBits(zk.publics.M_commitment_iv, TX_COMMIT_IV_BITS, zk.publics.M_commitment_iv_bits);
 
 	zk.publics.M_encrypt_iv_bits.resize(TX_ENC_IV_BITS);
 
@@ -1163,12 +1163,12 @@ static void breakout_bits(TxPayZK& zk)
 		TxOutZKPub& zkoutpub = zk.output_public[i];
 		TxOutZKPriv& zkoutpriv = zk.output_private[i];
 
-		zkoutpub.dest_chain_bits = ZKHasher::extractBits(zkoutpub.dest_chain, TX_CHAIN_BITS);
-		zkoutpub.M_domain_bits = ZKHasher::extractBits(zkoutpub.M_domain, TX_DOMAIN_BITS);
-		zkoutpub.asset_mask_bits = ZKHasher::extractBits(zkoutpub.asset_mask, TX_ASSET_BITS);
-		zkoutpub.M_asset_enc_bits = ZKHasher::extractBits(zkoutpub.M_asset_enc, TX_ASSET_BITS);
-		zkoutpub.amount_mask_bits = ZKHasher::extractBits(zkoutpub.amount_mask, TX_AMOUNT_BITS);
-		zkoutpub.M_amount_enc_bits = ZKHasher::extractBits(zkoutpub.M_amount_enc, TX_AMOUNT_BITS);
+		ZKHasher::extractBits(zkoutpub.dest_chain, TX_CHAIN_BITS, zkoutpub.dest_chain_bits);
+		ZKHasher::extractBits(zkoutpub.M_domain, TX_DOMAIN_BITS, zkoutpub.M_domain_bits);
+		ZKHasher::extractBits(zkoutpub.asset_mask, TX_ASSET_BITS, zkoutpub.asset_mask_bits);
+		ZKHasher::extractBits(zkoutpub.M_asset_enc, TX_ASSET_BITS, zkoutpub.M_asset_enc_bits);
+		ZKHasher::extractBits(zkoutpub.amount_mask, TX_AMOUNT_BITS, zkoutpub.amount_mask_bits);
+		ZKHasher::extractBits(zkoutpub.M_amount_enc, TX_AMOUNT_BITS, zkoutpub.M_amount_enc_bits);
 		//zkoutpub.M_commitment_index_bits = ZKHasher::nextractBits(zkoutpub.M_commitment_index, TX_COMMIT_INDEX_BITS);
 
 		#if 0 // no longer used
@@ -1186,12 +1186,12 @@ static void breakout_bits(TxPayZK& zk)
 		for (unsigned j = 0; j < zk.nassets; ++j)
 			ZKConstraints::addBooleanity(zkoutpriv.__is_asset[j]);
 
-		zkoutpriv.__dest_bits = ZKHasher::extractBits(zkoutpriv.__dest, TX_FIELD_BITS);
-		zkoutpriv.__paynum_bits = ZKHasher::extractBits(zkoutpriv.__paynum, TX_PAYNUM_BITS);
-		zkoutpriv.__asset_bits = ZKHasher::extractBits(zkoutpriv.__asset, TX_ASSET_BITS);
-		zkoutpriv.__asset_xor_bits = ZKHasher::extractBits(zkoutpriv.__asset_xor, TX_ASSET_BITS);
-		zkoutpriv.__amount_fp_bits = ZKHasher::extractBits(zkoutpriv.__amount_fp, TX_AMOUNT_BITS);
-		zkoutpriv.__amount_xor_bits = ZKHasher::extractBits(zkoutpriv.__amount_xor, TX_AMOUNT_BITS);
+		ZKHasher::extractBits(zkoutpriv.__dest, TX_FIELD_BITS, zkoutpriv.__dest_bits);
+		ZKHasher::extractBits(zkoutpriv.__paynum, TX_PAYNUM_BITS, zkoutpriv.__paynum_bits);
+		ZKHasher::extractBits(zkoutpriv.__asset, TX_ASSET_BITS, zkoutpriv.__asset_bits);
+		ZKHasher::extractBits(zkoutpriv.__asset_xor, TX_ASSET_BITS, zkoutpriv.__asset_xor_bits);
+		ZKHasher::extractBits(zkoutpriv.__amount_fp, TX_AMOUNT_BITS, zkoutpriv.__amount_fp_bits);
+		ZKHasher::extractBits(zkoutpriv.__amount_xor, TX_AMOUNT_BITS, zkoutpriv.__amount_xor_bits);
 	}
 
 	for (unsigned i = 0; i < zk.nin; ++i)
@@ -1199,7 +1199,7 @@ static void breakout_bits(TxPayZK& zk)
 		TxInZKPub& zkinpub = zk.input_public[i];
 		TxInZKPriv& zkinpriv = zk.input_private[i];
 
-		zkinpub.M_domain_bits = ZKHasher::extractBits(zkinpub.M_domain, TX_DOMAIN_BITS);
+		ZKHasher::extractBits(zkinpub.M_domain, TX_DOMAIN_BITS, zkinpub.M_domain_bits);
 
 		for (unsigned j = 0; j < zk.nassets; ++j)
 			ZKConstraints::addBooleanity(zkinpriv.__is_asset[j]);
@@ -1217,33 +1217,33 @@ static void breakout_bits(TxPayZK& zk)
 		ZKConstraints::addBooleanity(zkinpriv.____spend_secrets_valid);
 		ZKConstraints::addBooleanity(zkinpriv.____trust_secrets_valid);
 
-		zkinpriv.__asset_bits = ZKHasher::extractBits(zkinpriv.__asset, TX_ASSET_BITS);
-		zkinpriv.__amount_fp_bits = ZKHasher::extractBits(zkinpriv.__amount_fp, TX_AMOUNT_BITS);
-		zkinpriv.__M_commitment_iv_bits = ZKHasher::extractBits(zkinpriv.__M_commitment_iv, TX_COMMIT_IV_BITS);
+		ZKHasher::extractBits(zkinpriv.__asset, TX_ASSET_BITS, zkinpriv.__asset_bits);
+		ZKHasher::extractBits(zkinpriv.__amount_fp, TX_AMOUNT_BITS, zkinpriv.__amount_fp_bits);
+		ZKHasher::extractBits(zkinpriv.__M_commitment_iv, TX_COMMIT_IV_BITS, zkinpriv.__M_commitment_iv_bits);
 		//zkinpriv.__M_commitment_index_bits = ZKHasher::nextractBits(zkinpriv.__M_commitment_index, TX_COMMIT_INDEX_BITS);
 
-		zkinpriv.__M_commitment_bits = ZKHasher::extractBits(zkinpriv.__M_commitment, TX_FIELD_BITS);
-		zkinpriv.__M_commitnum_bits = ZKHasher::extractBits(zkinpriv.__M_commitnum, TX_COMMITNUM_BITS);
+		ZKHasher::extractBits(zkinpriv.__M_commitment, TX_FIELD_BITS, zkinpriv.__M_commitment_bits);
+		ZKHasher::extractBits(zkinpriv.__M_commitnum, TX_COMMITNUM_BITS, zkinpriv.__M_commitnum_bits);
 
-		zkinpriv.____master_secret_bits = ZKHasher::extractBits(zkinpriv.____master_secret, TX_INPUT_BITS);
-		zkinpriv.____spend_secret_number_bits = ZKHasher::extractBits(zkinpriv.____spend_secret_number, TX_SPEND_SECRETNUM_BITS);
-		zkinpriv.____required_spendspec_hash_bits = ZKHasher::extractBits(zkinpriv.____required_spendspec_hash, TX_INPUT_BITS);
-		zkinpriv.____spend_locktime_bits = ZKHasher::extractBits(zkinpriv.____spend_locktime, TX_TIME_BITS);
-		zkinpriv.____trust_locktime_bits = ZKHasher::extractBits(zkinpriv.____trust_locktime, TX_TIME_BITS);
-		zkinpriv.____spend_delaytime_bits = ZKHasher::extractBits(zkinpriv.____spend_delaytime, TX_DELAYTIME_BITS);
-		zkinpriv.____trust_delaytime_bits = ZKHasher::extractBits(zkinpriv.____trust_delaytime, TX_DELAYTIME_BITS);
+		ZKHasher::extractBits(zkinpriv.____master_secret, TX_INPUT_BITS, zkinpriv.____master_secret_bits);
+		ZKHasher::extractBits(zkinpriv.____spend_secret_number, TX_SPEND_SECRETNUM_BITS, zkinpriv.____spend_secret_number_bits);
+		ZKHasher::extractBits(zkinpriv.____required_spendspec_hash, TX_INPUT_BITS, zkinpriv.____required_spendspec_hash_bits);
+		ZKHasher::extractBits(zkinpriv.____spend_locktime, TX_TIME_BITS, zkinpriv.____spend_locktime_bits);
+		ZKHasher::extractBits(zkinpriv.____trust_locktime, TX_TIME_BITS, zkinpriv.____trust_locktime_bits);
+		ZKHasher::extractBits(zkinpriv.____spend_delaytime, TX_DELAYTIME_BITS, zkinpriv.____spend_delaytime_bits);
+		ZKHasher::extractBits(zkinpriv.____trust_delaytime, TX_DELAYTIME_BITS, zkinpriv.____trust_delaytime_bits);
 
-		zkinpriv.____required_spend_secrets_bits = ZKHasher::extractBits(zkinpriv.____required_spend_secrets, TX_MAX_SECRETS_BITS);
-		zkinpriv.____required_trust_secrets_bits = ZKHasher::extractBits(zkinpriv.____required_trust_secrets, TX_MAX_SECRETS_BITS);
-		zkinpriv.____destnum_bits = ZKHasher::extractBits(zkinpriv.____destnum, TX_DESTNUM_BITS);
-		zkinpriv.__paynum_bits = ZKHasher::extractBits(zkinpriv.__paynum, TX_PAYNUM_BITS);
+		ZKHasher::extractBits(zkinpriv.____required_spend_secrets, TX_MAX_SECRETS_BITS, zkinpriv.____required_spend_secrets_bits);
+		ZKHasher::extractBits(zkinpriv.____required_trust_secrets, TX_MAX_SECRETS_BITS, zkinpriv.____required_trust_secrets_bits);
+		ZKHasher::extractBits(zkinpriv.____destnum, TX_DESTNUM_BITS, zkinpriv.____destnum_bits);
+		ZKHasher::extractBits(zkinpriv.__paynum, TX_PAYNUM_BITS, zkinpriv.__paynum_bits);
 
 		for (unsigned j = 0; j < zkinpriv.nsecrets; ++j)
 		{
 			ZKConstraints::addBooleanity(zkinpriv.____secret_valid[j]);
 
-			zkinpriv.____spend_secret_bits[j] = ZKHasher::extractBits(zkinpriv.____spend_secret[j], TX_INPUT_BITS);
-			zkinpriv.____trust_secret_bits[j] = ZKHasher::extractBits(zkinpriv.____trust_secret[j], TX_INPUT_BITS);
+			ZKHasher::extractBits(zkinpriv.____spend_secret[j], TX_INPUT_BITS, zkinpriv.____spend_secret_bits[j]);
+			ZKHasher::extractBits(zkinpriv.____trust_secret[j], TX_INPUT_BITS, zkinpriv.____trust_secret_bits[j]);
 		}
 
 		for (unsigned j = 0; j < TX_MAX_SECRETS; ++j)
@@ -1256,8 +1256,8 @@ static void breakout_bits(TxPayZK& zk)
 
 		for (unsigned j = 0; j < TX_MAX_SECRET_SLOTS; ++j)
 		{
-			zkinpriv.____monitor_secret_lo_bits[j] = ZKHasher::extractBits(zkinpriv.____monitor_secret[j], TX_INPUT_BITS/2, &zkinpriv.____monitor_secret_hi[j], &zkinpriv.____monitor_secret_lo[j]);
-			zkinpriv.____monitor_secret_hi_bits[j] = ZKHasher::extractBits(zkinpriv.____monitor_secret_hi[j], TX_INPUT_BITS/2);
+			ZKHasher::extractBits(zkinpriv.____monitor_secret[j], TX_INPUT_BITS/2, zkinpriv.____monitor_secret_lo_bits[j], &zkinpriv.____monitor_secret_hi[j], &zkinpriv.____monitor_secret_lo[j]);
+			ZKHasher::extractBits(zkinpriv.____monitor_secret_hi[j], TX_INPUT_BITS/2, zkinpriv.____monitor_secret_hi_bits[j]);
 		}
 
 		for (unsigned k = 0; k < zk.nrouts; ++k)
@@ -1961,71 +1961,318 @@ static void compute_tx(TxPayZK& zk)
 	}
 }
 
+/*
+
+Proof workspaces
+
+A TxPayZK holds the circuit variables for one proof, most of them in vectors whose sizes depend only on the proof key.
+Rather than allocating a new TxPayZK and new vectors for every proof, finished workspaces are kept in a pool indexed by
+key, and the next proof for the same key refills the vectors of a previous one.  The pool is process-wide instead of
+thread local because the wallet starts a new thread for each transaction it builds.
+
+Before a workspace is returned to the pool, its bit vectors are cleared so they don't hold on to the circuit nodes of
+the previous proof; vector::clear keeps the allocated storage.
+
+Only the TxPayZK is pooled.  The R1C constraint system and the witness and QAP buffers belong to snarkfront's thread
+local singletons, which reset<ZKPAIRING>() clears and CCProof_Free deletes, so they are not pooled and the workspace
+byte counts don't include them.
+
+*/
+
+#define ZK_WORKSPACE_POOL_MAX	16	// max idle workspaces kept in pool; one per key covers all keys currently in use
+
+template <typename F>
+static void zk_workspace_bit_vectors(TxPayZK& zk, F f)
+{
+	// calls f for every vector of circuit bits in the workspace
+
+	f(zk.publics.M_commitment_iv_bits);
+	f(zk.publics.M_encrypt_iv_bits);
+
+	for (auto& zkoutpub : zk.output_public)
+	{
+		f(zkoutpub.dest_chain_bits);
+		f(zkoutpub.M_domain_bits);
+		f(zkoutpub.asset_mask_bits);
+		f(zkoutpub.amount_mask_bits);
+		f(zkoutpub.M_asset_enc_bits);
+		f(zkoutpub.M_amount_enc_bits);
+	}
+
+	for (auto& zkoutpriv : zk.output_private)
+	{
+		f(zkoutpriv.__dest_bits);
+		f(zkoutpriv.__paynum_bits);
+		f(zkoutpriv.__asset_bits);
+		f(zkoutpriv.__amount_fp_bits);
+		f(zkoutpriv.__asset_xor_bits);
+		f(zkoutpriv.__amount_xor_bits);
+	}
+
+	for (auto& zkinpub : zk.input_public)
+		f(zkinpub.M_domain_bits);
+
+	for (auto& zkinpriv : zk.input_private)
+	{
+		f(zkinpriv.____enforce_spendspec_with_spend_secrets_bit);
+		f(zkinpriv.____enforce_spendspec_with_trust_secrets_bit);
+		f(zkinpriv.____allow_master_secret_bit);
+		f(zkinpriv.____allow_freeze_bit);
+		f(zkinpriv.____allow_trust_unfreeze_bit);
+		f(zkinpriv.____require_public_hashkey_bit);
+		f(zkinpriv.____restrict_addresses_bit);
+		f(zkinpriv.____use_spend_secret_bits);
+		f(zkinpriv.____use_trust_secret_bits);
+
+		for (auto& v : zkinpriv.____output_address_matches)
+			f(v);
+
+		f(zkinpriv.__asset_bits);
+		f(zkinpriv.__amount_fp_bits);
+		f(zkinpriv.__M_commitment_iv_bits);
+		f(zkinpriv.__M_commitment_bits);
+		f(zkinpriv.__M_commitnum_bits);
+		f(zkinpriv.____master_secret_bits);
+		f(zkinpriv.____spend_secret_number_bits);
+		f(zkinpriv.____required_spendspec_hash_bits);
+		f(zkinpriv.____spend_locktime_bits);
+		f(zkinpriv.____trust_locktime_bits);
+		f(zkinpriv.____spend_delaytime_bits);
+		f(zkinpriv.____trust_delaytime_bits);
+		f(zkinpriv.____required_spend_secrets_bits);
+		f(zkinpriv.____required_trust_secrets_bits);
+		f(zkinpriv.____destnum_bits);
+		f(zkinpriv.__paynum_bits);
+
+		for (auto& v : zkinpriv.____spend_secret_bits)
+			f(v);
+		for (auto& v : zkinpriv.____trust_secret_bits)
+			f(v);
+		for (auto& v : zkinpriv.____monitor_secret_lo_bits)
+			f(v);
+		for (auto& v : zkinpriv.____monitor_secret_hi_bits)
+			f(v);
+	}
+
+	for (auto& zkinpath : zk.inpaths)
+		f(zkinpath.__M_merkle_path);
+}
+
+static uint64_t zk_workspace_bytes(TxPayZK& zk)
+{
+	// approximate; counts the workspace and the storage allocated by its vectors, but not the circuit nodes
+
+	uint64_t nbytes = sizeof(TxPayZK);
+
+	nbytes += zk.output_public.capacity() * sizeof(TxOutZKPub);
+	nbytes += zk.input_public.capacity() * sizeof(TxInZKPub);
+	nbytes += zk.output_private.capacity() * sizeof(TxOutZKPriv);
+	nbytes += zk.input_private.capacity() * sizeof(TxInZKPriv);
+
+	zk_workspace_bit_vectors(zk, [&nbytes](vector<ZKVAR>& v)
+	{
+		nbytes += v.capacity() * sizeof(ZKVAR);
+	});
+
+	return nbytes;
+}
+
+class ZKWorkspacePool
+{
+	struct Entry
+	{
+		unsigned keyindex;
+		uint64_t nbytes;
+		TxPayZK *pworkspace;
+	};
+
+	FastSpinLock pool_lock;
+	vector<Entry> idle;		// least recently used first
+
+	uint64_t nacquired;
+	uint64_t nreused;
+	uint64_t nevicted;
+	uint64_t idle_bytes;
+	uint64_t inuse_bytes;
+	uint64_t high_water_bytes;
+
+public:
+	ZKWorkspacePool()
+	 :	pool_lock(__FILE__, __LINE__),
+		nacquired(0),
+		nreused(0),
+		nevicted(0),
+		idle_bytes(0),
+		inuse_bytes(0),
+		high_water_bytes(0)
+	{ }
+
+	// returns a workspace for keyindex, and its size in nbytes
+	TxPayZK* Acquire(unsigned keyindex, uint64_t& nbytes)
+	{
+		{
+			lock_guard<FastSpinLock> lock(pool_lock);
+
+			++nacquired;
+
+			for (unsigned i = idle.size(); i-- > 0; )
+			{
+				if (idle[i].keyindex == keyindex)
+				{
+					auto pworkspace = idle[i].pworkspace;
+					nbytes = idle[i].nbytes;
+
+					idle.erase(idle.begin() + i);
+
+					idle_bytes -= nbytes;
+					inuse_bytes += nbytes;
+
+					++nreused;
+
+					return pworkspace;
+				}
+			}
+
+			nbytes = sizeof(TxPayZK);
+			inuse_bytes += nbytes;
+		}
+
+		auto pworkspace = new TxPayZK;
+		CCASSERT(pworkspace);
+
+		//@cerr << "ZKWorkspacePool new TxPayZK at " << hex << (uintptr_t)pworkspace << dec << endl;
+
+		return pworkspace;
+	}
+
+	// returns the workspace to the pool; acquired_bytes must be the size returned by Acquire
+	void Release(unsigned keyindex, TxPayZK *pworkspace, uint64_t acquired_bytes)
+	{
+		zk_workspace_bit_vectors(*pworkspace, [](vector<ZKVAR>& v)
+		{
+			v.clear();
+		});
+
+		auto nbytes = zk_workspace_bytes(*pworkspace);
+
+		TxPayZK *pevict = NULL;
+
+		{
+			lock_guard<FastSpinLock> lock(pool_lock);
+
+			inuse_bytes -= acquired_bytes;
+
+			if (high_water_bytes < idle_bytes + inuse_bytes + nbytes)
+				high_water_bytes = idle_bytes + inuse_bytes + nbytes;
+
+			if (idle.size() >= ZK_WORKSPACE_POOL_MAX)
+			{
+				pevict = idle.front().pworkspace;
+				idle_bytes -= idle.front().nbytes;
+				idle.erase(idle.begin());
+
+				++nevicted;
+			}
+
+			idle.push_back(Entry{keyindex, nbytes, pworkspace});
+			idle_bytes += nbytes;
+		}
+
+		delete pevict;
+	}
+
+	void GetStats(CCProof_WorkspaceStats& stats)
+	{
+		lock_guard<FastSpinLock> lock(pool_lock);
+
+		stats.acquired = nacquired;
+		stats.reused = nreused;
+		stats.evicted = nevicted;
+		stats.pooled = idle.size();
+		stats.pooled_bytes = idle_bytes;
+		stats.inuse_bytes = inuse_bytes;
+		stats.high_water_bytes = high_water_bytes;
+	}
+};
+
+static ZKWorkspacePool zkpool;
+
 thread_local static TxPayZK *pzk;
+thread_local static unsigned pzk_keyindex;
+thread_local static uint64_t pzk_nbytes;
 
-CCPROOF_API CCProof_Free()
+static TxPayZK& zk_workspace_acquire(unsigned keyindex)
 {
-	// clean up thread local storage
+	if (pzk && pzk_keyindex != keyindex)
+	{
+		zkpool.Release(pzk_keyindex, pzk, pzk_nbytes);
 
-	CCPseudoRandomDeInit();
+		pzk = NULL;
+	}
 
-	TL<R1C<ZKPAIRING::Fr>>::singleton(true);		// delete
-	TL<PowersOf2<ZKPAIRING::Fr>>::singleton(true);	// delete
+	if (!pzk)
+	{
+		pzk = zkpool.Acquire(keyindex, pzk_nbytes);
+		pzk_keyindex = keyindex;
+	}
 
+	return *pzk;
+}
+
+static void zk_workspace_release()
+{
 	if (pzk)
 	{
-		delete pzk;
+		zkpool.Release(pzk_keyindex, pzk, pzk_nbytes);
 
 		pzk = NULL;
 	}
+}
+
+CCPROOF_API CCProof_GetWorkspaceStats(CCProof_WorkspaceStats& stats)
+{
+	zkpool.GetStats(stats);
 
 	return 0;
 }
 
-// returns keyindex
-unsigned CCProof_Compute(TxPay& tx, unsigned keyindex = -1, bool verify = false, ostringstream *benchmark_text = NULL)
+CCPROOF_API CCProof_Free()
 {
-	init_rand_seed(tx.random_seed);
+	// clean up thread local storage
 
-	//cerr << "sizeof(TxPay) " << sizeof(TxPay) << endl;
-	//cerr << "sizeof(TxPayZK) " << sizeof(TxPayZK) << endl;
+	CCPseudoRandomDeInit();
 
-	//auto pzk = unique_ptr<TxPayZK>(new TxPayZK);
+	TL<R1C<ZKPAIRING::Fr>>::singleton(true);		// delete
+	TL<PowersOf2<ZKPAIRING::Fr>>::singleton(true);	// delete
 
-	if (!pzk)
-	{
-		pzk = new TxPayZK;
-		CCASSERT(pzk);
+	zk_workspace_release();
 
-		//@cerr << "CCProof_Compute new TxPayZK at " << hex << (uintptr_t)pzk << dec << endl;
-	}
+	return 0;
+}
+
+// returns keyindex
+unsigned CCProof_Compute(TxPay& tx, unsigned keyindex = -1, bool verify = false, ostringstream *benchmark_text = NULL, TxPayZK *pworkspace = NULL)
+{
+	init_rand_seed(tx.random_seed);
 
-	TxPayZK& zk(*pzk);
+	//cerr << "sizeof(TxPay) " << sizeof(TxPay) << endl;
+	//cerr << "sizeof(TxPayZK) " << sizeof(TxPayZK) << endl;
 
 	//@cerr << "tx nout " << tx.nout << " nin " << tx.nin << " nin_with_path " << tx.nin_with_path << endl;
 
-	zk.nout = tx.nout;
-	zk.nin = tx.nin;
-	zk.nin_with_path = tx.nin_with_path;
+	uint16_t nout = tx.nout;
+	uint16_t nin = tx.nin;
+	uint16_t nin_with_path = tx.nin_with_path;
 
 	// retrieve best fitting zk key
 
 	if ((int)keyindex == -1)
-		keyindex = keystore.GetKeyIndex(zk.nout, zk.nin, zk.nin_with_path, tx.test_uselargerzkkey);
+		keyindex = keystore.GetKeyIndex(nout, nin, nin_with_path, tx.test_uselargerzkkey);
 	else
-		keystore.SetTxCounts(keyindex, zk.nout, zk.nin, zk.nin_with_path, verify);
+		keystore.SetTxCounts(keyindex, nout, nin, nin_with_path, verify);
 
 	tx.zkkeyid = keystore.GetKeyId(keyindex);
 
-	zk.nassets = (zk.nout < zk.nin ? zk.nout : zk.nin) + (zk.nout != zk.nin);
-	if (!zk.nassets) ++zk.nassets;
-
-	zk.nsecrets = TX_MAX_SECRETS;
-	zk.nraddrs = TX_MAX_RESTRICTED_ADDRESSES;
-	zk.nrouts = zk.nout;
-
-	//cerr << "zk nout " << zk.nout << " nin " << zk.nin << " nin_with_path " << zk.nin_with_path << " nassets " << zk.nassets << " nsecrets " << zk.nsecrets << " nraddrs " << zk.nraddrs << " nrouts " << zk.nrouts << " keyindex " << keyindex << endl;
-
 	if ((int)keyindex == -1)
 	{
 		//@lock_guard<mutex> lock(g_cerr_lock);
@@ -2035,6 +2282,23 @@ unsigned CCProof_Compute(TxPay& tx, unsigned keyindex = -1, bool verify = false,
 		return CCPROOF_ERR_NO_KEY;
 	}
 
+	// use the caller's workspace if provided, otherwise a pooled workspace for this key
+
+	TxPayZK& zk(pworkspace ? *pworkspace : zk_workspace_acquire(keyindex));
+
+	zk.nout = nout;
+	zk.nin = nin;
+	zk.nin_with_path = nin_with_path;
+
+	zk.nassets = (zk.nout < zk.nin ? zk.nout : zk.nin) + (zk.nout != zk.nin);
+	if (!zk.nassets) ++zk.nassets;
+
+	zk.nsecrets = TX_MAX_SECRETS;
+	zk.nraddrs = TX_MAX_RESTRICTED_ADDRESSES;
+	zk.nrouts = zk.nout;
+
+	//cerr << "zk nout " << zk.nout << " nin " << zk.nin << " nin_with_path " << zk.nin_with_path << " nassets " << zk.nassets << " nsecrets " << zk.nsecrets << " nraddrs " << zk.nraddrs << " nrouts " << zk.nrouts << " keyindex " << keyindex << endl;
+
 	if (zk.nout < tx.nout || zk.nin < tx.nin || zk.nin_with_path < tx.nin_with_path)
 	{
 		//@lock_guard<mutex> lock(g_cerr_lock);
@@ -2292,6 +2556,8 @@ CCPROOF_API CCProof_GenProof(TxPay& tx)
 	{
 	}
 
+	zk_workspace_release();
+
 	if ((int)keyindex < 0)
 		return keyindex;
 
@@ -2375,6 +2641,8 @@ CCPROOF_API CCProof_VerifyProof(TxPay& tx)
 	{
 	}
 
+	zk_workspace_release();
+
 	if ((int)keyindex < 0)
 		return keyindex;
 
@@ -2389,3 +2657,87 @@ CCPROOF_API CCProof_VerifyProof(TxPay& tx)
 
 	return (valid ? 0 : -1);
 }
+
+static void zk_workspace_proof(const ZKKeyStore::ProveKey& key, const snarklib::PPZK_ProofRandomness<ZKPAIRING::Fr>& randomness, proof_vec_t& vec)
+{
+	// same as proof<ZKPAIRING>(key), but uses the caller's proof randomness, so two proofs from the same witness are identical
+
+	const auto& RS = TL<R1C<ZKPAIRING::Fr>>::singleton();
+
+	Proof<ZKPAIRING> zkproof(RS->constraintSystem(), RS->numCircuitInputs(), key, RS->witness(), randomness);
+
+	Proof2Vec(vec, zkproof);
+}
+
+// Computes the proof for tx in a pooled workspace and again in a newly allocated workspace, with the same proof
+// randomness, and checks that both proofs are byte-identical.  If verify is set, it then checks that the proof from the
+// pooled workspace verifies, which requires a tx that satisfies the proof constraints.  Called repeatedly with a mix of
+// key shapes, this checks that workspace reuse leaves nothing behind from one proof to the next that changes the next proof.
+// Returns 0 if the proofs match (and verify), -1 if they don't, or an error code from CCProof_Compute.
+
+CCPROOF_API CCProof_CheckWorkspace(TxPay& tx, bool verify)
+{
+#if TEST_SKIP_ZKPROOFS
+	return 0;
+#endif
+
+	proof_vec_t pooled_proof, fresh_proof;
+	unsigned keyindex = -1;
+	bool match = false;
+
+	try
+	{
+		reset<ZKPAIRING>();
+
+		keyindex = CCProof_Compute(tx, (tx.tag_type == CC_TYPE_MINT ? TX_MINT_ZKKEY_ID : -1), false);
+
+		if ((int)keyindex >= 0)
+		{
+			auto key = keystore.GetProofKey(keyindex);
+
+			if (!key)
+				keyindex = CCPROOF_ERR_LOADING_KEY;
+			else
+			{
+				const snarklib::PPZK_ProofRandomness<ZKPAIRING::Fr> randomness(0);
+
+				zk_workspace_proof(*key, randomness, pooled_proof);
+
+				reset<ZKPAIRING>();
+
+				unique_ptr<TxPayZK> fresh(new TxPayZK);
+				CCASSERT(fresh);
+
+				CCProof_Compute(tx, keyindex, false, NULL, fresh.get());
+
+				zk_workspace_proof(*key, randomness, fresh_proof);
+
+				match = !memcmp(&pooled_proof, &fresh_proof, sizeof(pooled_proof));
+			}
+		}
+
+		reset<ZKPAIRING>();	// free memory
+	}
+	catch (...)
+	{
+	}
+
+	zk_workspace_release();
+
+	if ((int)keyindex < 0)
+		return keyindex;
+
+	if (!match)
+		return -1;
+
+	if (verify)
+	{
+		static_assert(sizeof(tx.zkproof) == sizeof(pooled_proof), "proof size mismatch");
+
+		memcpy(&tx.zkproof, &pooled_proof, sizeof(tx.zkproof));
+
+		return CCProof_VerifyProof(tx);
+	}
+
+	return 0;
+}
@@ -53,6 +53,17 @@
 
 struct TxPay;
 
+struct CCProof_WorkspaceStats
+{
+	uint64_t acquired;			// number of proofs and verifications that used a pooled workspace
+	uint64_t reused;			// number of those that reused a workspace from a previous proof with the same key
+	uint64_t evicted;			// number of idle workspaces freed to keep the pool within its size limit
+	uint32_t pooled;			// number of idle workspaces in the pool
+	uint64_t pooled_bytes;		// approximate memory held by idle workspaces (excludes the constraint system, witness and QAP)
+	uint64_t inuse_bytes;		// approximate memory held by workspaces in use
+	uint64_t high_water_bytes;	// highest value of pooled_bytes + inuse_bytes
+};
+
 #if TEST_SUPPORT_ZK_KEYGEN
 CCPROOF_API CCProof_GenKeys();
 #endif
@@ -66,3 +77,7 @@ CCPROOF_API CCProof_GenProof(TxPay& tx);
 CCPROOF_API CCProof_PreloadVerifyKeys(bool require_all = false);
 
 CCPROOF_API CCProof_VerifyProof(TxPay& tx);
+
+CCPROOF_API CCProof_GetWorkspaceStats(CCProof_WorkspaceStats& stats);
+
+CCPROOF_API CCProof_CheckWorkspace(TxPay& tx, bool verify = false);
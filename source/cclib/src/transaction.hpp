@@ -220,7 +220,10 @@ struct TxInPath
 	array<bigint_t, TX_MERKLE_DEPTH> __M_merkle_path;
 };
 
-struct TxPay
+// TxPayBase holds the values of a TxPay that don't depend on the number of inputs and outputs
+// the inputs and outputs are in TxPay, which is sized for the maximum counts, or in TxPayCompact, which is sized for the actual counts
+
+struct TxPayBase
 {
 	// not on wire:
 	uint32_t zero;				// always zero in case app tries to print buffer as string
@@ -292,6 +295,10 @@ struct TxPay
 	uint16_t nout;
 	uint16_t nin;
 	uint16_t nin_with_path;
+};
+
+struct TxPay : public TxPayBase
+{
 	array<TxOut, TX_MAXOUT> outputs;
 	array<TxIn, TX_MAXIN> inputs;
 	array<TxInPath, TX_MAXINPATH> inpaths;
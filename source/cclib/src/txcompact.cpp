@@ -0,0 +1,98 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * txcompact.cpp
+*/
+
+#include "cclib.h"
+#include "txcompact.hpp"
+#include "transaction.h"
+
+// the arena holds the inputs first, then the input paths, then the outputs
+// all three structs are a multiple of 8 bytes in size, so each array in the arena is aligned the same as its struct
+
+static_assert(sizeof(TxIn) % sizeof(uint64_t) == 0, "TxIn size");
+static_assert(sizeof(TxInPath) % sizeof(uint64_t) == 0, "TxInPath size");
+static_assert(sizeof(TxOut) % sizeof(uint64_t) == 0, "TxOut size");
+
+void TxPayCompact::Clear()
+{
+	memset((void*)static_cast<TxPayBase*>(this), 0, sizeof(TxPayBase));
+
+	m_arena.clear();
+	m_arena.shrink_to_fit();
+
+	outputs = NULL;
+	inputs = NULL;
+	inpaths = NULL;
+}
+
+void TxPayCompact::Allocate(unsigned nout, unsigned nin, unsigned npath)
+{
+	CCASSERT(nout <= TX_MAXOUT);
+	CCASSERT(nin <= TX_MAXIN);
+	CCASSERT(npath <= TX_MAXINPATH);
+
+	auto nbytes = nin * sizeof(TxIn) + npath * sizeof(TxInPath) + nout * sizeof(TxOut);
+
+	m_arena.assign(nbytes / sizeof(uint64_t), 0);
+	m_arena.shrink_to_fit();
+
+	auto p = (char*)m_arena.data();
+
+	inputs = (TxIn*)p;
+	p += nin * sizeof(TxIn);
+
+	inpaths = (TxInPath*)p;
+	p += npath * sizeof(TxInPath);
+
+	outputs = (TxOut*)p;
+}
+
+TxPayCompact& TxPayCompact::operator= (const TxPayCompact& other)
+{
+	if (this == &other)
+		return *this;
+
+	memcpy((void*)static_cast<TxPayBase*>(this), (const void*)static_cast<const TxPayBase*>(&other), sizeof(TxPayBase));
+
+	Allocate(nout, nin, nin_with_path);
+
+	memcpy((void*)m_arena.data(), other.m_arena.data(), ArenaSize());
+
+	return *this;
+}
+
+void TxPayCompact::FromTxPay(const TxPay& tx)
+{
+	CCASSERT(tx.nout <= TX_MAXOUT);
+	CCASSERT(tx.nin <= TX_MAXIN);
+	CCASSERT(tx.nin_with_path <= TX_MAXINPATH);
+
+	memcpy((void*)static_cast<TxPayBase*>(this), (const void*)static_cast<const TxPayBase*>(&tx), sizeof(TxPayBase));
+
+	Allocate(nout, nin, nin_with_path);
+
+	memcpy((void*)outputs, (const void*)tx.outputs.data(), nout * sizeof(TxOut));
+	memcpy((void*)inputs, (const void*)tx.inputs.data(), nin * sizeof(TxIn));
+	memcpy((void*)inpaths, (const void*)tx.inpaths.data(), nin_with_path * sizeof(TxInPath));
+}
+
+// sets tx to the same values it had when it was passed to FromTxPay, assuming it was initialized with tx_init
+// only the entries past the counts are cleared, which is faster than clearing the entire TxPay
+
+void TxPayCompact::ToTxPay(TxPay& tx) const
+{
+	memcpy((void*)static_cast<TxPayBase*>(&tx), (const void*)static_cast<const TxPayBase*>(this), sizeof(TxPayBase));
+
+	memcpy((void*)tx.outputs.data(), (const void*)outputs, nout * sizeof(TxOut));
+	memset((void*)(tx.outputs.data() + nout), 0, (TX_MAXOUT - nout) * sizeof(TxOut));
+
+	memcpy((void*)tx.inputs.data(), (const void*)inputs, nin * sizeof(TxIn));
+	memset((void*)(tx.inputs.data() + nin), 0, (TX_MAXIN - nin) * sizeof(TxIn));
+
+	memcpy((void*)tx.inpaths.data(), (const void*)inpaths, nin_with_path * sizeof(TxInPath));
+	memset((void*)(tx.inpaths.data() + nin_with_path), 0, (TX_MAXINPATH - nin_with_path) * sizeof(TxInPath));
+}
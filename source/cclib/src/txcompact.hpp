@@ -0,0 +1,59 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * txcompact.hpp
+*/
+
+#pragma once
+
+#include "transaction.hpp"
+
+/*
+
+TxPayCompact holds the same values as a TxPay, but its outputs, inputs and input paths are stored in a single arena that
+is sized for the actual number of each, instead of in fixed arrays sized for the maximum number.  A TxPay with one or two
+inputs is about one sixth of the size when stored as a TxPayCompact.
+
+The field names are the same as in TxPay, so code that reads or sets tx.param_level or tx.outputs[i].M_address works
+the same with either one.  Code that requires the fixed layout, such as the wire encoder and the zero knowledge proof,
+is called on a TxPay obtained from ToTxPay.
+
+*/
+
+class TxPayCompact : public TxPayBase
+{
+	vector<uint64_t> m_arena;
+
+	void Allocate(unsigned nout, unsigned nin, unsigned npath);
+
+public:
+	TxOut *outputs;
+	TxIn *inputs;
+	TxInPath *inpaths;
+
+	TxPayCompact()
+	{
+		Clear();
+	}
+
+	TxPayCompact(const TxPayCompact& other)
+	{
+		Clear();
+
+		*this = other;
+	}
+
+	TxPayCompact& operator= (const TxPayCompact& other);
+
+	void Clear();
+
+	void FromTxPay(const TxPay& tx);
+	void ToTxPay(TxPay& tx) const;
+
+	size_t ArenaSize() const
+	{
+		return m_arena.size() * sizeof(uint64_t);
+	}
+};
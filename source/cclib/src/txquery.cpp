@@ -221,6 +221,96 @@ static CCRESULT tx_query_inputs_json_create(const string& fn, const string& quer
 	return 0;
 }
 
+CCRESULT tx_query_address_watch_create(const string& fn, uint64_t blockchain, const uint64_t commitstart, const bigint_t *addresses, unsigned naddresses, char *binbuf, const uint32_t binsize)
+{
+	uint32_t bufpos = 0;
+	const bool bhex = false;
+
+	copy_to_buf(bufpos, sizeof(bufpos), bufpos, binbuf, binsize, bhex);  // save space for size word
+
+	uint32_t tag = CC_TAG_TX_QUERY_ADDRESS_WATCH;
+	copy_to_buf(tag, sizeof(tag), bufpos, binbuf, binsize, bhex);
+
+	CCASSERT(bufpos == sizeof(CCObject::Header));
+
+	copy_to_buf(zero_pow, sizeof(zero_pow), bufpos, binbuf, binsize, bhex);
+	copy_to_buf(blockchain, TX_CHAIN_BYTES, bufpos, binbuf, binsize, bhex);
+	copy_to_buf(commitstart, sizeof(commitstart), bufpos, binbuf, binsize, bhex);
+
+	for (unsigned i = 0; i < naddresses; ++i)
+		copy_to_buf(addresses[i], TX_ADDRESS_BYTES, bufpos, binbuf, binsize, bhex);
+
+	if (bufpos > binsize)
+		return 1;
+
+	//cerr << "tx_query_address_watch_create nbytes " << bufpos << endl;
+
+	memcpy(binbuf, &bufpos, sizeof(bufpos));
+
+	return 0;
+}
+
+static CCRESULT tx_query_address_watch_json_create(const string& fn, const string& query, Json::Value& root, char *output, const uint32_t outsize, char *binbuf, const uint32_t binsize)
+{
+	unsigned naddresses = 0;
+	uint64_t blockchain, commitstart = 0;
+	vector<bigint_t> addresses;
+	bigint_t bigval;
+
+	string key;
+	Json::Value value;
+
+	key = "blockchain";
+	if (!root.removeMember(key, &value))
+		return error_missing_key(fn, key, output, outsize);
+	auto rc = parse_int_value(fn, key, value.asString(), TX_CHAIN_BITS, 0UL, bigval, output, outsize);
+	if (rc) return rc;
+	blockchain = BIG64(bigval);
+
+	key = "commitment-number-start";
+	if (root.removeMember(key, &value))
+	{
+		rc = parse_int_value(fn, key, value.asString(), TX_COMMITNUM_BITS, 0UL, bigval, output, outsize);
+		if (rc) return rc;
+		commitstart = BIG64(bigval);
+	}
+
+	key = "addresses";
+	if (!root.removeMember(key, &value))
+		return error_missing_key(fn, key, output, outsize);
+
+	if (!value.isArray())
+		return error_not_array_objs(fn, key, output, outsize);
+
+	naddresses = value.size();
+
+	if (naddresses < 1)
+		return error_num_values(fn, key, 1, output, outsize);
+
+	if (naddresses > TX_QUERY_WATCH_MAX_ADDRESSES)
+		return error_too_many_objs(fn, key, TX_QUERY_WATCH_MAX_ADDRESSES, output, outsize);
+
+	addresses.resize(naddresses);
+
+	for (unsigned i = 0; i < naddresses; ++i)
+	{
+		auto rc = parse_int_value(fn, key, value[i].asString(), TX_ADDRESS_BITS, 0UL, addresses[i], output, outsize);
+		if (rc) return rc;
+	}
+
+	if (!root.empty())
+		return error_unexpected_key(fn, root.begin().name(), output, outsize);
+
+	rc = tx_query_address_watch_create(fn, blockchain, commitstart, addresses.data(), naddresses, binbuf, binsize);
+
+	if (rc > 0)
+		return error_buffer_overflow(fn, output, outsize);
+	if (rc)
+		return error_unexpected(fn, output, outsize);
+
+	return 0;
+}
+
 CCRESULT tx_query_serialnum_create(const string& fn, uint64_t blockchain, const bigint_t *serialnums, unsigned nserials, char *binbuf, const uint32_t binsize)
 {
 	//cerr << "serialnum " << serialnum << endl;
@@ -333,6 +423,9 @@ CCRESULT tx_query_from_json(const string& fn, Json::Value& root, char *output, c
 	if (key == "tx-address-query")
 		return tx_query_address_json_create(fn, key, root, output, outsize, binbuf, binsize);
 
+	if (key == "tx-address-watch")
+		return tx_query_address_watch_json_create(fn, key, root, output, outsize, binbuf, binsize);
+
 	if (key == "tx-input-query")
 		return tx_query_inputs_json_create(fn, key, root, output, outsize, binbuf, binsize);
 
@@ -0,0 +1,266 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * txview.cpp
+*/
+
+#include "cclib.h"
+#include "txview.hpp"
+#include "transaction.hpp"
+#include "xtransaction.hpp"
+#include "CCparams.h"
+
+#include <CCobjects.hpp>
+
+//#define TEST_SHOW_WIRE_ERRORS	1	// for debugging
+
+#ifndef TEST_SHOW_WIRE_ERRORS
+#define TEST_SHOW_WIRE_ERRORS	0	// don't debug
+#endif
+
+#define TXVIEW_ZKPROOF_BYTES	(ZKPROOF_VALS * sizeof(bigint_t) - 1)	// same as txpay_body_from_wire
+
+CCRESULT TxView::Init(const void *wire, const uint32_t binsize)
+{
+	Clear();
+
+	if (TEST_EXTRA_ON_WIRE)
+		return -1;		// wire layout not supported
+
+	auto bufp = (const uint8_t*)wire;
+	uint32_t bufpos = sizeof(CCObject::Header);
+
+	if (binsize < bufpos)
+		return -1;
+
+	uint32_t wiresize, wire_tag;
+	memcpy(&wiresize, bufp, sizeof(wiresize));
+	memcpy(&wire_tag, bufp + sizeof(wiresize), sizeof(wire_tag));
+
+	if (wiresize > binsize)
+		return -1;
+
+	auto tag_type = CCObject::ObjType(wire_tag);
+
+	if (!tag_type || tag_type == CC_TYPE_BLOCK || tag_type == CC_TYPE_VOID)
+		return -1;
+
+	if (CCObject::HasPOW(wire_tag))
+		bufpos += TX_POW_SIZE;
+
+	wire_tag = CCObject::WireTag(wire_tag);
+
+	bool xdomain = (wire_tag == CC_TAG_TX_XDOMAIN);
+
+	if (!Xtx::TypeHasBareMsg(tag_type))
+	{
+		m_body_offset = bufpos;
+
+		bufpos += TX_BLOCKLEVEL_BYTES + TXVIEW_ZKPROOF_BYTES;
+
+		if (tag_type == CC_TYPE_MINT)
+			m_zkkeyid = TX_MINT_ZKKEY_ID;
+		else
+		{
+			if (bufpos + 1 > binsize)
+				return -1;
+
+			m_zkkeyid = bufp[bufpos++];
+		}
+
+		bufpos += TX_DONATION_BYTES;
+
+		switch (tag_type)
+		{
+		case CC_TYPE_TXPAY:
+		case CC_TYPE_XCX_SIMPLE_BUY:
+		case CC_TYPE_XCX_SIMPLE_SELL:
+		case CC_TYPE_XCX_MINING_TRADE:
+		case CC_TYPE_XCX_NAKED_BUY:
+		case CC_TYPE_XCX_NAKED_SELL:
+		{
+			if (bufpos + 1 > binsize)
+				return -1;
+
+			uint8_t nadj = bufp[bufpos++];
+			m_nout = (nadj >> 4) + 1;
+			m_nin_with_path = (nadj & 15) + 1;
+			m_nin = m_nin_with_path;
+
+			break;
+		}
+
+		case CC_TYPE_MINT:
+			m_nout = TX_MINT_NOUT;
+			break;
+
+		default:
+			if (TEST_SHOW_WIRE_ERRORS) cerr << "TxView::Init invalid transaction type " << tag_type << endl;
+
+			return -1;
+		}
+
+		if (m_nout > TX_MAXOUT || m_nin > TX_MAXIN || m_nin_with_path > TX_MAXINPATH)
+		{
+			if (TEST_SHOW_WIRE_ERRORS) cerr << "TxView::Init invalid nout " << m_nout << " nin " << m_nin << " nin_with_path " << m_nin_with_path << endl;
+
+			return -1;
+		}
+
+		m_output_size = TX_ADDRESS_BYTES + TX_AMOUNT_BYTES + TX_COMMITMENT_BYTES;
+		if (xdomain)
+			m_output_size += TX_DOMAIN_BYTES;
+		if (tag_type != CC_TYPE_MINT)
+			m_output_size += TX_ASSET_WIRE_BYTES;
+
+		m_input_size = TX_SERIALNUM_BYTES + TX_HASHKEY_WIRE_BYTES;
+		if (xdomain)
+			m_input_size += TX_DOMAIN_BYTES;
+
+		m_outputs_offset = bufpos;
+		bufpos += m_nout * m_output_size;
+
+		m_inputs_offset = bufpos;
+		bufpos += m_nin * m_input_size;
+	}
+
+	if (bufpos > wiresize)
+	{
+		if (TEST_SHOW_WIRE_ERRORS) cerr << "TxView::Init bufpos " << bufpos << " > wiresize " << wiresize << endl;
+
+		return -1;
+	}
+
+	auto nappend = wiresize - bufpos;
+
+	if (nappend && (!Xtx::TypeIsXtx(tag_type) || nappend > TX_MAX_APPEND))
+	{
+		if (TEST_SHOW_WIRE_ERRORS) cerr << "TxView::Init tag_type " << tag_type << " append data length " << nappend << endl;
+
+		return -1;
+	}
+
+	m_wire = bufp;
+	m_wiresize = wiresize;
+	m_wire_tag = wire_tag;
+	m_tag_type = tag_type;
+	m_append_offset = bufpos;
+
+	return 0;
+}
+
+uint64_t TxView::ReadUint(uint32_t offset, unsigned nbytes) const
+{
+	CCASSERT(nbytes <= sizeof(uint64_t));
+	CCASSERT(offset + nbytes <= m_wiresize);
+
+	uint64_t val = 0;
+
+	memcpy(&val, m_wire + offset, nbytes);
+
+	return val;
+}
+
+uint64_t TxView::ParamLevel() const
+{
+	if (!HasBody())
+		return 0;
+
+	return ReadUint(m_body_offset, TX_BLOCKLEVEL_BYTES);
+}
+
+uint64_t TxView::DonationFp() const
+{
+	if (!HasBody())
+		return 0;
+
+	auto offset = m_body_offset + TX_BLOCKLEVEL_BYTES + TXVIEW_ZKPROOF_BYTES;
+	if (m_tag_type != CC_TYPE_MINT)
+		offset += 1;
+
+	return ReadUint(offset, TX_DONATION_BYTES);
+}
+
+const uint8_t* TxView::OutputPtr(unsigned index) const
+{
+	CCASSERT(index < m_nout);
+
+	return m_wire + m_outputs_offset + index * m_output_size;
+}
+
+const uint8_t* TxView::InputPtr(unsigned index) const
+{
+	CCASSERT(index < m_nin);
+
+	return m_wire + m_inputs_offset + index * m_input_size;
+}
+
+void TxView::GetOutputAddress(unsigned index, bigint_t& address) const
+{
+	address = 0UL;
+
+	memcpy(&address, OutputPtr(index), TX_ADDRESS_BYTES);
+}
+
+uint32_t TxView::GetOutputDomain(unsigned index) const
+{
+	if (m_wire_tag != CC_TAG_TX_XDOMAIN)
+		return 0;	// default domain is not on the wire
+
+	return ReadUint(OutputPtr(index) - m_wire + TX_ADDRESS_BYTES, TX_DOMAIN_BYTES);
+}
+
+uint64_t TxView::GetOutputAssetEnc(unsigned index) const
+{
+	if (m_tag_type == CC_TYPE_MINT)
+		return 0;
+
+	auto offset = OutputPtr(index) - m_wire + TX_ADDRESS_BYTES;
+	if (m_wire_tag == CC_TAG_TX_XDOMAIN)
+		offset += TX_DOMAIN_BYTES;
+
+	return ReadUint(offset, TX_ASSET_WIRE_BYTES);
+}
+
+uint64_t TxView::GetOutputAmountEnc(unsigned index) const
+{
+	auto offset = OutputPtr(index) - m_wire + m_output_size - TX_COMMITMENT_BYTES - TX_AMOUNT_BYTES;
+
+	return ReadUint(offset, TX_AMOUNT_BYTES);
+}
+
+void TxView::GetOutputCommitment(unsigned index, bigint_t& commitment) const
+{
+	commitment = 0UL;
+
+	memcpy(&commitment, OutputPtr(index) + m_output_size - TX_COMMITMENT_BYTES, TX_COMMITMENT_BYTES);
+}
+
+uint32_t TxView::GetInputDomain(unsigned index) const
+{
+	if (m_wire_tag != CC_TAG_TX_XDOMAIN)
+		return 0;	// default domain is not on the wire
+
+	return ReadUint(InputPtr(index) - m_wire, TX_DOMAIN_BYTES);
+}
+
+const uint8_t* TxView::SerialnumPtr(unsigned index) const
+{
+	return InputPtr(index) + m_input_size - TX_HASHKEY_WIRE_BYTES - TX_SERIALNUM_BYTES;
+}
+
+void TxView::GetSerialnum(unsigned index, bigint_t& serialnum) const
+{
+	serialnum = 0UL;
+
+	memcpy(&serialnum, SerialnumPtr(index), TX_SERIALNUM_BYTES);
+}
+
+void TxView::GetHashkey(unsigned index, bigint_t& hashkey) const
+{
+	hashkey = 0UL;
+
+	memcpy(&hashkey, InputPtr(index) + m_input_size - TX_HASHKEY_WIRE_BYTES, TX_HASHKEY_WIRE_BYTES);
+}
@@ -0,0 +1,136 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * txview.hpp
+*/
+
+#pragma once
+
+#include "CCapi.h"
+#include "CCbigint.hpp"
+
+/*
+
+TxView provides read-only access to the public values of a transaction directly from its wire data, without decoding
+it into a TxPay.  Init checks the wire header and the size of the transaction, and records where the outputs, inputs and
+append data start; the field accessors then read directly from the wire buffer, which must remain valid and unchanged
+while the view is used.
+
+Init checks the wire layout the same way tx_from_wire does, and also rejects append data longer than TX_MAX_APPEND.
+Only the values that are on the wire are available: a mint transaction has no inputs on the wire, and the values that
+tx_from_wire sets from the param_level (such as the mint inputs) are neither available nor checked.  Init always fails
+in TEST_EXTRA_ON_WIRE builds, so callers should fall back to tx_from_wire when Init fails.
+
+*/
+
+class TxView
+{
+	const uint8_t *m_wire;
+	uint32_t m_wiresize;
+	uint32_t m_wire_tag;
+	uint16_t m_tag_type;
+	uint16_t m_zkkeyid;
+	uint16_t m_nout;
+	uint16_t m_nin;
+	uint16_t m_nin_with_path;
+	uint32_t m_body_offset;
+	uint32_t m_outputs_offset;
+	uint32_t m_inputs_offset;
+	uint32_t m_append_offset;
+	uint32_t m_output_size;
+	uint32_t m_input_size;
+
+	uint64_t ReadUint(uint32_t offset, unsigned nbytes) const;
+
+public:
+	TxView()
+	{
+		Clear();
+	}
+
+	void Clear()
+	{
+		memset((void*)this, 0, sizeof(*this));
+	}
+
+	CCRESULT Init(const void *wire, const uint32_t binsize);
+
+	bool IsValid() const
+	{
+		return m_wire != NULL;
+	}
+
+	const uint8_t* WirePtr() const
+	{
+		return m_wire;
+	}
+
+	uint32_t WireSize() const
+	{
+		return m_wiresize;
+	}
+
+	uint32_t WireTag() const
+	{
+		return m_wire_tag;
+	}
+
+	uint16_t TagType() const
+	{
+		return m_tag_type;
+	}
+
+	bool HasBody() const
+	{
+		return m_body_offset != 0;
+	}
+
+	uint16_t ZKKeyId() const
+	{
+		return m_zkkeyid;
+	}
+
+	uint16_t NOut() const
+	{
+		return m_nout;
+	}
+
+	uint16_t NIn() const
+	{
+		return m_nin;
+	}
+
+	uint16_t NInWithPath() const
+	{
+		return m_nin_with_path;
+	}
+
+	uint64_t ParamLevel() const;
+	uint64_t DonationFp() const;
+
+	const uint8_t* OutputPtr(unsigned index) const;
+	const uint8_t* InputPtr(unsigned index) const;
+
+	void GetOutputAddress(unsigned index, bigint_t& address) const;
+	uint32_t GetOutputDomain(unsigned index) const;
+	uint64_t GetOutputAssetEnc(unsigned index) const;
+	uint64_t GetOutputAmountEnc(unsigned index) const;
+	void GetOutputCommitment(unsigned index, bigint_t& commitment) const;
+
+	uint32_t GetInputDomain(unsigned index) const;
+	const uint8_t* SerialnumPtr(unsigned index) const;	// points to TX_SERIALNUM_BYTES on the wire
+	void GetSerialnum(unsigned index, bigint_t& serialnum) const;
+	void GetHashkey(unsigned index, bigint_t& hashkey) const;
+
+	const uint8_t* AppendDataPtr() const
+	{
+		return m_wire + m_append_offset;
+	}
+
+	uint32_t AppendDataLength() const
+	{
+		return m_wiresize - m_append_offset;
+	}
+};
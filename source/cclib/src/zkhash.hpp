@@ -400,6 +400,17 @@ public:
 	//	and if pbitval is not NULL, sum(bit[i]*2^i) is constrained to equal *pbitval
 
 	static vector<ZKBOOL> extractBits(const ZKVAR& var, int nbits, ZKVAR *premainder = NULL, ZKVAR *pbitval = NULL)
+	{
+		vector<ZKBOOL> bits;
+
+		extractBits(var, nbits, bits, premainder, pbitval);
+
+		return bits;
+	}
+
+	// Same as above, but places the bits in an existing vector, so its storage can be reused from one proof to the next
+
+	static void extractBits(const ZKVAR& var, int nbits, vector<ZKBOOL>& bits, ZKVAR *premainder = NULL, ZKVAR *pbitval = NULL)
 	{
 		bigint_t val = ZKVAL<ZKVAR, bigint_t>::value(var);
 
@@ -422,7 +433,7 @@ public:
 		}
 		#endif
 
-		vector<ZKBOOL> bits;
+		bits.clear();
 		bits.reserve(nbits);
 
 		bigint_t bval = 0UL;
@@ -467,8 +478,6 @@ public:
 		}
 
 		ZKCONSTRAINTS<ZKPAIRING,ZKVAR,ZKBOOL>::constrainValue(var, bits, NULL, premainder, pbitval);
-
-		return bits;
 	}
 
 	static ZKVAR Knapsack1(const vector<ZKBOOL>& bits, const void *prfkey, uint32_t& basisi, bool sequential)
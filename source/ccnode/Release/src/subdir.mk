@@ -6,8 +6,10 @@
 CPP_SRCS += \
 ../src/block.cpp \
 ../src/blockchain.cpp \
+../src/blockscore.cpp \
 ../src/blockserve.cpp \
 ../src/blocksync.cpp \
+../src/blocktxcheck.cpp \
 ../src/ccnode.cpp \
 ../src/commitments.cpp \
 ../src/dbconn-explain.cpp \
@@ -27,6 +29,7 @@ CPP_SRCS += \
 ../src/foreign-query.cpp \
 ../src/foreign-rpc.cpp \
 ../src/hostdir.cpp \
+../src/memaccount.cpp \
 ../src/mints.cpp \
 ../src/process-xreq.cpp \
 ../src/processblock.cpp \
@@ -34,13 +37,16 @@ CPP_SRCS += \
 ../src/relay.cpp \
 ../src/seqnum.cpp \
 ../src/transact.cpp \
+../src/txpool.cpp \
 ../src/witness.cpp 
 
 CPP_DEPS += \
 ./src/block.d \
 ./src/blockchain.d \
+./src/blockscore.d \
 ./src/blockserve.d \
 ./src/blocksync.d \
+./src/blocktxcheck.d \
 ./src/ccnode.d \
 ./src/commitments.d \
 ./src/dbconn-explain.d \
@@ -60,6 +66,7 @@ CPP_DEPS += \
 ./src/foreign-query.d \
 ./src/foreign-rpc.d \
 ./src/hostdir.d \
+./src/memaccount.d \
 ./src/mints.d \
 ./src/process-xreq.d \
 ./src/processblock.d \
@@ -67,13 +74,16 @@ CPP_DEPS += \
 ./src/relay.d \
 ./src/seqnum.d \
 ./src/transact.d \
+./src/txpool.d \
 ./src/witness.d 
 
 OBJS += \
 ./src/block.o \
 ./src/blockchain.o \
+./src/blockscore.o \
 ./src/blockserve.o \
 ./src/blocksync.o \
+./src/blocktxcheck.o \
 ./src/ccnode.o \
 ./src/commitments.o \
 ./src/dbconn-explain.o \
@@ -93,6 +103,7 @@ OBJS += \
 ./src/foreign-query.o \
 ./src/foreign-rpc.o \
 ./src/hostdir.o \
+./src/memaccount.o \
 ./src/mints.o \
 ./src/process-xreq.o \
 ./src/processblock.o \
@@ -100,6 +111,7 @@ OBJS += \
 ./src/relay.o \
 ./src/seqnum.o \
 ./src/transact.o \
+./src/txpool.o \
 ./src/witness.o 
 
 
@@ -115,7 +127,7 @@ src/%.o: ../src/%.cpp src/subdir.mk
 clean: clean-src
 
 clean-src:
-	-$(RM) ./src/block.d ./src/block.o ./src/blockchain.d ./src/blockchain.o ./src/blockserve.d ./src/blockserve.o ./src/blocksync.d ./src/blocksync.o ./src/ccnode.d ./src/ccnode.o ./src/commitments.d ./src/commitments.o ./src/dbconn-explain.d ./src/dbconn-explain.o ./src/dbconn-persistent.d ./src/dbconn-persistent.o ./src/dbconn-processq.d ./src/dbconn-processq.o ./src/dbconn-relay.d ./src/dbconn-relay.o ./src/dbconn-tempserials.d ./src/dbconn-tempserials.o ./src/dbconn-validobjs.d ./src/dbconn-validobjs.o ./src/dbconn-wal.d ./src/dbconn-wal.o ./src/dbconn-xreqs.d ./src/dbconn-xreqs.o ./src/dbconn.d ./src/dbconn.o ./src/exchange.d ./src/exchange.o ./src/exchange_mining.d ./src/exchange_mining.o ./src/expire.d ./src/expire.o ./src/foreign-conn.d ./src/foreign-conn.o ./src/foreign-query-btc.d ./src/foreign-query-btc.o ./src/foreign-query.d ./src/foreign-query.o ./src/foreign-rpc.d ./src/foreign-rpc.o ./src/hostdir.d ./src/hostdir.o ./src/mints.d ./src/mints.o ./src/process-xreq.d ./src/process-xreq.o ./src/processblock.d ./src/processblock.o ./src/processtx.d ./src/processtx.o ./src/relay.d ./src/relay.o ./src/seqnum.d ./src/seqnum.o ./src/transact.d ./src/transact.o ./src/witness.d ./src/witness.o
+	-$(RM) ./src/block.d ./src/block.o ./src/blockchain.d ./src/blockchain.o ./src/blockscore.d ./src/blockscore.o ./src/blockserve.d ./src/blockserve.o ./src/blocksync.d ./src/blocksync.o ./src/blocktxcheck.d ./src/blocktxcheck.o ./src/ccnode.d ./src/ccnode.o ./src/commitments.d ./src/commitments.o ./src/dbconn-explain.d ./src/dbconn-explain.o ./src/dbconn-persistent.d ./src/dbconn-persistent.o ./src/dbconn-processq.d ./src/dbconn-processq.o ./src/dbconn-relay.d ./src/dbconn-relay.o ./src/dbconn-tempserials.d ./src/dbconn-tempserials.o ./src/dbconn-validobjs.d ./src/dbconn-validobjs.o ./src/dbconn-wal.d ./src/dbconn-wal.o ./src/dbconn-xreqs.d ./src/dbconn-xreqs.o ./src/dbconn.d ./src/dbconn.o ./src/exchange.d ./src/exchange.o ./src/exchange_mining.d ./src/exchange_mining.o ./src/expire.d ./src/expire.o ./src/foreign-conn.d ./src/foreign-conn.o ./src/foreign-query-btc.d ./src/foreign-query-btc.o ./src/foreign-query.d ./src/foreign-query.o ./src/foreign-rpc.d ./src/foreign-rpc.o ./src/hostdir.d ./src/hostdir.o ./src/memaccount.d ./src/memaccount.o ./src/mints.d ./src/mints.o ./src/process-xreq.d ./src/process-xreq.o ./src/processblock.d ./src/processblock.o ./src/processtx.d ./src/processtx.o ./src/relay.d ./src/relay.o ./src/seqnum.d ./src/seqnum.o ./src/transact.d ./src/transact.o ./src/txpool.d ./src/txpool.o ./src/witness.d ./src/witness.o
 
 .PHONY: clean-src
 
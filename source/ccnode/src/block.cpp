@@ -27,69 +27,6 @@
 #define TEST_SKIP_SIGS		0	// don't skip
 #endif
 
-#define MAX_SCORE_BITS		64
-
-BlockAux* Block::AuxPtr()
-{
-	auto auxp = preamble.auxp[0];
-
-	CCASSERT(auxp);
-
-	return (BlockAux*)auxp;
-}
-
-BlockAux* Block::SetupAuxBuf(SmartBuf smartobj, bool from_tx_net)
-{
-	auto wire = WireData();
-
-	if (TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "Block::SetupAuxBuf from_tx_net " << from_tx_net << " level " << wire->level.GetValue() << " witness " << (unsigned)wire->witness << " prior oid " << buf2hex(&wire->prior_oid, CC_OID_TRACE_SIZE);
-
-	auto auxp = (BlockAux*)malloc(sizeof(BlockAux));
-	if (!auxp)
-	{
-		BOOST_LOG_TRIVIAL(error) << "Block::SetupAuxBuf malloc failed";
-
-		return NULL;
-	}
-
-	memset((void*)auxp, 0, sizeof(BlockAux));
-
-	preamble.auxp[0] = auxp;
-	smartobj.SetAuxPtrCount(2);
-
-	auxp->from_tx_net = from_tx_net;
-	auxp->announce_ticks = ccticks();
-
-	return auxp;
-}
-
-#if 0 // use inline version
-SmartBuf Block::GetPriorBlock() const
-{
-	if (TRACE_BLOCK) BOOST_LOG_TRIVIAL(debug) << "Block::GetPriorBlock blockp " << (uintptr_t)this << " prior " << (uintptr_t)preamble.auxp[1];
-
-	lock_guard<FastSpinLock> lock(prior_block_lock);
-
-	return SmartBuf(preamble.auxp[1]);
-}
-#endif
-
-FastSpinLock Block::prior_block_lock(__FILE__, __LINE__);
-
-void Block::SetPriorBlock(SmartBuf priorobj)
-{
-	if (TRACE_BLOCK) BOOST_LOG_TRIVIAL(debug) << "Block::SetPriorBlock blockp " << (uintptr_t)this << " was " << (uintptr_t)preamble.auxp[1] << " setting to " << (uintptr_t)priorobj.BasePtr();
-
-	auto curprior = preamble.auxp[1];
-	preamble.auxp[1] = priorobj.BasePtr();
-
-	priorobj.IncRef();
-
-	lock_guard<FastSpinLock> lock(prior_block_lock);
-
-	SmartBuf(curprior).DecRef(true);
-}
-
 void Block::ChainToPriorBlock(SmartBuf priorobj)
 {
 	auto wire = WireData();
@@ -182,11 +119,6 @@ void BlockAux::SetConfSigs()
 	}
 }
 
-unsigned Block::ComputeSkip(unsigned prev_witness, unsigned next_witness, unsigned nwitnesses)
-{
-	return (next_witness - ((prev_witness + 1) % nwitnesses) + nwitnesses) % nwitnesses;
-}
-
 bool Block::CheckBadSigOrder(int top_witness) const
 {
 	auto block = this;
@@ -269,176 +201,6 @@ bool Block::CheckBadSigOrder(int top_witness) const
 	return false;
 }
 
-// returns 0 if block does not chain back to last indelible block
-uint64_t Block::CalcSkipScore(int top_witness, SmartBuf last_indelible_block, uint16_t genstamp, bool maltest)
-{
-	CCASSERT(last_indelible_block);
-	auto block = (Block*)last_indelible_block.data();
-	auto last_indelible_wire = block->WireData();
-
-	auto wire = WireData();
-	auto auxp = AuxPtr();
-
-	if (maltest)
-	{
-		auto target_level = last_indelible_wire->level.GetValue();
-		auto offset = auxp->blockchain_params.nskipconfsigs;
-
-		if (target_level <= offset)
-			target_level = 0;
-		else
-			target_level -= offset;
-
-		if (wire->level.GetValue() <= target_level)
-		{
-			if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore top witness " << top_witness << " test mal " << maltest << " starting at level " << wire->level.GetValue() << " <= target level " << target_level << " returning score 0";
-
-			return 0;
-		}
-	}
-
-	if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore top witness " << top_witness << " genstamp " << genstamp << " test mal " << maltest << " starting at level " << wire->level.GetValue() << " nwitnesses " << auxp->blockchain_params.nwitnesses << " maxmal " << auxp->blockchain_params.maxmal << " nconfsigs " << auxp->blockchain_params.nconfsigs << " witness " << (unsigned)wire->witness << " skip " << auxp->skip << " oid " << buf2hex(&auxp->oid, CC_OID_TRACE_SIZE) << " last indelible level " << last_indelible_wire->level.GetValue();
-
-	uint64_t score = 0;
-	unsigned scorebits = 0;
-
-	CalcSkipScoreRecursive(last_indelible_wire, genstamp, maltest, score, scorebits);
-
-	if (score && top_witness >= 0)
-	{
-		if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore before top witness score " << hex << score << dec << " scorebits " << scorebits;
-
-		unsigned nwitnesses = auxp->blockchain_params.next_nwitnesses;
-		auto skip = ComputeSkip(wire->witness, top_witness, nwitnesses);
-
-		score <<= skip + 1;
-		score |= 1;
-		scorebits += skip + 1;
-
-		if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore added top witness " << top_witness << " skip " << skip << " score " << hex << score << dec << " scorebits " << scorebits;
-	}
-
-	if (scorebits > MAX_SCORE_BITS)
-	{
-		static unsigned highestscorebits = 0;
-
-		if (scorebits > highestscorebits)
-			highestscorebits = scorebits;
-
-		BOOST_LOG_TRIVIAL(error) << "Block::CalcSkipScore top witness " << top_witness << " test mal " << maltest << " score " << hex << score << dec << " scorebits " << scorebits << " exceeds max scorebits " << MAX_SCORE_BITS << "; highest scorebits seen " << highestscorebits;
-
-		if (maltest)
-			scorebits = MAX_SCORE_BITS;
-		else
-			score = 0;
-
-		//start_shutdown();	// for debugging
-	}
-
-	if (scorebits < MAX_SCORE_BITS)
-		score <<= MAX_SCORE_BITS - scorebits;
-
-	if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore score " << hex << score << dec << " test mal " << maltest << " starting at level " << wire->level.GetValue() << " nwitnesses " << auxp->blockchain_params.nwitnesses << " maxmal " << auxp->blockchain_params.maxmal << " nconfsigs " << auxp->blockchain_params.nconfsigs << " witness " << (unsigned)wire->witness << " skip " << auxp->skip << " oid " << buf2hex(&auxp->oid, CC_OID_TRACE_SIZE) << " last indelible level " << last_indelible_wire->level.GetValue();
-
-	return score;
-}
-
-void Block::CalcSkipScoreRecursive(const BlockWireHeader* last_indelible_wire, uint16_t genstamp, bool maltest, uint64_t& score, unsigned& scorebits)
-{
-	auto wire = WireData();
-	auto auxp = AuxPtr();
-
-	if (genstamp && genstamp == auxp->witness_params.score_genstamp)
-	{
-		score = auxp->witness_params.score;
-		scorebits = auxp->witness_params.score_bits;
-
-		return;
-	}
-
-	if (wire == last_indelible_wire && !maltest)
-	{
-		score = 1;
-		scorebits = 1;
-
-		if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore at last indelible block returning score " << hex << score << dec << " scorebits " << scorebits;
-
-		return;
-	}
-
-	if (wire->level.GetValue() <= last_indelible_wire->level.GetValue() && !maltest)
-	{
-		score = 0;
-		scorebits = 0;
-
-		if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore passed last indelible block returning score " << hex << score << dec << " scorebits " << scorebits;
-
-		return;
-	}
-
-	if (maltest)
-	{
-		auto target_level = last_indelible_wire->level.GetValue();
-		auto offset = auxp->blockchain_params.nskipconfsigs;
-
-		if (target_level <= offset)
-			target_level = 0;
-		else
-			target_level -= offset;
-
-		if (wire->level.GetValue() <= target_level)
-		{
-			score = 1;
-			scorebits = 1;
-
-			if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore test mal " << maltest << " reached level " << wire->level.GetValue() << " returning score " << hex << score << dec << " scorebits " << scorebits;
-
-			return;
-		}
-	}
-
-	auto prior_block = GetPriorBlock();
-
-	if (!prior_block)
-	{
-		if (!maltest)
-		{
-			score = 0;
-			scorebits = 0;
-		}
-		else
-		{
-			score = 1;
-			scorebits = 1;
-		}
-
-		if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore test mal " << maltest << " no prior block at level " << wire->level.GetValue() << " returning score " << hex << score << dec << " scorebits " << scorebits;
-
-		return;
-	}
-
-	auto smartobj = prior_block;
-	auto block = (Block*)smartobj.data();
-
-	block->CalcSkipScoreRecursive(last_indelible_wire, genstamp, maltest, score, scorebits);
-
-	if (!score)
-		return;
-
-	score <<= auxp->skip + 1;
-	score |= 1;
-	scorebits += auxp->skip + 1;
-
-	if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore level " << wire->level.GetValue() << " added skip " << auxp->skip << " score " << hex << score << dec << " scorebits " << scorebits;
-
-	if (genstamp)
-	{
-		auxp->witness_params.score = score;
-		auxp->witness_params.score_bits = scorebits;
-		auxp->witness_params.score_genstamp = genstamp;
-	}
-}
-
 void Block::SetOrVerifyOid(bool bset)
 {
 	block_hash_t hash;
@@ -149,6 +149,7 @@ public:
 	}
 
 	static FastSpinLock prior_block_lock;
+	static FastSpinLock score_lock;			// protects the scores cached in witness_params
 
 	SmartBuf GetPriorBlock() const
 	{
@@ -175,6 +176,8 @@ public:
 
 	bool CheckBadSigOrder(int top_witness) const;
 	uint64_t CalcSkipScore(int top_witness, SmartBuf last_indelible_block, uint16_t genstamp, bool maltest);
+	void CalcSkipScoreBase(SmartBuf last_indelible_block, uint16_t genstamp, bool maltest, uint64_t& score, unsigned& scorebits);
+	uint64_t FinishSkipScore(int top_witness, bool maltest, uint64_t score, unsigned scorebits) const;
 
 	bool SignOrVerify(bool verify);
 
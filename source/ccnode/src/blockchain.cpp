@@ -17,6 +17,7 @@
 #include "processblock.hpp"
 #include "processtx.hpp"
 #include "process-xreq.hpp"
+#include "transact.hpp"
 #include "dbparamkeys.h"
 
 #include <CCobjects.hpp>
@@ -987,6 +988,8 @@ bool BlockChain::DoConfirmationLoop(DbConn *dbconn, SmartBuf newobj, TxPay& txbu
 
 	bool have_new = false;
 
+	g_txwatch.DiscardPending();		// drop matches left by a prior pass that was not committed
+
 	while (true)
 	{
 		auto rc = DoConfirmOne(dbconn, newobj, txbuf);	// if true, check for another
@@ -1015,6 +1018,8 @@ bool BlockChain::DoConfirmationLoop(DbConn *dbconn, SmartBuf newobj, TxPay& txbu
 
 	SetLastIndelible(m_new_indelible_block);	// for consistency, call after EndWrite
 
+	g_txwatch.NotifyPending();		// after SetLastIndelible, so queries made in response will find the new outputs
+
 	m_new_indelible_block.ClearRef();
 
 	dbconn->ReleaseMutex();		// must release before starting the checkpoint
@@ -1489,8 +1494,12 @@ bool BlockChain::IndexTxOutputs(DbConn *dbconn, const uint64_t level, TxPay& tx,
 	domain = (domain << 1) | no_encypt;								// encode no_encypt with M_domain
 
 	if (!txout.no_address)
+	{
 		dbconn->TxOutputInsert(&txout.M_address, TX_ADDRESS_BYTES, domain, txout.M_asset_enc, txout.M_amount_enc, tx.param_level, commitnum);	// if this fails, we can still continue
 
+		g_txwatch.Match(&txout.M_address);
+	}
+
 	if (!Implement_CCMint(g_params.blockchain) || tx.tag_type != CC_TYPE_MINT)
 		return false;
 
@@ -1578,6 +1587,8 @@ bool BlockChain::CreateTxOutputs(DbConn *dbconn, uint64_t asset, bigint_t& total
 			if (TRACE_BLOCKCHAIN) BOOST_LOG_TRIVIAL(LOG_SYNC_DEBUG) << "BlockChain::CreateTxOutputs commitnum " << commitnum << " asset " << asset << " amount " << amount << " dest " << buf2hex(&dest, sizeof(dest)) << " domain " << domain << " bindex " << bindex << " no_encypt " << no_encypt << " blockchain " << g_params.blockchain << " paynum " << paynum << " address " << buf2hex(&addr, TX_ADDRESS_BYTES) << " commitment " << buf2hex(&commitment, TX_COMMITMENT_BYTES);
 
 			dbconn->TxOutputInsert(&addr, TX_ADDRESS_BYTES, (domain << 1) | no_encypt, asset, amount_fp, txbuf.param_level, commitnum);	// if this fails, we can still continue
+
+			g_txwatch.Match(&addr);
 		}
 
 		CCASSERT(total >= amount);
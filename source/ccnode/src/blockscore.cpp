@@ -0,0 +1,438 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * blockscore.cpp
+*/
+
+#include <CCdef.h>
+#include <CCboost.hpp>
+
+#include "blockscore.hpp"
+
+#include <CCticks.hpp>
+#include <CCthread.hpp>
+
+/*
+
+The parts of Block used to chain blocks together and compute their skip scores, and SkipScorePool, which scores a set of
+blocks using the calling thread plus a pool of threads.
+
+This file doesn't depend on the rest of ccnode, so that ccbench can drive the same code.
+
+The score of each block in a chain is cached in its aux data with the caller's genstamp, so scoring a set of blocks costs
+one step per block once the blocks below it have been scored.  SkipScorePool scores the blocks in order of level, so the
+prior of a block has usually been scored, and cached, by the time the block is taken by a thread.  The cached score is
+read and written under score_lock, since more than one thread can reach the same prior block.
+
+A round works the same way as in BlockTxCheckPool: it is started by incrementing m_seqnum, every pool thread takes part
+and decrements m_pending when it is done, and Run doesn't return until m_pending is zero.
+
+*/
+
+#define TRACE_BLOCK			0
+#define TRACE_CALCSKIPSCORE 0
+
+#define MAX_SCORE_BITS		64
+
+BlockAux* Block::AuxPtr()
+{
+	auto auxp = preamble.auxp[0];
+
+	CCASSERT(auxp);
+
+	return (BlockAux*)auxp;
+}
+
+BlockAux* Block::SetupAuxBuf(SmartBuf smartobj, bool from_tx_net)
+{
+	auto wire = WireData();
+
+	if (TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "Block::SetupAuxBuf from_tx_net " << from_tx_net << " level " << wire->level.GetValue() << " witness " << (unsigned)wire->witness << " prior oid " << buf2hex(&wire->prior_oid, CC_OID_TRACE_SIZE);
+
+	auto auxp = (BlockAux*)malloc(sizeof(BlockAux));
+	if (!auxp)
+	{
+		BOOST_LOG_TRIVIAL(error) << "Block::SetupAuxBuf malloc failed";
+
+		return NULL;
+	}
+
+	memset((void*)auxp, 0, sizeof(BlockAux));
+
+	preamble.auxp[0] = auxp;
+	smartobj.SetAuxPtrCount(2);
+
+	auxp->from_tx_net = from_tx_net;
+	auxp->announce_ticks = ccticks();
+
+	return auxp;
+}
+
+#if 0 // use inline version
+SmartBuf Block::GetPriorBlock() const
+{
+	if (TRACE_BLOCK) BOOST_LOG_TRIVIAL(debug) << "Block::GetPriorBlock blockp " << (uintptr_t)this << " prior " << (uintptr_t)preamble.auxp[1];
+
+	lock_guard<FastSpinLock> lock(prior_block_lock);
+
+	return SmartBuf(preamble.auxp[1]);
+}
+#endif
+
+FastSpinLock Block::prior_block_lock(__FILE__, __LINE__);
+FastSpinLock Block::score_lock(__FILE__, __LINE__);
+
+void Block::SetPriorBlock(SmartBuf priorobj)
+{
+	if (TRACE_BLOCK) BOOST_LOG_TRIVIAL(debug) << "Block::SetPriorBlock blockp " << (uintptr_t)this << " was " << (uintptr_t)preamble.auxp[1] << " setting to " << (uintptr_t)priorobj.BasePtr();
+
+	auto curprior = preamble.auxp[1];
+	preamble.auxp[1] = priorobj.BasePtr();
+
+	priorobj.IncRef();
+
+	lock_guard<FastSpinLock> lock(prior_block_lock);
+
+	SmartBuf(curprior).DecRef(true);
+}
+
+unsigned Block::ComputeSkip(unsigned prev_witness, unsigned next_witness, unsigned nwitnesses)
+{
+	return (next_witness - ((prev_witness + 1) % nwitnesses) + nwitnesses) % nwitnesses;
+}
+
+// returns 0 if block does not chain back to last indelible block
+uint64_t Block::CalcSkipScore(int top_witness, SmartBuf last_indelible_block, uint16_t genstamp, bool maltest)
+{
+	uint64_t score;
+	unsigned scorebits;
+
+	CalcSkipScoreBase(last_indelible_block, genstamp, maltest, score, scorebits);
+
+	return FinishSkipScore(top_witness, maltest, score, scorebits);
+}
+
+// computes the score of the chain from this block back to the last indelible block, before the top witness is added
+// the score of each block in the chain is cached in its aux data with genstamp, so genstamp can be zero to bypass the cache
+void Block::CalcSkipScoreBase(SmartBuf last_indelible_block, uint16_t genstamp, bool maltest, uint64_t& score, unsigned& scorebits)
+{
+	CCASSERT(last_indelible_block);
+	auto block = (Block*)last_indelible_block.data();
+	auto last_indelible_wire = block->WireData();
+
+	auto wire = WireData();
+	auto auxp = AuxPtr();
+
+	if (maltest)
+	{
+		auto target_level = last_indelible_wire->level.GetValue();
+		auto offset = auxp->blockchain_params.nskipconfsigs;
+
+		if (target_level <= offset)
+			target_level = 0;
+		else
+			target_level -= offset;
+
+		if (wire->level.GetValue() <= target_level)
+		{
+			if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore test mal " << maltest << " starting at level " << wire->level.GetValue() << " <= target level " << target_level << " returning score 0";
+
+			score = 0;
+			scorebits = 0;
+
+			return;
+		}
+	}
+
+	if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore genstamp " << genstamp << " test mal " << maltest << " starting at level " << wire->level.GetValue() << " nwitnesses " << auxp->blockchain_params.nwitnesses << " maxmal " << auxp->blockchain_params.maxmal << " nconfsigs " << auxp->blockchain_params.nconfsigs << " witness " << (unsigned)wire->witness << " skip " << auxp->skip << " oid " << buf2hex(&auxp->oid, CC_OID_TRACE_SIZE) << " last indelible level " << last_indelible_wire->level.GetValue();
+
+	score = 0;
+	scorebits = 0;
+
+	CalcSkipScoreRecursive(last_indelible_wire, genstamp, maltest, score, scorebits);
+}
+
+// adds the top witness to a score returned by CalcSkipScoreBase, and shifts it so scores with different lengths can be compared
+uint64_t Block::FinishSkipScore(int top_witness, bool maltest, uint64_t score, unsigned scorebits) const
+{
+	auto wire = WireData();
+	auto auxp = AuxPtr();
+
+	if (score && top_witness >= 0)
+	{
+		if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore before top witness score " << hex << score << dec << " scorebits " << scorebits;
+
+		unsigned nwitnesses = auxp->blockchain_params.next_nwitnesses;
+		auto skip = ComputeSkip(wire->witness, top_witness, nwitnesses);
+
+		score <<= skip + 1;
+		score |= 1;
+		scorebits += skip + 1;
+
+		if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore added top witness " << top_witness << " skip " << skip << " score " << hex << score << dec << " scorebits " << scorebits;
+	}
+
+	if (scorebits > MAX_SCORE_BITS)
+	{
+		static unsigned highestscorebits = 0;
+
+		if (scorebits > highestscorebits)
+			highestscorebits = scorebits;
+
+		BOOST_LOG_TRIVIAL(error) << "Block::CalcSkipScore top witness " << top_witness << " test mal " << maltest << " score " << hex << score << dec << " scorebits " << scorebits << " exceeds max scorebits " << MAX_SCORE_BITS << "; highest scorebits seen " << highestscorebits;
+
+		if (maltest)
+			scorebits = MAX_SCORE_BITS;
+		else
+			score = 0;
+
+		//start_shutdown();	// for debugging
+	}
+
+	if (scorebits < MAX_SCORE_BITS)
+		score <<= MAX_SCORE_BITS - scorebits;
+
+	if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore score " << hex << score << dec << " test mal " << maltest << " starting at level " << wire->level.GetValue() << " nwitnesses " << auxp->blockchain_params.nwitnesses << " maxmal " << auxp->blockchain_params.maxmal << " nconfsigs " << auxp->blockchain_params.nconfsigs << " witness " << (unsigned)wire->witness << " skip " << auxp->skip << " oid " << buf2hex(&auxp->oid, CC_OID_TRACE_SIZE);
+
+	return score;
+}
+
+void Block::CalcSkipScoreRecursive(const BlockWireHeader* last_indelible_wire, uint16_t genstamp, bool maltest, uint64_t& score, unsigned& scorebits)
+{
+	auto wire = WireData();
+	auto auxp = AuxPtr();
+
+	if (genstamp)
+	{
+		lock_guard<FastSpinLock> lock(score_lock);
+
+		if (genstamp == auxp->witness_params.score_genstamp)
+		{
+			score = auxp->witness_params.score;
+			scorebits = auxp->witness_params.score_bits;
+
+			return;
+		}
+	}
+
+	if (wire == last_indelible_wire && !maltest)
+	{
+		score = 1;
+		scorebits = 1;
+
+		if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore at last indelible block returning score " << hex << score << dec << " scorebits " << scorebits;
+
+		return;
+	}
+
+	if (wire->level.GetValue() <= last_indelible_wire->level.GetValue() && !maltest)
+	{
+		score = 0;
+		scorebits = 0;
+
+		if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore passed last indelible block returning score " << hex << score << dec << " scorebits " << scorebits;
+
+		return;
+	}
+
+	if (maltest)
+	{
+		auto target_level = last_indelible_wire->level.GetValue();
+		auto offset = auxp->blockchain_params.nskipconfsigs;
+
+		if (target_level <= offset)
+			target_level = 0;
+		else
+			target_level -= offset;
+
+		if (wire->level.GetValue() <= target_level)
+		{
+			score = 1;
+			scorebits = 1;
+
+			if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore test mal " << maltest << " reached level " << wire->level.GetValue() << " returning score " << hex << score << dec << " scorebits " << scorebits;
+
+			return;
+		}
+	}
+
+	auto prior_block = GetPriorBlock();
+
+	if (!prior_block)
+	{
+		if (!maltest)
+		{
+			score = 0;
+			scorebits = 0;
+		}
+		else
+		{
+			score = 1;
+			scorebits = 1;
+		}
+
+		if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore test mal " << maltest << " no prior block at level " << wire->level.GetValue() << " returning score " << hex << score << dec << " scorebits " << scorebits;
+
+		return;
+	}
+
+	auto smartobj = prior_block;
+	auto block = (Block*)smartobj.data();
+
+	block->CalcSkipScoreRecursive(last_indelible_wire, genstamp, maltest, score, scorebits);
+
+	if (!score)
+		return;
+
+	score <<= auxp->skip + 1;
+	score |= 1;
+	scorebits += auxp->skip + 1;
+
+	if (TRACE_CALCSKIPSCORE) BOOST_LOG_TRIVIAL(trace) << "Block::CalcSkipScore level " << wire->level.GetValue() << " added skip " << auxp->skip << " score " << hex << score << dec << " scorebits " << scorebits;
+
+	if (genstamp)
+	{
+		lock_guard<FastSpinLock> lock(score_lock);
+
+		auxp->witness_params.score = score;
+		auxp->witness_params.score_bits = scorebits;
+		auxp->witness_params.score_genstamp = genstamp;
+	}
+}
+
+void SkipScorePool::Init(unsigned nthreads, const char *role)
+{
+	// the calling thread also scores blocks, so one less pool thread is needed
+
+	for (unsigned i = 1; i < nthreads && !g_shutdown; ++i)
+	{
+		auto t = new thread(&SkipScorePool::ThreadProc, this, role);
+		m_threads.push_back(t);
+	}
+}
+
+void SkipScorePool::Stop()
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	m_start_condition_variable.notify_all();
+}
+
+void SkipScorePool::DeInit()
+{
+	Stop();
+
+	for (auto t : m_threads)
+	{
+		t->join();
+		delete t;
+	}
+
+	m_threads.clear();
+}
+
+void SkipScorePool::ThreadProc(const char *role)
+{
+	if (role)
+		CCThreadRoles::Apply(role);
+
+	uint64_t seqnum = 0;
+
+	unique_lock<mutex> lock(m_mutex);
+
+	while (true)
+	{
+		while (seqnum == m_seqnum && !g_shutdown)
+			m_start_condition_variable.wait(lock);
+
+		if (seqnum == m_seqnum)
+			break;					// shutdown with no round pending
+
+		seqnum = m_seqnum;
+
+		lock.unlock();
+
+		ScoreRange();
+
+		lock.lock();
+
+		CCASSERT(m_pending);
+
+		if (!--m_pending)
+			m_done_condition_variable.notify_all();
+	}
+}
+
+void SkipScorePool::ScoreRange()
+{
+	auto nblocks = m_order.size();
+
+	while (!g_shutdown)
+	{
+		auto index = m_next_index.fetch_add(1);
+
+		if (index >= nblocks)
+			break;
+
+		auto& work = (*m_work)[m_order[index].second];
+		auto block = (Block*)work.smartobj.data();
+
+		block->CalcSkipScoreBase(m_last_indelible_block, m_genstamp, false, work.score, work.scorebits);
+	}
+}
+
+// scores the blocks in work with Block::CalcSkipScoreBase; the calling thread takes part
+// the pool threads are only woken when there are at least parallel_min blocks, since below that, waking them costs more
+// than it saves
+// returns true if the pool threads took part
+
+bool SkipScorePool::Run(vector<SkipScoreWork>& work, SmartBuf last_indelible_block, uint16_t genstamp, unsigned parallel_min)
+{
+	unique_lock<mutex> lock(m_mutex);
+
+	CCASSERTZ(m_pending);
+
+	m_work = &work;
+	m_last_indelible_block = last_indelible_block;
+	m_genstamp = genstamp;
+
+	m_order.resize(work.size());
+
+	for (unsigned i = 0; i < work.size(); ++i)
+	{
+		auto block = (Block*)work[i].smartobj.data();
+
+		m_order[i] = make_pair(block->WireData()->level.GetValue(), i);
+	}
+
+	sort(m_order.begin(), m_order.end());
+
+	m_next_index = 0;
+
+	bool parallel = (work.size() >= parallel_min && work.size() > 1 && m_threads.size() && !g_shutdown);
+
+	if (parallel)
+	{
+		m_pending = m_threads.size();
+
+		++m_seqnum;
+
+		m_start_condition_variable.notify_all();
+	}
+
+	lock.unlock();
+
+	ScoreRange();
+
+	lock.lock();
+
+	while (m_pending)
+		m_done_condition_variable.wait(lock);
+
+	m_work = NULL;
+	m_last_indelible_block = SmartBuf();
+
+	return parallel;
+}
@@ -0,0 +1,68 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * blockscore.hpp
+*/
+
+#pragma once
+
+#include "block.hpp"
+
+//#define SKIP_SCORE_PARALLEL_MIN	2	// for testing
+
+#ifndef SKIP_SCORE_PARALLEL_MIN
+#define SKIP_SCORE_PARALLEL_MIN		1000	// the witness's pool threads score new blocks when there are at least this many; see the ccbench forks benchmark
+#endif
+
+struct SkipScoreWork
+{
+	SmartBuf smartobj;
+	uint64_t score;				// set by SkipScorePool::Run to the score returned by Block::CalcSkipScoreBase
+	unsigned scorebits;
+};
+
+class SkipScorePool
+{
+	vector<thread*> m_threads;
+	vector<SkipScoreWork> *m_work;				// protected by m_mutex when m_pending == 0
+	vector<pair<uint64_t, unsigned>> m_order;	// level and index of each block in m_work, in the order they are scored
+	SmartBuf m_last_indelible_block;
+	uint16_t m_genstamp;
+
+	mutex m_mutex;
+	condition_variable m_start_condition_variable;
+	condition_variable m_done_condition_variable;
+	uint64_t m_seqnum;
+	unsigned m_pending;							// number of pool threads that have not yet finished the current round
+	atomic<unsigned> m_next_index;
+
+	void ScoreRange();
+	void ThreadProc(const char *role);
+
+public:
+
+	SkipScorePool()
+	 :	m_work(NULL),
+		m_genstamp(0),
+		m_seqnum(0),
+		m_pending(0)
+	{ }
+
+	~SkipScorePool()
+	{
+		DeInit();
+	}
+
+	void Init(unsigned nthreads, const char *role);
+	void Stop();
+	void DeInit();
+
+	unsigned NThreads() const
+	{
+		return m_threads.size() + 1;
+	}
+
+	bool Run(vector<SkipScoreWork>& work, SmartBuf last_indelible_block, uint16_t genstamp, unsigned parallel_min);
+};
@@ -33,6 +33,10 @@
 
 #define BLOCKSERVE_MSG_SIZE		(CC_MSG_HEADER_SIZE + 8 + 2)	// incoming size: level + nblocks
 
+#define BLOCKSERVE_WINDOW_SNDBUFS		4				// each prefetched batch holds about this many socket send buffers of blocks
+#define BLOCKSERVE_MIN_WINDOW_BYTES		(64*1024)
+#define BLOCKSERVE_MAX_WINDOW_BYTES		(4*1024*1024)
+
 #pragma pack(push, 1)
 
 static const uint32_t Ack_Reply[2] =					{CC_MSG_HEADER_SIZE, CC_ACK};
@@ -50,6 +54,29 @@ void BlockServeConnection::StartConnection()
 
 	m_nreqlevels.store(0);
 
+	m_next_batch.clear();
+	m_next_batch_bytes = 0;
+	m_next_batch_status = 0;
+	m_prefetching = false;
+	m_write_pending = false;
+
+	// size the prefetch window to the socket send buffer, so the next batch is ready by the time the kernel has drained the current one
+
+	boost::asio::socket_base::send_buffer_size sndbuf;
+	boost::system::error_code e;
+
+	{
+		lock_guard<mutex> lock(m_conn_lock);
+
+		m_socket.get_option(sndbuf, e);
+	}
+
+	uint64_t window = (e ? 0 : (uint64_t)max(sndbuf.value(), 0)) * BLOCKSERVE_WINDOW_SNDBUFS;
+
+	m_window_bytes = min(max(window, (uint64_t)BLOCKSERVE_MIN_WINDOW_BYTES), (uint64_t)BLOCKSERVE_MAX_WINDOW_BYTES);
+
+	if (TRACE_BLOCKSERVE) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " BlockServeConnection::StartConnection send buffer size " << sndbuf.value() << " window bytes " << m_window_bytes;
+
 	if (SetTimer(BLOCKSERVE_TIMEOUT))
 		return;
 
@@ -134,87 +161,165 @@ void BlockServeConnection::HandleReadComplete()
 	m_reqlevel.store(reqlevel);
 	m_nreqlevels.store(reqlevels);
 
-	DoSend();
-}
+	PrefetchBatch();
 
-void BlockServeConnection::DoSend()
-{
-	if (TRACE_BLOCKSERVE) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " BlockServeConnection::DoSend m_reqlevel " << m_reqlevel.load() << " m_nreqlevels " << m_nreqlevels.load();
+	SendBatches();
+}
 
-	if (!m_nreqlevels.fetch_sub(1))
-	{
-		// done sending, so queue another read
+// reads the next batch of requested levels into m_next_batch using a single range scan
+// sets m_next_batch_status to 0 if ok or all levels have been sent, 1 if the next level is not yet indelible, or -1 on error
 
-		m_nreqlevels.store(0);
+void BlockServeConnection::PrefetchBatch()
+{
+	m_next_batch.clear();
+	m_next_batch_bytes = 0;
+	m_next_batch_status = 0;
 
-		if (SetTimer(BLOCKSERVE_TIMEOUT))
-			return;
+	auto nlevels = m_nreqlevels.load();
+	if (!nlevels)
+		return;
 
-		return StartRead();
-	}
+	uint64_t level = m_reqlevel.load();
 
-	uint64_t level = m_reqlevel.fetch_add(1);
-	uint64_t last_indelible_level;
+	if (TRACE_BLOCKSERVE) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " BlockServeConnection::PrefetchBatch level " << level << " nlevels " << nlevels << " window bytes " << m_window_bytes;
 
-	auto rc = blockserve_dbconn->BlockchainSelectMax(last_indelible_level);
+	auto rc = blockserve_dbconn->BlockchainSelectRange(level, nlevels, m_window_bytes, m_next_batch, &m_next_batch_bytes);
 	if (rc)
 	{
-		BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " BlockServeConnection::DoSend error BlockchainSelectMax failed";
+		BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " BlockServeConnection::PrefetchBatch error BlockchainSelectRange failed level " << level;
 
-		return Stop();
+		m_next_batch.clear();
+		m_next_batch_status = -1;
+
+		return;
 	}
 
-	if (level > last_indelible_level)
+	if (m_next_batch.empty())
 	{
-		if (TRACE_BLOCKSERVE) BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " BlockServeConnection::DoSend level " << level << " > last_indelible_level " << last_indelible_level;
+		uint64_t last_indelible_level;
 
-		m_read_after_write = false;
+		rc = blockserve_dbconn->BlockchainSelectMax(last_indelible_level);
+		if (rc)
+		{
+			BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " BlockServeConnection::PrefetchBatch error BlockchainSelectMax failed";
 
-		WriteAsync("BlockServeConnection::DoSend", boost::asio::buffer(No_Level_Reply, sizeof(No_Level_Reply)),
-				boost::bind(&Connection::HandleWrite, this, boost::asio::placeholders::error, AutoCount(this)));
+			m_next_batch_status = -1;
+
+			return;
+		}
+
+		if (level > last_indelible_level)
+		{
+			if (TRACE_BLOCKSERVE) BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " BlockServeConnection::PrefetchBatch level " << level << " > last_indelible_level " << last_indelible_level;
+
+			m_next_batch_status = 1;
+
+			return;
+		}
+
+		BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " BlockServeConnection::PrefetchBatch BlockchainSelectRange found no block at level " << level << " last_indelible_level " << last_indelible_level;
+
+		m_next_batch_status = -1;
 
 		return;
 	}
 
-	SmartBuf smartobj;
+	m_reqlevel.fetch_add(m_next_batch.size());
+	m_nreqlevels.fetch_sub(m_next_batch.size());
+}
+
+// writes the prefetched batch in one vectored write, then prefetches the following batch while the write is in progress
 
-	blockserve_dbconn->BlockchainSelect(level, &smartobj);
-	if (!smartobj)
+void BlockServeConnection::SendBatches()
+{
+	while (true)
 	{
-		BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " BlockServeConnection::DoSend BlockchainSelect failed level " << level;
+		vector<SmartBuf> batch;
+		batch.swap(m_next_batch);
 
-		return Stop();
-	}
+		if (TRACE_BLOCKSERVE) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " BlockServeConnection::SendBatches nblocks " << batch.size() << " bytes " << m_next_batch_bytes << " status " << m_next_batch_status << " m_reqlevel " << m_reqlevel.load() << " m_nreqlevels " << m_nreqlevels.load();
 
-	auto obj = (CCObject*)smartobj.data();
-	CCASSERT(obj);
+		if (m_next_batch_status < 0)
+			return Stop();
 
-	auto size = obj->ObjSize();
+		if (batch.empty())
+		{
+			if (m_next_batch_status > 0)
+			{
+				m_read_after_write = false;
 
-	//size = 20;	// for testing
+				WriteAsync("BlockServeConnection::SendBatches", boost::asio::buffer(No_Level_Reply, sizeof(No_Level_Reply)),
+						boost::bind(&Connection::HandleWrite, this, boost::asio::placeholders::error, AutoCount(this)));
 
-	if (size < CC_MSG_HEADER_SIZE || size > CC_BLOCK_MAX_SIZE)
-	{
-		BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " BlockServeConnection::DoSend object invalid size " << size;
+				return;
+			}
 
-		return Stop();
-	}
+			// done sending, so queue another read
 
-	if (TRACE_BLOCKSERVE) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " BlockServeConnection::DoSend level " << level << " size " << obj->ObjSize() << " tag " << hex << obj->ObjTag() << dec;
+			m_nreqlevels.store(0);
 
-	if (SetTimer(BLOCKSERVE_TIMEOUT + size / BLOCKSERVE_BYTES_PER_SEC))
-		return;
+			if (SetTimer(BLOCKSERVE_TIMEOUT))
+				return;
+
+			return StartRead();
+		}
+
+		auto buffers = make_shared<CCServer::WriteBuffers>();
+
+		for (auto& smartobj : batch)
+		{
+			auto obj = (CCObject*)smartobj.data();
+			CCASSERT(obj);
+
+			auto size = obj->ObjSize();
+
+			//size = 20;	// for testing
+
+			if (size < CC_MSG_HEADER_SIZE || size > CC_BLOCK_MAX_SIZE)
+			{
+				BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " BlockServeConnection::SendBatches object invalid size " << size;
+
+				return Stop();
+			}
+
+			if (TRACE_BLOCKSERVE) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " BlockServeConnection::SendBatches size " << obj->ObjSize() << " tag " << hex << obj->ObjTag() << dec;
+
+			buffers->Add(smartobj, (const char*)obj->ObjPtr() - (const char*)smartobj.data(), size);
+		}
+
+		if (SetTimer(BLOCKSERVE_TIMEOUT + m_next_batch_bytes / BLOCKSERVE_BYTES_PER_SEC))
+			return;
 
-	m_read_after_write = false;
+		m_read_after_write = false;
+
+		{
+			lock_guard<FastSpinLock> lock(m_send_lock);
+
+			m_prefetching = true;
+			m_write_pending = true;
+		}
+
+		if (WriteAsync("BlockServeConnection::SendBatches", buffers,
+				boost::bind(&BlockServeConnection::HandleBatchWrite, this, boost::asio::placeholders::error, AutoCount(this))))
+			return;
+
+		batch.clear();	// the write holds its own references to the blocks
+
+		PrefetchBatch();
+
+		{
+			lock_guard<FastSpinLock> lock(m_send_lock);
+
+			m_prefetching = false;
 
-	WriteAsync("BlockServeConnection::DoSend", boost::asio::buffer(obj->ObjPtr(), size),
-			boost::bind(&BlockServeConnection::HandleBlockWrite, this, boost::asio::placeholders::error, smartobj, AutoCount(this)));
+			if (m_write_pending)
+				return;		// HandleBatchWrite will send the batch we just prefetched
+		}
+	}
 }
 
-void BlockServeConnection::HandleBlockWrite(const boost::system::error_code& e, SmartBuf smartobj, AutoCount pending_op_counter)
+void BlockServeConnection::HandleBatchWrite(const boost::system::error_code& e, AutoCount pending_op_counter)
 {
-	smartobj.ClearRef();	// we're done with this, so might as well free it now
-
 	if (CancelTimer())
 		return;
 
@@ -225,9 +330,18 @@ void BlockServeConnection::HandleBlockWrite(const boost::system::error_code& e,
 
 	m_write_in_progress.clear();
 
-	if (TRACE_BLOCKSERVE) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " BlockServeConnection::HandleBlockWrite ok";
+	if (TRACE_BLOCKSERVE) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " BlockServeConnection::HandleBatchWrite ok";
+
+	{
+		lock_guard<FastSpinLock> lock(m_send_lock);
+
+		m_write_pending = false;
+
+		if (m_prefetching)
+			return;		// SendBatches will send the next batch when its prefetch is done
+	}
 
-	DoSend();
+	SendBatches();
 }
 
 void BlockService::Start()
@@ -241,14 +355,14 @@ void BlockService::Start()
 
 	// unsigned conn_nreadbuf, unsigned conn_nwritebuf, unsigned sock_nreadbuf, unsigned sock_nwritebuf, unsigned headersize, bool noclose, bool bregister
 	CCServer::ConnectionFactoryInstantiation<BlockServeConnection> connfac(BLOCKSERVE_MSG_SIZE + 2, 0, -1, -1, CC_MSG_HEADER_SIZE, 0, 0);
-	CCThreadFactoryInstantiation<BlockServeThread> threadfac;
+	CCThreadFactoryInstantiation<BlockServeThread> threadfac("blockserve");
 
 	unsigned maxconns = (unsigned)(max_inconns + max_outconns);
 	unsigned nthreads = maxconns * threads_per_conn;
 
 	// unsigned nthreads, unsigned maxconns, unsigned maxincoming, unsigned backlog
 	m_service.Start(boost::asio::ip::tcp::endpoint(address, port),
-			nthreads, maxconns, max_inconns, 0, connfac, threadfac);
+			nthreads, maxconns, max_inconns, 0, connfac, threadfac, nreactors);
 
 	// ConnMonitorProc reregisters with rendezvous servers every BLOCKSERVE_DIR_REFRESH seconds
 
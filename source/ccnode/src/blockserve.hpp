@@ -19,20 +19,39 @@ public:
 	BlockServeConnection(class CCServer::ConnectionManagerBase& manager, boost::asio::io_service& io_service, const class CCServer::ConnectionFactoryBase& connfac)
 	 :	CCServer::Connection(manager, io_service, connfac),
 		m_reqlevel(0),
-		m_nreqlevels(0)
+		m_nreqlevels(0),
+		m_window_bytes(0),
+		m_send_lock(__FILE__, __LINE__),
+		m_next_batch_bytes(0),
+		m_next_batch_status(0),
+		m_prefetching(false),
+		m_write_pending(false)
 	{ }
 
 private:
 
-	atomic<uint64_t> m_reqlevel;
-	atomic<uint16_t> m_nreqlevels;
+	atomic<uint64_t> m_reqlevel;		// next level to prefetch
+	atomic<uint16_t> m_nreqlevels;		// number of requested levels not yet prefetched
+
+	unsigned m_window_bytes;			// approximate size of each prefetched batch of blocks
+
+	// the next batch is prefetched while the current batch is being written;
+	// whichever of the prefetch or the write finishes last sends the next batch
+
+	FastSpinLock m_send_lock;
+	vector<SmartBuf> m_next_batch;
+	unsigned m_next_batch_bytes;
+	int m_next_batch_status;
+	bool m_prefetching;
+	bool m_write_pending;
 
 	void StartConnection();
 
 	void HandleReadComplete();
 
-	void DoSend();
-	void HandleBlockWrite(const boost::system::error_code& e, SmartBuf smartobj, AutoCount pending_op_counter);
+	void PrefetchBatch();
+	void SendBatches();
+	void HandleBatchWrite(const boost::system::error_code& e, AutoCount pending_op_counter);
 };
 
 
@@ -61,6 +80,13 @@ public:
 
 	void Start();
 
+	// logs the connection counts of each reactor, if there is more than one
+	void LogStats()
+	{
+		if (m_service.GetNServers() > 1)
+			m_service.LogStats();
+	}
+
 	void StartShutdown();
 	void WaitForShutdown();
 };
@@ -19,6 +19,7 @@
 #include <CCobjects.hpp>
 
 #include <transaction.h>
+#include <socks.hpp>
 #include <ccserver/server.hpp>
 #include <ccserver/connection_manager.hpp>
 
@@ -35,7 +36,17 @@
 
 #define BLOCKSYNC_LOST_SECS						420
 
-#define BLOCKSYNC_NLEVELS_PER_REQ				100
+#define BLOCKSYNC_NLEVELS_PER_REQ				100		// maximum levels per request
+#define BLOCKSYNC_MIN_NLEVELS_PER_REQ			5
+#define BLOCKSYNC_INITIAL_NLEVELS_PER_REQ		20		// used until the connection's receive rate has been measured
+#define BLOCKSYNC_TARGET_REQ_SECS				20		// requests are sized to take about this long to receive
+
+#define BLOCKSYNC_RATE_SMOOTHING				0.2		// weight of the newest sample in the moving averages
+
+#define BLOCKSYNC_HEDGE_SECS					10		// the earliest entry is hedged if it has made no progress in this time
+#define BLOCKSYNC_HEDGE_SPEEDUP					2		// and the requesting connection is at least this much faster
+
+#define BLOCKSYNC_PEER_RATES_LOG_SECS			60
 
 #define BLOCKSYNC_MAX_BLOCK_PROCESSING_TIME		30
 
@@ -53,6 +64,13 @@ void BlockSyncConnection::StartConnection()
 
 	m_conn_state = CONN_CONNECTED;
 
+	if (m_outgoing_host.length())
+	{
+		g_hostdir.ReportConnect(HostDir::Blockserve, m_outgoing_host, true, m_tor_pooled ? -1 : ccticks_elapsed(m_tor_connect_ticks, ccticks()));
+
+		m_outgoing_host.clear();
+	}
+
 	m_cur_req_msg.entry.nlevels = 0;
 	m_next_req_msg.entry.nlevels = 0;
 
@@ -61,6 +79,16 @@ void BlockSyncConnection::StartConnection()
 	m_has_requeues = false;
 	m_finished = false;
 
+	m_sync_start_ticks = ccticks();
+	m_last_block_ticks = 0;
+	m_req_sent_ticks = 0;
+	m_req_rtt_pending = false;
+	m_sync_blocks = 0;
+	m_sync_bytes = 0;
+	m_avg_block_secs = 0;
+	m_avg_block_bytes = 0;
+	m_avg_rtt_secs = 0;
+
 	// start with a ping to make sure the connection is working
 
 	if (SetTimer(BLOCKSYNC_REQ_TIMEOUT))
@@ -111,7 +139,7 @@ void BlockSyncConnection::CheckSendReq(unique_lock<mutex> &lock)
 
 		// get next level to request, ensuring it's above the last_indelible_level and not past the maximum request span
 
-		next = g_blocksync_client.m_sync_list.GetNextEntry(Name(), m_conn_index);
+		next = g_blocksync_client.m_sync_list.GetNextEntry(Name(), m_conn_index, RequestLevels(), BlocksPerSec());
 
 		if (next.nlevels)
 			break;
@@ -160,6 +188,16 @@ void BlockSyncConnection::CheckSendReq(unique_lock<mutex> &lock)
 
 	m_next_req_msg.entry = next;
 
+	if (!m_cur_req_msg.entry.nlevels)
+	{
+		// nothing else is outstanding, so the time until the first block arrives measures the round trip
+
+		m_req_sent_ticks = ccticks();
+		m_req_rtt_pending = true;
+	}
+	else
+		m_req_rtt_pending = false;
+
 	lock.unlock();
 
 	if (SetTimer(BLOCKSYNC_REQ_TIMEOUT))
@@ -167,7 +205,7 @@ void BlockSyncConnection::CheckSendReq(unique_lock<mutex> &lock)
 
 	if (TRACE_BLOCKSYNC) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " BlockSyncConnection::CheckSendReq SetTimer " << BLOCKSYNC_REQ_TIMEOUT;
 
-	if (TRACE_BLOCKSYNC) BOOST_LOG_TRIVIAL(debug) << Name() << " Conn " << m_conn_index << " BlockSyncConnection::CheckSendReq requesting level " << m_next_req_msg.entry.level << " nlevels " << m_next_req_msg.entry.nlevels;
+	if (TRACE_BLOCKSYNC) BOOST_LOG_TRIVIAL(debug) << Name() << " Conn " << m_conn_index << " BlockSyncConnection::CheckSendReq requesting level " << m_next_req_msg.entry.level << " nlevels " << m_next_req_msg.entry.nlevels << " blocks/sec " << BlocksPerSec() << " rtt " << m_avg_rtt_secs;
 
 	WriteAsync("BlockSyncConnection::CheckSendReq", boost::asio::buffer(&m_next_req_msg, sizeof(m_next_req_msg)),
 			boost::bind(&Connection::HandleWrite, this, boost::asio::placeholders::error, AutoCount(this)));
@@ -244,7 +282,7 @@ void BlockSyncConnection::HandleReadComplete()
 
 	CCASSERT(CC_MSG_HEADER_SIZE == sizeof(CCObject::Header));
 
-	smartobj = SmartBuf(size + sizeof(CCObject::Preamble));
+	smartobj = SmartBuf(size + sizeof(CCObject::Preamble), false);	// filled by the read
 	if (!smartobj)
 	{
 		BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " BlockSyncConnection::HandleReadComplete error smartobj failed";
@@ -418,6 +456,10 @@ void BlockSyncConnection::HandleObjReadComplete(const boost::system::error_code&
 
 	unique_lock<mutex> lock(req_lock);
 
+	UpdateRates(msgsize);
+
+	g_blocksync_client.m_sync_list.EntryProgress(m_conn_index, level, BlocksPerSec());
+
 	++m_cur_req_msg.entry.level;
 	--m_cur_req_msg.entry.nlevels;
 
@@ -432,6 +474,69 @@ void BlockSyncConnection::HandleObjReadComplete(const boost::system::error_code&
 	CheckSendReq(lock);
 }
 
+void BlockSyncConnection::UpdateRates(unsigned nbytes)
+{
+	auto now = ccticks();
+
+	if (m_req_rtt_pending)
+	{
+		double rtt = (double)ccticks_elapsed(m_req_sent_ticks, now) / CCTICKS_PER_SEC;
+
+		m_avg_rtt_secs = (m_avg_rtt_secs ? (1 - BLOCKSYNC_RATE_SMOOTHING) * m_avg_rtt_secs + BLOCKSYNC_RATE_SMOOTHING * rtt : rtt);
+
+		m_req_rtt_pending = false;
+	}
+	else if (m_last_block_ticks)
+	{
+		// blocks received back-to-back on a pipelined request measure the transfer rate
+
+		double secs = (double)max(ccticks_elapsed(m_last_block_ticks, now), 1) / CCTICKS_PER_SEC;
+
+		if (m_avg_block_secs)
+		{
+			m_avg_block_secs = (1 - BLOCKSYNC_RATE_SMOOTHING) * m_avg_block_secs + BLOCKSYNC_RATE_SMOOTHING * secs;
+			m_avg_block_bytes = (1 - BLOCKSYNC_RATE_SMOOTHING) * m_avg_block_bytes + BLOCKSYNC_RATE_SMOOTHING * nbytes;
+		}
+		else
+		{
+			m_avg_block_secs = secs;
+			m_avg_block_bytes = nbytes;
+		}
+	}
+
+	m_last_block_ticks = now;
+
+	++m_sync_blocks;
+	m_sync_bytes += nbytes;
+}
+
+double BlockSyncConnection::BlocksPerSec() const
+{
+	if (!m_avg_block_secs)
+		return 0;
+
+	return 1 / m_avg_block_secs;
+}
+
+unsigned BlockSyncConnection::RequestLevels() const
+{
+	// size the request so it takes about BLOCKSYNC_TARGET_REQ_SECS to receive, plus enough to cover the round trip
+	// so the connection stays busy, while keeping slow connections from holding large ranges of levels
+
+	if (!m_avg_block_secs)
+		return BLOCKSYNC_INITIAL_NLEVELS_PER_REQ;
+
+	auto nlevels = (BLOCKSYNC_TARGET_REQ_SECS + m_avg_rtt_secs) / m_avg_block_secs;
+
+	if (nlevels < BLOCKSYNC_MIN_NLEVELS_PER_REQ)
+		return BLOCKSYNC_MIN_NLEVELS_PER_REQ;
+
+	if (nlevels > BLOCKSYNC_NLEVELS_PER_REQ)
+		return BLOCKSYNC_NLEVELS_PER_REQ;
+
+	return nlevels;
+}
+
 bool BlockSyncConnection::SetValidationTimer()
 {
 	auto sec = g_blocksync_client.ConnectedCount() * BLOCKSYNC_NLEVELS_PER_REQ * BLOCKSYNC_MAX_BLOCK_PROCESSING_TIME;
@@ -488,6 +593,13 @@ void BlockSyncConnection::FinishConnection()
 {
 	if (TRACE_BLOCKSYNC) BOOST_LOG_TRIVIAL(debug) << Name() << " Conn " << m_conn_index << " BlockSyncConnection::FinishConnection requeues " << m_has_requeues << " finished " << m_finished;
 
+	if (m_outgoing_host.length())
+	{
+		g_hostdir.ReportConnect(HostDir::Blockserve, m_outgoing_host, false);	// the connection failed before it started
+
+		m_outgoing_host.clear();
+	}
+
 	if (m_finished)
 	{
 		int64_t dt = unixtime() - g_blockchain.GetLastIndelibleTimestamp();
@@ -498,6 +610,14 @@ void BlockSyncConnection::FinishConnection()
 		if (TRACE_BLOCKSYNC) BOOST_LOG_TRIVIAL(debug) << Name() << " Conn " << m_conn_index << " BlockSyncConnection::FinishConnection LastIndelibleTimestamp dt " << dt << " block_future_tolerance " << g_params.block_future_tolerance << " ExpireAge " << g_expire.GetExpireAge(1)/CCTICKS_PER_SEC << " finished " << m_finished;
 	}
 
+	auto secs = (double)max(ccticks_elapsed(m_sync_start_ticks, ccticks()), 1) / CCTICKS_PER_SEC;
+
+	if (m_sync_blocks) BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " BlockSyncConnection::FinishConnection received " << m_sync_blocks << " blocks " << m_sync_bytes << " bytes in " << secs << " secs; average " << m_sync_blocks / secs << " blocks/sec " << m_sync_bytes / secs << " bytes/sec; recent " << BlocksPerSec() << " blocks/sec " << (m_avg_block_secs ? m_avg_block_bytes / m_avg_block_secs : 0) << " bytes/sec rtt " << m_avg_rtt_secs << " secs";
+
+	m_sync_blocks = 0;
+
+	g_blocksync_client.m_sync_list.ReleaseEntries(m_conn_index);
+
 	bool no_requeue = m_finished && g_blocksync_client.IsFinishing();
 
 	lock_guard<mutex> lock(req_lock);
@@ -531,7 +651,7 @@ void BlockSyncClient::Start()
 
 	// unsigned conn_nreadbuf, unsigned conn_nwritebuf, unsigned sock_nreadbuf, unsigned sock_nwritebuf, unsigned headersize, bool noclose, bool bregister
 	CCServer::ConnectionFactoryInstantiation<BlockSyncConnection> connfac(CC_MAX_MSG_SIZE + 2, 0, -1, -1, CC_MSG_HEADER_SIZE, 1, 1);
-	CCThreadFactoryInstantiation<BlockSyncThread> threadfac;
+	CCThreadFactoryInstantiation<BlockSyncThread> threadfac("blocksync");
 
 	unsigned maxconns = (unsigned)(max_inconns + max_outconns);
 	unsigned nthreads = maxconns * threads_per_conn;
@@ -579,17 +699,58 @@ void BlockSyncList::Init(int64_t level)
 	lock_guard<FastSpinLock> lock(m_block_sync_list_lock);
 
 	m_list.clear();
+	m_inflight.clear();
 	m_next_level = level;
 }
 
-BlockSyncEntry BlockSyncList::GetNextEntry(const string& name, int conn_index)
+// if the earliest level still being received is held by a connection that has stalled, and the requesting connection is
+// faster, hand it the same levels so the validation of the levels that follow isn't held up by the slow connection
+// called with m_block_sync_list_lock held
+
+BlockSyncEntry BlockSyncList::GetHedgeEntry(const string& name, int conn_index, unsigned max_nlevels, double blocks_per_sec)
 {
 	BlockSyncEntry entry;
 
+	if (blocks_per_sec <= 0 || !m_list.empty())
+		return entry;
+
+	InFlightEntry *earliest = NULL;
+
+	for (auto& inflight : m_inflight)
+	{
+		if (!earliest || inflight.entry.level < earliest->entry.level)
+			earliest = &inflight;
+	}
+
+	if (!earliest || earliest->conn_index == conn_index || earliest->hedged)
+		return entry;
+
+	if (ccticks_elapsed(earliest->last_progress_ticks, ccticks()) < BLOCKSYNC_HEDGE_SECS * CCTICKS_PER_SEC)
+		return entry;
+
+	if (blocks_per_sec < BLOCKSYNC_HEDGE_SPEEDUP * earliest->blocks_per_sec)
+		return entry;
+
+	earliest->hedged = true;
+
+	entry = BlockSyncEntry(earliest->entry.level, min((unsigned)earliest->entry.nlevels, max_nlevels));
+
+	BOOST_LOG_TRIVIAL(info) << name << " Conn " << conn_index << " BlockSyncList::GetHedgeEntry hedging level " << entry.level << " nlevels " << entry.nlevels << " held by Conn " << earliest->conn_index << " at " << earliest->blocks_per_sec << " blocks/sec; requester at " << blocks_per_sec << " blocks/sec";
+
+	return entry;
+}
+
+BlockSyncEntry BlockSyncList::GetNextEntry(const string& name, int conn_index, unsigned max_nlevels, double blocks_per_sec)
+{
+	CCASSERT(max_nlevels);
+
 	lock_guard<FastSpinLock> lock(m_block_sync_list_lock);
 
 	auto last_indelible_level = g_blockchain.GetLastIndelibleLevel();
 
+	auto entry = GetHedgeEntry(name, conn_index, max_nlevels, blocks_per_sec);
+	bool hedged = entry.nlevels;
+
 	while (!entry.nlevels && !g_shutdown)
 	{
 		if (!m_list.empty())
@@ -604,6 +765,15 @@ BlockSyncEntry BlockSyncList::GetNextEntry(const string& name, int conn_index)
 				++entry.level;
 				--entry.nlevels;
 			}
+
+			if (entry.nlevels > max_nlevels)
+			{
+				// the requeued entry is larger than this connection should take, so leave the rest for the next request
+
+				m_list.push_front(BlockSyncEntry(entry.level + max_nlevels, entry.nlevels - max_nlevels));
+
+				entry.nlevels = max_nlevels;
+			}
 		}
 		else
 		{
@@ -621,18 +791,96 @@ BlockSyncEntry BlockSyncList::GetNextEntry(const string& name, int conn_index)
 			if (m_next_level > max_level)
 				break;
 
-			auto nlevels = BLOCKSYNC_NLEVELS_PER_REQ - (m_next_level + BLOCKSYNC_NLEVELS_PER_REQ - 1) % BLOCKSYNC_NLEVELS_PER_REQ;
+			auto nlevels = max_nlevels;
 
 			entry = BlockSyncEntry(m_next_level, nlevels);
 			m_next_level += nlevels;
 		}
 	}
 
-	if (TRACE_BLOCKSYNC) BOOST_LOG_TRIVIAL(trace) << name << " Conn " << conn_index << " BlockSyncList::GetNextEntry last_indelible_level " << last_indelible_level << " returning level " << entry.level << " nlevels " << entry.nlevels;
+	if (entry.nlevels)
+		m_inflight.push_back(InFlightEntry{entry, conn_index, blocks_per_sec, ccticks(), hedged});
+
+	if (TRACE_BLOCKSYNC) BOOST_LOG_TRIVIAL(trace) << name << " Conn " << conn_index << " BlockSyncList::GetNextEntry last_indelible_level " << last_indelible_level << " max_nlevels " << max_nlevels << " returning level " << entry.level << " nlevels " << entry.nlevels << " hedged " << hedged;
 
 	return entry;
 }
 
+void BlockSyncList::EntryProgress(int conn_index, uint64_t level, double blocks_per_sec)
+{
+	lock_guard<FastSpinLock> lock(m_block_sync_list_lock);
+
+	auto now = ccticks();
+
+	for (unsigned i = 0; i < m_inflight.size(); )
+	{
+		auto& inflight = m_inflight[i];
+
+		if (inflight.conn_index != conn_index)
+		{
+			++i;
+			continue;
+		}
+
+		inflight.blocks_per_sec = blocks_per_sec;
+
+		if (level >= inflight.entry.level && level < inflight.entry.level + inflight.entry.nlevels)
+		{
+			inflight.entry.nlevels -= level + 1 - inflight.entry.level;
+			inflight.entry.level = level + 1;
+			inflight.last_progress_ticks = now;
+
+			if (!inflight.entry.nlevels)
+			{
+				m_inflight.erase(m_inflight.begin() + i);
+				continue;
+			}
+		}
+
+		++i;
+	}
+}
+
+void BlockSyncList::ReleaseEntries(int conn_index)
+{
+	lock_guard<FastSpinLock> lock(m_block_sync_list_lock);
+
+	for (unsigned i = 0; i < m_inflight.size(); )
+	{
+		if (m_inflight[i].conn_index == conn_index)
+			m_inflight.erase(m_inflight.begin() + i);
+		else
+			++i;
+	}
+}
+
+void BlockSyncList::LogPeerRates(const string& name)
+{
+	ostringstream rates;
+
+	{
+		lock_guard<FastSpinLock> lock(m_block_sync_list_lock);
+
+		for (unsigned i = 0; i < m_inflight.size(); ++i)
+		{
+			auto& inflight = m_inflight[i];
+
+			bool first = true;
+
+			for (unsigned j = 0; j < i; ++j)
+			{
+				if (m_inflight[j].conn_index == inflight.conn_index)
+					first = false;
+			}
+
+			if (first)
+				rates << " Conn " << inflight.conn_index << " " << inflight.blocks_per_sec << " blocks/sec level " << inflight.entry.level << (inflight.hedged ? " hedged" : "") << ";";
+		}
+	}
+
+	BOOST_LOG_TRIVIAL(info) << name << " BlockSyncList peer rates:" << rates.str();
+}
+
 void BlockSyncList::RequeueEntry(const string& name, int conn_index, const BlockSyncEntry& entry)
 {
 	if (!entry.nlevels)
@@ -706,6 +954,8 @@ void BlockSyncClient::DoSync()
 
 	unsigned si = 0;
 
+	auto last_rates_time = unixtime();
+
 	while (!g_shutdown)
 	{
 		auto outcount = m_service.GetServer(si).GetConnectionManager().GetOutgoingConnectionCount();
@@ -751,6 +1001,13 @@ void BlockSyncClient::DoSync()
 		if (done && !outcount)
 			break;
 
+		if (outcount && now - last_rates_time >= BLOCKSYNC_PEER_RATES_LOG_SECS)
+		{
+			m_sync_list.LogPeerRates(Name());
+
+			last_rates_time = now;
+		}
+
 		if (!done && uncount)
 			ConnectOutgoing();
 
@@ -766,9 +1023,19 @@ void BlockSyncClient::DoSync()
 
 void BlockSyncClient::ConnectOutgoing()
 {
-	BOOST_LOG_TRIVIAL(info) << Name() << " BlockSyncClient::ConnectOutgoing calling GetHostName()";
+	string peer, toruser;
 
-	auto peer = g_hostdir.GetHostName(HostDir::Blockserve);
+	if (m_next_peer.length())
+	{
+		peer.swap(m_next_peer);
+		toruser.swap(m_next_peer_toruser);
+	}
+	else
+	{
+		BOOST_LOG_TRIVIAL(info) << Name() << " BlockSyncClient::ConnectOutgoing calling GetHostName()";
+
+		peer = g_hostdir.GetHostName(HostDir::Blockserve);
+	}
 
 	if (!peer.size())
 	{
@@ -779,7 +1046,18 @@ void BlockSyncClient::ConnectOutgoing()
 
 	if (TRACE_BLOCKSYNC) BOOST_LOG_TRIVIAL(info) << Name() << " BlockSyncClient::ConnectOutgoing connecting to " << peer;
 
-	m_service.GetServer(0).Connect(peer, g_params.torproxy_port, true);
+	m_service.GetServer(0).Connect(peer, g_params.torproxy_port, true, toruser);
+
+	// pick the next server now so the Tor proxy pool can connect to it in the background
+
+	m_next_peer = g_hostdir.GetHostName(HostDir::Blockserve);
+
+	if (m_next_peer.length())
+	{
+		m_next_peer_toruser = Socks::IsolationUser();
+
+		g_sockspool.Warm(m_next_peer, m_next_peer_toruser);
+	}
 }
 
 void BlockSyncClient::StartShutdown()
@@ -57,11 +57,25 @@ public:
 
 class BlockSyncList
 {
+	// an entry that has been handed to a connection and not yet fully received
+
+	struct InFlightEntry
+	{
+		BlockSyncEntry entry;
+		int conn_index;
+		double blocks_per_sec;			// measured receive rate of the connection, or zero if not yet measured
+		uint32_t last_progress_ticks;
+		bool hedged;					// the entry has also been handed to a second connection
+	};
+
 	deque<BlockSyncEntry> m_list;
+	vector<InFlightEntry> m_inflight;
 	uint64_t m_next_level;
 
 	FastSpinLock m_block_sync_list_lock;
 
+	BlockSyncEntry GetHedgeEntry(const string& name, int conn_index, unsigned max_nlevels, double blocks_per_sec);
+
 public:
 	BlockSyncList()
 	 :	m_block_sync_list_lock(__FILE__, __LINE__)
@@ -71,8 +85,13 @@ public:
 
 	bool HasRequeues();
 
-	BlockSyncEntry GetNextEntry(const string& name, int conn_index);
+	BlockSyncEntry GetNextEntry(const string& name, int conn_index, unsigned max_nlevels, double blocks_per_sec);
 	void RequeueEntry(const string& name, int conn_index, const BlockSyncEntry& entry);
+
+	void EntryProgress(int conn_index, uint64_t level, double blocks_per_sec);
+	void ReleaseEntries(int conn_index);
+
+	void LogPeerRates(const string& name);
 };
 
 
@@ -80,7 +99,8 @@ class BlockSyncConnection : public CCServer::Connection
 {
 public:
 	BlockSyncConnection(class CCServer::ConnectionManagerBase& manager, boost::asio::io_service& io_service, const class CCServer::ConnectionFactoryBase& connfac)
-	 :	CCServer::Connection(manager, io_service, connfac)
+	 :	CCServer::Connection(manager, io_service, connfac),
+		m_sync_blocks(0)
 	{
 		m_read_after_write = true;
 	}
@@ -101,8 +121,24 @@ private:
 	bool m_has_requeues;
 	bool m_finished;
 
+	// receive rate measurements used to size the requests
+
+	uint32_t m_sync_start_ticks;
+	uint32_t m_last_block_ticks;
+	uint32_t m_req_sent_ticks;
+	bool m_req_rtt_pending;
+	uint64_t m_sync_blocks;
+	uint64_t m_sync_bytes;
+	double m_avg_block_secs;
+	double m_avg_block_bytes;
+	double m_avg_rtt_secs;
+
 	void StartConnection();
 
+	void UpdateRates(unsigned nbytes);
+	double BlocksPerSec() const;
+	unsigned RequestLevels() const;
+
 	void CheckSendReq(unique_lock<mutex> &lock);
 
 	void StartNextRead();
@@ -130,6 +166,9 @@ class BlockSyncClient : public TorService
 	void DoSync();
 	void ConnectOutgoing();
 
+	string m_next_peer;				// picked ahead of time so the Tor proxy connection to it can be set up in advance
+	string m_next_peer_toruser;
+
 public:
 	BlockSyncClient(const string& n, const wstring& d, const string& s)
 	 :	TorService(n, d, s, true),
@@ -0,0 +1,273 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * blocktxcheck.cpp
+*/
+
+#include <CCdef.h>
+#include <CCboost.hpp>
+
+#include "blocktxcheck.hpp"
+
+#include <CCobjects.hpp>
+#include <CCthread.hpp>
+#include <txview.hpp>
+
+/*
+
+The first phase of the block tx checks: the block is split into tx's, and each tx is checked independently of the other
+tx's in the block by the calling thread plus a pool of threads, each with its own BlockTxChecker.  Once a tx fails, the
+tx's after it are skipped, since only the first failure in block order is used.
+
+This file doesn't depend on the rest of ccnode, so that ccbench can drive the same code.
+
+A round is started by incrementing m_seqnum, and m_pending is set to the number of pool threads.  Every pool thread takes
+part in every round and decrements m_pending when it is done, and Run doesn't return until m_pending is zero, so no pool
+thread can still be reading m_checks when the next call to Split resizes it.  A pool thread only exits on shutdown
+between rounds, and Run doesn't start a round once shutdown has been set, so a round can't wait on a thread that has exited.
+
+*/
+
+void BlockTxCheckPool::Init(unsigned nthreads, BlockTxCheckerFactory factory, const char *role)
+{
+	// the calling thread also checks tx's, so one less pool thread is needed
+
+	for (unsigned i = 1; i < nthreads && !g_shutdown; ++i)
+	{
+		auto t = new thread(&BlockTxCheckPool::ThreadProc, this, factory, role);
+		m_threads.push_back(t);
+	}
+}
+
+void BlockTxCheckPool::Stop()
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	m_start_condition_variable.notify_all();
+}
+
+void BlockTxCheckPool::DeInit()
+{
+	Stop();
+
+	for (auto t : m_threads)
+	{
+		t->join();
+		delete t;
+	}
+
+	m_threads.clear();
+}
+
+void BlockTxCheckPool::ThreadProc(BlockTxCheckerFactory factory, const char *role)
+{
+	if (role)
+		CCThreadRoles::Apply(role);
+
+	unique_ptr<BlockTxChecker> checker(factory());
+	CCASSERT(checker);
+
+	uint64_t seqnum = 0;
+
+	unique_lock<mutex> lock(m_mutex);
+
+	while (true)
+	{
+		while (seqnum == m_seqnum && !g_shutdown)
+			m_start_condition_variable.wait(lock);
+
+		if (seqnum == m_seqnum)
+			break;					// shutdown with no round pending
+
+		seqnum = m_seqnum;
+
+		lock.unlock();
+
+		CheckRange(*checker);
+
+		lock.lock();
+
+		CCASSERT(m_pending);
+
+		if (!--m_pending)
+			m_done_condition_variable.notify_all();
+	}
+}
+
+void BlockTxCheckPool::CheckRange(BlockTxChecker& checker)
+{
+	auto ntx = m_checks.size();
+
+	while (true)
+	{
+		auto index = m_next_index.fetch_add(1);
+
+		if (index >= ntx)
+			break;
+
+		auto& check = m_checks[index];
+
+		if (check.result)
+			continue;				// the block split failed at this tx, and m_fail_index was already set
+
+		if (g_shutdown)
+			check.result = 1;
+		else if (index > m_fail_index.load())
+			check.result = 1;		// an earlier tx failed, so the result of this one won't be used
+		else
+			check.result = checker.Check(check);
+
+		if (check.result)
+		{
+			auto fail_index = m_fail_index.load();
+
+			while (index < fail_index && !m_fail_index.compare_exchange_weak(fail_index, index))
+			{ }
+		}
+	}
+}
+
+// splits the block into tx's
+// returns the number of tx's; if the block cannot be split, the last tx's result is set to -1
+
+unsigned BlockTxCheckPool::Split(const char *pdata, const char *pend)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	CCASSERTZ(m_pending);
+
+	unsigned ntx = 0;
+
+	for (auto p = pdata; p < pend; ++ntx)
+	{
+		if (m_checks.size() <= ntx)
+			m_checks.resize(ntx + 1);
+
+		auto& check = m_checks[ntx];
+
+		check.wire = p;
+		check.result = 0;
+		check.smartobj = SmartBuf();
+
+		if (pend - p < (ptrdiff_t)sizeof(uint32_t))
+		{
+			BOOST_LOG_TRIVIAL(info) << "BlockTxCheckPool::Split end of block has " << (uintptr_t)pend - (uintptr_t)p << " extra bytes";
+
+			check.txsize = 0;
+			check.result = -1;
+			++ntx;
+
+			break;
+		}
+
+		check.txsize = *(uint32_t*)p;
+
+		if (check.txsize < CC_MSG_HEADER_SIZE || check.txsize > (uintptr_t)pend - (uintptr_t)p)
+		{
+			BOOST_LOG_TRIVIAL(info) << "BlockTxCheckPool::Split tx size " << check.txsize << " invalid at block offset " << (uintptr_t)p - (uintptr_t)pdata;
+
+			check.result = -1;
+			++ntx;
+
+			break;
+		}
+
+		p += check.txsize;
+	}
+
+	m_checks.resize(ntx);
+
+	m_next_index = 0;
+	m_fail_index = (ntx && m_checks[ntx-1].result ? ntx - 1 : ntx);	// if the block split failed, skip the tx's after the failure
+
+	return ntx;
+}
+
+// checks the tx's from the last call to Split; the calling thread takes part using checker
+// returns the number of tx's
+
+unsigned BlockTxCheckPool::Run(BlockTxChecker& checker)
+{
+	unique_lock<mutex> lock(m_mutex);
+
+	CCASSERTZ(m_pending);
+
+	auto ntx = m_checks.size();
+
+	if (ntx > 1 && m_threads.size() && !g_shutdown)
+	{
+		m_pending = m_threads.size();
+
+		++m_seqnum;
+
+		m_start_condition_variable.notify_all();
+	}
+
+	lock.unlock();
+
+	CheckRange(checker);
+
+	lock.lock();
+
+	while (m_pending)
+		m_done_condition_variable.wait(lock);
+
+	return ntx;
+}
+
+int BlockTxCheckPool::ExtractTx(const char *wire, const uint32_t txsize, SmartBuf& smartobj)
+{
+	if (txsize < CC_MSG_HEADER_SIZE)
+	{
+		BOOST_LOG_TRIVIAL(info) << "BlockTxCheckPool::ExtractTx size " << txsize << " < " << CC_MSG_HEADER_SIZE;
+
+		return -1;
+	}
+
+	smartobj = SmartBuf(txsize + sizeof(CCObject::Preamble), false);	// filled by the memcpy below
+	if (!smartobj)
+	{
+		BOOST_LOG_TRIVIAL(error) << "BlockTxCheckPool::ExtractTx SmartBuf allocation failed size " << txsize + sizeof(CCObject::Preamble);
+
+		return -1;
+	}
+
+	auto obj = (CCObject*)smartobj.data();
+
+	memcpy(obj->ObjPtr(), wire, txsize);
+
+	if (!obj->IsValid() || obj->ObjSize() != txsize)
+	{
+		BOOST_LOG_TRIVIAL(info) << "BlockTxCheckPool::ExtractTx invalid tx object";
+
+		return -1;
+	}
+
+	obj->SetObjId();
+
+	return 0;
+}
+
+// a plain txpay has no Xtx and every input has a serialnum, so it can be checked without decoding it into a TxPay
+// returns 0 if the tx passed, -1 if it failed, or 1 if it isn't a plain txpay
+
+int BlockTxCheckPool::CheckPlainTx(BlockTxCheck& check)
+{
+	TxView txview;
+
+	auto rc = txview.Init(check.wire, check.txsize);
+	if (rc || txview.TagType() != CC_TYPE_TXPAY)
+		return 1;
+
+	check.serialnums.resize(txview.NIn());
+
+	for (unsigned i = 0; i < txview.NIn(); ++i)
+		txview.GetSerialnum(i, check.serialnums[i]);
+
+	rc = ExtractTx(check.wire, check.txsize, check.smartobj);
+	if (rc) return -1;
+
+	return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * blocktxcheck.hpp
+*/
+
+#pragma once
+
+#include <transaction.hpp>
+#include <SmartBuf.hpp>
+
+#include <functional>
+
+struct BlockTxCheck
+{
+	const char *wire;
+	uint32_t txsize;
+	int result;
+	vector<bigint_t> serialnums;
+	SmartBuf smartobj;
+};
+
+// per-thread state used to check block tx's; each pool thread creates its own
+
+class BlockTxChecker
+{
+public:
+	virtual ~BlockTxChecker() { }
+
+	// returns 0 if the tx passed, or non-zero if it failed
+	virtual int Check(BlockTxCheck& check) = 0;
+};
+
+typedef function<BlockTxChecker*()> BlockTxCheckerFactory;
+
+class BlockTxCheckPool
+{
+	vector<thread*> m_threads;
+	vector<BlockTxCheck> m_checks;	// protected by m_mutex when m_pending == 0
+
+	mutex m_mutex;
+	condition_variable m_start_condition_variable;
+	condition_variable m_done_condition_variable;
+	uint64_t m_seqnum;
+	unsigned m_pending;				// number of pool threads that have not yet finished the current round
+	atomic<unsigned> m_next_index;
+	atomic<unsigned> m_fail_index;
+
+	void CheckRange(BlockTxChecker& checker);
+	void ThreadProc(BlockTxCheckerFactory factory, const char *role);
+
+public:
+
+	BlockTxCheckPool()
+	 :	m_seqnum(0),
+		m_pending(0)
+	{ }
+
+	~BlockTxCheckPool()
+	{
+		DeInit();
+	}
+
+	void Init(unsigned nthreads, BlockTxCheckerFactory factory, const char *role);
+	void Stop();
+	void DeInit();
+
+	unsigned NThreads() const
+	{
+		return m_threads.size() + 1;
+	}
+
+	unsigned Split(const char *pdata, const char *pend);
+	unsigned Run(BlockTxChecker& checker);
+
+	// valid after Run returns, until the next call to Split
+	BlockTxCheck& GetCheck(unsigned index)
+	{
+		return m_checks[index];
+	}
+
+	static int ExtractTx(const char *wire, const uint32_t txsize, SmartBuf& smartobj);
+	static int CheckPlainTx(BlockTxCheck& check);
+};
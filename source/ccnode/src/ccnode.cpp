@@ -16,11 +16,15 @@
 #include "foreign-query.hpp"
 #include "witness.hpp"
 #include "expire.hpp"
+#include "memaccount.hpp"
 
 #include <CCproof.h>
 #include <CCmint.h>
+#include <CCthread.hpp>
 
 #include <tor.h>
+#include <socks.hpp>
+#include <ccserver/buffer_pool.hpp>
 
 #include <dblog.h>
 #include <sqlite/sqlite3.h>
@@ -52,6 +56,8 @@
 #define DEFAULT_HISTORY_DATA_FILE			"history-#.dat"
 #define DEFAULT_PRIVATE_RELAY_HOSTS_FILE	"private_relay_hosts.lis"
 
+#define SERVICE_STATS_LOG_INTERVAL		(10*60)	// seconds between logging the connection counts of services with more than one reactor
+
 #define DEFAULT_TRACE_LEVEL	4
 #define TRACE_SHUTDOWN		0
 
@@ -132,12 +138,21 @@ static void do_show_config()
 	//cout << "   store created bills = " << yesno(g_store_created) << endl;
 	//cout << "   store spent bills = " << yesno(g_store_spent) << endl;
 	cout << "   base port = " << g_params.base_port << endl;
+	cout << "   Tor proxy pool idle seconds = " << g_params.torproxy_pool_idle << endl;
 	cout << "   rendezvous server difficulty = " << g_params.rendezvous_server_difficulty << endl;
 	cout << "   max object memory in MB = " << g_params.max_obj_mem << endl;
+	cout << "   max connection buffer pool memory in MB = " << g_params.conn_buffer_pool_mem << endl;
+	cout << "   soft memory budget in MB = " << g_params.mem_soft_budget << endl;
+	cout << "   hard memory budget in MB = " << g_params.mem_hard_budget << endl;
+	cout << "   memory status log interval = " << g_params.mem_log_interval << endl;
+	cout << "   lock profile log interval = " << g_params.lock_profile_interval << endl;
 	cout << "   tx validation threads = " << g_params.tx_validation_threads << endl;
+	cout << "   block validation threads = " << g_params.block_validation_threads << endl;
+	cout << "   thread placement = " << CCThreadRoles::ConfigString() << endl;
 	cout << "   block future tolerance = " << g_params.block_future_tolerance << endl;
 	cout << "   db checkpoint interval = " << g_params.db_checkpoint_sec << endl;
 	cout << "   index transaction outputs = " << yesno(g_params.index_txouts) << endl;
+	cout << "   relay compact blocks = " << yesno(g_params.relay_compact_blocks) << endl;
 
 	cout << endl;
 
@@ -151,6 +166,8 @@ static void do_show_config()
 	cout << "   block time ms = " << g_witness.block_time_ms << endl;
 	cout << "   min block work ms = " << g_witness.block_min_work_ms << endl;
 	cout << "   idle block secs = " << g_witness.block_max_time << endl;
+	cout << "   tx age floor secs = " << g_witness.tx_age_floor_secs << endl;
+	cout << "   tx age share pct = " << g_witness.tx_age_share_pct << endl;
 	cout << "   test random block ms = " << g_witness.test_block_random_ms << endl;
 	cout << "   witness malicious test = " << yesno(g_witness.test_mal) << endl;
 	cout << endl;
@@ -206,15 +223,42 @@ static void check_config_values()
 
 	#endif
 
+	if (g_params.conn_buffer_pool_mem < 0 || g_params.conn_buffer_pool_mem > 4096)
+		throw range_error("Max connection buffer pool memory MB not in valid range");
+
+	if (g_params.mem_soft_budget < 0 || g_params.mem_soft_budget > 1024*1024)
+		throw range_error("Soft memory budget MB not in valid range");
+
+	if (g_params.mem_hard_budget < 0 || g_params.mem_hard_budget > 1024*1024 || (g_params.mem_hard_budget && g_params.mem_hard_budget < g_params.mem_soft_budget))
+		throw range_error("Hard memory budget MB not in valid range");
+
+	if (g_params.mem_log_interval < 0 || g_params.mem_log_interval > 7*24*3600)
+		throw range_error("Memory status log interval not in valid range");
+
+	if (g_params.lock_profile_interval < 0 || g_params.lock_profile_interval > 7*24*3600)
+		throw range_error("Lock profile log interval not in valid range");
+
+	if (g_params.torproxy_pool_idle < 0 || g_params.torproxy_pool_idle > 3600)
+		throw range_error("Tor proxy pool idle seconds not in valid range");
+
 	if (g_params.tx_validation_threads < 1 || g_params.tx_validation_threads > 2000)
 		throw range_error("Tx validation threads value not in valid range");
 
+	if (g_params.block_validation_threads < 1 || g_params.block_validation_threads > 2000)
+		throw range_error("Block validation threads value not in valid range");
+
 	if (g_params.block_future_tolerance < 1 || g_params.block_future_tolerance > 90000)
 		throw range_error("Block time tolerance not in valid range");
 
 	if (g_params.db_checkpoint_sec < 0 || g_params.db_checkpoint_sec > 3600)
 		throw range_error("Database checkpoint seconds not in valid range");
 
+	if (g_witness.tx_age_floor_secs < 0 || g_witness.tx_age_floor_secs > 7*24*3600)
+		throw range_error("Witness tx age floor seconds not in valid range");
+
+	if (g_witness.tx_age_share_pct < 0 || g_witness.tx_age_share_pct > 100)
+		throw range_error("Witness tx age share percent not in valid range");
+
 	if (g_transact_service.enabled && !g_params.index_txouts)
 		throw range_error("transactions must be indexed for the transaction service to work correctly");
 
@@ -224,9 +268,30 @@ static void check_config_values()
 	if (g_transact_service.max_inconns < 0 || g_transact_service.max_inconns > 100000)
 		throw range_error("Max connections for transaction support service not in valid range");
 
+	if (g_transact_service.max_watch_conns < 0 || g_transact_service.max_watch_conns > g_transact_service.max_inconns)
+		throw range_error("Max address watch connections for transaction support service not in valid range");
+
+	if (g_transact_service.submit_reserve_conns < 0 || (g_transact_service.max_inconns && g_transact_service.submit_reserve_conns >= g_transact_service.max_inconns))
+		throw range_error("Transaction support service connections reserved for transactions not in valid range");
+
+	if (g_transact_service.max_heavy_conns < 1 || g_transact_service.max_heavy_conns > 100000)
+		throw range_error("Max heavy query connections for transaction support service not in valid range");
+
+	if (g_transact_service.source_rate < 0 || g_transact_service.source_rate > 1000000)
+		throw range_error("Transaction support service per-source request rate not in valid range");
+
+	if (g_transact_service.source_burst < 10 || g_transact_service.source_burst > 1000000)
+		throw range_error("Transaction support service per-source request burst not in valid range");
+
 	if (g_transact_service.threads_per_conn <= 0 || g_transact_service.threads_per_conn > 2)
 		throw range_error("Max connections for transaction support service not in valid range");
 
+	if (g_transact_service.nreactors < 1 || g_transact_service.nreactors > 256)
+		throw range_error("Reactors for transaction support service not in valid range");
+
+	if (g_blockserve_service.nreactors < 1 || g_blockserve_service.nreactors > 256)
+		throw range_error("Reactors for blockchain service not in valid range");
+
 	if (g_transact_service.query_work_difficulty && g_transact_service.query_work_difficulty < ((uint64_t)1 << 38))
 		throw range_error("Transaction server query work difficulty not in valid range");
 
@@ -265,6 +330,74 @@ static void check_config_values()
 	}
 }
 
+static void log_thread_placement()
+{
+	static uint32_t start_ticks;
+	static bool done;
+
+	if (done || g_params.thread_placement.empty())
+		return;
+
+	auto now = ccticks();
+
+	if (!start_ticks)
+		start_ticks = now;
+
+	// wait for the service threads to start
+
+	if (ccticks_elapsed(start_ticks, now) < 5*CCTICKS_PER_SEC)
+		return;
+
+	done = true;
+
+	BOOST_LOG_TRIVIAL(info) << CCThreadRoles::ReportString();
+}
+
+static void log_service_stats()
+{
+	static uint32_t last_ticks;
+
+	auto now = ccticks();
+
+	if (!last_ticks)
+		last_ticks = now;
+
+	if (ccticks_elapsed(last_ticks, now) < SERVICE_STATS_LOG_INTERVAL*CCTICKS_PER_SEC)
+		return;
+
+	last_ticks = now;
+
+	g_transact_service.LogStats();
+	g_blockserve_service.LogStats();
+}
+
+static void log_lock_profile(bool force = false)
+{
+	static uint32_t last_ticks;
+
+	if (!g_params.lock_profile_interval)
+		return;
+
+	auto now = ccticks();
+
+	if (!last_ticks)
+		last_ticks = now;
+
+	if (!force && ccticks_elapsed(last_ticks, now) < g_params.lock_profile_interval*CCTICKS_PER_SEC)
+		return;
+
+	last_ticks = now;
+
+	ostringstream out;
+	SpinLockProfiler::Report(out, 20);
+
+	istringstream in(out.str());
+	string line;
+
+	while (getline(in, line))
+		BOOST_LOG_TRIVIAL(info) << line;
+}
+
 static int process_options(int argc, char **argv)
 {
 	namespace po = boost::program_options;
@@ -298,9 +431,20 @@ static int process_options(int argc, char **argv)
 		("proof-key-dir", po::wvalue<wstring>(&g_params.proof_key_dir), "Path to zero knowledge proof keys; if set to \"env\", the environment variable " KEY_PATH_ENV_VAR " is used (default: the subdirectory \"" ZK_KEY_DIR "\" in same directory as this program).")
 		("tor-exe", po::wvalue<wstring>(&g_params.tor_exe), "Path to Tor executable; if set to \"external\", Tor is not launched by this program, and must be launched and managed externally (default: \"" TOR_EXE "\" in same directory as this program).")
 		("tor-port", po::value<int>(&g_params.torproxy_port)->default_value(0), "Tor proxy port (default baseport+" STRINGIFY(TOR_PORT) ").")
+		("tor-pool-idle", po::value<int>(&g_params.torproxy_pool_idle)->default_value(20), "Seconds to keep an idle pre-established Tor proxy connection to the rendezvous server or the next relay or blockchain peer before replacing it; should be less than the peers' idle connection timeout (0 = don't pre-establish connections).")
 		("tor-config", po::wvalue<wstring>(&g_params.tor_config), "Path to Tor configuration file (default: \"" TOR_CONFIG "\" in same directory as this program).")
 		("obj-memory-max", po::value<int>(&g_params.max_obj_mem)->default_value(500), "Maximum object (block and transaction) memory in MB.")
+		("conn-buffer-pool-max", po::value<int>(&g_params.conn_buffer_pool_mem)->default_value(64), "Maximum memory in MB held for reuse in the pool of network connection buffers.")
+		("memory-soft-budget", po::value<int>(&g_params.mem_soft_budget)->default_value(0), "Memory in MB used by objects, in-memory databases and connection buffers above which objects are expired early (0 = no limit).")
+		("memory-hard-budget", po::value<int>(&g_params.mem_hard_budget)->default_value(0), "Memory in MB used by objects, in-memory databases and connection buffers above which new transactions are not downloaded from relay peers (0 = no limit).")
+		("memory-log-interval", po::value<int>(&g_params.mem_log_interval)->default_value(600), "Seconds between logging memory use by each subsystem (0 = only when a memory budget is crossed).")
+		("lock-profile-interval", po::value<int>(&g_params.lock_profile_interval)->default_value(0), "Seconds between logging the lock sites with the highest wait times (0 = lock contention profiling disabled).")
 		("tx-validation-threads", po::value<int>(&g_params.tx_validation_threads)->default_value(-1), "Transaction validation threads (-1 = auto config).")
+		("block-validation-threads", po::value<int>(&g_params.block_validation_threads)->default_value(-1), "Threads used to parse and check the transactions in each block (-1 = auto config).")
+		("thread-placement", po::value<string>(&g_params.thread_placement)->default_value(""), "CPU placement of each thread role, as role=cpus[:nice[:sched]] separated by semicolons, "
+				"where cpus is a list of CPU numbers and ranges such as 0-7,16-23 or * for any CPU, nice is added to the thread nice value, and sched is other, batch or idle; "
+				"the roles are validate, block, witness, expire, wal, xreq, relay, blocksync, blockserve, transact and foreign-rpc (default: no placement).")
+		("thread-numa-local", po::value<bool>(&g_params.thread_numa_local)->default_value(0), "Allocate the memory of pinned threads only from the NUMA nodes of their CPU's.")
 		("block-future-tolerance", po::value<int>(&g_params.block_future_tolerance)->default_value(3900), "Block future timestamp tolerance in seconds.")
 		("db-checkpoint-sec", po::value<int>(&g_params.db_checkpoint_sec)->default_value(21), "Database checkpoint interval in seconds (0 = continuous).")
 		("baseport", po::value<int>(&g_params.base_port)->default_value(0), (string("Base port for node interfaces\n")
@@ -317,7 +461,18 @@ static int process_options(int argc, char **argv)
 		("transact-tor", po::value<bool>(&g_transact_service.tor_service)->default_value(0), "Make the transaction support service available as a Tor hidden service.")
 		("transact-tor-auth", po::value<string>(&g_transact_service.tor_auth_string)->default_value("v3"), "Tor hidden service authentication method (none, basic, or v3).")
 		("transact-conns", po::value<int>(&g_transact_service.max_inconns)->default_value(20), "Maximum number of incoming connections for transaction support service.")
+		("transact-watch-conns", po::value<int>(&g_transact_service.max_watch_conns)->default_value(5), "Maximum number of transaction support service connections that can hold an address watch open;\n"
+				"each one counts toward transact-conns.")
+		("transact-submit-reserve", po::value<int>(&g_transact_service.submit_reserve_conns)->default_value(4), "Number of transaction support service connections that queries may not use, so they remain available to submit transactions.")
+		("transact-heavy-conns", po::value<int>(&g_transact_service.max_heavy_conns)->default_value(4), "Maximum number of transaction support service connections that can run heavy queries (inputs, exchange requests and exchange matching requests) at once;\n"
+				"other heavy queries wait for a connection to finish.")
+		("transact-source-rate", po::value<int>(&g_transact_service.source_rate)->default_value(10), "Request tokens per second given to each remote address connecting to the transaction support service (0 = no limit);\n"
+				"a query costs 1 to 8 tokens depending on its type, and a transaction costs 4;\n"
+				"connections from the localhost, which include those arriving through a Tor hidden service, are not limited.")
+		("transact-source-burst", po::value<int>(&g_transact_service.source_burst)->default_value(100), "Maximum request tokens each remote address can accumulate.")
 		("transact-threads", po::value<float>(&g_transact_service.threads_per_conn)->default_value(1), "Threads per connection for transaction support service.")
+		("transact-reactors", po::value<int>(&g_transact_service.nreactors)->default_value(1), "Number of independent I/O reactors for transaction support service;\n"
+				"incoming connections are spread across the reactors to reduce lock contention when there are many connections.")
 		("transact-difficulty", po::value<uint64_t>(&g_transact_service.query_work_difficulty)->default_value(0), "Proof-of-work difficulty for transaction server queries (0 = none, otherwise lower numbers have more difficulty).")
 		("transact-max-network-sec", po::value<int32_t>(&g_transact_service.max_net_sec)->default_value(420), "Maximum time in seconds since last block received for transaction server to be considered connected to the network (0 = disabled).")
 		("transact-max-block-sec", po::value<int32_t>(&g_transact_service.max_block_sec)->default_value(3600), "Maximum timestamp age in seconds of last indelible block for transaction server to be considered connected to the network (0 = disabled).")
@@ -328,6 +483,7 @@ static int process_options(int argc, char **argv)
 				"this setting can be used to bind to another address for direct access via the local network or internet.")
 		("relay-out", po::value<int>(&g_relay_service.max_outconns)->default_value(8), "Target number of outgoing relay connections (must be at least 4).")
 		("relay-in", po::value<int>(&g_relay_service.max_inconns)->default_value(16), "Maximum number of incoming relay connections (must be at least 1.5*relay-out).")
+		("relay-compact-blocks", po::value<bool>(&g_params.relay_compact_blocks)->default_value(1), "Relay blocks as compact blocks that are rebuilt from transactions the receiving node already has, when the peer supports it.")
 		("privrelay", po::value<bool>(&g_privrelay_service.enabled)->default_value(0), "Fetch and relay blocks and transactions (at port baseport+" STRINGIFY(PRIVRELAY_PORT) ");\n"
 				"if no relay is enabled, this node will receive no updates and will only use data previously stored.")
 		("privrelay-file", po::wvalue<wstring>(&g_privrelay_service.priv_hosts_file), "Path to file containing a list of private relay ip_address:port values or Tor onion hostnames (default: \"" DEFAULT_PRIVATE_RELAY_HOSTS_FILE "\").")
@@ -349,6 +505,7 @@ static int process_options(int argc, char **argv)
 		("blockserve-tor-new-hostname", po::value<bool>(&g_blockserve_service.tor_new_hostname)->default_value(1), "Give the blockchain Tor hidden service a new hostname.")
 		("blockserve-tor-auth", po::value<string>(&g_blockserve_service.tor_auth_string)->default_value("none"), "Tor hidden service authentication method (none, basic, or v3).")
 		("blockserve-conns", po::value<int>(&g_blockserve_service.max_inconns)->default_value(1), "Maximum number of incoming connections for blockchain service.")
+		("blockserve-reactors", po::value<int>(&g_blockserve_service.nreactors)->default_value(1), "Number of independent I/O reactors for blockchain service.")
 		("blocksync-conns", po::value<int>(&g_blocksync_client.max_outconns)->default_value(10), "Maximum number of outgoing connections for blockchain synchonization.")
 		("foreign-rpc-conns", po::value<int>(&g_foreignrpc_client.max_outconns)->default_value(4), "Maximum number of outgoing connections for foreign blockchain RPC.")
 		("foreign-btc-verify-level", po::value<int>(&g_foreignrpc_client.verify_level[XREQ_BLOCKCHAIN_BTC])->default_value(ForeignRpcClient::VerifyLevel::If_Possible), "Verification level for BTC exchange requests (0=No RPC, 1=If possible, 2=Strict Relay, 3=Strict Blocks).")
@@ -363,6 +520,8 @@ static int process_options(int argc, char **argv)
 		("witness-block-ms", po::value<int>(&g_witness.block_time_ms)->default_value(2000), "Nominal milliseconds between blocks.")
 		("witness-block-min-work-ms", po::value<int>(&g_witness.block_min_work_ms)->default_value(200), "Minimum milliseconds to work assembling a block.")
 		("witness-block-idle-sec", po::value<int>(&g_witness.block_max_time)->default_value(20), "Seconds between blocks when there are no transactions to witness.")
+		("witness-tx-age-floor-sec", po::value<int>(&g_witness.tx_age_floor_secs)->default_value(60), "Seconds a transaction must be pending before it is included in blocks ahead of transactions with a higher donation per byte (0 = order only by donation per byte).")
+		("witness-tx-age-share-pct", po::value<int>(&g_witness.tx_age_share_pct)->default_value(25), "Percent of each block reserved for transactions pending longer than witness-tx-age-floor-sec, oldest first.")
 		("witness-test-block-random-ms", po::value<int>(&g_witness.test_block_random_ms)->default_value(0), "Test randomly generating blocks, with this average milliseconds between blocks (0 = disabled).")
 		("witness-test-mal", po::value<bool>(&g_witness.test_mal)->default_value(0), "Act as a malicious witness.")
 		//("control", po::value<bool>(&g_control_service.enabled)->default_value(0), "Allow other programs to control node operation (at port baseport+" STRINGIFY(NODE_CONTROL_PORT) ").")
@@ -527,6 +686,11 @@ static int process_options(int argc, char **argv)
 		BOOST_LOG_TRIVIAL(warning) << "std::thread::hardware_concurrency is indeterminant; using program default value " << DEFAULT_TX_VALIDATION_THREADS;
 	}
 
+	if (g_params.block_validation_threads < 0)
+		g_params.block_validation_threads = max(thread::hardware_concurrency(), 1U);
+
+	CCThreadRoles::Configure(g_params.thread_placement, g_params.thread_numa_local, {"validate", "block", "witness", "expire", "wal", "xreq", "relay", "blocksync", "blockserve", "transact", "foreign-rpc"});
+
 	get_proof_key_dir(g_params.proof_key_dir, g_params.process_dir);
 
 	string def = CCAPPDIR;
@@ -628,6 +792,10 @@ int main(int argc, char **argv)
 	if (g_blockchain.HasFatalError())
 		goto do_fatal;
 
+	g_connbufpool.SetMaxPooledBytes((uint64_t)g_params.conn_buffer_pool_mem << 20);
+
+	SpinLockProfiler::Enable(g_params.lock_profile_interval > 0);
+
 	g_foreignrpc_client.Start();
 
 	for (unsigned i = 1; i <= XREQ_BLOCKCHAIN_MAX; ++i)
@@ -660,6 +828,10 @@ int main(int argc, char **argv)
 	g_processblock.Init();
 
 	g_expire.Init();
+
+	if (g_params.torproxy_pool_idle)
+		g_sockspool.Start(g_params.torproxy_port, g_params.torproxy_pool_idle);
+
 	g_blockserve_service.Start();
 	g_blocksync_client.Start();
 	g_relay_service.Start();
@@ -675,8 +847,18 @@ int main(int argc, char **argv)
 	}
 
 	while (!g_shutdown)
+	{
 		wait_for_shutdown(500);
 
+		g_memaccount.Check();
+
+		log_lock_profile();
+
+		log_thread_placement();
+
+		log_service_stats();
+	}
+
 	BOOST_LOG_TRIVIAL(info) << "Shutting down...";
 
 	start_shutdown();
@@ -704,6 +886,7 @@ int main(int argc, char **argv)
 	g_blockserve_service.StartShutdown();
 	g_foreignrpc_client.StartShutdown();
 	g_hostdir.DeInit();
+	g_sockspool.Stop();
 
 		if (TRACE_SHUTDOWN) BOOST_LOG_TRIVIAL(info) << "shutdown 4...";
 
@@ -718,6 +901,12 @@ int main(int argc, char **argv)
 	g_blockserve_service.WaitForShutdown();
 	g_foreignrpc_client.WaitForShutdown();
 
+	g_connbufpool.LogStats();
+	for (unsigned i = 0; i < PROCESS_Q_N; ++i)
+		DbConnProcessQ::LogHoldStats(i);
+	SmartBuf::LogAllocStats();
+	log_lock_profile(true);
+
 		if (TRACE_SHUTDOWN) BOOST_LOG_TRIVIAL(info) << "shutdown 6...";
 
 	g_processblock.DeInit();
@@ -734,6 +923,8 @@ int main(int argc, char **argv)
 
 	g_expire.DeInit();
 
+	g_memaccount.DeInit();
+
 do_fatal:
 
 		if (TRACE_SHUTDOWN) BOOST_LOG_TRIVIAL(info) << "shutdown 10...";
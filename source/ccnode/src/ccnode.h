@@ -50,6 +50,7 @@ DECLARE_EXTERN struct global_params_struct
 
 	int		base_port;
 	int		torproxy_port;
+	int		torproxy_pool_idle;
 
 	wstring rendezvous_servers_file;
 	long long rendezvous_server_difficulty;
@@ -73,9 +74,18 @@ DECLARE_EXTERN struct global_params_struct
 	uint64_t xcx_pay_work_difficulty;
 
 	int		max_obj_mem;
+	int		conn_buffer_pool_mem;
+	int		mem_soft_budget;
+	int		mem_hard_budget;
+	int		mem_log_interval;
+	int		lock_profile_interval;
 	int		tx_validation_threads;
+	int		block_validation_threads;
+	string	thread_placement;
+	bool	thread_numa_local;
 	int		block_future_tolerance;
 	int		db_checkpoint_sec;
+	bool	relay_compact_blocks;
 	bool	index_txouts;
 	bool	index_mint_donations;
 	bool	test1;
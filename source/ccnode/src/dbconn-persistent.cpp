@@ -57,6 +57,7 @@ DbConnPersistData::DbConnPersistData()
 	CCASSERTZ(dblog(sqlite3_prepare_v2(Persistent_db, "insert into Blockchain (Level, Block) values (?1, ?2);", -1, &Blockchain_insert, NULL)));
 	CCASSERTZ(dblog(sqlite3_prepare_v2(Persistent_db, "select max(Level) from Blockchain;", -1, &Blockchain_select_max, NULL)));
 	CCASSERTZ(dblog(sqlite3_prepare_v2(Persistent_db, "select Block from Blockchain where Level = ?1;", -1, &Blockchain_select, NULL)));
+	CCASSERTZ(dblog(sqlite3_prepare_v2(Persistent_db, "select Level, Block from Blockchain where Level >= ?1 order by Level limit ?2;", -1, &Blockchain_select_range, NULL)));
 
 	CCASSERTZ(dblog(sqlite3_prepare_v2(Persistent_db, "insert into Serialnums (Serialnum, HashKey, TxCommitnum) values (?1, ?2, ?3);", -1, &Serialnum_insert, NULL)));
 	CCASSERTZ(dblog(sqlite3_prepare_v2(Persistent_db, "select HashKey, TxCommitnum from Serialnums where Serialnum = ?1;", -1, &Serialnum_select, NULL)));
@@ -131,6 +132,7 @@ DbConnPersistData::~DbConnPersistData()
 	DbFinalize(Blockchain_insert, explain);
 	DbFinalize(Blockchain_select_max, explain);
 	DbFinalize(Blockchain_select, explain);
+	DbFinalize(Blockchain_select_range, explain);
 	DbFinalize(Serialnum_insert, explain);
 	DbFinalize(Serialnum_select, explain);
 	DbFinalize(Commit_Tree_insert, explain);
@@ -173,6 +175,7 @@ void DbConnPersistData::DoPersistentDataFinish()
 	sqlite3_reset(Blockchain_insert);
 	sqlite3_reset(Blockchain_select_max);
 	sqlite3_reset(Blockchain_select);
+	sqlite3_reset(Blockchain_select_range);
 	sqlite3_reset(Serialnum_insert);
 	sqlite3_reset(Serialnum_select);
 	sqlite3_reset(Commit_Tree_insert);
@@ -628,6 +631,129 @@ int DbConnPersistData::BlockchainSelect(uint64_t level, SmartBuf *retobj)
 	return 0;
 }
 
+// returns consecutive blocks starting at level in one ordered scan, stopping after maxlevels blocks,
+// at the first missing level, or once the blocks returned total at least maxbytes (at least one block is always returned if it exists)
+
+int DbConnPersistData::BlockchainSelectRange(uint64_t level, unsigned maxlevels, unsigned maxbytes, vector<SmartBuf>& retobjs, unsigned *retbytes)
+{
+	Finally finally(boost::bind(&DbConnPersistData::DoPersistentDataFinish, this));
+
+	if (TRACE_DB_READS) BOOST_LOG_TRIVIAL(trace) << "DbConnPersistData::BlockchainSelectRange level " << level << " maxlevels " << maxlevels << " maxbytes " << maxbytes;
+
+	CCASSERT(maxlevels);
+
+	retobjs.clear();
+	unsigned nbytes = 0;
+
+	if (retbytes)
+		*retbytes = 0;
+
+	// Level >=, limit
+	if (dblog(sqlite3_bind_int64(Blockchain_select_range, 1, level))) return -1;
+	if (dblog(sqlite3_bind_int(Blockchain_select_range, 2, maxlevels))) return -1;
+
+	while (!g_shutdown && retobjs.size() < maxlevels && (retobjs.empty() || nbytes < maxbytes))
+	{
+		int rc;
+
+		if (dblog(rc = sqlite3_step(Blockchain_select_range), DB_STMT_SELECT)) return -1;
+
+		if (RandTest(RTEST_DB_ERRORS))
+		{
+			BOOST_LOG_TRIVIAL(info) << "DbConnPersistData::BlockchainSelectRange simulating database error post-select";
+
+			return -1;
+		}
+
+		if (dbresult(rc) == SQLITE_DONE)
+		{
+			if (TRACE_DB_READS) BOOST_LOG_TRIVIAL(trace) << "DbConnPersistData::BlockchainSelectRange level " << level << " not found";
+
+			break;
+		}
+
+		if (dbresult(rc) != SQLITE_ROW)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnPersistData::BlockchainSelectRange level " << level << " returned " << rc;
+
+			return -1;
+		}
+
+		if (sqlite3_data_count(Blockchain_select_range) != 2)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnPersistData::BlockchainSelectRange returned " << sqlite3_data_count(Blockchain_select_range) << " columns";
+
+			return -1;
+		}
+
+		// Level, Block
+		uint64_t row_level = sqlite3_column_int64(Blockchain_select_range, 0);
+		auto data_blob = sqlite3_column_blob(Blockchain_select_range, 1);
+		unsigned datasize = sqlite3_column_bytes(Blockchain_select_range, 1);
+
+		if (row_level != level)
+		{
+			BOOST_LOG_TRIVIAL(warning) << "DbConnPersistData::BlockchainSelectRange level " << level << " missing; next level " << row_level;
+
+			break;
+		}
+
+		if (!data_blob)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnPersistData::BlockchainSelectRange Data is null";
+
+			return -1;
+		}
+
+		if (dblog(sqlite3_extended_errcode(Persistent_db), DB_STMT_SELECT)) return -1;	// check if error retrieving results
+
+		if (RandTest(RTEST_DB_ERRORS))
+		{
+			BOOST_LOG_TRIVIAL(info) << "DbConnPersistData::BlockchainSelectRange simulating database error post-error check";
+
+			return -1;
+		}
+
+		if (datasize < (int)(sizeof(CCObject::Header) + sizeof(BlockWireHeader)) || datasize > CC_BLOCK_MAX_SIZE)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnPersistData::BlockchainSelectRange data size " << datasize << " < " << sizeof(BlockWireHeader) << " or > CC_BLOCK_MAX_SIZE " << CC_BLOCK_MAX_SIZE;
+
+			return -1;
+		}
+
+		unsigned tag = *(uint32_t*)((char*)data_blob + 4);
+		if (tag != CC_TAG_BLOCK)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnPersistData::BlockchainSelectRange tag " << hex << tag << dec << " != CC_TAG_BLOCK " << CC_TAG_BLOCK;
+
+			return -1;
+		}
+
+		auto wire = (BlockWireHeader*)((char*)data_blob + sizeof(CCObject::Header));
+		if (wire->level.GetValue() != level)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnPersistData::BlockchainSelectRange data level " << wire->level.GetValue() << " != " << level;
+
+			return -1;
+		}
+
+		SmartBuf smartobj(datasize + sizeof(CCObject::Preamble));
+
+		memcpy(smartobj.data() + sizeof(CCObject::Preamble), data_blob, datasize);
+
+		retobjs.push_back(smartobj);
+		nbytes += datasize;
+		++level;
+	}
+
+	if (TRACE_DB_READS) BOOST_LOG_TRIVIAL(trace) << "DbConnPersistData::BlockchainSelectRange returning " << retobjs.size() << " blocks total size " << nbytes;
+
+	if (retbytes)
+		*retbytes = nbytes;
+
+	return 0;
+}
+
 int DbConnPersistData::BlockchainSelectMax(uint64_t& level)
 {
 	Finally finally(boost::bind(&DbConnPersistData::DoPersistentDataFinish, this));
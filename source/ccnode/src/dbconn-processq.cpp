@@ -8,11 +8,14 @@
 
 #include "ccnode.h"
 #include "dbconn.hpp"
+#include "memaccount.hpp"
 
 #include <dblog.h>
 #include <CCobjects.hpp>
 #include <ccserver/connection_registry.hpp>
 
+#include <unordered_map>
+
 #define TRACE_DBCONN	(g_params.trace_validation_q_db)
 #define TRACE_PROCESS	(g_params.trace_block_validation || g_params.trace_tx_validation || g_params.trace_xreq_processing)
 
@@ -22,6 +25,131 @@ static array<condition_variable, PROCESS_Q_N>	work_queue_condition_variable;
 
 static mutex Process_Q_db_mutex[PROCESS_Q_N];	// to avoid inconsistency problems with shared cache
 
+//#define PROCESS_Q_HOLD_LOG_INTERVAL	60	// for testing
+
+#ifndef PROCESS_Q_HOLD_LOG_INTERVAL
+#define PROCESS_Q_HOLD_LOG_INTERVAL	600	// seconds between logging the hold stats
+#endif
+
+// Objects that are waiting for their prior object to become valid, kept in memory as a dependency graph so that when an
+// object becomes valid, its direct dependents can be released without scanning the queue.  The entries are indexed by
+// oid, and the oids are also indexed by prior oid, so an entry can be inserted, removed, or found from its prior object
+// without walking the graph.  Both are protected by Process_Q_db_mutex[type].  An object is added to the graph when it
+// is picked for processing, since its status is set to HOLD at that point, and it is removed when its status leaves HOLD
+// or it is deleted.
+
+struct ProcessQHeldObj
+{
+	ccoid_t prior_oid;
+	int64_t level;
+	int64_t seqnum;
+	int priority;
+	uint32_t hold_ticks;
+};
+
+struct ProcessQOidHash
+{
+	size_t operator() (const ccoid_t& oid) const
+	{
+		size_t hash;						// an oid is a hash, so any of its bytes can be used
+		memcpy(&hash, oid.data(), sizeof(hash));
+		return hash;
+	}
+};
+
+struct ProcessQHoldStats
+{
+	uint64_t nheld;
+	uint64_t nreleased;
+	uint64_t release_ticks_total;
+	uint32_t release_ticks_max;
+	uint32_t last_log_ticks;
+};
+
+typedef unordered_map<ccoid_t, ProcessQHeldObj, ProcessQOidHash> ProcessQHeldMap;			// oid -> entry
+typedef unordered_multimap<ccoid_t, ccoid_t, ProcessQOidHash> ProcessQHeldChildMap;		// prior oid -> oid
+
+static array<ProcessQHeldMap, PROCESS_Q_N> Process_Q_held;
+static array<ProcessQHeldChildMap, PROCESS_Q_N> Process_Q_held_children;
+static array<ProcessQHoldStats, PROCESS_Q_N> Process_Q_hold_stats;
+
+// removes oid from the children of prior_oid; a block rarely has more than a few children, so the walk is short
+
+static void ProcessQHeldRemoveChild(unsigned type, const ccoid_t& prior_oid, const ccoid_t& oid)
+{
+	auto& children = Process_Q_held_children[type];
+
+	auto range = children.equal_range(prior_oid);
+
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (it->second == oid)
+		{
+			children.erase(it);
+
+			return;
+		}
+	}
+}
+
+static void ProcessQHeldRemove(unsigned type, const ccoid_t& oid)
+{
+	auto& held = Process_Q_held[type];
+
+	auto it = held.find(oid);
+
+	if (it == held.end())
+		return;
+
+	ProcessQHeldRemoveChild(type, it->second.prior_oid, oid);
+
+	held.erase(it);
+}
+
+static void ProcessQHeldInsert(unsigned type, const ccoid_t& oid, const ProcessQHeldObj& entry)
+{
+	ProcessQHeldRemove(type, oid);
+
+	Process_Q_held[type].emplace(oid, entry);
+	Process_Q_held_children[type].emplace(entry.prior_oid, oid);
+
+	++Process_Q_hold_stats[type].nheld;
+}
+
+static void ProcessQHeldRemoveLevel(unsigned type, int64_t level)
+{
+	auto& held = Process_Q_held[type];
+
+	for (auto it = held.begin(); it != held.end(); )
+	{
+		if (it->second.level < level)
+		{
+			ProcessQHeldRemoveChild(type, it->second.prior_oid, it->first);
+
+			it = held.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+static string ProcessQHoldStatsString(unsigned type)	// caller must hold Process_Q_db_mutex[type]
+{
+	auto& stats = Process_Q_hold_stats[type];
+
+	ostringstream out;
+
+	out << "type " << type << " held now " << Process_Q_held[type].size() << " total " << stats.nheld << " released " << stats.nreleased;
+	out << " release latency avg " << (stats.nreleased ? stats.release_ticks_total / stats.nreleased : 0) << " max " << stats.release_ticks_max << " ms";
+
+	return out.str();
+}
+
+static MemTag ProcessQMemTag(unsigned type)
+{
+	return type == PROCESS_Q_TYPE_BLOCK ? MEMTAG_PROCESS_Q_BLOCKS : MEMTAG_PROCESS_Q_TXS;
+}
+
 DbConnProcessQ::DbConnProcessQ()
 {
 	ClearDbPointers();
@@ -43,15 +171,17 @@ DbConnProcessQ::DbConnProcessQ()
 		// The follow select is used in ProcessQGetNextValidateObj to select the next object for processing
 		// It selects highest Level first to give max chance of the blockchain advancing
 		// ok to use offset in this select when witness is selecting valid blocks because between calls (a) no one will change sort keys; (b) no one will delete an entry (b) if an entry is added, it's ok to get same entry twice
-		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "select Level, ConnId, CallbackId, Bufp from Process_Q where Status = ?1 order by Priority, Level desc, Seqnum limit 1 offset ?2;", -1, &Process_Q_select_next[i], NULL)));
+		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "select Level, ConnId, CallbackId, Bufp, PriorOid, Priority, Seqnum from Process_Q where Status = ?1 order by Priority, Level desc, Seqnum limit 1 offset ?2;", -1, &Process_Q_select_next[i], NULL)));
 		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "update Process_Q set Status = ?2, AuxInt = ifnull(?3, AuxInt) where ObjId = ?1;", -1, &Process_Q_update[i], NULL)));
-		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "update Process_Q set Status = " STRINGIFY(PROCESS_Q_STATUS_PENDING) " where Status = " STRINGIFY(PROCESS_Q_STATUS_HOLD) " and PriorOid = ?1;", -1, &Process_Q_update_priorobj[i], NULL)));
+		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "update Process_Q set Status = " STRINGIFY(PROCESS_Q_STATUS_PENDING) " where ObjId = ?1 and Status = " STRINGIFY(PROCESS_Q_STATUS_HOLD) ";", -1, &Process_Q_update_priorobj[i], NULL)));
+		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "select Bufp from Process_Q where Status = " STRINGIFY(PROCESS_Q_STATUS_VALID) " order by Priority, Level desc, Seqnum;", -1, &Process_Q_select_valid[i], NULL)));
 		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "update Process_Q set AuxInt = 0 where Status = " STRINGIFY(PROCESS_Q_STATUS_VALID) ";", -1, &Process_Q_clear[i], NULL)));
 		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "select count(*) from Process_Q where Status = " STRINGIFY(PROCESS_Q_STATUS_VALID) " and AuxInt = ?1;", -1, &Process_Q_count[i], NULL)));	// used for testing
 		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "update Process_Q set Priority = random() where Status = " STRINGIFY(PROCESS_Q_STATUS_VALID) ";", -1, &Process_Q_randomize[i], NULL)));		// used for testing
 		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "update Process_Q set Status = Status | " STRINGIFY(PROCESS_Q_STATUS_DONE_FLAG) " where Level < ?1;", -1, &Process_Q_done[i], NULL)));
 		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "select ObjId, Bufp, Level, Status, ConnId, CallbackId from Process_Q where Level < ?1 limit 1;", -1, &Process_Q_select_level[i], NULL)));
 		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "delete from Process_Q where ObjId = ?1;", -1, &Process_Q_delete[i], NULL)));
+		CCASSERTZ(dblog(sqlite3_prepare_v2(Process_Q_db[i], "select Bufp from Process_Q where ObjId = ?1 and Status = (" STRINGIFY(PROCESS_Q_STATUS_VALID | PROCESS_Q_STATUS_DONE_FLAG) ");", -1, &Process_Q_select_done[i], NULL)));
 	}
 
 	//if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnProcessQ::DbConnProcessQ done dbconn " << (uintptr_t)this;
@@ -85,12 +215,14 @@ DbConnProcessQ::~DbConnProcessQ()
 		DbFinalize(Process_Q_select_next[i], explain);
 		DbFinalize(Process_Q_update[i], explain);
 		DbFinalize(Process_Q_update_priorobj[i], explain);
+		DbFinalize(Process_Q_select_valid[i], explain);
 		DbFinalize(Process_Q_clear[i], explain);
 		DbFinalize(Process_Q_count[i], explain);
 		DbFinalize(Process_Q_randomize[i], explain);
 		DbFinalize(Process_Q_done[i], explain);
 		DbFinalize(Process_Q_select_level[i], explain);
 		DbFinalize(Process_Q_delete[i], explain);
+		DbFinalize(Process_Q_select_done[i], explain);
 
 		explain = false;	// if the queue types have different queries, then comment out this line
 	}
@@ -112,12 +244,14 @@ void DbConnProcessQ::DoProcessQFinish(unsigned type)
 	sqlite3_reset(Process_Q_select_next[type]);
 	sqlite3_reset(Process_Q_update[type]);
 	sqlite3_reset(Process_Q_update_priorobj[type]);
+	sqlite3_reset(Process_Q_select_valid[type]);
 	sqlite3_reset(Process_Q_clear[type]);
 	sqlite3_reset(Process_Q_count[type]);
 	sqlite3_reset(Process_Q_randomize[type]);
 	sqlite3_reset(Process_Q_done[type]);
 	sqlite3_reset(Process_Q_select_level[type]);
 	sqlite3_reset(Process_Q_delete[type]);
+	sqlite3_reset(Process_Q_select_done[type]);
 }
 
 void DbConnProcessQ::IncrementQueuedWork(unsigned type, unsigned changes)
@@ -196,6 +330,15 @@ void DbConnProcessQ::WaitForQueuedWork(unsigned type)
 	}
 }
 
+void DbConnProcessQ::LogHoldStats(unsigned type)
+{
+	CCASSERT(type < PROCESS_Q_N);
+
+	lock_guard<mutex> lock(Process_Q_db_mutex[type]);
+
+	BOOST_LOG_TRIVIAL(info) << "DbConnProcessQ::LogHoldStats " << ProcessQHoldStatsString(type);
+}
+
 int DbConnProcessQ::ProcessQEnqueueValidate(unsigned type, SmartBuf smartobj, const ccoid_t *prior_oid, int64_t level, unsigned status, Process_Q_Priority priority, bool is_block_tx, unsigned conn_index, uint32_t callback_id)
 {
 	static int64_t sequence = 0;
@@ -271,6 +414,8 @@ int DbConnProcessQ::ProcessQEnqueueValidate(unsigned type, SmartBuf smartobj, co
 		if (TRACE_DBCONN || TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "DbConnProcessQ::ProcessQEnqueueValidate inserted into Process_Q type " << type << " level " << level << " status " << status << " priority " << priority << " seqnum " << seqnum << " is_block_tx " << is_block_tx << " callback_id " << callback_id << " bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
 
 		smartobj.IncRef();
+
+		g_memaccount.Add(ProcessQMemTag(type), smartobj);
 	}
 
 	if (changes != 1)
@@ -338,18 +483,36 @@ int DbConnProcessQ::ProcessQGetNextValidateObj(unsigned type, SmartBuf *retobj,
 		return -1;
 	}
 
-	if (sqlite3_data_count(Process_Q_select_next[type]) != 4)
+	if (sqlite3_data_count(Process_Q_select_next[type]) != 7)
 	{
 		BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQGetNextValidateObj select returned " << sqlite3_data_count(Process_Q_select_next[type]) << " columns";
 
 		return -1;
 	}
 
-	// Level, ConnId, CallbackId, Bufp
+	// Level, ConnId, CallbackId, Bufp, PriorOid, Priority, Seqnum
 	auto level = sqlite3_column_int64(Process_Q_select_next[type], 0);
 	conn_index = sqlite3_column_int(Process_Q_select_next[type], 1);
 	callback_id = sqlite3_column_int(Process_Q_select_next[type], 2);
 	auto bufp_blob = sqlite3_column_blob(Process_Q_select_next[type], 3);
+	auto prior_oid_blob = sqlite3_column_blob(Process_Q_select_next[type], 4);
+
+	ProcessQHeldObj held;
+
+	if (prior_oid_blob)
+	{
+		if (sqlite3_column_bytes(Process_Q_select_next[type], 4) != sizeof(ccoid_t))
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQGetNextValidateObj PriorOid size " << sqlite3_column_bytes(Process_Q_select_next[type], 4) << " != " << sizeof(ccoid_t);
+
+			return -1;
+		}
+
+		memcpy(&held.prior_oid, prior_oid_blob, sizeof(ccoid_t));
+		held.level = level;
+		held.priority = sqlite3_column_int(Process_Q_select_next[type], 5);
+		held.seqnum = sqlite3_column_int64(Process_Q_select_next[type], 6);
+	}
 
 	if (RandTest(RTEST_DB_ERRORS))
 	{
@@ -414,6 +577,16 @@ int DbConnProcessQ::ProcessQGetNextValidateObj(unsigned type, SmartBuf *retobj,
 		return -1;
 	}
 
+	if (prior_oid_blob)
+	{
+		// the object stays on HOLD if its prior object is not yet valid, so add it to the dependency graph now;
+		// if the prior object becomes valid while this object is being processed, the release will still find it
+
+		held.hold_ticks = ccticks();
+
+		ProcessQHeldInsert(type, *obj->OidPtr(), held);
+	}
+
 	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnProcessQ::ProcessQGetNextValidateObj type " << type << " result " << result;
 
 	if (!result)
@@ -439,12 +612,68 @@ int DbConnProcessQ::ProcessQUpdateSubsequentBlockStatus(unsigned type, const cco
 
 	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnProcessQ::ProcessQUpdateSubsequentBlockStatus type " << type << " oid " << buf2hex(&oid, CC_OID_TRACE_SIZE);
 
-	// ObjId
-	if (dblog(sqlite3_bind_blob(Process_Q_update_priorobj[type], 1, &oid, sizeof(ccoid_t), SQLITE_STATIC))) return -1;
+	// remove the direct dependents of oid from the graph and release them in the same order ProcessQGetNextValidateObj picks objects
 
-	if (dblog(sqlite3_step(Process_Q_update_priorobj[type]), DB_STMT_STEP)) return -1;
+	auto& held = Process_Q_held[type];
+	auto& held_children = Process_Q_held_children[type];
 
-	changes = sqlite3_changes(Process_Q_db[type]);
+	auto range = held_children.equal_range(oid);
+
+	vector<pair<ccoid_t, ProcessQHeldObj>> children;
+
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		auto entry = held.find(it->second);
+		CCASSERT(entry != held.end());
+
+		children.emplace_back(*entry);
+
+		held.erase(entry);
+	}
+
+	held_children.erase(range.first, range.second);
+
+	sort(children.begin(), children.end(), [](const pair<ccoid_t, ProcessQHeldObj>& a, const pair<ccoid_t, ProcessQHeldObj>& b)
+	{
+		if (a.second.priority != b.second.priority)
+			return a.second.priority < b.second.priority;
+		if (a.second.level != b.second.level)
+			return a.second.level > b.second.level;
+		return a.second.seqnum < b.second.seqnum;
+	});
+
+	auto& stats = Process_Q_hold_stats[type];
+	auto now = ccticks();
+
+	for (auto& child : children)
+	{
+		// ObjId
+		if (dblog(sqlite3_bind_blob(Process_Q_update_priorobj[type], 1, &child.first, sizeof(ccoid_t), SQLITE_STATIC))) return -1;
+
+		if (dblog(sqlite3_step(Process_Q_update_priorobj[type]), DB_STMT_STEP)) return -1;
+
+		auto released = sqlite3_changes(Process_Q_db[type]);
+
+		sqlite3_reset(Process_Q_update_priorobj[type]);
+
+		if (!released)
+			continue;
+
+		changes += released;
+
+		uint32_t elapsed = max(ccticks_elapsed(child.second.hold_ticks, now), 0);
+
+		++stats.nreleased;
+		stats.release_ticks_total += elapsed;
+		stats.release_ticks_max = max(stats.release_ticks_max, elapsed);
+	}
+
+	if (ccticks_elapsed(stats.last_log_ticks, now) >= PROCESS_Q_HOLD_LOG_INTERVAL * CCTICKS_PER_SEC)
+	{
+		stats.last_log_ticks = now;
+
+		BOOST_LOG_TRIVIAL(info) << "DbConnProcessQ::ProcessQUpdateSubsequentBlockStatus hold stats " << ProcessQHoldStatsString(type);
+	}
 
 	} // unlock db
 
@@ -481,6 +710,9 @@ int DbConnProcessQ::ProcessQUpdateObj(unsigned type, const ccoid_t& oid, int sta
 		return -1;
 	}
 
+	if (status != PROCESS_Q_STATUS_HOLD)
+		ProcessQHeldRemove(type, oid);
+
 	return 0;
 }
 
@@ -601,14 +833,14 @@ int DbConnProcessQ::ProcessQGetNextValidObj(unsigned type, unsigned offset, Smar
 		return -1;
 	}
 
-	if (sqlite3_data_count(Process_Q_select_next[type]) != 4)
+	if (sqlite3_data_count(Process_Q_select_next[type]) != 7)
 	{
 		BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQGetNextValidObj select returned " << sqlite3_data_count(Process_Q_select_next[type]) << " columns";
 
 		return -1;
 	}
 
-	// Level, ConnId, CallbackId, Bufp
+	// Level, ConnId, CallbackId, Bufp, PriorOid, Priority, Seqnum
 	auto bufp_blob = sqlite3_column_blob(Process_Q_select_next[type], 3);
 
 	if (RandTest(RTEST_DB_ERRORS))
@@ -661,6 +893,82 @@ int DbConnProcessQ::ProcessQGetNextValidObj(unsigned type, unsigned offset, Smar
 	return 0;
 }
 
+// returns all valid objects in one pass, in the same order as ProcessQGetNextValidObj
+int DbConnProcessQ::ProcessQGetValidObjs(unsigned type, vector<SmartBuf>& objs)
+{
+	lock_guard<mutex> lock(Process_Q_db_mutex[type]);	// sql statements must be reset before lock is released
+	Finally finally(boost::bind(&DbConnProcessQ::DoProcessQFinish, this, type));
+
+	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnProcessQ::ProcessQGetValidObjs type " << type;
+
+	objs.clear();
+
+	while (true)
+	{
+		int rc;
+
+		if (dblog(rc = sqlite3_step(Process_Q_select_valid[type]), DB_STMT_SELECT)) return -1;
+
+		if (RandTest(RTEST_DB_ERRORS))
+		{
+			BOOST_LOG_TRIVIAL(info) << "DbConnProcessQ::ProcessQGetValidObjs simulating database error post-select";
+
+			return -1;
+		}
+
+		if (dbresult(rc) == SQLITE_DONE)
+			break;
+
+		if (dbresult(rc) != SQLITE_ROW)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQGetValidObjs select returned " << rc;
+
+			return -1;
+		}
+
+		if (sqlite3_data_count(Process_Q_select_valid[type]) != 1)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQGetValidObjs select returned " << sqlite3_data_count(Process_Q_select_valid[type]) << " columns";
+
+			return -1;
+		}
+
+		// Bufp
+		auto bufp_blob = sqlite3_column_blob(Process_Q_select_valid[type], 0);
+
+		if (!bufp_blob)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQGetValidObjs bufp_blob is null";
+
+			return -1;
+		}
+
+		if (sqlite3_column_bytes(Process_Q_select_valid[type], 0) != sizeof(void*))
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQGetValidObjs Bufp size " << sqlite3_column_bytes(Process_Q_select_valid[type], 0) << " != " << sizeof(void*);
+
+			return -1;
+		}
+
+		void *bufp = *(void**)bufp_blob;
+
+		if (!bufp)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQGetValidObjs bufp is null";
+
+			return -1;
+		}
+
+		objs.push_back(SmartBuf(bufp));
+	}
+
+	if (dblog(sqlite3_extended_errcode(Process_Q_db[type]), DB_STMT_SELECT)) return -1;	// check if error retrieving results
+
+	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnProcessQ::ProcessQGetValidObjs type " << type << " returning " << objs.size() << " objects";
+
+	return 0;
+}
+
 int DbConnProcessQ::ProcessQDone(unsigned type, int64_t level)
 {
 	lock_guard<mutex> lock(Process_Q_db_mutex[type]);	// sql statements must be reset before lock is released
@@ -675,6 +983,8 @@ int DbConnProcessQ::ProcessQDone(unsigned type, int64_t level)
 
 	auto changes = sqlite3_changes64(Process_Q_db[type]);
 
+	ProcessQHeldRemoveLevel(type, level);	// done objects are no longer on HOLD
+
 	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnProcessQ::ProcessQDone type " << type << " changes " << changes;
 
 	return 0;
@@ -687,6 +997,8 @@ int DbConnProcessQ::ProcessQPruneLevel(unsigned type, int64_t level)
 
 	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(debug) << "DbConnProcessQ::ProcessQPruneLevel type " << type << " level " << level;
 
+	ProcessQHeldRemoveLevel(type, level);
+
 	// Level <
 	if (dblog(sqlite3_bind_int64(Process_Q_select_level[type], 1, level))) return -1;
 
@@ -813,6 +1125,8 @@ int DbConnProcessQ::ProcessQPruneLevel(unsigned type, int64_t level)
 		{
 			if (TRACE_DBCONN | TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "DbConnProcessQ::ProcessQPruneLevel DecRef bufp " << (uintptr_t)smartobj.BasePtr() << " oid " << buf2hex(&oid, CC_OID_TRACE_SIZE);
 
+			g_memaccount.Sub(ProcessQMemTag(type), smartobj);
+
 			smartobj.DecRef();		// it's now deleted from the db
 		}
 
@@ -944,11 +1258,114 @@ int DbConnProcessQ::ProcessQSelectAndDelete(unsigned type, const ccoid_t& oid, u
 		return -1;
 	}
 
+	ProcessQHeldRemove(type, oid);
+
 	if (TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "DbConnProcessQ::ProcessQSelectAndDelete DecRef bufp " << (uintptr_t)smartobj.BasePtr() << " oid " << buf2hex(&oid, CC_OID_TRACE_SIZE);
 
+	g_memaccount.Sub(ProcessQMemTag(type), smartobj);
+
 	smartobj.DecRef();		// it's now deleted from the db
 
 	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnProcessQ::ProcessQSelectAndDelete type " << type << " oid " << buf2hex(&oid, CC_OID_TRACE_SIZE) << " block_tx_count " << block_tx_count << " conn_index " << conn_index << " callback_id " << callback_id;
 
 	return 0;
 }
+
+// deletes a batch of entries that are valid and done while holding the db lock once; entries with any other status are skipped
+
+int DbConnProcessQ::ProcessQDeleteDoneObjs(unsigned type, const vector<ccoid_t>& oids)
+{
+	lock_guard<mutex> lock(Process_Q_db_mutex[type]);	// sql statements must be reset before lock is released
+	Finally finally(boost::bind(&DbConnProcessQ::DoProcessQFinish, this, type));
+
+	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnProcessQ::ProcessQDeleteDoneObjs type " << type << " count " << oids.size();
+
+	if (RandTest(RTEST_DB_ERRORS))
+	{
+		BOOST_LOG_TRIVIAL(info) << "DbConnProcessQ::ProcessQDeleteDoneObjs simulating database error pre-select";
+
+		return -1;
+	}
+
+	unsigned ndeleted = 0;
+
+	for (auto& oid : oids)
+	{
+		int rc;
+
+		if (dblog(sqlite3_bind_blob(Process_Q_select_done[type], 1, &oid, sizeof(ccoid_t), SQLITE_STATIC))) return -1;
+
+		if (dblog(rc = sqlite3_step(Process_Q_select_done[type]), DB_STMT_SELECT)) return -1;
+
+		if (dbresult(rc) == SQLITE_DONE)
+		{
+			sqlite3_reset(Process_Q_select_done[type]);
+
+			continue;	// not in the queue, or not done
+		}
+
+		if (dbresult(rc) != SQLITE_ROW)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQDeleteDoneObjs select returned " << rc;
+
+			return -1;
+		}
+
+		auto bufp_blob = sqlite3_column_blob(Process_Q_select_done[type], 0);
+		void *bufp = NULL;
+
+		if (!bufp_blob)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQDeleteDoneObjs bufp_blob is null";
+		}
+		else if (sqlite3_column_bytes(Process_Q_select_done[type], 0) != sizeof(void*))
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQDeleteDoneObjs Bufp size " << sqlite3_column_bytes(Process_Q_select_done[type], 0) << " != " << sizeof(void*);
+		}
+		else
+			bufp = *(void**)bufp_blob;
+
+		if (dblog(sqlite3_extended_errcode(Process_Q_db[type]), DB_STMT_SELECT)) return -1;	// check if error retrieving results
+
+		sqlite3_reset(Process_Q_select_done[type]);
+
+		SmartBuf smartobj;
+
+		if (bufp)
+		{
+			smartobj.SetBasePtr(bufp);
+			auto obj = (CCObject*)smartobj.data();
+			CCASSERT(obj);
+
+			if (memcmp(obj->OidPtr(), &oid, sizeof(ccoid_t)))
+			{
+				BOOST_LOG_TRIVIAL(error) << "DbConnProcessQ::ProcessQDeleteDoneObjs ObjId mismatch";
+
+				smartobj.ClearRef();
+			}
+		}
+
+		// DELETE entry from processing queue
+
+		if (dblog(sqlite3_bind_blob(Process_Q_delete[type], 1, &oid, sizeof(ccoid_t), SQLITE_STATIC))) return -1;
+
+		if (dblog(sqlite3_step(Process_Q_delete[type]), DB_STMT_STEP)) return -1;
+
+		sqlite3_reset(Process_Q_delete[type]);
+
+		++ndeleted;
+
+		if (smartobj)
+		{
+			if (TRACE_DBCONN | TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "DbConnProcessQ::ProcessQDeleteDoneObjs DecRef bufp " << (uintptr_t)smartobj.BasePtr() << " oid " << buf2hex(&oid, CC_OID_TRACE_SIZE);
+
+			g_memaccount.Sub(ProcessQMemTag(type), smartobj);
+
+			smartobj.DecRef();		// it's now deleted from the db
+		}
+	}
+
+	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnProcessQ::ProcessQDeleteDoneObjs type " << type << " deleted " << ndeleted;
+
+	return 0;
+}
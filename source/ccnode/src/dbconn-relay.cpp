@@ -10,6 +10,7 @@
 #include "dbconn.hpp"
 #include "seqnum.hpp"
 #include "witness.hpp"
+#include "expire.hpp"
 
 #include <dblog.h>
 #include <CCobjects.hpp>
@@ -212,6 +213,8 @@ void DbConnRelayObjs::RelayObjsInsert(unsigned peer, unsigned type, const relay_
 
 		if (dblog(sqlite3_step(Relay_Objs_insert), DB_STMT_STEP)) return;
 
+		g_expire.Register(false, seqnum, ticks);
+
 		if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnRelayObjs::RelayObjsInsert adding new seqnum " << seqnum << " for obj tag type " << type << " announced " << ticks;
 	}
 	else
@@ -672,6 +675,54 @@ int DbConnRelayObjs::RelayObjsDeleteSeqnum(int64_t seqnum)
 	return 0;
 }
 
+// deletes a batch of seqnums in a single transaction
+
+int DbConnRelayObjs::RelayObjsDeleteSeqnums(const vector<int64_t>& seqnums)
+{
+	lock_guard<mutex> lock(Relay_Objs_db_mutex);	// sql statements must be reset before lock is released
+	Finally finally(boost::bind(&DbConnRelayObjs::DoRelayObjsFinish, this, 1));		// 1 = rollback
+
+	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnRelayObjs::RelayObjsDeleteSeqnums count " << seqnums.size();
+
+	// BEGIN
+
+	if (dblog(sqlite3_step(Relay_Objs_begin), DB_STMT_STEP)) return -1;
+
+	for (auto seqnum : seqnums)
+	{
+		// DELETE seqnum from Relay_Peers
+
+		if (dblog(sqlite3_bind_int64(Relay_Peers_delete_seqnum, 1, seqnum))) return -1;
+
+		if (dblog(sqlite3_step(Relay_Peers_delete_seqnum), DB_STMT_STEP)) return -1;
+
+		sqlite3_reset(Relay_Peers_delete_seqnum);
+
+		// DELETE seqnum from Relay_Objs
+
+		if (dblog(sqlite3_bind_int64(Relay_Objs_delete_seqnum, 1, seqnum))) return -1;
+
+		if (dblog(sqlite3_step(Relay_Objs_delete_seqnum), DB_STMT_STEP)) return -1;
+
+		sqlite3_reset(Relay_Objs_delete_seqnum);
+	}
+
+	if (RandTest(RTEST_DB_ERRORS))
+	{
+		BOOST_LOG_TRIVIAL(info) << "DbConnRelayObjs::RelayObjsDeleteSeqnums simulating database error pre-commit";
+
+		return -1;
+	}
+
+	if (dblog(sqlite3_step(Relay_Objs_commit), DB_STMT_STEP)) return -1;
+
+	DoRelayObjsFinish(0);	// don't rollback
+
+	finally.Clear();
+
+	return 0;
+}
+
 int DbConnRelayObjs::RelayObjsGetExpires(int64_t min_seqnum, int64_t max_seqnum, int64_t& next_expires_seqnum, ccoid_t& oid, uint32_t& next_expires_t0)
 {
 	lock_guard<mutex> lock(Relay_Objs_db_mutex);	// sql statements must be reset before lock is released
@@ -11,6 +11,8 @@
 #include "seqnum.hpp"
 #include "block.hpp"
 #include "witness.hpp"
+#include "expire.hpp"
+#include "memaccount.hpp"
 
 #include <dblog.h>
 #include <CCobjects.hpp>
@@ -123,9 +125,11 @@ int DbConnValidObjs::ValidObjsInsert(SmartBuf smartobj, int64_t* pseqnum)
 			seqnum = 0;
 	}
 
+	auto ticks = ccticks();
+
 	// Seqnum, Time, ObjId, Bufp
 	if (dblog(sqlite3_bind_int64(Valid_Objs_insert, 1, seqnum))) return -1;
-	if (dblog(sqlite3_bind_int(Valid_Objs_insert, 2, ccticks()))) return -1;
+	if (dblog(sqlite3_bind_int(Valid_Objs_insert, 2, ticks))) return -1;
 	if (dblog(sqlite3_bind_blob(Valid_Objs_insert, 3, obj->OidPtr(), sizeof(ccoid_t), SQLITE_STATIC))) return -1;
 	if (dblog(sqlite3_bind_blob(Valid_Objs_insert, 4, &bufp, sizeof(bufp), SQLITE_STATIC))) return -1;
 
@@ -153,6 +157,10 @@ int DbConnValidObjs::ValidObjsInsert(SmartBuf smartobj, int64_t* pseqnum)
 		if (TRACE_DBCONN || TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "DbConnValidObjs::ValidObjsInsert inserted seqnum " << seqnum << " bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
 
 		smartobj.IncRef();
+
+		g_memaccount.Add(MEMTAG_VALID_OBJS, smartobj);
+
+		g_expire.Register(true, seqnum, ticks, Expire::SkipsExpireAge(smartobj));
 	}
 
 	if (changes != 1)
@@ -523,6 +531,10 @@ int DbConnValidObjs::ValidObjsDeleteObj(SmartBuf smartobj)
 	{
 		if (TRACE_DBCONN || TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "DbConnValidObjs::ValidObjsDeleteObj deleted bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
 
+		g_memaccount.Sub(MEMTAG_VALID_OBJS, smartobj);
+
+		g_witness.NotifyValidObjDeleted(smartobj);
+
 		smartobj.DecRef();		// it's now deleted from the db
 	}
 
@@ -538,6 +550,53 @@ int DbConnValidObjs::ValidObjsDeleteObj(SmartBuf smartobj)
 	return 0;
 }
 
+// deletes a batch of objects while holding the db lock once; objects not in the db are skipped
+
+int DbConnValidObjs::ValidObjsDeleteObjs(vector<SmartBuf>& smartobjs)
+{
+	//lock_guard<boost::shared_mutex> lock(Valid_Objs_db_mutex);	// sql statements must be reset before lock is released
+	lock_guard<mutex> lock(Valid_Objs_db_mutex);				// sql statements must be reset before lock is released
+	Finally finally(boost::bind(&DbConnValidObjs::DoValidObjsFinish, this));
+
+	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnValidObjs::ValidObjsDeleteObjs count " << smartobjs.size();
+
+	if (RandTest(RTEST_DB_ERRORS))
+	{
+		BOOST_LOG_TRIVIAL(info) << "DbConnValidObjs::ValidObjsDeleteObjs simulating database error pre-delete";
+
+		return -1;
+	}
+
+	for (auto& smartobj : smartobjs)
+	{
+		auto bufp = smartobj.BasePtr();
+		auto obj = (CCObject*)smartobj.data();
+
+		if (dblog(sqlite3_bind_blob(Valid_Objs_delete_obj, 1, obj->OidPtr(), sizeof(ccoid_t), SQLITE_STATIC))) return -1;
+
+		if (dblog(sqlite3_step(Valid_Objs_delete_obj), DB_STMT_STEP)) return -1;
+
+		auto changes = sqlite3_changes(Valid_Objs_db);
+
+		sqlite3_reset(Valid_Objs_delete_obj);
+
+		if (changes)
+		{
+			if (TRACE_DBCONN || TRACE_SMARTBUF) BOOST_LOG_TRIVIAL(debug) << "DbConnValidObjs::ValidObjsDeleteObjs deleted bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
+
+			g_memaccount.Sub(MEMTAG_VALID_OBJS, smartobj);
+
+			g_witness.NotifyValidObjDeleted(smartobj);
+
+			smartobj.DecRef();		// it's now deleted from the db
+		}
+		else if (TRACE_DBCONN)
+			BOOST_LOG_TRIVIAL(debug) << "DbConnValidObjs::ValidObjsDeleteObjs obj already deleted bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
+	}
+
+	return 0;
+}
+
 int DbConnValidObjs::ValidObjsDeleteSeqnum(int64_t seqnum)
 {
 	// Note: this function does not DefRef the smartobj in the Valid_Objs_db, leading to a memory leak.
@@ -680,3 +739,60 @@ int DbConnValidObjs::ValidObjsGetExpires(int64_t min_seqnum, int64_t max_seqnum,
 
 	return 0;
 }
+
+// looks up a batch of objects by seqnum while holding the db lock once
+// retobjs is returned with one entry per seqnum, which is empty if the seqnum is not in the db
+
+int DbConnValidObjs::ValidObjsGetSeqnums(const vector<int64_t>& seqnums, vector<SmartBuf>& retobjs)
+{
+	//boost::shared_lock<boost::shared_mutex> lock(Valid_Objs_db_mutex);	// sql statements must be reset before lock is released
+	lock_guard<mutex> lock(Valid_Objs_db_mutex);						// sql statements must be reset before lock is released
+	Finally finally(boost::bind(&DbConnValidObjs::DoValidObjsFinish, this));
+
+	if (TRACE_DBCONN) BOOST_LOG_TRIVIAL(trace) << "DbConnValidObjs::ValidObjsGetSeqnums count " << seqnums.size();
+
+	retobjs.clear();
+	retobjs.resize(seqnums.size());
+
+	for (unsigned i = 0; i < seqnums.size(); ++i)
+	{
+		int rc;
+
+		// min, max, limit
+		if (dblog(sqlite3_bind_int64(Valid_Objs_select_seqnums, 1, seqnums[i]))) return -1;
+		if (dblog(sqlite3_bind_int64(Valid_Objs_select_seqnums, 2, seqnums[i]))) return -1;
+		if (dblog(sqlite3_bind_int64(Valid_Objs_select_seqnums, 3, 1))) return -1;
+
+		if (dblog(rc = sqlite3_step(Valid_Objs_select_seqnums), DB_STMT_SELECT)) return -1;
+
+		if (dbresult(rc) == SQLITE_ROW && sqlite3_data_count(Valid_Objs_select_seqnums) == 4)
+		{
+			// Seqnum, Time, ObjId, Bufp
+			auto bufp_blob = sqlite3_column_blob(Valid_Objs_select_seqnums, 3);
+
+			if (bufp_blob && sqlite3_column_bytes(Valid_Objs_select_seqnums, 3) == sizeof(void*) && *(void**)bufp_blob)
+				retobjs[i].SetBasePtr(*(void**)bufp_blob);
+			else
+				BOOST_LOG_TRIVIAL(error) << "DbConnValidObjs::ValidObjsGetSeqnums invalid Bufp for seqnum " << seqnums[i];
+		}
+		else if (dbresult(rc) != SQLITE_DONE)
+		{
+			BOOST_LOG_TRIVIAL(error) << "DbConnValidObjs::ValidObjsGetSeqnums select returned " << rc << " columns " << sqlite3_data_count(Valid_Objs_select_seqnums);
+
+			return -1;
+		}
+
+		if (dblog(sqlite3_extended_errcode(Valid_Objs_db), DB_STMT_SELECT)) return -1;	// check if error retrieving results
+
+		sqlite3_reset(Valid_Objs_select_seqnums);
+	}
+
+	if (RandTest(RTEST_DB_ERRORS))
+	{
+		BOOST_LOG_TRIVIAL(info) << "DbConnValidObjs::ValidObjsGetSeqnums simulating database error post-select";
+
+		return -1;
+	}
+
+	return 0;
+}
@@ -13,6 +13,7 @@
 
 #include <dblog.h>
 #include <CCobjects.hpp>
+#include <CCthread.hpp>
 
 #define TRACE_DBCONN	(g_params.trace_wal_db)
 
@@ -128,6 +129,8 @@ void WalDB::WalCheckpoint(sqlite3 *db)
 
 void WalDB::WalCheckpointThreadProc(sqlite3 *db)
 {
+	CCThreadRoles::Apply("wal");
+
 	BOOST_LOG_TRIVIAL(info) << "WalDB::WalCheckpointThreadProc " << dbname << " start";
 
 	while (!stop_checkpointing.load() && !g_blockchain.HasFatalError() && !g_shutdown)
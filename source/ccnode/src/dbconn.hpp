@@ -221,6 +221,7 @@ class DbConnPersistData : protected DbConnBasePersistData
 	sqlite3_stmt *Blockchain_insert;
 	sqlite3_stmt *Blockchain_select_max;
 	sqlite3_stmt *Blockchain_select;
+	sqlite3_stmt *Blockchain_select_range;
 	sqlite3_stmt *Serialnum_insert;
 	sqlite3_stmt *Serialnum_select;
 	sqlite3_stmt *Commit_Tree_insert;
@@ -276,6 +277,7 @@ public:
 	int ParameterSelect(int key, int subkey, void *value, unsigned bufsize, bool add_terminator = false, unsigned *retsize = NULL);
 	int BlockchainInsert(uint64_t level, SmartBuf smartobj);
 	int BlockchainSelect(uint64_t level, SmartBuf *retobj);
+	int BlockchainSelectRange(uint64_t level, unsigned maxlevels, unsigned maxbytes, vector<SmartBuf>& retobjs, unsigned *retbytes = NULL);
 	int BlockchainSelectMax(uint64_t& level);
 	int SerialnumInsert(const void *serialnum, unsigned serialnum_size, const void *hashkey, unsigned hashkey_size, uint64_t tx_commitnum);
 	int SerialnumSelect(const void *serialnum, unsigned serialnum_size, void *hashkey = NULL, unsigned *hashkey_size = NULL, uint64_t *tx_commitnum = NULL);
@@ -382,6 +384,7 @@ public:
 	int RelayObjsDeletePeer(unsigned peer);
 
 	int RelayObjsDeleteSeqnum(int64_t seqnum);
+	int RelayObjsDeleteSeqnums(const vector<int64_t>& seqnums);
 	int RelayObjsGetExpires(int64_t min_seqnum, int64_t max_seqnum, int64_t& next_expires_seqnum, ccoid_t& oid, uint32_t& next_expires_t0);
 };
 
@@ -393,16 +396,18 @@ class DbConnProcessQ : protected DbConnBaseProcessQ
 	sqlite3_stmt *Process_Q_select_next[PROCESS_Q_N];
 	sqlite3_stmt *Process_Q_update[PROCESS_Q_N];
 	sqlite3_stmt *Process_Q_update_priorobj[PROCESS_Q_N];
+	sqlite3_stmt *Process_Q_select_valid[PROCESS_Q_N];
 	sqlite3_stmt *Process_Q_clear[PROCESS_Q_N];
 	sqlite3_stmt *Process_Q_count[PROCESS_Q_N];
 	sqlite3_stmt *Process_Q_randomize[PROCESS_Q_N];
 	sqlite3_stmt *Process_Q_done[PROCESS_Q_N];
 	sqlite3_stmt *Process_Q_select_level[PROCESS_Q_N];
 	sqlite3_stmt *Process_Q_delete[PROCESS_Q_N];
+	sqlite3_stmt *Process_Q_select_done[PROCESS_Q_N];
 
 	void ClearDbPointers()
 	{
-		CLEAR_DB_POINTERS(Process_Q_insert, Process_Q_delete);
+		CLEAR_DB_POINTERS(Process_Q_insert, Process_Q_select_done);
 	};
 
 public:
@@ -413,6 +418,7 @@ public:
 	static void IncrementQueuedWork(unsigned type, unsigned changes);
 	static void WaitForQueuedWork(unsigned type);
 	static void StopQueuedWork(unsigned type);
+	static void LogHoldStats(unsigned type);
 
 	int ProcessQEnqueueValidate(unsigned type, SmartBuf smartobj, const ccoid_t *prior_oid, int64_t level, unsigned status, Process_Q_Priority priority, bool is_block_tx, unsigned conn_index, uint32_t callback_id);
 	int ProcessQGetNextValidateObj(unsigned type, SmartBuf *retobj, unsigned& conn_index, uint32_t& callback_id);
@@ -423,10 +429,12 @@ public:
 	int ProcessQCountValidObjs(unsigned type, int64_t auxint);
 	int ProcessQRandomizeValidObjs(unsigned type);
 	int ProcessQGetNextValidObj(unsigned type, unsigned offset, SmartBuf *retobj);
+	int ProcessQGetValidObjs(unsigned type, vector<SmartBuf>& objs);
 
 	int ProcessQDone(unsigned type, int64_t level);
 	int ProcessQPruneLevel(unsigned type, int64_t level);
 	int ProcessQSelectAndDelete(unsigned type, const ccoid_t& oid, unsigned& block_tx_count, unsigned& conn_index, uint32_t& callback_id);
+	int ProcessQDeleteDoneObjs(unsigned type, const vector<ccoid_t>& oids);
 };
 
 class DbConnValidObjs : protected DbConnBaseValidObjs
@@ -458,7 +466,9 @@ public:
 	unsigned ValidObjsFindNew(int64_t& next_seqnum, int64_t max_seqnum, unsigned limit, bool want_msgs, uint8_t *output, unsigned bufsize);
 
 	int ValidObjsDeleteObj(SmartBuf smartobj);
+	int ValidObjsDeleteObjs(vector<SmartBuf>& smartobjs);
 	int ValidObjsDeleteSeqnum(int64_t seqnum);
+	int ValidObjsGetSeqnums(const vector<int64_t>& seqnums, vector<SmartBuf>& retobjs);
 	int ValidObjsGetExpires(int64_t min_seqnum, int64_t max_seqnum, int64_t& next_expires_seqnum, SmartBuf *retobj, uint32_t& next_expires_t0);
 };
 
@@ -14,6 +14,7 @@
 #include "witness.hpp"
 
 #include <CCmint.h>
+#include <CCthread.hpp>
 #include <transaction.h>
 
 #define TRACE_EXPIRE	(g_params.trace_expire)
@@ -36,18 +37,89 @@ static const int32_t valid_tx_expire_age = 12*60*CCTICKS_PER_SEC;
 //static const int32_t valid_tx_expire_age = 0*CCTICKS_PER_SEC;			// for testing
 //static const int32_t valid_tx_expire_age = 60*60*CCTICKS_PER_SEC;		// for testing
 
+#define MEMORY_PRESSURE_EXPIRE_AGE	(3*60*CCTICKS_PER_SEC)
+
+#define EXPIRE_RETRY_SECS		10		// after a db error
+#define EXPIRE_MINT_RETRY_SECS	2		// wait for new indelible level
+#define EXPIRE_BLOCK_RETRY_SECS	10		// wait for blockchain to advance
+#define EXPIRE_BATCH_MAX		500		// max objects deleted while holding a db lock
+#define EXPIRE_LOG_INTERVAL		(10*60)	// seconds
+
 Expire g_expire;
 
 class RelayObjsExpire : public ExpireObj
 {
-	int GetExpires(int64_t& seqnum, SmartBuf *retobj, ccoid_t& oid, uint32_t& next_expires_t0)
+	vector<int64_t> m_deletes;
+	vector<unsigned> m_delete_index;
+
+	int GetExpires(DbConn *dbconn, int64_t min_seqnum, int64_t& seqnum, uint32_t& t0, bool& no_age)
 	{
-		return m_dbconn->RelayObjsGetExpires(m_min_seqnum, m_max_seqnum, seqnum, oid, next_expires_t0);
+		ccoid_t oid;
+
+		no_age = false;
+
+		return dbconn->RelayObjsGetExpires(min_seqnum, m_max_seqnum, seqnum, oid, t0);
 	}
 
-	int DeleteExpires(int64_t& seqnum, SmartBuf smartobj)
+	void DoExpires(DbConn *dbconn, vector<ExpireEntry>& entries)
 	{
-		return m_dbconn->RelayObjsDeleteSeqnum(seqnum);
+		bool has_blocks = HasSeqnum(g_seqnum[BLOCKSEQ][RELAYSEQ].seqmin);
+
+		m_deletes.clear();
+		m_delete_index.clear();
+
+		for (unsigned i = 0; i < entries.size(); ++i)
+		{
+			auto& entry = entries[i];
+
+			if (has_blocks)
+			{
+				// when expiring a block, we need the obj to get its level
+
+				int64_t seqnum = 0;
+				ccoid_t oid;
+				uint32_t t0;
+
+				memset((void*)&oid, 0, sizeof(oid));
+
+				auto rc = dbconn->RelayObjsGetExpires(entry.seqnum, entry.seqnum, seqnum, oid, t0);
+
+				if (rc > 0)
+					continue;	// already deleted
+
+				if (rc)
+				{
+					entry.retry_secs = EXPIRE_RETRY_SECS;
+
+					continue;
+				}
+
+				SmartBuf smartobj;
+
+				dbconn->ValidObjsGetObj(oid, &smartobj);
+
+				entry.retry_secs = CheckBlock(smartobj);
+
+				if (entry.retry_secs)
+					continue;
+			}
+
+			m_deletes.push_back(entry.seqnum);
+			m_delete_index.push_back(i);
+		}
+
+		if (m_deletes.empty())
+			return;
+
+		auto rc = dbconn->RelayObjsDeleteSeqnums(m_deletes);
+
+		for (auto i : m_delete_index)
+		{
+			if (rc)
+				entries[i].retry_secs = EXPIRE_RETRY_SECS;
+			else
+				entries[i].deleted = true;
+		}
 	}
 
 public:
@@ -58,18 +130,98 @@ public:
 
 class ValidObjsExpire : public ExpireObj
 {
-	int GetExpires(int64_t& seqnum, SmartBuf *retobj, ccoid_t& oid, uint32_t& next_expires_t0)
+	vector<int64_t> m_seqnums;
+	vector<SmartBuf> m_smartobjs;
+	vector<SmartBuf> m_deletes;
+	vector<unsigned> m_delete_index;
+	vector<ccoid_t> m_block_oids;
+
+	int GetExpires(DbConn *dbconn, int64_t min_seqnum, int64_t& seqnum, uint32_t& t0, bool& no_age)
 	{
-		return m_dbconn->ValidObjsGetExpires(m_min_seqnum, m_max_seqnum, seqnum, retobj, next_expires_t0);
+		SmartBuf smartobj;
+
+		auto rc = dbconn->ValidObjsGetExpires(min_seqnum, m_max_seqnum, seqnum, &smartobj, t0);
+
+		no_age = (!rc && Expire::SkipsExpireAge(smartobj));
+
+		return rc;
 	}
 
-	int DeleteExpires(int64_t& seqnum, SmartBuf smartobj)
+	void DoExpires(DbConn *dbconn, vector<ExpireEntry>& entries)
 	{
-		auto rc = m_dbconn->ValidObjsDeleteObj(smartobj);
-		if (!rc)
-			return rc;
+		m_seqnums.clear();
+
+		for (auto& entry : entries)
+			m_seqnums.push_back(entry.seqnum);
 
-		return m_dbconn->ValidObjsDeleteSeqnum(seqnum);	// fallback: attempt to delete obj by seqnum
+		if (dbconn->ValidObjsGetSeqnums(m_seqnums, m_smartobjs))
+		{
+			for (auto& entry : entries)
+				entry.retry_secs = EXPIRE_RETRY_SECS;
+
+			m_smartobjs.clear();
+
+			return;
+		}
+
+		m_deletes.clear();
+		m_delete_index.clear();
+		m_block_oids.clear();
+
+		for (unsigned i = 0; i < entries.size(); ++i)
+		{
+			auto& smartobj = m_smartobjs[i];
+
+			if (!smartobj)
+				continue;	// already deleted
+
+			auto& entry = entries[i];
+
+			entry.retry_secs = CheckMint(smartobj);
+
+			if (!entry.retry_secs)
+				entry.retry_secs = CheckBlock(smartobj);
+
+			if (entry.retry_secs)
+				continue;
+
+			auto obj = (CCObject*)smartobj.data();
+
+			if (obj->ObjType() == CC_TYPE_BLOCK)
+			{
+				((Block*)obj)->SetPriorBlock(SmartBuf());	// break the link so prior block can be freed
+
+				m_block_oids.push_back(*obj->OidPtr());
+			}
+
+			m_deletes.push_back(smartobj);
+			m_delete_index.push_back(i);
+		}
+
+		m_smartobjs.clear();
+
+		if (m_deletes.empty())
+			return;
+
+		auto rc = dbconn->ValidObjsDeleteObjs(m_deletes);
+
+		m_deletes.clear();
+
+		for (auto i : m_delete_index)
+		{
+			if (rc)
+				entries[i].retry_secs = EXPIRE_RETRY_SECS;
+			else
+				entries[i].deleted = true;
+		}
+
+		// an expired block that is done in the process queue is no longer a witness candidate, so its entry is deleted
+		// in the same batch instead of waiting for ProcessQPruneLevel; if this fails, the prune will delete it later
+
+		if (!rc && !m_block_oids.empty() && dbconn->ProcessQDeleteDoneObjs(PROCESS_Q_TYPE_BLOCK, m_block_oids))
+			BOOST_LOG_TRIVIAL(warning) << "ValidObjsExpire::DoExpires " << m_name << " ProcessQDeleteDoneObjs failed";
+
+		m_block_oids.clear();
 	}
 
 public:
@@ -78,17 +230,105 @@ public:
 	{ }
 };
 
-void ExpireObj::Start()
+int32_t ExpireObj::ExpireAge() const
+{
+	int32_t age = m_expire_age;
+
+	if (g_expire.HasMemoryPressure())
+		age = min(age, (int32_t)MEMORY_PRESSURE_EXPIRE_AGE);
+
+	return age;
+}
+
+// returns zero if the object can be expired, or the number of seconds to wait before checking again
+
+unsigned ExpireObj::CheckMint(const SmartBuf& smartobj)
+{
+	auto obj = (CCObject*)smartobj.data();
+
+	if (!obj || obj->ObjType() != CC_TYPE_MINT || !Implement_CCMint(g_params.blockchain))
+		return 0;
+
+	auto param_level = txpay_param_level_from_wire(obj);
+
+	auto block_level = g_blockchain.GetLastIndelibleLevel();
+
+	if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(debug) << "ExpireObj::CheckMint " << m_name << " block level " << block_level << " param_level " << param_level;
+
+	if (block_level >= CC_MINT_COUNT + CC_MINT_ACCEPT_SPAN)
+		return 0;	// expire all mints
+
+	if (!param_level && block_level)
+		return 0;	// expire now
+
+	if (param_level == 1 && block_level && block_level > 2 * CC_MINT_ACCEPT_SPAN)
+		return 0;	// expire now
+
+	if (param_level > 1 && param_level + CC_MINT_ACCEPT_SPAN < block_level)
+		return 0;	// expire now
+
+	return EXPIRE_MINT_RETRY_SECS;
+}
+
+unsigned ExpireObj::CheckBlock(const SmartBuf& smartobj)
 {
+	auto obj = (CCObject*)smartobj.data();
+
+	if (!obj || obj->ObjType() != CC_TYPE_BLOCK)
+		return 0;
+
+	auto prune_level = g_blockchain.ComputePruneLevel(0, BLOCK_PRUNE_ROUNDS + 2 + 2 * m_is_valid_objs);
+
+	auto block = (Block*)obj;
+	auto wire = block->WireData();
+
+	if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(debug) << "ExpireObj::CheckBlock " << m_name << " bufp " << (uintptr_t)smartobj.BasePtr() << " level " << wire->level.GetValue() << " prune level " << prune_level;
+
+	if (wire->level.GetValue() < prune_level)
+		return 0;
+
+	return EXPIRE_BLOCK_RETRY_SECS;
+}
+
+void Expire::Init()
+{
+	if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(trace) << "Expire::Init";
+
+	m_expireobjs.push_back(new ValidObjsExpire("ValidObjs-Blocks", g_seqnum[BLOCKSEQ][VALIDSEQ].seqmin, g_seqnum[BLOCKSEQ][VALIDSEQ].seqmax, valid_block_expire_age, true));
+	m_expireobjs.push_back(new RelayObjsExpire("RelayObjs-Blocks", g_seqnum[BLOCKSEQ][RELAYSEQ].seqmin, g_seqnum[BLOCKSEQ][RELAYSEQ].seqmax, relay_block_expire_age, false));
+
+	m_expireobjs.push_back(new ValidObjsExpire("ValidObjs-Txs", g_seqnum[TXSEQ][VALIDSEQ].seqmin, g_seqnum[TXSEQ][VALIDSEQ].seqmax, valid_tx_expire_age, true));
+	m_expireobjs.push_back(new RelayObjsExpire("RelayObjs-Txs", g_seqnum[TXSEQ][RELAYSEQ].seqmin, g_seqnum[TXSEQ][RELAYSEQ].seqmax, relay_tx_expire_age, false));
+
+	m_expireobjs.push_back(new ValidObjsExpire("ValidObjs-Xreq", g_seqnum[XREQSEQ][VALIDSEQ].seqmin, g_seqnum[XREQSEQ][VALIDSEQ].seqmax, valid_tx_expire_age, true));
+	m_expireobjs.push_back(new RelayObjsExpire("RelayObjs-Xreq", g_seqnum[XREQSEQ][RELAYSEQ].seqmin, g_seqnum[XREQSEQ][RELAYSEQ].seqmax, relay_tx_expire_age, false));
+
 	m_dbconn = new DbConn;
 	CCASSERT(m_dbconn);
 
-	m_thread = new thread(&ExpireObj::ThreadProc, this);
+	m_tick = 0;
+	m_tick_ticks = ccticks();
+
+	{
+		lock_guard<FastSpinLock> lock(m_expire_lock);
+
+		m_accepting = true;
+	}
+
+	m_thread = new thread(&Expire::ThreadProc, this);
 	CCASSERT(m_thread);
 }
 
-void ExpireObj::Stop()
+void Expire::DeInit()
 {
+	if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(trace) << "Expire::DeInit";
+
+	{
+		lock_guard<FastSpinLock> lock(m_expire_lock);
+
+		m_accepting = false;
+	}
+
 	if (m_thread)
 	{
 		m_thread->join();
@@ -96,6 +336,8 @@ void ExpireObj::Stop()
 		delete m_thread;
 
 		m_thread = NULL;
+
+		LogStats();
 	}
 
 	if (m_dbconn)
@@ -104,171 +346,369 @@ void ExpireObj::Stop()
 
 		m_dbconn = NULL;
 	}
+
+	for (unsigned i = 0; i < m_expireobjs.size(); ++i)
+	{
+		auto obj = m_expireobjs[i];
+
+		m_expireobjs[i] = NULL;
+
+		delete obj;
+	}
+
+	if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(trace) << "Expire::DeInit done";
 }
 
-void ExpireObj::ThreadProc()
+bool Expire::SkipsExpireAge(const SmartBuf& smartobj)
 {
-	BOOST_LOG_TRIVIAL(info) << "ExpireObj::ThreadProc " << m_name << " start m_min_seqnum " << m_min_seqnum << " m_max_seqnum " << m_max_seqnum << " m_expire_age " << m_expire_age << " m_dbconn " << (uintptr_t)m_dbconn;
+	auto obj = (CCObject*)smartobj.data();
 
-	while (!g_shutdown)
+	return obj && obj->ObjType() == CC_TYPE_MINT && Implement_CCMint(g_params.blockchain);
+}
+
+void Expire::Register(bool valid_objs, int64_t seqnum, uint32_t t0, bool no_age)
+{
+	lock_guard<FastSpinLock> lock(m_expire_lock);
+
+	if (!m_accepting)
+		return;
+
+	for (unsigned i = 0; i < m_expireobjs.size(); ++i)
 	{
-		DoExpires();
+		auto expireobj = m_expireobjs[i];
 
-		ccsleep(10);
-	}
+		if (expireobj->m_is_valid_objs == valid_objs && expireobj->HasSeqnum(seqnum))
+		{
+			m_registered.push_back({seqnum, 0, t0, (uint16_t)i, 0, false, no_age});
 
-	BOOST_LOG_TRIVIAL(info) << "ExpireObj::ThreadProc " << m_name << " end m_min_seqnum " << m_min_seqnum << " m_max_seqnum " << m_max_seqnum << " m_expire_age " << m_expire_age << " m_dbconn " << (uintptr_t)m_dbconn;
+			return;
+		}
+	}
 }
 
-void ExpireObj::DoExpires()
+void Expire::ThreadProc()
 {
-	int64_t next_expires_seqnum = -1;
-	SmartBuf next_expires_smartobj;
-	ccoid_t oid;
-	uint32_t next_expires_t0;
-	int32_t age;
+	CCThreadRoles::Apply("expire");
+
+	BOOST_LOG_TRIVIAL(info) << "Expire::ThreadProc start wheel levels " << WHEEL_LEVELS << " slots " << WHEEL_SLOTS << " m_dbconn " << (uintptr_t)m_dbconn;
+
+	Seed();
+
+	vector<ExpireEntry> registered;
+	auto log_ticks = ccticks();
 
 	while (!g_shutdown)
 	{
-		next_expires_smartobj.ClearRef();
-		memset((void*)&oid, 0, sizeof(oid));
+		if (ccsleep(1))
+			break;
 
-		GetExpires(next_expires_seqnum, &next_expires_smartobj, oid, next_expires_t0);
-
-		if (next_expires_seqnum == -1)
 		{
-			if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(trace) << "ExpireObj::DoExpires " << m_name << " seqnum " << next_expires_seqnum;
+			lock_guard<FastSpinLock> lock(m_expire_lock);
 
-			return;
+			registered.swap(m_registered);
 		}
 
-		if (!next_expires_smartobj && g_seqnum[BLOCKSEQ][VALIDSEQ].seqmin <= next_expires_seqnum && next_expires_seqnum <= g_seqnum[BLOCKSEQ][VALIDSEQ].seqmax)
+		for (auto& entry : registered)
 		{
-			// when expiring a block, we need the obj to get its level
+			entry.deadline = Deadline(entry, m_tick_ticks);
 
-			m_dbconn->ValidObjsGetObj(oid, &next_expires_smartobj);
+			Place(entry);
 		}
 
-		auto obj = (CCObject*)next_expires_smartobj.data();
-		unsigned objtype = (obj ? obj->ObjType() : 0);
+		registered.clear();
 
-		bool is_ccmint = Implement_CCMint(g_params.blockchain) && objtype == CC_TYPE_MINT;
+		auto now = ccticks();
 
-		while (!is_ccmint)
+		if (m_rebuild.exchange(false))
+			Rebuild();
+
+		while (ccticks_elapsed(m_tick_ticks, now) >= CCTICKS_PER_SEC)
+			Advance();
+
+		ExpireDue(now);
+
+		if (ccticks_elapsed(log_ticks, now) >= EXPIRE_LOG_INTERVAL*CCTICKS_PER_SEC)
 		{
-			age = ccticks_elapsed(next_expires_t0, ccticks());
+			LogStats();
+
+			log_ticks = now;
+		}
+	}
 
-			if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(trace) << "ExpireObj::DoExpires " << m_name << " seqnum " << next_expires_seqnum << " bufp " << (uintptr_t)next_expires_smartobj.BasePtr() << " age " << age << " expire_age " << m_expire_age;
+	BOOST_LOG_TRIVIAL(info) << "Expire::ThreadProc end m_tick " << m_tick;
+}
 
-			if (age >= m_expire_age)
-				break;
+// puts the objects that were inserted into the db before Init on the wheel
+// an object inserted after Init started accepting registrations, but before it was seen here, is also registered, so the
+// registrations made while seeding are placed first, and the seeded objects they cover are skipped
 
-			auto sec = (m_expire_age - age + CCTICKS_PER_SEC/2) / CCTICKS_PER_SEC;
+void Expire::Seed()
+{
+	vector<ExpireEntry> seeded;
 
-			if (sec <= 0)
+	for (unsigned i = 0; i < m_expireobjs.size() && !g_shutdown; ++i)
+	{
+		auto expireobj = m_expireobjs[i];
+
+		int64_t min_seqnum = expireobj->m_min_seqnum;
+		int64_t seqnum = 0;
+
+		while (!g_shutdown)
+		{
+			uint32_t t0;
+			bool no_age;
+
+			auto rc = expireobj->GetExpires(m_dbconn, min_seqnum, seqnum, t0, no_age);
+
+			if (rc > 0)
 				break;
 
-			#if 0
-			if (sec > 10)
+			if (rc)
 			{
-				ccsleep(10);
+				if (ccsleep(1))
+					return;
 
-				return;		// return to recheck object time in case it's changed by another thread during the sleep
+				continue;
 			}
-			#endif
 
-			if (ccsleep(sec))
-				return;
+			seeded.push_back({seqnum, 0, t0, (uint16_t)i, 0, false, no_age});
+
+			if (seqnum >= expireobj->m_max_seqnum)
+				break;
 
+			min_seqnum = seqnum + 1;
 		}
+	}
 
-		while (is_ccmint)
-		{
-			auto param_level = txpay_param_level_from_wire(obj);
+	// Register is called while the db insert lock is held, so every object seen above was registered before this point
 
-			auto block_level = g_blockchain.GetLastIndelibleLevel();
+	vector<ExpireEntry> registered;
 
-			if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(debug) << "ExpireObj::DoExpires " << m_name << " is_ccmint " << is_ccmint << " block level " << block_level << " param_level " << param_level;
+	{
+		lock_guard<FastSpinLock> lock(m_expire_lock);
 
-			if (block_level >= CC_MINT_COUNT + CC_MINT_ACCEPT_SPAN)
-				break;	// expire all mints
+		registered.swap(m_registered);
+	}
 
-			if (!param_level && block_level)
-				break;	// expire now
+	auto entry_less = [](const ExpireEntry& a, const ExpireEntry& b)
+	{
+		return a.queue < b.queue || (a.queue == b.queue && a.seqnum < b.seqnum);
+	};
 
-			if (param_level == 1 && block_level && block_level > 2 * CC_MINT_ACCEPT_SPAN)
-				break;	// expire now
+	sort(registered.begin(), registered.end(), entry_less);
 
-			if (param_level > 1 && param_level + CC_MINT_ACCEPT_SPAN < block_level)
-				break;	// expire now
+	for (auto& entry : registered)
+	{
+		entry.deadline = Deadline(entry, m_tick_ticks);
 
-			if (ccsleep(2))	// wait for new indelible level
-				return;
-		}
+		Place(entry);
+	}
 
-		while (objtype == CC_TYPE_BLOCK)
-		{
-			auto prune_level = g_blockchain.ComputePruneLevel(0, BLOCK_PRUNE_ROUNDS + 2 + 2 * m_is_valid_objs);
+	vector<unsigned> count(m_expireobjs.size());
 
-			auto block = (Block*)obj;
-			auto wire = block->WireData();
+	for (auto& entry : seeded)
+	{
+		if (binary_search(registered.begin(), registered.end(), entry, entry_less))
+			continue;
 
-			if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(debug) << "ExpireObj::DoExpires " << m_name << " block seqnum " << next_expires_seqnum << " bufp " << (uintptr_t)next_expires_smartobj.BasePtr() << " level " << wire->level.GetValue() << " prune level " << prune_level;
+		entry.deadline = Deadline(entry, m_tick_ticks);
 
-			if (wire->level.GetValue() < prune_level)
-			{
-				if (m_is_valid_objs)
-					block->SetPriorBlock(SmartBuf());	// break the link so prior block can be freed
+		Place(entry);
 
-				break;
-			}
+		++count[entry.queue];
+	}
+
+	for (unsigned i = 0; i < m_expireobjs.size(); ++i)
+	{
+		if (TRACE_EXPIRE || count[i]) BOOST_LOG_TRIVIAL(info) << "Expire::Seed " << m_expireobjs[i]->m_name << " objects " << count[i];
+	}
+
+	if (registered.size()) BOOST_LOG_TRIVIAL(info) << "Expire::Seed objects registered while seeding " << registered.size();
+}
 
-			if (ccsleep(10))	// wait for blockchain to advance
-				return;
+uint64_t Expire::Deadline(const ExpireEntry& entry, uint32_t now)
+{
+	if (entry.no_age)
+		return m_tick;
+
+	int32_t remaining = m_expireobjs[entry.queue]->ExpireAge() - ccticks_elapsed(entry.t0, now);
+
+	if (remaining <= 0)
+		return m_tick;
+
+	return m_tick + (remaining + CCTICKS_PER_SEC - 1) / CCTICKS_PER_SEC;
+}
+
+void Expire::Place(const ExpireEntry& entry)
+{
+	if (entry.deadline <= m_tick)
+	{
+		m_due.push_back(entry);
+
+		return;
+	}
+
+	auto delta = entry.deadline - m_tick;
+	auto slot_tick = entry.deadline;
+	unsigned level = 0;
+
+	while (level < WHEEL_LEVELS - 1 && delta >= ((uint64_t)1 << (WHEEL_BITS * (level + 1))))
+		++level;
+
+	if (delta >= ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)))
+		slot_tick = m_tick + ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;	// park in the last slot of the top level
+
+	auto slot = (slot_tick >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+
+	m_wheel[level][slot].push_back(entry);
+}
+
+void Expire::Cascade(unsigned level, unsigned slot)
+{
+	vector<ExpireEntry> entries;
+
+	entries.swap(m_wheel[level][slot]);
+
+	for (auto& entry : entries)
+		Place(entry);
+}
+
+void Expire::Advance()
+{
+	++m_tick;
+	m_tick_ticks += CCTICKS_PER_SEC;
+
+	for (unsigned level = WHEEL_LEVELS - 1; level > 0; --level)
+	{
+		if (!(m_tick & (((uint64_t)1 << (WHEEL_BITS * level)) - 1)))
+			Cascade(level, (m_tick >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+	}
+
+	Cascade(0, m_tick & (WHEEL_SLOTS - 1));
+}
+
+void Expire::Rebuild()
+{
+	vector<ExpireEntry> entries;
+
+	entries.swap(m_due);
+
+	for (auto& level : m_wheel)
+	{
+		for (auto& slot : level)
+		{
+			entries.insert(entries.end(), slot.begin(), slot.end());
+
+			slot.clear();
 		}
+	}
+
+	BOOST_LOG_TRIVIAL(info) << "Expire::Rebuild recomputing expire times of " << entries.size() << " objects; memory pressure " << HasMemoryPressure();
 
-		if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(trace) << "ExpireObj::DoExpires " << m_name << " expiring seqnum " << next_expires_seqnum << " bufp " << (uintptr_t)next_expires_smartobj.BasePtr() << " type " << objtype << " age " << age << " expire_age " << m_expire_age;
+	for (auto& entry : entries)
+	{
+		entry.deadline = Deadline(entry, m_tick_ticks);
 
-		if (DeleteExpires(next_expires_seqnum, next_expires_smartobj))
-			return;	// retry later
+		Place(entry);
 	}
 }
 
-void Expire::Init()
+void Expire::ExpireDue(uint32_t now)
 {
-	if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(trace) << "Expire::Init";
+	if (m_due.empty())
+		return;
 
-	m_expireobjs.push_back(new ValidObjsExpire("ValidObjs-Blocks", g_seqnum[BLOCKSEQ][VALIDSEQ].seqmin, g_seqnum[BLOCKSEQ][VALIDSEQ].seqmax, valid_block_expire_age, true));
-	m_expireobjs.push_back(new RelayObjsExpire("RelayObjs-Blocks", g_seqnum[BLOCKSEQ][RELAYSEQ].seqmin, g_seqnum[BLOCKSEQ][RELAYSEQ].seqmax, relay_block_expire_age, false));
+	vector<ExpireEntry> due, batch;
 
-	m_expireobjs.push_back(new ValidObjsExpire("ValidObjs-Txs", g_seqnum[TXSEQ][VALIDSEQ].seqmin, g_seqnum[TXSEQ][VALIDSEQ].seqmax, valid_tx_expire_age, true));
-	m_expireobjs.push_back(new RelayObjsExpire("RelayObjs-Txs", g_seqnum[TXSEQ][RELAYSEQ].seqmin, g_seqnum[TXSEQ][RELAYSEQ].seqmax, relay_tx_expire_age, false));
+	due.swap(m_due);
 
-	m_expireobjs.push_back(new ValidObjsExpire("ValidObjs-Xreq", g_seqnum[XREQSEQ][VALIDSEQ].seqmin, g_seqnum[XREQSEQ][VALIDSEQ].seqmax, valid_tx_expire_age, true));
-	m_expireobjs.push_back(new RelayObjsExpire("RelayObjs-Xreq", g_seqnum[XREQSEQ][RELAYSEQ].seqmin, g_seqnum[XREQSEQ][RELAYSEQ].seqmax, relay_tx_expire_age, false));
+	sort(due.begin(), due.end(), [](const ExpireEntry& a, const ExpireEntry& b)
+	{
+		return a.queue < b.queue || (a.queue == b.queue && a.seqnum < b.seqnum);
+	});
 
-	for (auto expireobj : m_expireobjs)
+	for (unsigned start = 0; start < due.size() && !g_shutdown; start += batch.size())
 	{
-		expireobj->Start();
+		auto queue = due[start].queue;
+		auto expireobj = m_expireobjs[queue];
+
+		batch.clear();
+
+		for (unsigned i = start; i < due.size() && due[i].queue == queue && batch.size() < EXPIRE_BATCH_MAX; ++i)
+			batch.push_back(due[i]);
+
+		expireobj->DoExpires(m_dbconn, batch);
+
+		auto expire_age = expireobj->ExpireAge();
+		unsigned ndeleted = 0, nretry = 0;
+
+		for (auto& entry : batch)
+		{
+			if (entry.retry_secs)
+			{
+				entry.deadline = m_tick + entry.retry_secs;
+				entry.retry_secs = 0;
+
+				Place(entry);
+
+				++nretry;
+			}
+			else if (entry.deleted)
+			{
+				auto lag = max(ccticks_elapsed(entry.t0, now) - expire_age, 0);
+
+				lock_guard<FastSpinLock> lock(m_expire_lock);
+
+				++expireobj->m_nexpired;
+				expireobj->m_lag_total += lag;
+				expireobj->m_lag_max = max(expireobj->m_lag_max, (uint32_t)lag);
+
+				++ndeleted;
+			}
+		}
+
+		if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(trace) << "Expire::ExpireDue " << expireobj->m_name << " tick " << m_tick << " due " << batch.size() << " deleted " << ndeleted << " retry " << nretry << " expire_age " << expire_age;
 	}
 }
 
-void Expire::DeInit()
+void Expire::LogStats()
 {
-	if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(trace) << "Expire::DeInit";
+	uint64_t nentries = m_due.size();
+
+	for (auto& level : m_wheel)
+		for (auto& slot : level)
+			nentries += slot.size();
+
+	ostringstream out;
+
+	out << "Expire::LogStats objects on wheel " << nentries;
 
 	for (unsigned i = 0; i < m_expireobjs.size(); ++i)
 	{
-		auto obj = m_expireobjs[i];
+		uint64_t nexpired;
+		uint32_t lag_avg, lag_max;
 
-		m_expireobjs[i] = NULL;
+		if (GetLagStats(i, nexpired, lag_avg, lag_max))
+			out << "; " << m_expireobjs[i]->m_name << " expired " << nexpired << " lag avg " << lag_avg << " max " << lag_max << " ms";
+	}
+
+	BOOST_LOG_TRIVIAL(info) << out.str();
+}
 
-		obj->Stop();
+bool Expire::GetLagStats(unsigned i, uint64_t& nexpired, uint32_t& lag_avg, uint32_t& lag_max)
+{
+	lock_guard<FastSpinLock> lock(m_expire_lock);
 
-		delete obj;
-	}
+	if (i >= m_expireobjs.size() || !m_expireobjs[i])
+		return false;
 
-	if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(trace) << "Expire::DeInit done";
+	auto expireobj = m_expireobjs[i];
+
+	nexpired = expireobj->m_nexpired;
+	lag_avg = (nexpired ? expireobj->m_lag_total / nexpired : 0);
+	lag_max = expireobj->m_lag_max;
+
+	return true;
 }
 
 int32_t Expire::GetExpireAge(unsigned i)
@@ -321,5 +761,7 @@ void Expire::ChangeExpireAge(unsigned i, int32_t age)
 
 	m_expireobjs[i]->m_expire_age = age;
 
+	m_rebuild.store(true);	// recompute the expire times of the objects already on the wheel
+
 	if (TRACE_EXPIRE) BOOST_LOG_TRIVIAL(trace) << "Expire::ChangeExpireAge queue " << i << " set to expire age " << age;
 }
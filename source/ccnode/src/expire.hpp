@@ -11,6 +11,18 @@
 #include "dbconn.hpp"
 
 #include <SmartBuf.hpp>
+#include <SpinLock.hpp>
+
+struct ExpireEntry
+{
+	int64_t seqnum;
+	uint64_t deadline;			// in wheel ticks
+	uint32_t t0;				// ccticks when the object was inserted into the db
+	uint16_t queue;				// index into Expire::m_expireobjs
+	uint16_t retry_secs;		// set by ExpireObj::DoExpires when the object can't be expired yet
+	bool deleted;				// set by ExpireObj::DoExpires when the object was deleted from the db
+	bool no_age;				// expired without waiting for its expire age (a CCMint mint, which expires on the block level alone)
+};
 
 class ExpireObj
 {
@@ -23,14 +35,24 @@ protected:
 	volatile int32_t m_expire_age;
 	bool m_is_valid_objs;
 
-	virtual int GetExpires(int64_t& seqnum, SmartBuf *retobj, ccoid_t& oid, uint32_t& next_expires_t0) = 0;
-	virtual int DeleteExpires(int64_t& seqnum, SmartBuf smartobj) = 0;
+	// objects expired and how long after their expire time they were deleted; protected by Expire::m_expire_lock
 
-	thread *m_thread;
-	DbConn *m_dbconn;
+	uint64_t m_nexpired;
+	uint64_t m_lag_total;
+	uint32_t m_lag_max;
 
-	void ThreadProc();
-	void DoExpires();
+	virtual int GetExpires(DbConn *dbconn, int64_t min_seqnum, int64_t& seqnum, uint32_t& t0, bool& no_age) = 0;
+	virtual void DoExpires(DbConn *dbconn, vector<ExpireEntry>& entries) = 0;
+
+	int32_t ExpireAge() const;
+
+	bool HasSeqnum(int64_t seqnum) const
+	{
+		return m_min_seqnum <= seqnum && seqnum <= m_max_seqnum;
+	}
+
+	unsigned CheckMint(const SmartBuf& smartobj);
+	unsigned CheckBlock(const SmartBuf& smartobj);
 
 public:
 	ExpireObj(const char *name, int64_t min_seqnum, int64_t max_seqnum, int32_t expire_age, bool is_valid_objs)
@@ -40,26 +62,103 @@ public:
 		m_default_expire_age(expire_age),
 		m_expire_age(expire_age),
 		m_is_valid_objs(is_valid_objs),
-		m_thread(NULL),
-		m_dbconn(NULL)
+		m_nexpired(0),
+		m_lag_total(0),
+		m_lag_max(0)
 	{ }
 
 	virtual ~ExpireObj() = default;
-
-	void Start();
-	void Stop();
 };
 
+/*
+	Expire keeps every object in the ValidObjs and RelayObjs dbs on a hierarchical timer wheel.  An object is registered
+	when it is inserted into the db, and a single thread advances the wheel once per second and expires all of the objects
+	that have come due in one batch per db.  Process queue entries are not on the wheel, since they are removed by block
+	level rather than by age, but when an expired block is already done in the block process queue, its entry is deleted
+	in the same batch.
+
+	The wheel has WHEEL_LEVELS levels of WHEEL_SLOTS slots.  A slot at level 0 holds the objects that expire in one
+	particular second, and each higher level slot spans WHEEL_SLOTS times more seconds than the level below it.  When the
+	wheel reaches a higher level slot, its objects are moved down to the lower levels.  Objects that expire past the top
+	level are parked in its last slot and moved again when it is reached.
+
+	When an expire age changes, or memory pressure starts or ends, the expire times of all objects on the wheel are
+	recomputed from their db insert times.
+*/
+
 class Expire
 {
+	static const unsigned WHEEL_BITS = 6;
+	static const unsigned WHEEL_SLOTS = 1 << WHEEL_BITS;
+	static const unsigned WHEEL_LEVELS = 3;
+
 	vector<ExpireObj*> m_expireobjs;
 
+	array<array<vector<ExpireEntry>, WHEEL_SLOTS>, WHEEL_LEVELS> m_wheel;
+	vector<ExpireEntry> m_due;
+	uint64_t m_tick;			// the wheel advances one tick per second
+	uint32_t m_tick_ticks;		// ccticks at m_tick
+
+	vector<ExpireEntry> m_registered;		// objects registered since the last tick
+	bool m_accepting;
+	FastSpinLock m_expire_lock;
+
+	thread *m_thread;
+	DbConn *m_dbconn;
+
+	atomic<bool> m_memory_pressure;
+	atomic<bool> m_rebuild;
+
+	void ThreadProc();
+
+	void Seed();
+	uint64_t Deadline(const ExpireEntry& entry, uint32_t now);
+	void Place(const ExpireEntry& entry);
+	void Cascade(unsigned level, unsigned slot);
+	void Advance();
+	void Rebuild();
+	void ExpireDue(uint32_t now);
+
+	void LogStats();
+
 public:
+	Expire()
+	 :	m_tick(0),
+		m_tick_ticks(0),
+		m_accepting(false),
+		m_expire_lock(__FILE__, __LINE__),
+		m_thread(NULL),
+		m_dbconn(NULL),
+		m_memory_pressure(false),
+		m_rebuild(false)
+	{ }
+
 	void Init();
 	void DeInit();
 
+	/// Called when an object is inserted into the ValidObjs or RelayObjs db
+	void Register(bool valid_objs, int64_t seqnum, uint32_t t0, bool no_age = false);
+
+	/// Returns true if the object is expired without waiting for its expire age
+	static bool SkipsExpireAge(const SmartBuf& smartobj);
+
 	int32_t GetExpireAge(unsigned i);
 	void ChangeExpireAge(unsigned i, int32_t age);
+
+	/// Returns the number of objects expired from queue i, and the average and maximum time in ticks they were deleted after their expire time
+	bool GetLagStats(unsigned i, uint64_t& nexpired, uint32_t& lag_avg, uint32_t& lag_max);
+
+	/// While set, objects are expired after at most three minutes
+	void SetMemoryPressure(bool pressure)
+	{
+		if (m_memory_pressure.exchange(pressure) != pressure)
+			m_rebuild.store(true);
+	}
+
+	bool HasMemoryPressure() const
+	{
+		return m_memory_pressure.load();
+	}
 };
 
 extern Expire g_expire;
@@ -225,7 +225,7 @@ void ForeignRpcClient::Start()
 
 	// unsigned conn_nreadbuf, unsigned conn_nwritebuf, unsigned sock_nreadbuf, unsigned sock_nwritebuf, unsigned headersize, bool noclose, bool bregister
 	CCServer::ConnectionFactoryInstantiation<ForeignRpc> connfac(TXCONN_READ_MAX, 0, -1, -1, 0, 1, 0);
-	CCThreadFactoryInstantiation<ForeignRpcThread> threadfac;
+	CCThreadFactoryInstantiation<ForeignRpcThread> threadfac("foreign-rpc");
 
 	unsigned maxconns = (unsigned)(max_inconns + max_outconns);
 	unsigned nthreads = maxconns * threads_per_conn;
@@ -19,17 +19,36 @@
 
 #define QUERY_SERVER_TRIES	1	// set to 1 so retries will use a different server instead of same server
 
+#define HOSTDIR_CACHE_FILE			"hostdir_cache.lis"
+#define HOSTDIR_STARTUP_SECS		60				// delay before the first background refresh, to give tor time to start
+#define HOSTDIR_REFRESH_SECS		(10*60)
+#define HOSTDIR_MIN_REFRESH_SECS	30				// minimum time between refreshes when running short of peers
+#define HOSTDIR_SAVE_SECS			60
+#define HOSTDIR_MIN_CANDIDATES		4				// refresh early when fewer than this many peers of a type can be picked
+#define HOSTDIR_REPICK_SECS			60				// a peer isn't picked again for this long, to avoid duplicate connections
+#define HOSTDIR_STALE_SECS			(24*60*60)		// score halves when a peer hasn't been seen for this long
+#define HOSTDIR_EXPIRE_SECS			(7*24*60*60)	// peers not seen for this long are dropped from the cache
+#define HOSTDIR_SLOW_CONNECT_SECS	10				// score halves when connection setup takes this long
+#define HOSTDIR_MAX_COUNTS			64				// success and failure counts are halved past this, so recent results count more
+
 #define TRACE_HOSTDIR	(g_params.trace_host_dir)
 
+// called by each service that uses the directory; only the first call loads the files and starts the refresh thread
+
 bool HostDir::Init()
 {
-	if (m_rendezvous_servers.size())
+	lock_guard<mutex> lock(m_init_lock);
+
+	if (m_initialized)
 	{
 		BOOST_LOG_TRIVIAL(trace) << "HostDir::Init already initialized";
 
-		return false;
+		return m_init_failed;
 	}
 
+	m_initialized = true;
+	m_init_failed = true;	// cleared below on success
+
 	BOOST_LOG_TRIVIAL(trace) << "HostDir::Init file \"" << w2s(g_params.rendezvous_servers_file) << "\"";
 
 	CCASSERT(g_params.rendezvous_servers_file.length());
@@ -81,6 +100,18 @@ bool HostDir::Init()
 
 	BOOST_LOG_TRIVIAL(debug) << "HostDir::Init loaded " << m_rendezvous_servers.size() << " private rendezvous hostnames";
 
+	m_cache_file = g_params.app_data_dir + WIDE(PATH_DELIMITER) + s2w(HOSTDIR_CACHE_FILE);
+
+	LoadCache();
+
+	if (!m_refresh_thread.joinable())
+	{
+		thread worker(&HostDir::RefreshProc, this);
+		m_refresh_thread.swap(worker);
+	}
+
+	m_init_failed = false;
+
 	return false;
 }
 
@@ -88,6 +119,9 @@ void HostDir::DeInit()
 {
 	BOOST_LOG_TRIVIAL(trace) << "HostDir::DeInit";
 
+	if (m_refresh_thread.joinable())
+		m_refresh_thread.join();
+
 	while (m_query_in_progress.load())
 		usleep(50*1000);
 
@@ -96,66 +130,408 @@ void HostDir::DeInit()
 		boost::system::error_code ec;
 		m_socket.close(ec);
 	}
+
+	if (m_dirty.load())
+		SaveCache();
 }
 
-string HostDir::GetHostName(HostType type)
+void HostDir::RefreshProc()
 {
-	if (g_shutdown)
-		return string();
+	BOOST_LOG_TRIVIAL(info) << "HostDir::RefreshProc started";
 
-	lock_guard<mutex> lock(classlock);
+	auto last_refresh = ccticks();
+	auto last_save = last_refresh;
+	bool first = true;
 
-	if (type < 0 || type >= N_HostTypes || hostnames[type].empty())
+	while (!g_shutdown)
 	{
-		auto query = PrepareQuery();
+		ccsleep(1);
+
+		int wait = (first ? HOSTDIR_STARTUP_SECS : HOSTDIR_REFRESH_SECS);
+
+		if (!first && m_refresh_wanted.load())
+			wait = HOSTDIR_MIN_REFRESH_SECS;
 
-		for (unsigned i = 0; i < QUERY_SERVER_TRIES && query.length() && !g_shutdown; ++i)
+		if (!g_shutdown && ccticks_elapsed(last_refresh, ccticks()) >= wait * CCTICKS_PER_SEC)
 		{
-			auto rc = QueryServer(query);
-			if (!rc)
-				break;
+			if (TRACE_HOSTDIR) BOOST_LOG_TRIVIAL(debug) << "HostDir::RefreshProc refreshing from rendezvous server; refresh wanted " << m_refresh_wanted.load();
+
+			m_refresh_wanted.store(false);
+			first = false;
+
+			QueryNow();
+
+			last_refresh = ccticks();
 		}
+
+		if (m_dirty.load() && ccticks_elapsed(last_save, ccticks()) >= HOSTDIR_SAVE_SECS * CCTICKS_PER_SEC)
+		{
+			SaveCache();
+
+			last_save = ccticks();
+		}
+	}
+
+	BOOST_LOG_TRIVIAL(info) << "HostDir::RefreshProc ended";
+}
+
+// returns true on failure
+
+bool HostDir::QueryNow()
+{
+	lock_guard<mutex> lock(classlock);
+
+	string name, toruser;
+	unsigned clen;
+
+	auto query = PrepareQuery(name, toruser, clen);
+
+	for (unsigned i = 0; i < QUERY_SERVER_TRIES && query.length() && !g_shutdown; ++i)
+	{
+		auto rc = QueryServer(query, name, toruser, clen);
+		if (!rc)
+			return false;
 	}
 
+	return true;
+}
+
+double HostDir::HostEntry::Score(uint64_t now) const
+{
+	double success = (successes + 1.0) / (successes + failures + 2.0);
+	double speed = 1 / (1 + avg_connect_secs / HOSTDIR_SLOW_CONNECT_SECS);
+	double age = (now > last_seen ? now - last_seen : 0);
+	double fresh = 1 / (1 + age / HOSTDIR_STALE_SECS);
+
+	return success * success * speed * fresh;
+}
+
+string HostDir::GetHostName(HostType type)
+{
+	if (g_shutdown)
+		return string();
+
 	if (type < 0 || type >= N_HostTypes)
+	{
+		QueryNow();		// let the rendezvous servers know we're here
+
 		return string();
+	}
+
+	bool have_hosts;
+
+	{
+		lock_guard<mutex> lock(m_hosts_lock);
+
+		have_hosts = !m_hosts[type].empty();
+	}
 
-	while (!hostnames[type].empty())
+	if (!have_hosts)
 	{
-		auto name = hostnames[type].front();
-		hostnames[type].pop_front();
+		if (TRACE_HOSTDIR) BOOST_LOG_TRIVIAL(trace) << "HostDir::GetHostName no hosts of type " << type << " known; querying rendezvous server";
+
+		QueryNow();
+	}
+
+	string own_name = (type == Relay ? g_relay_service.TorHostname() : g_blockserve_service.TorHostname());
+	uint64_t now = unixtime();
+
+	lock_guard<mutex> lock(m_hosts_lock);
+
+	auto& hosts = m_hosts[type];
+	double total = 0;
+	unsigned ncandidates = 0;
 
-		if (type == Relay && name == g_relay_service.TorHostname())
+	for (auto& h : hosts)
+	{
+		if (h.name == own_name || now < h.last_pick + HOSTDIR_REPICK_SECS)
 			continue;
 
-		if (type == Blockserve && name == g_blockserve_service.TorHostname())
+		total += h.Score(now);
+		++ncandidates;
+	}
+
+	if (ncandidates < HOSTDIR_MIN_CANDIDATES)
+		m_refresh_wanted.store(true);
+
+	if (!ncandidates)
+	{
+		if (TRACE_HOSTDIR) BOOST_LOG_TRIVIAL(trace) << "HostDir::GetHostName returning none";
+
+		return string();
+	}
+
+	// pick a host at random, weighted by score
+
+	uint64_t r;
+	CCPseudoRandom(&r, sizeof(r));
+
+	double pick = total * (r >> 11) / (double)(UINT64_C(1) << 53);
+	HostEntry *chosen = NULL;
+
+	for (auto& h : hosts)
+	{
+		if (h.name == own_name || now < h.last_pick + HOSTDIR_REPICK_SECS)
 			continue;
 
-		if (TRACE_HOSTDIR) BOOST_LOG_TRIVIAL(trace) << "HostDir::GetHostName returning " << name;
+		chosen = &h;
+
+		pick -= h.Score(now);
+		if (pick < 0)
+			break;
+	}
+
+	CCASSERT(chosen);
+
+	chosen->last_pick = now;
+
+	if (TRACE_HOSTDIR) BOOST_LOG_TRIVIAL(trace) << "HostDir::GetHostName returning " << chosen->name << " of " << ncandidates << " candidates; score " << chosen->Score(now) << " successes " << chosen->successes << " failures " << chosen->failures << " avg connect secs " << chosen->avg_connect_secs;
+
+	return chosen->name;
+}
+
+void HostDir::ReportConnect(HostType type, const string& name, bool ok, int ms)
+{
+	if (type < 0 || type >= N_HostTypes)
+		return;
+
+	lock_guard<mutex> lock(m_hosts_lock);
+
+	auto h = FindHost(type, name);
+	if (!h)
+		return;		// not a host from the directory, for example a private relay
+
+	if (ok)
+	{
+		++h->successes;
+		h->last_seen = unixtime();
+
+		if (ms >= 0)
+		{
+			float secs = (float)ms / CCTICKS_PER_SEC;
+
+			if (h->avg_connect_secs)
+				h->avg_connect_secs += 0.25f * (secs - h->avg_connect_secs);
+			else
+				h->avg_connect_secs = secs;
+		}
+	}
+	else
+		++h->failures;
 
-		return name;
+	if (h->successes + h->failures > HOSTDIR_MAX_COUNTS)
+	{
+		h->successes /= 2;
+		h->failures /= 2;
 	}
 
-	if (TRACE_HOSTDIR) BOOST_LOG_TRIVIAL(trace) << "HostDir::GetHostName returning none";
+	m_dirty.store(true);
 
-	return string();
+	if (TRACE_HOSTDIR) BOOST_LOG_TRIVIAL(trace) << "HostDir::ReportConnect " << name << " ok " << ok << " ms " << ms << " successes " << h->successes << " failures " << h->failures << " avg connect secs " << h->avg_connect_secs;
 }
 
-string HostDir::PrepareQuery()
+// caller must hold m_hosts_lock
+
+HostDir::HostEntry* HostDir::FindHost(const HostType type, const string& name)
+{
+	for (auto& h : m_hosts[type])
+	{
+		if (h.name == name)
+			return &h;
+	}
+
+	return NULL;
+}
+
+// caller must hold m_hosts_lock
+
+void HostDir::AddHost(const HostType type, const string& name, uint64_t now)
+{
+	m_dirty.store(true);
+
+	auto h = FindHost(type, name);
+	if (h)
+	{
+		h->last_seen = max(h->last_seen, now);
+
+		return;
+	}
+
+	auto& hosts = m_hosts[type];
+
+	if (hosts.size() >= MAX_SAVED_HOSTS)
+	{
+		// replace the lowest scoring host
+
+		unsigned worst = 0;
+		auto worst_score = hosts[0].Score(now);
+
+		for (unsigned i = 1; i < hosts.size(); ++i)
+		{
+			auto score = hosts[i].Score(now);
+
+			if (score < worst_score)
+			{
+				worst = i;
+				worst_score = score;
+			}
+		}
+
+		hosts.erase(hosts.begin() + worst);
+	}
+
+	HostEntry entry;
+	entry.name = name;
+	entry.last_seen = now;
+	entry.last_pick = 0;
+	entry.successes = 0;
+	entry.failures = 0;
+	entry.avg_connect_secs = 0;
+
+	hosts.push_back(entry);
+}
+
+// each line of the cache file is: type name last_seen successes failures avg_connect_ms
+
+void HostDir::LoadCache()
+{
+	boost::filesystem::ifstream fs;
+	fs.open(m_cache_file, fstream::in);
+	if(!fs.is_open())
+	{
+		BOOST_LOG_TRIVIAL(info) << "HostDir::LoadCache no host cache file \"" << w2s(m_cache_file) << "\"";
+
+		return;
+	}
+
+	uint64_t now = unixtime();
+	unsigned nloaded = 0;
+
+	lock_guard<mutex> lock(m_hosts_lock);
+
+	while (!g_shutdown)
+	{
+		unsigned type;
+		string name;
+		uint64_t last_seen;
+		uint32_t successes, failures, avg_connect_ms;
+
+		fs >> type >> name >> last_seen >> successes >> failures >> avg_connect_ms;
+
+		if (fs.fail())
+			break;
+
+		if (type >= N_HostTypes || name.empty() || now > last_seen + HOSTDIR_EXPIRE_SECS)
+			continue;
+
+		AddHost((HostType)type, name, min(last_seen, now));
+
+		auto h = FindHost((HostType)type, name);
+		CCASSERT(h);
+
+		h->successes = min(successes, (uint32_t)HOSTDIR_MAX_COUNTS);
+		h->failures = min(failures, (uint32_t)HOSTDIR_MAX_COUNTS);
+		h->avg_connect_secs = (float)avg_connect_ms / CCTICKS_PER_SEC;
+
+		++nloaded;
+	}
+
+	m_dirty.store(false);
+
+	BOOST_LOG_TRIVIAL(info) << "HostDir::LoadCache loaded " << nloaded << " hosts from \"" << w2s(m_cache_file) << "\"";
+}
+
+void HostDir::SaveCache()
+{
+	if (m_cache_file.empty())
+		return;
+
+	array<vector<HostEntry>, N_HostTypes> hosts;
+
+	{
+		lock_guard<mutex> lock(m_hosts_lock);
+
+		hosts = m_hosts;
+
+		m_dirty.store(false);
+	}
+
+	// write to a temporary file and then rename it, so a crash doesn't leave a partial cache
+
+	auto tmpfile = m_cache_file + L".tmp";
+
+	boost::filesystem::ofstream fs;
+	fs.open(tmpfile, fstream::out | fstream::trunc);
+	if(!fs.is_open())
+	{
+		BOOST_LOG_TRIVIAL(warning) << "HostDir::SaveCache error opening host cache file \"" << w2s(tmpfile) << "\"";
+
+		return;
+	}
+
+	unsigned nsaved = 0;
+
+	for (unsigned type = 0; type < N_HostTypes; ++type)
+	{
+		for (auto& h : hosts[type])
+		{
+			fs << type << " " << h.name << " " << h.last_seen << " " << h.successes << " " << h.failures << " " << (uint32_t)(h.avg_connect_secs * CCTICKS_PER_SEC) << "\n";
+
+			++nsaved;
+		}
+	}
+
+	fs.close();
+
+	if (fs.fail())
+	{
+		BOOST_LOG_TRIVIAL(warning) << "HostDir::SaveCache error writing host cache file \"" << w2s(tmpfile) << "\"";
+
+		return;
+	}
+
+	boost::system::error_code e;
+	boost::filesystem::rename(tmpfile, m_cache_file, e);
+	if (e)
+	{
+		BOOST_LOG_TRIVIAL(warning) << "HostDir::SaveCache error renaming host cache file \"" << w2s(tmpfile) << "\": " << e.message();
+
+		return;
+	}
+
+	if (TRACE_HOSTDIR) BOOST_LOG_TRIVIAL(debug) << "HostDir::SaveCache saved " << nsaved << " hosts";
+}
+
+// returns the query prefixed with the Socks connect string, which is clen bytes long
+
+string HostDir::PrepareQuery(string& name, string& toruser, unsigned& clen)
 {
 	if (!m_rendezvous_servers.size())
 		return string();
 
-	unsigned server;
-	CCPseudoRandom(&server, sizeof(server));
-	server %= m_rendezvous_servers.size();
-	string name = m_rendezvous_servers[server];
+	if (m_next_server_toruser.empty())
+	{
+		CCPseudoRandom(&m_next_server, sizeof(m_next_server));
+		m_next_server %= m_rendezvous_servers.size();
+		m_next_server_toruser = Socks::IsolationUser();
+	}
+
+	name = m_rendezvous_servers[m_next_server];
+	toruser = m_next_server_toruser;
+
+	// pick the server for the next query now so the Tor proxy pool can connect to it in the background
+
+	CCPseudoRandom(&m_next_server, sizeof(m_next_server));
+	m_next_server %= m_rendezvous_servers.size();
+	m_next_server_toruser = Socks::IsolationUser();
+
+	g_sockspool.Warm(m_rendezvous_servers[m_next_server], m_next_server_toruser);
 
 	if (TRACE_HOSTDIR) BOOST_LOG_TRIVIAL(info) << "HostDir::PrepareQuery server " << name; // << " torproxy port " << g_params.torproxy_port;
 
-	string str = Socks::ConnectString(name, string());
+	string str = Socks::ConnectString(name, toruser);
 
-	auto clen = str.length();
+	clen = str.length();
 
 	//str += "X:" + to_string(rand()) + "\n"; // for testing
 
@@ -202,7 +578,7 @@ string HostDir::PrepareQuery()
 	return str;
 }
 
-bool HostDir::QueryServer(const string& query)
+bool HostDir::QueryServer(const string& query, const string& name, const string& toruser, unsigned clen)
 {
 	string reply(SOCKS_REPLY_SIZE + MAX_DIR_REPLY_SIZE, 0);
 
@@ -210,7 +586,13 @@ bool HostDir::QueryServer(const string& query)
 
 	boost::system::error_code e(boost::system::errc::operation_canceled, boost::system::generic_category());
 
-	if (!g_shutdown)
+	if (!g_shutdown && g_sockspool.Lease(m_socket, name, toruser))
+	{
+		if (TRACE_HOSTDIR) BOOST_LOG_TRIVIAL(debug) << "HostDir::QueryServer using pooled connection to " << name;
+
+		e = Socks::SendData(m_socket, query.substr(clen), reply);
+	}
+	else if (!g_shutdown)
 		e = Socks::SendString(m_socket, g_params.torproxy_port, query, reply);
 
 	m_query_in_progress = false;
@@ -279,6 +661,8 @@ void HostDir::ParseNameArray(Json::Value& root, const char* label, const HostTyp
 		BOOST_LOG_TRIVIAL(error) << "HostDir::QueryServer error: " << label << " value is not a json array";
 	else for (unsigned i = 0; i < value.size(); ++i)
 	{
+		uint64_t now = unixtime();
+
 		auto name = value[i].asString();
 		if (name.empty())
 			BOOST_LOG_TRIVIAL(error) << "HostDir::QueryServer error: empty " << label << " name";
@@ -286,10 +670,9 @@ void HostDir::ParseNameArray(Json::Value& root, const char* label, const HostTyp
 		{
 			if (TRACE_HOSTDIR) BOOST_LOG_TRIVIAL(info) << "HostDir::QueryServer found " << label << " name " << name;
 
-			if (hostnames[type].size() > MAX_SAVED_HOSTS)
-				hostnames[type].pop_front();
+			lock_guard<mutex> lock(m_hosts_lock);
 
-			hostnames[type].push_back(name);
+			AddHost(type, name, now);
 		}
 	}
 }
@@ -11,11 +11,25 @@
 #include <boost/asio.hpp>
 #include <jsoncpp/json/json.h>
 
+/*
+	HostDir keeps a directory of relay and blockchain peers, saved to disk so a restarted node can reconnect without
+	waiting on a rendezvous server.  Each peer is scored by its connection success rate, its Tor connection setup time,
+	and how recently it was seen, and GetHostName picks peers at random weighted by that score.  A background thread
+	refreshes the directory from the rendezvous servers, so a rendezvous query is only made inline when no peer of the
+	requested type is known.
+*/
+
 class HostDir
 {
 public:
 	HostDir()
-	: m_socket(m_io_service)
+	: m_initialized(false),
+	  m_init_failed(false),
+	  m_socket(m_io_service),
+	  m_query_in_progress(false),
+	  m_next_server(0),
+	  m_refresh_wanted(false),
+	  m_dirty(false)
 	{ }
 
 	enum HostType
@@ -30,16 +44,52 @@ public:
 
 	string GetHostName(HostType type);
 
+	/// Records the outcome of a connection to a peer; ms is the Tor connection setup time, or < 0 if not measured
+	void ReportConnect(HostType type, const string& name, bool ok, int ms = -1);
+
 private:
-	string PrepareQuery();
-	bool QueryServer(const string& query);
+	struct HostEntry
+	{
+		string name;
+		uint64_t last_seen;			// unixtime the peer was last listed by a rendezvous server or connected
+		uint64_t last_pick;			// unixtime the peer was last returned by GetHostName
+		uint32_t successes;
+		uint32_t failures;
+		float avg_connect_secs;		// zero if not yet measured
+
+		double Score(uint64_t now) const;
+	};
+
+	bool QueryNow();
+	void RefreshProc();
+	void AddHost(const HostType type, const string& name, uint64_t now);
+	HostEntry* FindHost(const HostType type, const string& name);
+	void LoadCache();
+	void SaveCache();
+
+	string PrepareQuery(string& name, string& toruser, unsigned& clen);
+	bool QueryServer(const string& query, const string& name, const string& toruser, unsigned clen);
 	void ParseNameArray(Json::Value& root, const char* label, const HostType type);
 
-	mutex classlock;
+	mutex m_init_lock;
+	bool m_initialized;					// protected by m_init_lock
+	bool m_init_failed;
+
+	mutex classlock;					// serializes rendezvous queries
 	vector<string> m_rendezvous_servers;
-	array<deque<string>, N_HostTypes> hostnames;
+
+	mutex m_hosts_lock;
+	array<vector<HostEntry>, N_HostTypes> m_hosts;
+	wstring m_cache_file;
 
 	boost::asio::io_service m_io_service;
 	boost::asio::ip::tcp::socket m_socket;
 	atomic<bool> m_query_in_progress;
+
+	unsigned m_next_server;				// picked ahead of time so the Tor proxy connection to it can be set up in advance
+	string m_next_server_toruser;
+
+	thread m_refresh_thread;
+	atomic<bool> m_refresh_wanted;
+	atomic<bool> m_dirty;				// m_hosts has changed since it was last saved
 };
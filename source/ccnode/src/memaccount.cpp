@@ -0,0 +1,136 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * memaccount.cpp
+*/
+
+#include "ccnode.h"
+#include "memaccount.hpp"
+#include "expire.hpp"
+#include "dbconn.hpp"
+
+#include <ccserver/buffer_pool.hpp>
+
+#define MEMACCOUNT_CHECK_INTERVAL	5		// seconds
+
+MemAccount g_memaccount;
+
+class MemAccountDbs : public DbConnBaseTempSerials, public DbConnBaseRelayObjs, public DbConnBaseProcessQ, public DbConnBaseValidObjs, public DbConnBaseXreqs
+{ };
+
+static int64_t DbCacheUsed(sqlite3 *db)
+{
+	int current = 0, highwater = 0;
+
+	if (db)
+		sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED_SHARED, &current, &highwater, 0);
+
+	return current;
+}
+
+void MemAccount::Check()
+{
+	auto now = ccticks();
+
+	if (m_check_ticks && ccticks_elapsed(m_check_ticks, now) < MEMACCOUNT_CHECK_INTERVAL*CCTICKS_PER_SEC)
+		return;
+
+	m_check_ticks = now;
+
+	if (!m_dbs)
+	{
+		m_dbs = new MemAccountDbs;
+
+		m_dbs->DbConnBaseTempSerials::OpenDb();
+		m_dbs->DbConnBaseRelayObjs::OpenDb();
+		for (unsigned i = 0; i < PROCESS_Q_N; ++i)
+			m_dbs->DbConnBaseProcessQ::OpenDb(i);
+		m_dbs->DbConnBaseValidObjs::OpenDb();
+		m_dbs->DbConnBaseXreqs::OpenDb();
+	}
+
+	sqlite3_int64 sqlite_used = 0, highwater = 0;
+	sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &sqlite_used, &highwater, 0);
+
+	CCServer::BufferPoolStats bufstats;
+	g_connbufpool.GetStats(bufstats);
+
+	uint64_t total = SmartBuf::ByteTotal() + sqlite_used + bufstats.pooled_bytes + bufstats.outstanding_bytes;
+
+	uint64_t soft = (uint64_t)g_params.mem_soft_budget << 20;
+	uint64_t hard = (uint64_t)g_params.mem_hard_budget << 20;
+
+	// a state is left only after the total falls below 90% of its budget
+
+	int state = m_state.load();
+	int new_state;
+
+	if (hard && (total > hard || (state == MemState_Hard && total >= hard / 10 * 9)))
+		new_state = MemState_Hard;
+	else if (soft && (total > soft || (state >= MemState_Soft && total >= soft / 10 * 9)))
+		new_state = MemState_Soft;
+	else
+		new_state = MemState_Normal;
+
+	if (new_state != state)
+	{
+		m_state.store(new_state);
+
+		g_expire.SetMemoryPressure(new_state >= MemState_Soft);
+
+		BOOST_LOG_TRIVIAL(warning) << "MemAccount::Check memory state changed from " << state << " to " << new_state << "; " << StatusString(total);
+
+		m_log_ticks = now;
+	}
+	else if (g_params.mem_log_interval && (!m_log_ticks || ccticks_elapsed(m_log_ticks, now) >= g_params.mem_log_interval*CCTICKS_PER_SEC))
+	{
+		BOOST_LOG_TRIVIAL(info) << "MemAccount::Check " << StatusString(total);
+
+		m_log_ticks = now;
+	}
+}
+
+string MemAccount::StatusString(uint64_t total)
+{
+	static const char* tag_names[MEMTAG_N] = {"valid objs", "process q blocks", "process q txs", "relay queues"};
+
+	sqlite3_int64 sqlite_used = 0, highwater = 0;
+	sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &sqlite_used, &highwater, 0);
+
+	CCServer::BufferPoolStats bufstats;
+	g_connbufpool.GetStats(bufstats);
+
+	ostringstream out;
+
+	out << "memory total " << total << " soft budget " << ((uint64_t)g_params.mem_soft_budget << 20) << " hard budget " << ((uint64_t)g_params.mem_hard_budget << 20) << " state " << m_state.load();
+
+	out << "; SmartBuf objects " << SmartBuf::ObjTotal() << " bytes " << SmartBuf::ByteTotal();
+
+	for (unsigned i = 0; i < MEMTAG_N; ++i)
+		out << "; " << tag_names[i] << " objects " << m_counters[i].nobjs.load() << " bytes " << m_counters[i].nbytes.load();
+
+	out << "; sqlite used " << sqlite_used << " highwater " << highwater;
+
+	if (m_dbs)
+	{
+		out << " temp serials cache " << DbCacheUsed(m_dbs->Temp_Serials_db);
+		out << " relay objs cache " << DbCacheUsed(m_dbs->Relay_Objs_db);
+		out << " process q blocks cache " << DbCacheUsed(m_dbs->Process_Q_db[PROCESS_Q_TYPE_BLOCK]);
+		out << " process q txs cache " << DbCacheUsed(m_dbs->Process_Q_db[PROCESS_Q_TYPE_TX]);
+		out << " valid objs cache " << DbCacheUsed(m_dbs->Valid_Objs_db);
+		out << " xreqs cache " << DbCacheUsed(m_dbs->Xreqs_db);
+	}
+
+	out << "; connection buffers outstanding " << bufstats.outstanding_bytes << " pooled " << bufstats.pooled_bytes;
+
+	return out.str();
+}
+
+void MemAccount::DeInit()
+{
+	delete m_dbs;
+
+	m_dbs = NULL;
+}
@@ -0,0 +1,95 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * memaccount.hpp
+*/
+
+#pragma once
+
+#include <SmartBuf.hpp>
+
+enum MemTag
+{
+	MEMTAG_VALID_OBJS,
+	MEMTAG_PROCESS_Q_BLOCKS,
+	MEMTAG_PROCESS_Q_TXS,
+	MEMTAG_RELAY_QUEUES,		// compact blocks cached to send, and compact blocks waiting for their missing txs
+
+	MEMTAG_N
+};
+
+/*
+	MemAccount counts the objects and bytes referenced by each tagged holder of SmartBuf's, and periodically adds up the
+	memory used by all SmartBuf's, the SQLite in-memory databases and the connection buffer pool.
+
+	An object can be referenced by more than one holder at the same time, so the sum of the tags can exceed the SmartBuf
+	total.  The budgets are checked against the total.  Above the soft budget, objects are expired early; above the hard
+	budget, relay connections also stop downloading new transactions.  Each state is left when the total falls below
+	90% of its budget.
+*/
+
+class MemAccount
+{
+	struct Counter
+	{
+		atomic<int64_t> nobjs;
+		atomic<int64_t> nbytes;
+	};
+
+	array<Counter, MEMTAG_N> m_counters;
+
+	atomic<int> m_state;
+
+	class MemAccountDbs *m_dbs;
+	uint32_t m_check_ticks;
+	uint32_t m_log_ticks;
+
+	string StatusString(uint64_t total);
+
+public:
+	enum
+	{
+		MemState_Normal,
+		MemState_Soft,
+		MemState_Hard
+	};
+
+	MemAccount()
+	 :	m_state(MemState_Normal),
+		m_dbs(NULL),
+		m_check_ticks(0),
+		m_log_ticks(0)
+	{
+		for (auto& c : m_counters)
+		{
+			c.nobjs.store(0);
+			c.nbytes.store(0);
+		}
+	}
+
+	void Add(MemTag tag, const SmartBuf& smartobj)
+	{
+		m_counters[tag].nobjs.fetch_add(1, memory_order_relaxed);
+		m_counters[tag].nbytes.fetch_add(smartobj.size(), memory_order_relaxed);
+	}
+
+	void Sub(MemTag tag, const SmartBuf& smartobj)
+	{
+		m_counters[tag].nobjs.fetch_sub(1, memory_order_relaxed);
+		m_counters[tag].nbytes.fetch_sub(smartobj.size(), memory_order_relaxed);
+	}
+
+	bool OverHardBudget() const
+	{
+		return m_state.load() >= MemState_Hard;
+	}
+
+	/// Called periodically by the main thread
+	void Check();
+
+	void DeInit();
+};
+
+extern MemAccount g_memaccount;
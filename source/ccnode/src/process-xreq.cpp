@@ -16,6 +16,7 @@
 #include "dbparamkeys.h"
 
 #include <CCobjects.hpp>
+#include <CCthread.hpp>
 #include <transaction.hpp>
 #include <transaction.h>
 #include <xtransaction-xreq.hpp>
@@ -1138,6 +1139,8 @@ void ProcessXreqs::SetCondition(int condition)
 
 void ProcessXreqs::MatchingThread()
 {
+	CCThreadRoles::Apply("xreq");
+
 	BOOST_LOG_TRIVIAL(info) << "ProcessXreqs::MatchingThread start";
 
 	auto dbconn = new DbConn;
@@ -8,12 +8,14 @@
 
 #include "ccnode.h"
 #include "processblock.hpp"
+#include "blocktxcheck.hpp"
 #include "processtx.hpp"
 #include "block.hpp"
 #include "blockchain.hpp"
 #include "witness.hpp"
 
 #include <CCobjects.hpp>
+#include <CCthread.hpp>
 #include <transaction.h>
 #include <xtransaction-xreq.hpp>
 #include <xtransaction-xpay.hpp>
@@ -44,12 +46,70 @@ ProcessBlock g_processblock;
 
 static DbConn *dbconn = NULL;	// not thread safe
 
+/*
+
+Block tx checks are done in two phases.  In the first phase, each tx is parsed and checked independently of the other
+tx's in the block, and its serialnums are computed.  This phase is run in parallel by a BlockTxCheckPool, plus the block
+processing thread itself, each with its own TxPay and DbConn.  In the second phase, which is run serially in
+BlockValidate, the serialnums are checked for conflicts and indexed in block order.
+
+*/
+
+static BlockTxCheckPool check_pool;
+static uint64_t check_prior_blocktime;	// set before each call to check_pool.Run
+
+static int CheckBlockTx(DbConn *dbconn, TxPay& txbuf, BlockTxCheck& check, const uint64_t prior_blocktime);
+
+class NodeBlockTxChecker : public BlockTxChecker
+{
+	DbConn *m_dbconn;
+	TxPay *m_ptxbuf;
+	bool m_owned;
+
+public:
+
+	// used by the pool threads
+	NodeBlockTxChecker()
+	 :	m_dbconn(new DbConn),
+		m_ptxbuf(new TxPay),
+		m_owned(true)
+	{
+		CCASSERT(m_dbconn);
+		CCASSERT(m_ptxbuf);
+
+		BOOST_LOG_TRIVIAL(info) << "NodeBlockTxChecker dbconn " << (uintptr_t)m_dbconn;
+	}
+
+	// used by the block processing thread
+	NodeBlockTxChecker(DbConn *dbconn, TxPay& txbuf)
+	 :	m_dbconn(dbconn),
+		m_ptxbuf(&txbuf),
+		m_owned(false)
+	{ }
+
+	~NodeBlockTxChecker()
+	{
+		if (m_owned)
+		{
+			delete m_ptxbuf;
+			delete m_dbconn;
+		}
+	}
+
+	int Check(BlockTxCheck& check)
+	{
+		return CheckBlockTx(m_dbconn, *m_ptxbuf, check, check_prior_blocktime);
+	}
+};
+
 void ProcessBlock::Init()
 {
 	if (TRACE_PROCESS_BLOCK) BOOST_LOG_TRIVIAL(trace) << "ProcessBlock::Init";
 
 	dbconn = new DbConn;
 
+	check_pool.Init(g_params.block_validation_threads, []{ return new NodeBlockTxChecker; }, "block");
+
 	m_thread = new thread(&ProcessBlock::ThreadProc, this);
 }
 
@@ -59,6 +119,8 @@ void ProcessBlock::Stop()
 
 	DbConnProcessQ::StopQueuedWork(PROCESS_Q_TYPE_BLOCK);
 
+	check_pool.Stop();
+
 	if (TRACE_PROCESS_BLOCK) BOOST_LOG_TRIVIAL(trace) << "ProcessBlock::Stop done";
 }
 
@@ -75,6 +137,8 @@ void ProcessBlock::DeInit()
 		m_thread = NULL;
 	}
 
+	check_pool.DeInit();
+
 	delete dbconn;
 
 	if (TRACE_PROCESS_BLOCK) BOOST_LOG_TRIVIAL(trace) << "ProcessBlock::DeInit done";
@@ -82,63 +146,138 @@ void ProcessBlock::DeInit()
 
 int ProcessBlock::ExtractTx(const char *wire, const uint32_t txsize, SmartBuf& smartobj)
 {
-	if (txsize < CC_MSG_HEADER_SIZE)
+	return BlockTxCheckPool::ExtractTx(wire, txsize, smartobj);
+}
+
+int ProcessBlock::CompareBinaryTxs(SmartBuf smartobj1, SmartBuf smartobj2)
+{
+	auto obj1 = (CCObject*)smartobj1.data();
+	auto obj2 = (CCObject*)smartobj2.data();
+
+	if (obj1->WireTag() != obj2->WireTag())
 	{
-		BOOST_LOG_TRIVIAL(info) << "ProcessBlock::ExtractTx size " << txsize << " < " << CC_MSG_HEADER_SIZE;
+		BOOST_LOG_TRIVIAL(info) << "ProcessBlock::CompareBinaryTxs WireTag's differ";
 
 		return -1;
 	}
 
-	smartobj = SmartBuf(txsize + sizeof(CCObject::Preamble));
-	if (!smartobj)
+	if (obj1->BodySize() != obj2->BodySize())
 	{
-		BOOST_LOG_TRIVIAL(error) << "ProcessBlock::ExtractTx SmartBuf allocation failed size " << txsize + sizeof(CCObject::Preamble);
+		BOOST_LOG_TRIVIAL(info) << "ProcessBlock::CompareBinaryTxs sizes differ";
 
 		return -1;
 	}
 
-	auto obj = (CCObject*)smartobj.data();
-
-	memcpy(obj->ObjPtr(), wire, txsize);
-
-	if (!obj->IsValid() || obj->ObjSize() != txsize)
+	if (memcmp(obj1->BodyPtr(), obj2->BodyPtr(), obj1->BodySize()))
 	{
-		BOOST_LOG_TRIVIAL(info) << "ProcessBlock::ExtractTx invalid tx object";
+		BOOST_LOG_TRIVIAL(info) << "ProcessBlock::CompareBinaryTxs binary objects differ";
 
 		return -1;
 	}
 
-	obj->SetObjId();
-
 	return 0;
 }
 
-int ProcessBlock::CompareBinaryTxs(SmartBuf smartobj1, SmartBuf smartobj2)
+static int CheckBlockTx(DbConn *dbconn, TxPay& txbuf, BlockTxCheck& check, const uint64_t prior_blocktime)
 {
-	auto obj1 = (CCObject*)smartobj1.data();
-	auto obj2 = (CCObject*)smartobj2.data();
+	auto rc = BlockTxCheckPool::CheckPlainTx(check);
+	if (rc <= 0)
+	{
+		if (TEST_CUZZ) usleep(rand() & (1024*1024-1));
 
-	if (obj1->WireTag() != obj2->WireTag())
+		return rc;
+	}
+
+	rc = tx_from_wire(txbuf, (char*)check.wire, check.txsize);
+	if (rc)
 	{
-		BOOST_LOG_TRIVIAL(info) << "ProcessBlock::CompareBinaryTxs WireTag's differ";
+		BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate error parsing transaction";
+
+		auto save = txbuf.tag_type;
+		txbuf.tag_type = -1;
+		if (txbuf.tag_type == save)
+		{
+			lock_guard<mutex> lock(g_cerr_lock);
+			check_cerr_newline();
+			cerr << "WARNING: unrecognized block contents; please check if a newer software version is available" << endl;
+		}
 
 		return -1;
 	}
 
-	if (obj1->BodySize() != obj2->BodySize())
+	if (TEST_CUZZ) usleep(rand() & (1024*1024-1));
+
+	auto xtx = ProcessTx::ExtractXtx(dbconn, txbuf);
+	if (!xtx && ProcessTx::ExtractXtxFailed(txbuf, true)) return -1;
+
+	if (Xtx::TypeIsXreq(txbuf.tag_type))	// TODO: test this
 	{
-		BOOST_LOG_TRIVIAL(info) << "ProcessBlock::CompareBinaryTxs sizes differ";
+		auto xreq = Xreq::Cast(xtx);
 
-		return -1;
+		if (xreq->expire_time > prior_blocktime + XREQ_MAX_EXPIRE_TIME)
+		{
+			BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate xreq excess expire_time " << xreq->expire_time << " prior_blocktime " << prior_blocktime << " XREQ_MAX_EXPIRE_TIME " << XREQ_MAX_EXPIRE_TIME;
+
+			return -1;
+		}
+
+		if (xreq->expire_time <= prior_blocktime + xreq->hold_time + XREQ_MIN_POSTHOLD_TIME)
+		{
+			BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate expired xreq expire_time " << xreq->expire_time << " prior_blocktime " << prior_blocktime << " hold_time " << xreq->hold_time << " XREQ_MIN_POSTHOLD_TIME " << XREQ_MIN_POSTHOLD_TIME;
+
+			return -1;
+		}
+
+		if (xreq->foreign_address.length())
+		{
+			// this check doesn't depend on the other tx's in the block, so it can be done in parallel
+
+			auto rc = dbconn->XmatchingreqUniqueForeignAddressSelect(prior_blocktime, xreq->quote_asset, xreq->foreign_address);
+			if (rc <= 0)
+			{
+				BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate duplicate foreign_address " << xreq->foreign_address;
+
+				return -1;
+			}
+		}
 	}
 
-	if (memcmp(obj1->BodyPtr(), obj2->BodyPtr(), obj1->BodySize()))
+	if (Xtx::TypeIsXpay(txbuf.tag_type))	// TODO: test this
 	{
-		BOOST_LOG_TRIVIAL(info) << "ProcessBlock::CompareBinaryTxs binary objects differ";
+		auto xpay = Xpay::Cast(xtx);
 
-		return -1;
+		if (!xpay->match_timestamp)
+		{
+			BOOST_LOG_TRIVIAL(error) << "ProcessBlock::BlockValidate missing xpay.match_timestamp; " << xpay->DebugString();
+
+			return -1;
+		}
+
+		if (!xpay->payment_time)
+		{
+			BOOST_LOG_TRIVIAL(error) << "ProcessBlock::BlockValidate missing xpay.payment_time; " << xpay->DebugString();
+
+			return -1;
+		}
+
+		if (xpay->match_timestamp + xpay->payment_time < prior_blocktime)	// TODO: test this
+		{
+			BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate expired xpay match_timestamp " << xpay->match_timestamp << " payment_time " << xpay->payment_time << " prior_blocktime " << prior_blocktime;
+
+			return -1;
+		}
 	}
 
+	BlockChain::CheckCreatePseudoSerialnum(txbuf, xtx, check.wire);
+
+	check.serialnums.clear();
+
+	for (unsigned i = 0; i < txbuf.nin; ++i)
+		check.serialnums.push_back(txbuf.inputs[i].S_serialnum);
+
+	rc = BlockTxCheckPool::ExtractTx(check.wire, check.txsize, check.smartobj);
+	if (rc) return -1;
+
 	return 0;
 }
 
@@ -248,103 +387,38 @@ int ProcessBlock::BlockValidate(DbConn *dbconn, SmartBuf smartobj, TxPay& txbuf)
 
 	if (TRACE_PROCESS_BLOCK) BOOST_LOG_TRIVIAL(trace) << "ProcessBlock::BlockValidate block level " << wire->level.GetValue() << " bufp " << (uintptr_t)bufp << " objsize " << block->ObjSize() << " pdata " << (uintptr_t)pdata << " pend " << (uintptr_t)pend;
 
-	g_processtx.InitBlockScan();
-
-	auto p = pdata;
-	for (; p < pend; p += txsize)
-	{
-		if (g_shutdown)
-			return 1;
-
-		txsize = *(uint32_t*)p;
-
-		//if (TRACE_PROCESS_BLOCK) BOOST_LOG_TRIVIAL(trace) << "ProcessBlock::BlockValidate ptxdata " << (uintptr_t)p << " txsize " << txsize << " data " << buf2hex(p, 16);
-
-		auto rc = tx_from_wire(txbuf, (char*)p, txsize);
-		if (rc)
-		{
-			BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate error parsing transaction";
-
-			auto save = txbuf.tag_type;
-			txbuf.tag_type = -1;
-			if (txbuf.tag_type == save)
-			{
-				lock_guard<mutex> lock(g_cerr_lock);
-				check_cerr_newline();
-				cerr << "WARNING: unrecognized block contents; please check if a newer software version is available" << endl;
-			}
-
-			return -1;
-		}
+	auto t0 = chrono::steady_clock::now();
 
-		if (TEST_CUZZ) usleep(rand() & (1024*1024-1));
+	auto ntx = check_pool.Split((const char*)pdata, (const char*)pend);
 
-		auto xtx = ProcessTx::ExtractXtx(dbconn, txbuf);
-		if (!xtx && ProcessTx::ExtractXtxFailed(txbuf, true)) return -1;
+	check_prior_blocktime = prior_blocktime;
 
-		if (Xtx::TypeIsXreq(txbuf.tag_type))	// TODO: test this
-		{
-			auto xreq = Xreq::Cast(xtx);
+	NodeBlockTxChecker checker(dbconn, txbuf);
 
-			if (xreq->expire_time > prior_blocktime + XREQ_MAX_EXPIRE_TIME)
-			{
-				BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate xreq excess expire_time " << xreq->expire_time << " prior_blocktime " << prior_blocktime << " XREQ_MAX_EXPIRE_TIME " << XREQ_MAX_EXPIRE_TIME;
+	check_pool.Run(checker);
 
-				return -1;
-			}
+	auto t1 = chrono::steady_clock::now();
 
-			if (xreq->expire_time <= prior_blocktime + xreq->hold_time + XREQ_MIN_POSTHOLD_TIME)
-			{
-				BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate expired xreq expire_time " << xreq->expire_time << " prior_blocktime " << prior_blocktime << " hold_time " << xreq->hold_time << " XREQ_MIN_POSTHOLD_TIME " << XREQ_MIN_POSTHOLD_TIME;
-
-				return -1;
-			}
-
-			if (xreq->foreign_address.length())
-			{
-				auto rc = dbconn->XmatchingreqUniqueForeignAddressSelect(prior_blocktime, xreq->quote_asset, xreq->foreign_address);
-				if (rc <= 0)
-				{
-					BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate duplicate foreign_address " << xreq->foreign_address;
-
-					return -1;
-				}
-			}
-		}
-
-		if (Xtx::TypeIsXpay(txbuf.tag_type))	// TODO: test this
-		{
-			auto xpay = Xpay::Cast(xtx);
-
-			if (!xpay->match_timestamp)
-			{
-				BOOST_LOG_TRIVIAL(error) << "ProcessBlock::BlockValidate missing xpay.match_timestamp; " << xpay->DebugString();
-
-				return -1;
-			}
-
-			if (!xpay->payment_time)
-			{
-				BOOST_LOG_TRIVIAL(error) << "ProcessBlock::BlockValidate missing xpay.payment_time; " << xpay->DebugString();
+	g_processtx.InitBlockScan();
 
-				return -1;
-			}
+	// serial phase: the serialnums are checked and indexed in block order, so a serialnum that appears more than once
+	//	in the block is caught at its second appearance, and the first failure in block order determines the result
 
-			if (xpay->match_timestamp + xpay->payment_time < prior_blocktime)	// TODO: test this
-			{
-				BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate expired xpay match_timestamp " << xpay->match_timestamp << " payment_time " << xpay->payment_time << " prior_blocktime " << prior_blocktime;
+	for (unsigned t = 0; t < ntx; ++t)
+	{
+		if (g_shutdown)
+			return 1;
 
-				return -1;
-			}
-		}
+		auto& check = check_pool.GetCheck(t);
 
-		BlockChain::CheckCreatePseudoSerialnum(txbuf, xtx, p);
+		if (check.result)
+			return check.result;
 
-		for (unsigned i = 0; i < txbuf.nin; ++i)
+		for (auto& serialnum : check.serialnums)
 		{
 			if (TEST_CUZZ) usleep(rand() & (1024*1024-1));
 
-			auto rc = g_blockchain.CheckSerialnum(dbconn, priorobj, TEMP_SERIALS_PROCESS_BLOCKP, SmartBuf(), &txbuf.inputs[i].S_serialnum, TX_SERIALNUM_BYTES);
+			auto rc = g_blockchain.CheckSerialnum(dbconn, priorobj, TEMP_SERIALS_PROCESS_BLOCKP, SmartBuf(), &serialnum, TX_SERIALNUM_BYTES);
 
 			if (g_shutdown)
 				return 1;
@@ -359,7 +433,7 @@ int ProcessBlock::BlockValidate(DbConn *dbconn, SmartBuf smartobj, TxPay& txbuf)
 
 			if (TEST_CUZZ) usleep(rand() & (1024*1024-1));
 
-			auto rc2 = dbconn->TempSerialnumInsert(&txbuf.inputs[i].S_serialnum, TX_SERIALNUM_BYTES, (void*)TEMP_SERIALS_PROCESS_BLOCKP);
+			auto rc2 = dbconn->TempSerialnumInsert(&serialnum, TX_SERIALNUM_BYTES, (void*)TEMP_SERIALS_PROCESS_BLOCKP);
 			if (rc2)
 			{
 				BOOST_LOG_TRIVIAL(error) << "ProcessBlock::BlockValidate TempSerialnumInsert failure " << rc;
@@ -368,27 +442,25 @@ int ProcessBlock::BlockValidate(DbConn *dbconn, SmartBuf smartobj, TxPay& txbuf)
 			}
 		}
 
-		SmartBuf smartobj;
-		rc = ExtractTx((char*)p, txsize, smartobj);
-		if (rc) return -1;
-		CCASSERT(smartobj);
+		CCASSERT(check.smartobj);
+
+		g_processtx.TxEnqueueValidate(dbconn, true, false, PROCESS_Q_PRIORITY_BLOCK_TX, check.smartobj, 0, 0);
 
-		g_processtx.TxEnqueueValidate(dbconn, true, false, PROCESS_Q_PRIORITY_BLOCK_TX, smartobj, 0, 0);
+		check.smartobj = SmartBuf();
 	}
 
-	if (p != pend)
-	{
-		BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate end of block has " << (uintptr_t)pend - (uintptr_t)p << " extra bytes";
+	auto t2 = chrono::steady_clock::now();
 
-		return -1;
-	}
+	if (TRACE_PROCESS_BLOCK) BOOST_LOG_TRIVIAL(debug) << "ProcessBlock::BlockValidate block level " << wire->level.GetValue() << " ntx " << ntx << " threads " << check_pool.NThreads()
+			<< " parallel check usec " << chrono::duration_cast<chrono::microseconds>(t1 - t0).count()
+			<< " serialnum check usec " << chrono::duration_cast<chrono::microseconds>(t2 - t1).count();
 
 	if (!RandTest(RTEST_SKIP_TX_WAIT))
 		g_processtx.WaitForBlockTxValidation();
 	else
 		BOOST_LOG_TRIVIAL(info) << "ProcessBlock::BlockValidate skipping WaitForBlockTxValidation";
 
-	for (p = pdata; p < pend; p += txsize)
+	for (auto p = pdata; p < pend; p += txsize)
 	{
 		if (g_shutdown)
 			return 1;
@@ -521,6 +593,8 @@ void ProcessBlock::ThreadProc()
 {
 	static TxPay txbuf;	// not thread safe
 
+	CCThreadRoles::Apply("block");
+
 	BOOST_LOG_TRIVIAL(info) << "ProcessBlock::ThreadProc start dbconn " << (uintptr_t)dbconn;
 
 	while (true)
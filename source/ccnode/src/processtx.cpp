@@ -20,6 +20,7 @@
 
 #include <CCobjects.hpp>
 #include <CCmint.h>
+#include <CCthread.hpp>
 #include <transaction.hpp>
 #include <transaction.h>
 #include <xtransaction-xreq.hpp>
@@ -45,6 +46,12 @@
 #define TEST_DELAY_SOME_TXS		0	// don't test
 #endif
 
+//#define PROCESSTX_OID_LOCKS	1	// serialize all enqueues and commits on one lock
+
+#ifndef PROCESSTX_OID_LOCKS
+#define PROCESSTX_OID_LOCKS		64
+#endif
+
 #define FOREIGN_TX_PAST_ALLOWANCE		(4*3600)		// 4 hours	// TODO config this by blockchain
 #define FOREIGN_TX_FUTURE_ALLOWANCE		(2*3600)		// 2 hours	// TODO config this by blockchain
 
@@ -52,10 +59,24 @@
 
 ProcessTx g_processtx;
 
-static mutex processtx_mutex;
-static condition_variable processtx_condition_variable;
+// Enqueueing a tx and committing its validation result must each be atomic with respect to the same tx, so ValidObjs
+// and ProcessQ stay in sync.  Different txs don't interact here (conflicting serialnums are resolved when blocks are
+// built), so each tx only takes the lock selected by its object id, and results for different txs commit concurrently.
+
+static array<mutex, PROCESSTX_OID_LOCKS> processtx_oid_mutex;
+
+static mutex block_txs_mutex;
+static condition_variable block_txs_condition_variable;
 static atomic<int> block_txs_pending;
 
+static mutex& OidMutex(const ccoid_t *oid)
+{
+	uint32_t h;
+	memcpy(&h, oid, sizeof(h));		// oid is a hash, so any bits of it can be used
+
+	return processtx_oid_mutex[h % PROCESSTX_OID_LOCKS];
+}
+
 void ProcessTx::Init()
 {
 	if (g_params.tx_validation_threads <= 0)
@@ -76,9 +97,9 @@ void ProcessTx::Stop()
 
 	CCASSERT(g_shutdown);
 
-	lock_guard<mutex> lock(processtx_mutex);
+	lock_guard<mutex> lock(block_txs_mutex);
 
-	processtx_condition_variable.notify_all();
+	block_txs_condition_variable.notify_all();
 
 	DbConnProcessQ::StopQueuedWork(PROCESS_Q_TYPE_TX);
 
@@ -163,11 +184,11 @@ void ProcessTx::WaitForBlockTxValidation()
 {
 	if (TRACE_PROCESS_TX) BOOST_LOG_TRIVIAL(debug) << "ProcessTx::WaitForBlockTxValidation block_txs_pending " << block_txs_pending;
 
-	unique_lock<mutex> lock(processtx_mutex);
+	unique_lock<mutex> lock(block_txs_mutex);
 
 	while (block_txs_pending > 0 && !g_shutdown)
 	{
-		processtx_condition_variable.wait(lock);
+		block_txs_condition_variable.wait(lock);
 	}
 
 	if (TEST_CUZZ)
@@ -185,15 +206,15 @@ int ProcessTx::TxEnqueueValidate(DbConn *dbconn, bool is_block_tx, bool add_to_r
 
 	if (TEST_CUZZ) usleep(rand() & (1024*1024-1));
 
-	unique_lock<mutex> lock(processtx_mutex);
+	auto obj = (CCObject*)smartobj.data();
+	auto type = obj->ObjType();
+
+	unique_lock<mutex> lock(OidMutex(obj->OidPtr()));
 
 	if (TEST_CUZZ) usleep(rand() & (1024*1024-1));
 
 	// if tx is in valid obj's, then return 1 without enqueuing
 
-	auto obj = (CCObject*)smartobj.data();
-	auto type = obj->ObjType();
-
 	if (TRACE_XPAYS && Xtx::TypeIsXpay(type))  BOOST_LOG_TRIVIAL(info) << "ProcessTx::TxEnqueueValidate priority " << priority << " type " << type << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
 	else if (TRACE_PROCESS_TX)                BOOST_LOG_TRIVIAL(debug) << "ProcessTx::TxEnqueueValidate priority " << priority << " type " << type << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
 
@@ -1425,6 +1446,8 @@ int ProcessTx::TxValidate(DbConn *dbconn, TxPay& tx, SmartBuf smartobj, uint64_t
 
 void ProcessTx::ThreadProc()
 {
+	CCThreadRoles::Apply("validate");
+
 	auto dbconn = new DbConn;
 	auto ptx = new TxPay;
 
@@ -1518,7 +1541,7 @@ void ProcessTx::ThreadProc()
 
 			// the following operations are atomic, to ensure ValidObj's and ProcessQ stay in sync
 
-			lock_guard<mutex> lock(processtx_mutex);
+			lock_guard<mutex> lock(OidMutex(obj->OidPtr()));
 
 			if (validated)
 			{
@@ -1595,7 +1618,11 @@ void ProcessTx::ThreadProc()
 		{
 			if (TRACE_PROCESS_TX) BOOST_LOG_TRIVIAL(debug) << "ProcessTx block_txs_pending done";
 
-			processtx_condition_variable.notify_all();
+			{
+				lock_guard<mutex> lock(block_txs_mutex);	// so the notify can't slip in between the check and wait in WaitForBlockTxValidation
+			}
+
+			block_txs_condition_variable.notify_all();
 		}
 	}
 
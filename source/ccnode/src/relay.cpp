@@ -17,15 +17,20 @@
 #include "transact.hpp"
 #include "hostdir.hpp"
 #include "dbconn.hpp"
+#include "memaccount.hpp"
 #include "dbparamkeys.h"
 
 #include <CCobjects.hpp>
+#include <CCcrypto.hpp>
 #include <CCmint.h>
 #include <transaction.h>
 #include <xtransaction-xpay.hpp>
+#include <socks.hpp>
 #include <ccserver/server.hpp>
 #include <ccserver/connection_manager.hpp>
 
+#include <siphash/siphash.h>
+
 #define TRACE_RELAY		(g_params.trace_relay)
 
 #define RELAY_HEARTBEAT				100
@@ -39,6 +44,9 @@
 #define RELAY_TIMESTAMP_PAST_ALLOWANCE		(60*60) // >= TRANSACT_TIMESTAMP_PAST_ALLOWANCE + relay expire_age + 10
 #define RELAY_TIMESTAMP_FUTURE_ALLOWANCE	(10*60)
 
+#define RELAY_COMPACT_CACHE_SIZE			4		// number of recently built compact blocks kept for the other connections
+#define RELAY_COMPACT_SCAN_SIZE				100		// number of Valid_Objs fetched at a time when matching short tx id's
+
 //!#define TEST_CUZZ					1
 //!#define RTEST_NO_SEND_TX				4
 //!#define RTEST_NO_SEND_BLOCK			16
@@ -87,17 +95,69 @@ static const uint32_t Bad_Cmd_Reply[2] =				{CC_MSG_HEADER_SIZE, CC_ERROR_BAD_CM
 //static const uint32_t Bad_Param_Reply[2] =			{CC_MSG_HEADER_SIZE, CC_ERROR_BAD_PARAM};
 static const uint32_t No_Obj_Reply[2] =				{CC_MSG_HEADER_SIZE, CC_NO_OBJ};
 //static const uint32_t Send_Q_Reset_Reply[2] =		{CC_MSG_HEADER_SIZE, CC_ERROR_SEND_Q_RESET};
+static const uint32_t Compact_Blocks_Ok_Msg[2] =		{CC_MSG_HEADER_SIZE, CC_MSG_COMPACT_BLOCKS_OK};
+
+/*
+
+A compact block carries the block's object header and wire header, followed by a short id and size for each tx in the block.
+The short id is the siphash of the tx oid keyed with a random salt chosen by the sender, so the short id's can't be predicted
+when the tx's are created. The receiver matches the short id's against the tx's in its Valid_Objs, rebuilds the block, and
+requests the tx's it doesn't have with a CC_CMD_SEND_BLOCK_TXS, which the sender answers with a CC_MSG_BLOCK_TXS containing
+the requested tx's exactly as they appear in the block. The rebuilt block must then match the oid of the requested block.
+
+*/
+
+struct CompactBlockMsgHeader
+{
+	uint32_t size;
+	uint32_t tag;
+	uint64_t salt;
+	uint32_t ntx;
+	CCObject::Header block_header;
+	BlockWireHeader wire;
+};
+
+struct CompactBlockTxEntry
+{
+	uint64_t shortid;
+	uint32_t size;
+};
+
+struct BlockTxsMsgHeader
+{
+	uint32_t size;
+	uint32_t tag;
+	ccoid_t oid;		// oid of the block
+	uint32_t ntx;		// followed by ntx uint32_t tx indexes in a CC_CMD_SEND_BLOCK_TXS, or ntx tx's in a CC_MSG_BLOCK_TXS
+};
 
 #pragma pack(pop)
 
 thread_local static DbConn *relay_dbconn;
 
+static FastSpinLock compact_cache_lock(__FILE__, __LINE__);
+static array<pair<ccoid_t, SmartBuf>, RELAY_COMPACT_CACHE_SIZE> compact_cache;
+static unsigned compact_cache_next;
+
+static atomic<uint64_t> compact_blocks_sent(0);
+static atomic<uint64_t> compact_blocks_rebuilt(0);
+static atomic<uint64_t> compact_blocks_failed(0);
+static atomic<uint64_t> compact_txs_found(0);
+static atomic<uint64_t> compact_txs_requested(0);
+
 void RelayConnection::StartConnection()
 {
 	if (TRACE_RELAY) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " RelayConnection::StartConnection";
 
 	m_conn_state = CONN_CONNECTED;
 
+	if (m_outgoing_host.length())
+	{
+		g_hostdir.ReportConnect(HostDir::Relay, m_outgoing_host, true, m_tor_pooled ? -1 : ccticks_elapsed(m_tor_connect_ticks, ccticks()));
+
+		m_outgoing_host.clear();
+	}
+
 	if (private_peer_index >= 0)
 		g_privrelay_service.PrivateConnected(private_peer_index);
 
@@ -121,10 +181,29 @@ void RelayConnection::StartConnection()
 	send_queue.clear();
 	send_one.clear();
 
+	peer_compact_blocks.store(false);
+
+	{
+		lock_guard<FastSpinLock> lock(compact_pending_lock);
+
+		for (auto& pending : compact_pending)
+			g_memaccount.Sub(MEMTAG_RELAY_QUEUES, pending.smartobj);
+
+		compact_pending.clear();
+	}
+
 	if (SetHeartbeatTimer())
 		return;
 
 	StartRead();
+
+	if (g_params.relay_compact_blocks)
+	{
+		// peers that don't recognize this message ignore it
+
+		WriteAsync("RelayConnection::StartConnection", boost::asio::buffer(Compact_Blocks_Ok_Msg, sizeof(Compact_Blocks_Ok_Msg)),
+				boost::bind(&Connection::HandleWrite, this, boost::asio::placeholders::error, AutoCount(this)));
+	}
 }
 
 void RelayConnection::HandleReadComplete()
@@ -162,10 +241,13 @@ void RelayConnection::HandleReadComplete()
 	case CC_TAG_XCX_SIMPLE_SELL:
 	case CC_TAG_XCX_SIMPLE_TRADE:
 	case CC_TAG_XCX_PAYMENT:
+	case CC_MSG_COMPACT_BLOCK:
+	case CC_MSG_BLOCK_TXS:
+	case CC_CMD_SEND_BLOCK_TXS:
 	{
 		CCASSERT(CC_MSG_HEADER_SIZE == sizeof(CCObject::Header));
 
-		smartobj = SmartBuf(size + sizeof(CCObject::Preamble));
+		smartobj = SmartBuf(size + sizeof(CCObject::Preamble), false);	// filled by the read
 		if (!smartobj)
 		{
 			BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleReadComplete error smartobj failed";
@@ -323,6 +405,13 @@ void RelayConnection::HandleMsgReadComplete(const boost::system::error_code& e,
 				continue;
 			}
 
+			if (tag == CC_MSG_HAVE_TX && g_memaccount.OverHardBudget())
+			{
+				BOOST_LOG_TRIVIAL(debug) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleMsgReadComplete CC_MSG_HAVE_TX skipping download of tx because the hard memory budget is exceeded";
+
+				continue;
+			}
+
 			#if RTEST_DELAY_BLOCKS && RTEST_DELAY_TXS
 			#error both RTEST_DELAY_BLOCKS and RTEST_DELAY_TXS are set
 			#endif
@@ -346,6 +435,7 @@ void RelayConnection::HandleMsgReadComplete(const boost::system::error_code& e,
 	}
 
 	case CC_CMD_SEND_BLOCK:
+	case CC_CMD_SEND_COMPACT_BLOCK:
 	case CC_CMD_SEND_TX:
 	{
 		unsigned nobjs = (msgsize - CC_MSG_HEADER_SIZE) / sizeof(ccoid_t);
@@ -388,7 +478,11 @@ void RelayConnection::HandleMsgReadComplete(const boost::system::error_code& e,
 
 			BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleMsgReadComplete tag " << hex << tag << dec << " oid " << buf2hex(poid, CC_OID_TRACE_SIZE);
 
-			auto rc = send_queue.push(poid, sizeof(ccoid_t));
+			relay_send_entry_t entry;
+			memcpy(&entry.oid, poid, sizeof(ccoid_t));
+			entry.compact = (tag == CC_CMD_SEND_COMPACT_BLOCK);
+
+			auto rc = send_queue.push(&entry, sizeof(entry));
 			if (rc)
 			{
 				BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleMsgReadComplete error queuing tag " << hex << tag << dec << " oid " << buf2hex(poid, CC_OID_TRACE_SIZE);
@@ -405,7 +499,7 @@ void RelayConnection::HandleMsgReadComplete(const boost::system::error_code& e,
 
 			lock.unlock();	// unlock this after taking next_writer_mutex, so replies don't get out of order
 
-			auto msgbuf = SmartBuf(sizeof(Success_Reply_Queue_Len));
+			auto msgbuf = SmartBuf(sizeof(Success_Reply_Queue_Len), false);
 			if (!msgbuf)
 			{
 				BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleMsgReadComplete error msgbuf failed";
@@ -455,6 +549,37 @@ void RelayConnection::HandleMsgReadComplete(const boost::system::error_code& e,
 	}
 #endif
 
+	case CC_MSG_COMPACT_BLOCKS_OK:
+
+		if (TRACE_RELAY) BOOST_LOG_TRIVIAL(debug) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleMsgReadComplete received CC_MSG_COMPACT_BLOCKS_OK";
+
+		peer_compact_blocks.store(true);
+
+		break;
+
+	case CC_MSG_COMPACT_BLOCK:
+
+		if (HandleCompactBlock(msgsize))
+			return Stop();
+
+		objs_pending = request_objs_pending.load();	// so we'll CheckForDownload
+
+		break;
+
+	case CC_CMD_SEND_BLOCK_TXS:
+
+		if (SendBlockTxs(msgsize))
+			return Stop();
+
+		break;
+
+	case CC_MSG_BLOCK_TXS:
+
+		if (HandleBlockTxs(msgsize))
+			return Stop();
+
+		break;
+
 	case CC_NO_OBJ:
 	{
 		int64_t bytes_pending;
@@ -835,6 +960,95 @@ void RelayConnection::HandleMsgReadComplete(const boost::system::error_code& e,
 		CheckForDownload();
 }
 
+// returns a CC_MSG_COMPACT_BLOCK for the block, or an empty SmartBuf if the block should be sent in full
+
+static SmartBuf GetCompactBlock(const ccoid_t& oid, SmartBuf smartobj)
+{
+	{
+		lock_guard<FastSpinLock> lock(compact_cache_lock);
+
+		for (auto& entry : compact_cache)
+		{
+			if (entry.second && !memcmp(&entry.first, &oid, sizeof(ccoid_t)))
+				return entry.second;
+		}
+	}
+
+	auto block = (Block*)smartobj.data();
+
+	if (block->BodySize() < sizeof(BlockWireHeader))
+		return SmartBuf();
+
+	auto pdata = block->TxData();
+	auto pend = block->ObjEndPtr();
+	unsigned ntx = 0;
+
+	for (auto p = pdata; p < pend; ++ntx)
+	{
+		// only tx's can be matched by short id; anything else means the block is sent in full
+
+		if ((unsigned)(pend - p) < CC_MSG_HEADER_SIZE)
+			return SmartBuf();
+
+		auto txsize = *(uint32_t*)p;
+		auto txtag = *(uint32_t*)(p + 4);
+
+		if (txsize < CC_MSG_HEADER_SIZE || txsize > (unsigned)(pend - p) || !CCObject::HasPOW(CCObject::WireTag(txtag)))
+			return SmartBuf();
+
+		p += txsize;
+	}
+
+	unsigned msgsize = sizeof(CompactBlockMsgHeader) + ntx * sizeof(CompactBlockTxEntry);
+
+	if (!ntx || msgsize >= block->ObjSize())
+		return SmartBuf();
+
+	SmartBuf msgbuf(msgsize + sizeof(CCObject::Preamble));
+	if (!msgbuf)
+		return SmartBuf();
+
+	auto msg = (CompactBlockMsgHeader*)((CCObject*)msgbuf.data())->ObjPtr();
+	auto entries = (CompactBlockTxEntry*)(msg + 1);
+
+	msg->size = msgsize;
+	msg->tag = CC_MSG_COMPACT_BLOCK;
+	CCRandom(&msg->salt, sizeof(msg->salt));
+	msg->ntx = ntx;
+	memcpy(&msg->block_header, block->ObjPtr(), sizeof(CCObject::Header));
+	memcpy(&msg->wire, block->WireData(), sizeof(BlockWireHeader));
+
+	unsigned i = 0;
+
+	for (auto p = pdata; p < pend; ++i)
+	{
+		ccoid_t txoid;
+
+		CCObject::ComputeMessageObjId(p, &txoid);
+
+		entries[i].shortid = siphash(&txoid, sizeof(txoid), &msg->salt, sizeof(msg->salt));
+		entries[i].size = *(uint32_t*)p;
+
+		p += entries[i].size;
+	}
+
+	CCASSERT(i == ntx);
+
+	lock_guard<FastSpinLock> lock(compact_cache_lock);
+
+	if (compact_cache[compact_cache_next].second)
+		g_memaccount.Sub(MEMTAG_RELAY_QUEUES, compact_cache[compact_cache_next].second);
+
+	g_memaccount.Add(MEMTAG_RELAY_QUEUES, msgbuf);
+
+	memcpy(&compact_cache[compact_cache_next].first, &oid, sizeof(ccoid_t));
+	compact_cache[compact_cache_next].second = msgbuf;
+
+	compact_cache_next = (compact_cache_next + 1) % RELAY_COMPACT_CACHE_SIZE;
+
+	return msgbuf;
+}
+
 void RelayConnection::CheckToSend()
 {
 	if (send_one.test_and_set())		// make sure only one thread is sending so the send_queue objects are sent in the order they were queued
@@ -849,12 +1063,13 @@ void RelayConnection::CheckToSend()
 	while (!g_shutdown)
 	{
 		ccoid_t oid;
+		bool compact;
 
 		{
 			lock_guard<FastSpinLock> lock(send_queue_lock);
 
-			auto oidp = send_queue.pop(sizeof(ccoid_t));
-			if (!oidp)
+			auto entryp = (relay_send_entry_t*)send_queue.pop(sizeof(relay_send_entry_t));
+			if (!entryp)
 			{
 				if (TRACE_RELAY) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " RelayConnection::CheckToSend nothing in queue";
 
@@ -863,7 +1078,8 @@ void RelayConnection::CheckToSend()
 				return;
 			}
 
-			memcpy(&oid, oidp, sizeof(ccoid_t));
+			memcpy(&oid, &entryp->oid, sizeof(ccoid_t));
+			compact = entryp->compact;
 		}
 
 		SmartBuf smartobj;
@@ -905,6 +1121,23 @@ void RelayConnection::CheckToSend()
 			}
 			//if (TRACE_RELAY) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " RelayConnection::CheckToSend sending CC_TAG_BLOCK size " << obj->ObjSize() << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE); // << " block dump " << buf2hex(obj, obj->ObjSize());
 			if (TEST_DOUBLECHECK_BLOCK_OIDS) ((Block*)obj)->SetOrVerifyOid(false);
+
+			if (compact && g_params.relay_compact_blocks)
+			{
+				auto msgbuf = GetCompactBlock(oid, smartobj);
+				if (msgbuf)
+				{
+					smartobj = msgbuf;
+					obj = (CCObject*)smartobj.data();
+
+					if (TRACE_RELAY) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " RelayConnection::CheckToSend sending CC_MSG_COMPACT_BLOCK size " << obj->ObjSize() << " instead of block size " << size << " oid " << buf2hex(&oid, CC_OID_TRACE_SIZE);
+
+					size = obj->ObjSize();
+
+					compact_blocks_sent.fetch_add(1);
+				}
+			}
+
 			break;
 
 		case CC_TAG_TX:
@@ -968,6 +1201,478 @@ void RelayConnection::HandleObjWrite(const boost::system::error_code& e, SmartBu
 	CheckToSend();
 }
 
+// pops the request queue up to and including the entry for a block received as a CC_MSG_COMPACT_BLOCK
+// returns true if the connection should be stopped
+
+bool RelayConnection::PopBlockRequest(uint32_t blocksize, const BlockWireHeader *wire, relay_request_params_extended_t& req_params)
+{
+	while (true)
+	{
+		{
+			lock_guard<FastSpinLock> lock(request_queue_lock);
+
+			auto params = (relay_request_params_extended_t*)request_param_queue.pop(sizeof(relay_request_params_extended_t));
+			if (!params)
+			{
+				BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::PopBlockRequest error received CC_MSG_COMPACT_BLOCK but no matching block found in request queue";
+
+				return true;
+			}
+
+			memcpy(&req_params, params, sizeof(req_params));
+
+			auto objs_pending = request_objs_pending.fetch_sub(1) - 1;
+			auto bytes_pending = request_bytes_pending.fetch_sub(req_params.size) - req_params.size;
+
+			CCASSERT(objs_pending >= 0);
+			CCASSERT(bytes_pending >= 0);
+		}
+
+		if (memcmp(&req_params.prior_oid, &wire->prior_oid, sizeof(ccoid_t))
+			|| req_params.level != wire->level.GetValue()
+			|| req_params.witness != wire->witness
+			|| req_params.size != blocksize)
+		{
+			BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " RelayConnection::PopBlockRequest requested block level " << req_params.level << " witness " << (unsigned)req_params.witness << " size " << req_params.size << " prior oid " << buf2hex(&req_params.prior_oid, CC_OID_TRACE_SIZE) << " != compact block level " << wire->level.GetValue() << " witness " << (unsigned)wire->witness << " size " << blocksize << " prior oid " << buf2hex(&wire->prior_oid, CC_OID_TRACE_SIZE);
+
+			continue;	// assume this requested object will not be sent, but check if the received block matches a later request
+		}
+
+		lock_guard<FastSpinLock> lock(request_queue_lock);
+
+		last_valid_obj_time = unixtime();
+
+		return false;
+	}
+}
+
+bool RelayConnection::HandleCompactBlock(unsigned msgsize)
+{
+	auto msg = (const CompactBlockMsgHeader*)m_pread;
+
+	if (msgsize < sizeof(CompactBlockMsgHeader) || (msgsize - sizeof(CompactBlockMsgHeader)) / sizeof(CompactBlockTxEntry) != msg->ntx
+		|| (msgsize - sizeof(CompactBlockMsgHeader)) % sizeof(CompactBlockTxEntry) || !msg->ntx)
+	{
+		BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleCompactBlock error invalid msg size " << msgsize;
+
+		return true;
+	}
+
+	unsigned ntx = msg->ntx;
+	auto entries = (const CompactBlockTxEntry*)(msg + 1);
+	uint64_t blocksize = CC_MSG_HEADER_SIZE + sizeof(BlockWireHeader);
+
+	for (unsigned i = 0; i < ntx; ++i)
+	{
+		if (entries[i].size < CC_MSG_HEADER_SIZE || entries[i].size > CC_BLOCK_MAX_SIZE)
+		{
+			BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleCompactBlock error invalid tx size " << entries[i].size;
+
+			return true;
+		}
+
+		blocksize += entries[i].size;
+	}
+
+	if (msg->block_header.tag != CC_TAG_BLOCK || msg->block_header.size != blocksize || blocksize > CC_BLOCK_MAX_SIZE)
+	{
+		BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleCompactBlock error block tag " << hex << msg->block_header.tag << dec << " size " << msg->block_header.size << " tx's size " << blocksize;
+
+		return true;
+	}
+
+	CompactBlockPending pending;
+
+	if (PopBlockRequest(blocksize, &msg->wire, pending.req_params))
+		return true;
+
+	BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleCompactBlock received CC_MSG_COMPACT_BLOCK size " << msgsize << " block size " << blocksize << " ntx " << ntx << " level " << msg->wire.level.GetValue() << " oid " << buf2hex(&pending.req_params.oid, CC_OID_TRACE_SIZE);
+
+	pending.smartobj = SmartBuf(blocksize + sizeof(CCObject::Preamble));
+	if (!pending.smartobj)
+	{
+		BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleCompactBlock error smartobj failed";
+
+		return true;
+	}
+
+	auto block = (Block*)pending.smartobj.data();
+
+	memcpy(block->ObjPtr(), &msg->block_header, sizeof(CCObject::Header));
+	memcpy(block->WireData(), &msg->wire, sizeof(BlockWireHeader));
+
+	pending.request_ticks = ccticks();
+
+	FillCompactBlockTxs(msg->salt, entries, ntx, pending);
+
+	if (pending.missing_index.empty())
+		return FinishCompactBlock(pending);
+
+	// ask the peer for the tx's we don't have
+
+	unsigned nmissing = pending.missing_index.size();
+	unsigned reqsize = sizeof(BlockTxsMsgHeader) + nmissing * sizeof(uint32_t);
+
+	SmartBuf reqbuf(reqsize);
+	if (!reqbuf)
+	{
+		BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleCompactBlock error reqbuf failed";
+
+		return true;
+	}
+
+	auto req = (BlockTxsMsgHeader*)reqbuf.data();
+
+	req->size = reqsize;
+	req->tag = CC_CMD_SEND_BLOCK_TXS;
+	memcpy(&req->oid, &pending.req_params.oid, sizeof(ccoid_t));
+	req->ntx = nmissing;
+	memcpy(req + 1, pending.missing_index.data(), nmissing * sizeof(uint32_t));
+
+	if (TRACE_RELAY) BOOST_LOG_TRIVIAL(debug) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleCompactBlock requesting " << nmissing << " of " << ntx << " tx's for block oid " << buf2hex(&pending.req_params.oid, CC_OID_TRACE_SIZE);
+
+	{
+		lock_guard<FastSpinLock> lock(compact_pending_lock);
+
+		g_memaccount.Add(MEMTAG_RELAY_QUEUES, pending.smartobj);
+
+		compact_pending.push_back(move(pending));
+	}
+
+	WriteAsync("RelayConnection::HandleCompactBlock", boost::asio::buffer(reqbuf.data(), reqsize),
+			boost::bind(&Connection::HandleWriteSmartBuf, this, boost::asio::placeholders::error, reqbuf, AutoCount(this)));
+
+	return false;
+}
+
+// fills in the block's tx's that can be found in Valid_Objs by short id, and records the tx's that need to be requested from the peer
+
+void RelayConnection::FillCompactBlockTxs(uint64_t salt, const void *entries, unsigned ntx, CompactBlockPending& pending)
+{
+	static const unsigned types[] = {TXSEQ, XREQSEQ};
+
+	auto entryp = (const CompactBlockTxEntry*)entries;
+	auto block = (Block*)pending.smartobj.data();
+
+	vector<pair<uint64_t, unsigned>> shortids(ntx);		// sorted by short id so the Valid_Objs can be looked up with a binary search
+	vector<uint32_t> offsets(ntx);
+	vector<bool> found(ntx);
+	unsigned nfound = 0;
+
+	uint32_t offset = CC_MSG_HEADER_SIZE + sizeof(BlockWireHeader);
+
+	for (unsigned i = 0; i < ntx; ++i)
+	{
+		shortids[i] = make_pair(entryp[i].shortid, i);
+
+		offsets[i] = offset;
+		offset += entryp[i].size;
+	}
+
+	sort(shortids.begin(), shortids.end());
+
+	for (auto type : types)
+	{
+		auto next_seqnum = g_seqnum[type][VALIDSEQ].seqmin;
+
+		while (nfound < ntx && !g_shutdown)
+		{
+			array<DbConnValidObjs::ValidObjSeqnumObjPair, RELAY_COMPACT_SCAN_SIZE> objarray;
+
+			auto nobjs = relay_dbconn->ValidObjsFindNew(next_seqnum, g_seqnum[type][VALIDSEQ].seqmax, RELAY_COMPACT_SCAN_SIZE, false, (uint8_t*)&objarray, RELAY_COMPACT_SCAN_SIZE);
+			if (nobjs > RELAY_COMPACT_SCAN_SIZE)
+				break;
+
+			for (unsigned j = 0; j < nobjs && nfound < ntx; ++j)
+			{
+				auto obj = (CCObject*)objarray[j].smartobj.data();
+				if (!obj || !obj->HasPOW())
+					continue;
+
+				auto shortid = siphash(obj->OidPtr(), sizeof(ccoid_t), &salt, sizeof(salt));
+				uint32_t txsize = obj->BodySize() + CC_MSG_HEADER_SIZE;
+				unsigned i = ntx;
+
+				for (auto it = lower_bound(shortids.begin(), shortids.end(), make_pair(shortid, 0U)); it != shortids.end() && it->first == shortid; ++it)
+				{
+					if (!found[it->second] && entryp[it->second].size == txsize)
+					{
+						i = it->second;
+
+						break;
+					}
+				}
+
+				if (i >= ntx)
+					continue;
+
+				auto p = block->ObjPtr() + offsets[i];
+				uint32_t txtag = obj->BlockTag();
+
+				memcpy(p, &txsize, sizeof(txsize));
+				memcpy(p + 4, &txtag, sizeof(txtag));
+				memcpy(p + CC_MSG_HEADER_SIZE, obj->BodyPtr(), obj->BodySize());
+
+				found[i] = true;
+				++nfound;
+			}
+
+			if (nobjs < RELAY_COMPACT_SCAN_SIZE)
+				break;
+		}
+	}
+
+	for (unsigned i = 0; i < ntx; ++i)
+	{
+		if (!found[i])
+		{
+			pending.missing_index.push_back(i);
+			pending.missing_offset.push_back(offsets[i]);
+			pending.missing_size.push_back(entryp[i].size);
+		}
+	}
+
+	compact_txs_found.fetch_add(nfound);
+	compact_txs_requested.fetch_add(ntx - nfound);
+}
+
+// returns true if the connection should be stopped
+
+bool RelayConnection::FinishCompactBlock(CompactBlockPending& pending)
+{
+	auto smartobj = pending.smartobj;
+	auto& req_params = pending.req_params;
+	auto block = (Block*)smartobj.data();
+	auto wire = block->WireData();
+
+	block_hash_t block_hash;
+	ccoid_t oid;
+
+	block->CalcHash(block_hash);
+	block->CalcOid(block_hash, oid);
+
+	if (TEST_SEQ_BLOCK_OID)
+		memcpy(&oid, &req_params.oid, sizeof(ccoid_t));
+
+	if (memcmp(&req_params.oid, &oid, sizeof(ccoid_t)))
+	{
+		// a short id collision or a bad peer; the block will be downloaded again
+
+		BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::FinishCompactBlock error requested block oid " << buf2hex(&req_params.oid, CC_OID_TRACE_SIZE) << " != rebuilt block oid " << buf2hex(&oid, CC_OID_TRACE_SIZE);
+
+		compact_blocks_failed.fetch_add(1);
+
+		return false;
+	}
+
+	auto auxp = block->SetupAuxBuf(smartobj, true);
+	if (!auxp)
+	{
+		BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " RelayConnection::FinishCompactBlock error SetupAuxBuf failed";
+
+		return true;
+	}
+
+	auxp->SetHash(block_hash);
+	auxp->SetOid(oid);
+
+	auxp->announce_ticks = req_params.announce_ticks;
+
+	{
+		lock_guard<FastSpinLock> lock(request_queue_lock);
+
+		last_valid_obj_time = unixtime();
+	}
+
+	auto rebuilt = compact_blocks_rebuilt.fetch_add(1) + 1;
+
+	if (TRACE_RELAY) BOOST_LOG_TRIVIAL(debug) << Name() << " Conn " << m_conn_index << " RelayConnection::FinishCompactBlock rebuilt block level " << wire->level.GetValue() << " size " << block->ObjSize() << " requested " << pending.missing_index.size() << " tx's; announce to rebuilt " << ccticks_elapsed(req_params.announce_ticks, ccticks()) << " ms; totals sent " << compact_blocks_sent.load() << " rebuilt " << rebuilt << " failed " << compact_blocks_failed.load() << " tx's found " << compact_txs_found.load() << " requested " << compact_txs_requested.load() << " oid " << buf2hex(&oid, CC_OID_TRACE_SIZE);
+
+	relay_dbconn->RelayObjsSetStatus(oid, RELAY_STATUS_DOWNLOADED, 0);
+
+	relay_dbconn->ProcessQEnqueueValidate(PROCESS_Q_TYPE_BLOCK, smartobj, &wire->prior_oid, wire->level.GetValue(), PROCESS_Q_STATUS_PENDING, PROCESS_Q_PRIORITY_BLOCK, false, m_conn_index, m_use_count.load());
+
+	return false;
+}
+
+// replies to a CC_CMD_SEND_BLOCK_TXS with the requested tx's exactly as they appear in the block
+// returns true if the connection should be stopped
+
+bool RelayConnection::SendBlockTxs(unsigned msgsize)
+{
+	auto msg = (const BlockTxsMsgHeader*)m_pread;
+
+	if (msgsize < sizeof(BlockTxsMsgHeader) || (msgsize - sizeof(BlockTxsMsgHeader)) / sizeof(uint32_t) != msg->ntx
+		|| (msgsize - sizeof(BlockTxsMsgHeader)) % sizeof(uint32_t))
+	{
+		BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::SendBlockTxs error invalid msg size " << msgsize;
+
+		return true;
+	}
+
+	unsigned ntx = msg->ntx;
+	auto indexes = (const uint32_t*)(msg + 1);
+
+	for (unsigned k = 1; k < ntx; ++k)
+	{
+		if (indexes[k] <= indexes[k-1])
+		{
+			BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::SendBlockTxs error tx indexes not in ascending order";
+
+			return true;
+		}
+	}
+
+	SmartBuf hdrbuf(sizeof(BlockTxsMsgHeader));
+	if (!hdrbuf)
+	{
+		BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " RelayConnection::SendBlockTxs error hdrbuf failed";
+
+		return true;
+	}
+
+	auto reply = (BlockTxsMsgHeader*)hdrbuf.data();
+	auto writebufs = make_shared<CCServer::WriteBuffers>();
+
+	writebufs->Add(hdrbuf, 0, sizeof(BlockTxsMsgHeader));
+
+	reply->tag = CC_MSG_BLOCK_TXS;
+	memcpy(&reply->oid, &msg->oid, sizeof(ccoid_t));
+	reply->ntx = 0;
+
+	SmartBuf smartobj;
+
+	auto rc = relay_dbconn->ValidObjsGetObj(msg->oid, &smartobj);
+	if (!rc && ntx && ((CCObject*)smartobj.data())->ObjTag() == CC_TAG_BLOCK)
+	{
+		// the block is sent straight from its buffer; the reply stays empty if the block is no longer in Valid_Objs
+
+		auto block = (Block*)smartobj.data();
+		auto pdata = block->TxData();
+		auto pend = block->ObjEndPtr();
+		unsigned k = 0;
+
+		for (unsigned i = 0; pdata + CC_MSG_HEADER_SIZE <= pend && k < ntx; ++i)
+		{
+			auto txsize = *(uint32_t*)pdata;
+			if (txsize < CC_MSG_HEADER_SIZE || txsize > (unsigned)(pend - pdata))
+				break;
+
+			if (indexes[k] == i)
+			{
+				writebufs->Add(smartobj, pdata - smartobj.data(), txsize);
+				++k;
+			}
+
+			pdata += txsize;
+		}
+
+		if (k < ntx)
+		{
+			BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::SendBlockTxs error tx index " << indexes[k] << " not found in block oid " << buf2hex(&msg->oid, CC_OID_TRACE_SIZE);
+
+			return true;
+		}
+
+		reply->ntx = ntx;
+	}
+
+	reply->size = writebufs->TotalSize();
+
+	if (TRACE_RELAY) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " RelayConnection::SendBlockTxs sending CC_MSG_BLOCK_TXS ntx " << reply->ntx << " of " << ntx << " requested size " << reply->size << " block oid " << buf2hex(&msg->oid, CC_OID_TRACE_SIZE);
+
+	WriteAsync("RelayConnection::SendBlockTxs", writebufs,
+			boost::bind(&Connection::HandleWrite, this, boost::asio::placeholders::error, AutoCount(this)));
+
+	return false;
+}
+
+// returns true if the connection should be stopped
+
+bool RelayConnection::HandleBlockTxs(unsigned msgsize)
+{
+	auto msg = (const BlockTxsMsgHeader*)m_pread;
+
+	if (msgsize < sizeof(BlockTxsMsgHeader))
+	{
+		BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleBlockTxs error invalid msg size " << msgsize;
+
+		return true;
+	}
+
+	CompactBlockPending pending;
+
+	{
+		lock_guard<FastSpinLock> lock(compact_pending_lock);
+
+		auto it = compact_pending.begin();
+
+		while (it != compact_pending.end() && memcmp(&it->req_params.oid, &msg->oid, sizeof(ccoid_t)))
+			++it;
+
+		if (it == compact_pending.end())
+		{
+			BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleBlockTxs error received CC_MSG_BLOCK_TXS for unrequested block oid " << buf2hex(&msg->oid, CC_OID_TRACE_SIZE);
+
+			return true;
+		}
+
+		pending = move(*it);
+
+		compact_pending.erase(it);
+
+		g_memaccount.Sub(MEMTAG_RELAY_QUEUES, pending.smartobj);
+	}
+
+	if (!msg->ntx)
+	{
+		// the peer no longer has the block; it will be downloaded again
+
+		BOOST_LOG_TRIVIAL(debug) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleBlockTxs peer did not send tx's for block oid " << buf2hex(&msg->oid, CC_OID_TRACE_SIZE);
+
+		compact_blocks_failed.fetch_add(1);
+
+		return false;
+	}
+
+	auto nmissing = pending.missing_index.size();
+	auto block = (Block*)pending.smartobj.data();
+	auto pdata = (const uint8_t*)(msg + 1);
+	auto pend = (const uint8_t*)m_pread + msgsize;
+
+	if (msg->ntx != nmissing)
+	{
+		BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleBlockTxs error received " << msg->ntx << " tx's != requested " << nmissing;
+
+		return true;
+	}
+
+	for (unsigned k = 0; k < nmissing; ++k)
+	{
+		auto txsize = pending.missing_size[k];
+
+		if ((unsigned)(pend - pdata) < txsize || *(uint32_t*)pdata != txsize)
+		{
+			BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleBlockTxs error tx " << pending.missing_index[k] << " expected size " << txsize;
+
+			return true;
+		}
+
+		memcpy(block->ObjPtr() + pending.missing_offset[k], pdata, txsize);
+
+		pdata += txsize;
+	}
+
+	if (pdata != pend)
+	{
+		BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleBlockTxs error msg size " << msgsize << " has " << pend - pdata << " extra bytes";
+
+		return true;
+	}
+
+	return FinishCompactBlock(pending);
+}
+
 void RelayConnection::CheckForDownload()
 {
 	if (request_msg_buf_in_use.test_and_set())
@@ -998,6 +1703,9 @@ void RelayConnection::CheckForDownload()
 
 	relay_dbconn->RelayObjsFindDownloads(m_conn_index, g_blockchain.GetLastIndelibleLevel(), &request_msg_buf[0], sizeof(request_msg_buf), req_param_buf, CC_TX_SEND_MAX - RELAY_DOWNLOAD_HIGH_WATER - objs_pending, request_bytes_pending.load(), have_blocks, nobjs, nbytes);
 
+	if (nbytes && have_blocks && g_params.relay_compact_blocks && peer_compact_blocks.load())
+		*(uint32_t*)(&request_msg_buf[4]) = CC_CMD_SEND_COMPACT_BLOCK;
+
 	if (nobjs)
 	{
 		lock_guard<FastSpinLock> lock(request_queue_lock);
@@ -1099,6 +1807,17 @@ void RelayConnection::HandleHeartbeat(const boost::system::error_code& e, AutoCo
 		}
 	}
 
+	{
+		lock_guard<FastSpinLock> lock(compact_pending_lock);
+
+		if (compact_pending.size() && ccticks_elapsed(compact_pending.front().request_ticks, ccticks()) > RELAY_TIMEOUT * CCTICKS_PER_SEC)
+		{
+			BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " RelayConnection::HandleHeartbeat peer timeout sending txs for compact block oid " << buf2hex(&compact_pending.front().req_params.oid, CC_OID_TRACE_SIZE);
+
+			return Stop();
+		}
+	}
+
 	CheckForDownload();	// we do this on the same timer just to make it easier
 
 	unsigned nbytes;
@@ -1144,6 +1863,13 @@ void RelayConnection::FinishConnection()
 
 	relay_dbconn->RelayObjsDeletePeer(m_conn_index);
 
+	if (m_outgoing_host.length())
+	{
+		g_hostdir.ReportConnect(HostDir::Relay, m_outgoing_host, false);	// the connection failed before it started
+
+		m_outgoing_host.clear();
+	}
+
 	if (private_peer_index >= 0)
 		g_privrelay_service.PrivateDisconnected(private_peer_index);
 }
@@ -1159,7 +1885,7 @@ void RelayService::Start()
 
 	// unsigned conn_nreadbuf, unsigned conn_nwritebuf, unsigned sock_nreadbuf, unsigned sock_nwritebuf, unsigned headersize, bool noclose, bool bregister
 	CCServer::ConnectionFactoryInstantiation<RelayConnection> connfac(CC_MAX_MSG_SIZE + 2, 0, -1, -1, CC_MSG_HEADER_SIZE, 1, 1);
-	CCThreadFactoryInstantiation<RelayThread> threadfac;
+	CCThreadFactoryInstantiation<RelayThread> threadfac("relay");
 
 	unsigned maxconns = (unsigned)(max_inconns + max_outconns);
 	unsigned nthreads = maxconns * threads_per_conn;
@@ -1222,9 +1948,19 @@ void RelayService::ConnMonitorProc()
 
 void RelayService::ConnectOutgoing()
 {
-	BOOST_LOG_TRIVIAL(info) << Name() << " RelayService::ConnectOutgoing calling GetHostName()";
+	string peer, toruser;
 
-	auto peer = g_hostdir.GetHostName(HostDir::Relay);
+	if (m_next_peer.length())
+	{
+		peer.swap(m_next_peer);
+		toruser.swap(m_next_peer_toruser);
+	}
+	else
+	{
+		BOOST_LOG_TRIVIAL(info) << Name() << " RelayService::ConnectOutgoing calling GetHostName()";
+
+		peer = g_hostdir.GetHostName(HostDir::Relay);
+	}
 
 	if (!peer.size())
 	{
@@ -1235,7 +1971,19 @@ void RelayService::ConnectOutgoing()
 
 	if (TRACE_RELAY) BOOST_LOG_TRIVIAL(info) << Name() << " RelayService::ConnectOutgoing connecting to " << peer;
 
-	m_service.GetServer(0).Connect(peer, g_params.torproxy_port, true);
+	m_service.GetServer(0).Connect(peer, g_params.torproxy_port, true, toruser);
+
+	// pick the next peer now so the Tor proxy pool can connect to it in the background
+	// each peer gets its own Socks username, so each connection still gets its own Tor circuit
+
+	m_next_peer = g_hostdir.GetHostName(HostDir::Relay);
+
+	if (m_next_peer.length())
+	{
+		m_next_peer_toruser = Socks::IsolationUser();
+
+		g_sockspool.Warm(m_next_peer, m_next_peer_toruser);
+	}
 }
 
 void RelayService::ConfigPrivateRelay()
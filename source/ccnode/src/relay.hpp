@@ -16,6 +16,16 @@
 #include <CCobjdefs.h>
 #include <ObjQueue.hpp>
 
+#pragma pack(push, 1)
+
+struct relay_send_entry_t
+{
+	ccoid_t oid;
+	uint8_t compact;		// send a block as a CC_MSG_COMPACT_BLOCK if possible
+};
+
+#pragma pack(pop)
+
 class RelayConnection : public CCServer::Connection
 {
 public:
@@ -25,7 +35,8 @@ public:
 		request_queue_lock(__FILE__, __LINE__),
 		request_param_queue(sizeof(relay_request_params_extended_t), CC_TX_SEND_MAX),
 		send_queue_lock(__FILE__, __LINE__),
-		send_queue(sizeof(ccoid_t), CC_TX_SEND_MAX)
+		send_queue(sizeof(relay_send_entry_t), CC_TX_SEND_MAX),
+		compact_pending_lock(__FILE__, __LINE__)
 	{ }
 
 	int private_peer_index;
@@ -53,6 +64,22 @@ private:
 	FastSpinLock send_queue_lock;
 	ObjQueue send_queue;
 
+	// a block received as a CC_MSG_COMPACT_BLOCK that is waiting for the peer to send the txs not found in Valid_Objs
+
+	struct CompactBlockPending
+	{
+		SmartBuf smartobj;						// the block, with the txs found locally already in place
+		relay_request_params_extended_t req_params;
+		vector<uint32_t> missing_index;			// index in the block of each tx requested from the peer
+		vector<uint32_t> missing_offset;		// offset from ObjPtr() of each requested tx
+		vector<uint32_t> missing_size;
+		uint32_t request_ticks;
+	};
+
+	atomic<bool> peer_compact_blocks;
+	FastSpinLock compact_pending_lock;
+	deque<CompactBlockPending> compact_pending;
+
 	void StartConnection();
 
 	void HandleReadComplete();
@@ -63,6 +90,13 @@ private:
 	void CheckToSend();
 	void HandleObjWrite(const boost::system::error_code& e, SmartBuf smartobj, AutoCount pending_op_counter);
 
+	bool PopBlockRequest(uint32_t blocksize, const class BlockWireHeader *wire, relay_request_params_extended_t& req_params);
+	bool HandleCompactBlock(unsigned msgsize);
+	void FillCompactBlockTxs(uint64_t salt, const void *entries, unsigned ntx, CompactBlockPending& pending);
+	bool FinishCompactBlock(CompactBlockPending& pending);
+	bool SendBlockTxs(unsigned msgsize);
+	bool HandleBlockTxs(unsigned msgsize);
+
 	bool SetHeartbeatTimer();
 	void HandleHeartbeat(const boost::system::error_code& e, AutoCount pending_op_counter);
 	void HandleAnnounceMsgWrite(const boost::system::error_code& e, AutoCount pending_op_counter);
@@ -94,6 +128,9 @@ class RelayService : public TorService
 	vector<uint32_t> m_connect_error_count;
 	vector<uint32_t> m_connect_time;
 
+	string m_next_peer;				// picked ahead of time so the Tor proxy connection to it can be set up in advance
+	string m_next_peer_toruser;
+
 public:
 	RelayService(const string& n, const wstring& d, const string& s, bool b)
 	 :	TorService(n, d, s),
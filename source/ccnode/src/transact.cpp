@@ -52,6 +52,13 @@
 #define TRANSACT_TIMEOUT				10	// timeout for entire connection, excluding validation
 #define TRANSACT_VALIDATION_TIMEOUT		20
 
+#define TRANSACT_WATCH_EXPIRE			(10*60)	// an address watch connection is closed after this long, and the wallet resubscribes
+#define TRANSACT_WATCH_MAX_PENDING		64		// notifications queued for a slow reader before the connection is told to poll all its addresses
+
+#define TRANSACT_ADMIT_MAX_SOURCES		4096	// token buckets kept; when full, buckets that have refilled are dropped
+#define TRANSACT_ADMIT_BUSY_RETRY		1		// seconds a client is asked to wait when all connections it may use are busy
+#define TRANSACT_ADMIT_LOG_INTERVAL		60		// seconds between logging admission stats, when any requests were turned away
+
 #define TRANSACT_TIMESTAMP_PAST_ALLOWANCE		(40*60)
 #define TRANSACT_TIMESTAMP_FUTURE_ALLOWANCE		(5*60)
 
@@ -59,12 +66,29 @@
 
 thread_local static DbConn *tx_dbconn;
 
+TxWatch g_txwatch;
+TxAdmission g_txadmission;
+
 void TransactConnection::StartConnection()
 {
 	if (TRACE_TRANSACT) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " TransactConnection::StartConnection";
 
 	m_conn_state = CONN_CONNECTED;
 
+	m_watching = false;
+	m_watch_sending = false;
+	m_watch_overflow = false;
+	m_watch_pending.clear();
+
+	m_source.clear();
+	m_admit_lane = TxAdmitLane_None;
+	m_admit_waiting = false;
+
+	boost::system::error_code e;
+	auto endpoint = m_socket.remote_endpoint(e);
+	if (!e && !endpoint.address().is_loopback())
+		m_source = endpoint.address().to_string();
+
 	// On timeout, the connection will simply Stop. To prevent this, the timer can be reset with a different handler; see for example HandleTx()
 
 	if (SetTimer(TRANSACT_TIMEOUT))
@@ -123,6 +147,7 @@ void TransactConnection::HandleReadComplete()
 	case CC_TAG_TX_QUERY_XMATCH_REQNUM:
 	case CC_TAG_TX_QUERY_XMATCH_MATCHNUM:
 	case CC_TAG_TX_QUERY_XMINING_INFO:
+	case CC_TAG_TX_QUERY_ADDRESS_WATCH:
 
 		if (TRACE_TRANSACT) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " TransactConnection::HandleReadComplete CC_TAG_TX_QUERY_*";
 
@@ -146,7 +171,7 @@ void TransactConnection::HandleReadComplete()
 
 		CCASSERT(CC_MSG_HEADER_SIZE == sizeof(CCObject::Header));
 
-		smartobj = SmartBuf(size + sizeof(CCObject::Preamble));
+		smartobj = SmartBuf(size + sizeof(CCObject::Preamble), false);	// filled by the read
 		if (!smartobj)
 		{
 			BOOST_LOG_TRIVIAL(error) << Name() << " Conn " << m_conn_index << " TransactConnection::HandleReadComplete error smartobj failed";
@@ -262,6 +287,7 @@ void TransactConnection::HandleMsgReadComplete(const boost::system::error_code&
 	case CC_TAG_TX_QUERY_XMATCH_REQNUM:
 	case CC_TAG_TX_QUERY_XMATCH_MATCHNUM:
 	case CC_TAG_TX_QUERY_XMINING_INFO:
+	case CC_TAG_TX_QUERY_ADDRESS_WATCH:
 	{
 		proof_difficulty = g_transact_service.query_work_difficulty;
 		const unsigned data_offset = CC_MSG_HEADER_SIZE + TX_POW_SIZE;
@@ -384,6 +410,38 @@ void TransactConnection::HandleMsgReadComplete(const boost::system::error_code&
 	m_pread += CC_MSG_HEADER_SIZE + TX_POW_SIZE;
 	size -= CC_MSG_HEADER_SIZE + TX_POW_SIZE;
 
+	unsigned retry_secs = 0;
+
+	auto rc = g_txadmission.Admit(this, tag, size, retry_secs);
+
+	if (rc == TxAdmission::Admit_Busy)
+		return SendBusyError(retry_secs);
+
+	if (rc == TxAdmission::Admit_Wait)
+	{
+		if (TRACE_TRANSACT) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " TransactConnection::HandleMsgReadComplete tag " << hex << tag << dec << " waiting for admission";
+
+		return;		// TxAdmission::Release will post HandleAdmitted, or the connection will time out
+	}
+
+	DispatchMsg(tag, size, smartobj);
+}
+
+void TransactConnection::HandleAdmitted(unsigned tag, unsigned size, AutoCount pending_op_counter)
+{
+	if (CheckOpCount(pending_op_counter))
+		return;
+
+	if (TRACE_TRANSACT) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " TransactConnection::HandleAdmitted tag " << hex << tag << dec;
+
+	if (SetTimer(TRANSACT_TIMEOUT))		// restart the timeout now that the query can run
+		return;
+
+	DispatchMsg(tag, size, SmartBuf());		// only queries wait for admission, and they are read from m_pread
+}
+
+void TransactConnection::DispatchMsg(unsigned tag, unsigned size, SmartBuf smartobj)
+{
 	switch (tag)
 	{
 	case CC_TAG_TX_QUERY_PARAMS:
@@ -411,6 +469,9 @@ void TransactConnection::HandleMsgReadComplete(const boost::system::error_code&
 	case CC_TAG_TX_QUERY_XMINING_INFO:
 		return HandleTxQueryXminingInfo(m_pread, size);
 
+	case CC_TAG_TX_QUERY_ADDRESS_WATCH:
+		return HandleTxQueryAddressWatch(m_pread, size);
+
 	case CC_TAG_TX:
 	case CC_TAG_MINT:
 	case CC_TAG_TX_XDOMAIN:
@@ -1614,6 +1675,243 @@ void TransactConnection::HandleTxQueryXminingInfo(const char *msg, unsigned size
 	SendReply(os);
 }
 
+/*
+	An address watch connection stays open after the reply to the tx-address-watch message.  When a new output to
+	a watched address becomes indelible, the server sends a notification listing the addresses that received outputs,
+	and the wallet then queries those addresses as usual.  If the wallet falls behind reading notifications, they are
+	collapsed into one that has "poll-all":1 set.  The connection is closed after TRANSACT_WATCH_EXPIRE seconds; a wallet
+	that resubscribes with commitstart set to the next-commitment-number from its prior reply is then sent a notification
+	for each address that received an output in between.
+*/
+
+void TransactConnection::HandleTxQueryAddressWatch(const char *msg, unsigned size)
+{
+	if (TRACE_TRANSACT) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " TransactConnection::HandleTxQueryAddressWatch size " << size;
+
+	uint64_t blockchain = 0, commitstart = 0;
+
+	uint32_t bufpos = 0;
+	const bool bhex = false;
+
+	copy_from_buf(blockchain, TX_CHAIN_BYTES, bufpos, msg, size, bhex);
+	copy_from_buf(commitstart, sizeof(commitstart), bufpos, msg, size, bhex);
+
+	unsigned naddresses = (bufpos < size ? (size - bufpos) / TX_ADDRESS_BYTES : 0);
+
+	if (!naddresses || bufpos + naddresses * TX_ADDRESS_BYTES != size)
+	{
+		static const string outbuf = "ERROR:malformed binary tx-address-watch";
+
+		if (TRACE_TRANSACT) BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " TransactConnection::HandleTxQueryAddressWatch error malformed query; sending " << outbuf;
+
+		WriteAsync("TransactConnection::HandleTxQueryAddressWatch", boost::asio::buffer(outbuf.c_str(), outbuf.size() + 1),
+				boost::bind(&Connection::HandleWrite, this, boost::asio::placeholders::error, AutoCount(this)));
+
+		return;
+	}
+
+	if (blockchain != g_params.blockchain)
+		return SendBlockchainNumberError();
+
+	if (naddresses > TX_QUERY_WATCH_MAX_ADDRESSES)
+		return SendTooManyObjectsError();
+
+	{
+		// set before Add so notifications queued between Add and the reply are kept
+
+		lock_guard<FastSpinLock> lock(m_watch_lock);
+
+		m_watching = true;
+		m_watch_sending = true;		// until the reply is written
+	}
+
+	uint64_t next_commitnum;
+	vector<array<uint8_t, TX_ADDRESS_BYTES>> found;
+
+	if (g_txwatch.Add(this, tx_dbconn, msg + bufpos, naddresses, commitstart, next_commitnum, found))
+	{
+		{
+			lock_guard<FastSpinLock> lock(m_watch_lock);
+
+			m_watching = false;
+			m_watch_sending = false;
+			m_watch_pending.clear();
+		}
+
+		static const string outbuf = "ERROR:address watch connection limit reached";
+
+		if (TRACE_TRANSACT) BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " TransactConnection::HandleTxQueryAddressWatch connection limit reached; sending " << outbuf;
+
+		WriteAsync("TransactConnection::HandleTxQueryAddressWatch", boost::asio::buffer(outbuf.c_str(), outbuf.size() + 1),
+				boost::bind(&Connection::HandleWrite, this, boost::asio::placeholders::error, AutoCount(this)));
+
+		return;
+	}
+
+	for (auto& a : found)
+		QueueWatchNotify(a.data());
+
+	ostringstream os;
+	os.rdbuf()->pubsetbuf(m_writebuf.data(), m_writebuf.size());
+
+	os << "{\"tx-address-watch-report\":" JSON_ENDL
+	os << "{\"server-timestamp\":" << unixtime() JSON_ENDL
+	os << ",\"addresses-watched\":" << naddresses JSON_ENDL
+	os << ",\"next-commitment-number\":" << next_commitnum JSON_ENDL
+	os << ",\"expire-seconds\":" << TRANSACT_WATCH_EXPIRE JSON_ENDL
+	os << "}}";
+	os.put(0);
+
+	unsigned nbytes = os.tellp();
+
+	if (!os.good() || nbytes >= m_writebuf.size())
+		return Stop();
+
+	if (TRACE_TRANSACT) BOOST_LOG_TRIVIAL(debug) << Name() << " Conn " << m_conn_index << " TransactConnection::HandleTxQueryAddressWatch watching " << naddresses << " addresses";
+
+	if (SetTimer(TRANSACT_WATCH_EXPIRE))
+		return;
+
+	WriteAsync("TransactConnection::HandleTxQueryAddressWatch", boost::asio::buffer(m_writebuf.data(), nbytes),
+			boost::bind(&Connection::HandleWrite, this, boost::asio::placeholders::error, AutoCount(this)));
+}
+
+// called by TxWatch::NotifyPending; connection objects are never freed while the server runs, so at worst a
+// notification meant for a connection that has since closed goes to a new watch connection, which then makes an extra query
+
+void TransactConnection::QueueWatchNotify(const void *address)
+{
+	{
+		lock_guard<FastSpinLock> lock(m_watch_lock);
+
+		if (!m_watching)
+			return;
+
+		bool found = false;
+
+		for (auto& a : m_watch_pending)
+		{
+			if (!memcmp(a.data(), address, TX_ADDRESS_BYTES))
+				found = true;
+		}
+
+		if (!found && m_watch_pending.size() >= TRANSACT_WATCH_MAX_PENDING)
+		{
+			if (!m_watch_overflow) BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " TransactConnection::QueueWatchNotify notification queue full";
+
+			m_watch_overflow = true;
+			m_watch_pending.clear();
+		}
+		else if (!found && !m_watch_overflow)
+		{
+			m_watch_pending.emplace_back();
+			memcpy(m_watch_pending.back().data(), address, TX_ADDRESS_BYTES);
+		}
+
+		if (m_watch_sending)
+			return;		// HandleWrite will send it
+
+		m_watch_sending = true;
+	}
+
+	if (Post("TransactConnection::QueueWatchNotify", boost::bind(&TransactConnection::HandleWatchNotify, this, AutoCount(this))))
+	{
+		lock_guard<FastSpinLock> lock(m_watch_lock);
+
+		m_watch_sending = false;
+	}
+}
+
+void TransactConnection::HandleWatchNotify(AutoCount pending_op_counter)
+{
+	if (CheckOpCount(pending_op_counter))
+		return;
+
+	SendWatchNotify();
+}
+
+void TransactConnection::SendWatchNotify()
+{
+	ostringstream os;
+	os.rdbuf()->pubsetbuf(m_writebuf.data(), m_writebuf.size());
+
+	unsigned naddresses;
+
+	{
+		lock_guard<FastSpinLock> lock(m_watch_lock);
+
+		naddresses = m_watch_pending.size();
+
+		if (!naddresses && !m_watch_overflow)
+		{
+			m_watch_sending = false;
+
+			return;
+		}
+
+		os << "{\"tx-address-watch-notify\":" JSON_ENDL
+		os << "{\"server-timestamp\":" << unixtime() JSON_ENDL
+		if (m_watch_overflow)
+			os << ",\"poll-all\":1" JSON_ENDL
+		os << ",\"addresses\":[" JSON_ENDL
+		for (unsigned i = 0; i < naddresses; ++i)
+		{
+			bigint_t address = 0UL;
+			memcpy((void*)&address, m_watch_pending[i].data(), TX_ADDRESS_BYTES);
+
+			if (i) os << ",";
+			os << "\"0x" << hex << address << dec << "\"" JSON_ENDL
+		}
+		os << "]}}";
+		os.put(0);
+
+		m_watch_pending.clear();
+		m_watch_overflow = false;
+	}
+
+	unsigned nbytes = os.tellp();
+
+	if (!os.good() || nbytes >= m_writebuf.size())
+		return Stop();
+
+	if (TRACE_TRANSACT) BOOST_LOG_TRIVIAL(debug) << Name() << " Conn " << m_conn_index << " TransactConnection::SendWatchNotify " << naddresses << " addresses";
+
+	WriteAsync("TransactConnection::SendWatchNotify", boost::asio::buffer(m_writebuf.data(), nbytes),
+			boost::bind(&Connection::HandleWrite, this, boost::asio::placeholders::error, AutoCount(this)));
+}
+
+void TransactConnection::HandleWrite(const boost::system::error_code& e, AutoCount pending_op_counter)
+{
+	if (!m_watching)
+		return Connection::HandleWrite(e, move(pending_op_counter));
+
+	// an address watch connection stays open and sends the next notification, if any
+
+	if (CheckOpCount(pending_op_counter))
+		return;
+
+	if (e) return Stop();
+
+	m_write_in_progress.clear();
+
+	SendWatchNotify();
+}
+
+void TransactConnection::FinishConnection()
+{
+	g_txadmission.Release(this);
+
+	if (m_watching)
+	{
+		g_txwatch.Remove(this);
+
+		lock_guard<FastSpinLock> lock(m_watch_lock);
+
+		m_watching = false;
+		m_watch_pending.clear();
+	}
+}
+
 void TransactConnection::SendReply(ostringstream& os)
 {
 	os.put(0);
@@ -1666,6 +1964,18 @@ void TransactConnection::SendTooManyObjectsError()
 			boost::bind(&Connection::HandleWrite, this, boost::asio::placeholders::error, AutoCount(this)));
 }
 
+void TransactConnection::SendBusyError(unsigned retry_secs)
+{
+	char *outbuf = m_writebuf.data();
+
+	sprintf(outbuf, "ERROR:server busy:%u", retry_secs);
+
+	if (TRACE_TRANSACT) BOOST_LOG_TRIVIAL(info) << Name() << " Conn " << m_conn_index << " TransactConnection::SendBusyError source " << m_source << "; sending " << outbuf;
+
+	WriteAsync("TransactConnection::SendBusyError", boost::asio::buffer(outbuf, strlen(outbuf) + 1),
+			boost::bind(&Connection::HandleWrite, this, boost::asio::placeholders::error, AutoCount(this)));
+}
+
 void TransactConnection::SendNotConnectedError()
 {
 	static const string outbuf = "ERROR:server not connected";
@@ -1718,6 +2028,11 @@ void TransactConnection::SendTimeout()
 
 void TransactService::DumpExtraConfigBottom() const
 {
+	cout << "   max address watch connections = " << max_watch_conns << endl;
+	cout << "   connections reserved for transactions = " << submit_reserve_conns << endl;
+	cout << "   max heavy query connections = " << max_heavy_conns << endl;
+	cout << "   per-source request rate = " << source_rate << endl;
+	cout << "   per-source request burst = " << source_burst << endl;
 	cout << "   max network seconds = " << max_net_sec << endl;
 	cout << "   max indelible block age = " << max_block_sec << endl;
 	cout << "   query work difficulty = " << query_work_difficulty << endl;
@@ -1794,14 +2109,14 @@ void TransactService::Start()
 
 	// unsigned conn_nreadbuf, unsigned conn_nwritebuf, unsigned sock_nreadbuf, unsigned sock_nwritebuf, unsigned headersize, bool noclose, bool bregister
 	CCServer::ConnectionFactoryInstantiation<TransactConnection> connfac(TRANSACT_MAX_REQUEST_SIZE + 2, TRANSACT_MAX_REPLY_SIZE, 0, 0, CC_MSG_HEADER_SIZE + TX_POW_SIZE, 0, 1);
-	CCThreadFactoryInstantiation<TransactThread> threadfac;
+	CCThreadFactoryInstantiation<TransactThread> threadfac("transact");
 
 	unsigned maxconns = (unsigned)(max_inconns + max_outconns);
 	unsigned nthreads = maxconns * threads_per_conn;	//!!! threads_per_conn can be changed if TransactConnection's do not block
 
 	// unsigned nthreads, unsigned maxconns, unsigned maxincoming, unsigned backlog
 	m_service.Start(boost::asio::ip::tcp::endpoint(address, port),
-			nthreads, maxconns, max_inconns, 0, connfac, threadfac);
+			nthreads, maxconns, max_inconns, 0, connfac, threadfac, nreactors);
 }
 
 void TransactService::StartShutdown()
@@ -1812,6 +2127,9 @@ void TransactService::StartShutdown()
 void TransactService::WaitForShutdown()
 {
 	m_service.WaitForShutdown();
+
+	if (enabled)
+		g_txadmission.LogStats();
 }
 
 void TransactThread::ThreadProc(boost::function<void()> threadproc)
@@ -1826,3 +2144,380 @@ void TransactThread::ThreadProc(boost::function<void()> threadproc)
 
 	delete tx_dbconn;
 }
+
+// returns true if the connection limit has been reached
+// holds m_txwatch_lock while checking the database, which delays NotifyPending by at most a few hundred index lookups
+
+bool TxWatch::Add(TransactConnection *conn, DbConn *dbconn, const char *addresses, unsigned naddresses, uint64_t commitstart, uint64_t& next_commitnum, vector<address_t>& found)
+{
+	lock_guard<mutex> lock(m_txwatch_lock);
+
+	if (m_nconns >= (unsigned)g_transact_service.max_watch_conns)
+		return true;
+
+	++m_nconns;
+
+	next_commitnum = g_commitments.GetNextCommitnum();
+
+	Entry entry;
+	entry.conn = conn;
+
+	for (unsigned i = 0; i < naddresses; ++i)
+	{
+		memcpy(entry.address.data(), addresses + i * TX_ADDRESS_BYTES, TX_ADDRESS_BYTES);
+
+		m_index.insert(upper_bound(m_index.begin(), m_index.end(), entry), entry);
+
+		if (!commitstart)
+			continue;
+
+		uint32_t domain;
+		uint64_t asset_enc, amount_enc, commitnum;
+		char commitiv[TX_COMMIT_IV_BYTES];
+		bigint_t commitment;
+		bool have_more;
+
+		auto nfound = dbconn->TxOutputsSelect(entry.address.data(), TX_ADDRESS_BYTES, commitstart, &domain, &asset_enc, &amount_enc, commitiv, sizeof(commitiv), (char*)&commitment, sizeof(commitment), &commitnum, 1, &have_more);
+
+		if (nfound)		// on error, notify the wallet so it queries the address
+			found.push_back(entry.address);
+	}
+
+	return false;
+}
+
+void TxWatch::Remove(TransactConnection *conn)
+{
+	lock_guard<mutex> lock(m_txwatch_lock);
+
+	auto end = remove_if(m_index.begin(), m_index.end(), [conn](const Entry& e) { return e.conn == conn; });
+
+	if (end == m_index.end())
+		return;
+
+	m_index.erase(end, m_index.end());
+
+	CCASSERT(m_nconns);
+
+	--m_nconns;
+}
+
+// called by the blockchain thread for each indexed output
+
+void TxWatch::Match(const void *address)
+{
+	if (!g_transact_service.max_watch_conns)
+		return;
+
+	m_candidates.emplace_back();
+	memcpy(m_candidates.back().data(), address, TX_ADDRESS_BYTES);
+}
+
+void TxWatch::DiscardPending()
+{
+	m_candidates.clear();
+}
+
+// called by the blockchain thread after the blocks containing the candidate outputs have been committed to the database
+
+void TxWatch::NotifyPending()
+{
+	if (m_candidates.empty())
+		return;
+
+	vector<Entry> matches;
+
+	{
+		lock_guard<mutex> lock(m_txwatch_lock);
+
+		Entry entry;
+
+		for (auto& a : m_candidates)
+		{
+			entry.address = a;
+
+			auto range = equal_range(m_index.begin(), m_index.end(), entry);
+
+			matches.insert(matches.end(), range.first, range.second);
+		}
+	}
+
+	m_candidates.clear();
+
+	// QueueWatchNotify takes the connection's m_watch_lock, and after releasing it, Post takes the connection's m_conn_lock.
+	// FinishConnection calls Remove (which takes m_txwatch_lock) while holding m_conn_lock, so m_txwatch_lock can't be held here.
+	// The lock order is m_conn_lock -> m_txwatch_lock, and m_watch_lock is never held while taking either of the others.
+
+	for (auto& e : matches)
+		e.conn->QueueWatchNotify(e.address.data());
+}
+
+int TxAdmission::Lane(unsigned tag)
+{
+	switch (tag)
+	{
+	case CC_TAG_TX:
+	case CC_TAG_MINT:
+	case CC_TAG_TX_XDOMAIN:
+	case CC_TAG_XCX_NAKED_BUY:
+	case CC_TAG_XCX_NAKED_SELL:
+	case CC_TAG_XCX_SIMPLE_BUY:
+	case CC_TAG_XCX_SIMPLE_SELL:
+	case CC_TAG_XCX_SIMPLE_TRADE:
+	case CC_TAG_XCX_PAYMENT:
+		return TxAdmitLane_Submit;
+
+	case CC_TAG_TX_QUERY_PARAMS:
+	case CC_TAG_TX_QUERY_ADDRESS:
+	case CC_TAG_TX_QUERY_SERIAL:
+	case CC_TAG_TX_QUERY_XMATCH_MATCHNUM:
+	case CC_TAG_TX_QUERY_XMINING_INFO:
+		return TxAdmitLane_Query;
+
+	case CC_TAG_TX_QUERY_INPUTS:
+	case CC_TAG_TX_QUERY_XREQS:
+	case CC_TAG_TX_QUERY_XMATCH_OBJID:
+	case CC_TAG_TX_QUERY_XMATCH_REQNUM:
+		return TxAdmitLane_Heavy;
+
+	case CC_TAG_TX_QUERY_ADDRESS_WATCH:
+		return TxAdmitLane_N;		// watch connections are limited by max_watch_conns
+
+	default:
+		CCASSERT(0);	// need to handle all tags passed by HandleReadComplete
+	}
+
+	return TxAdmitLane_N;
+}
+
+unsigned TxAdmission::Cost(unsigned tag)
+{
+	switch (tag)
+	{
+	case CC_TAG_TX_QUERY_PARAMS:
+	case CC_TAG_TX_QUERY_XMINING_INFO:
+		return 1;
+
+	case CC_TAG_TX_QUERY_ADDRESS:
+	case CC_TAG_TX_QUERY_SERIAL:
+	case CC_TAG_TX_QUERY_XMATCH_MATCHNUM:
+		return 2;
+
+	case CC_TAG_TX_QUERY_INPUTS:
+	case CC_TAG_TX_QUERY_XREQS:
+		return 8;
+
+	default:
+		return 4;	// transactions, exchange requests, address watches, and xmatchreq queries
+	}
+}
+
+bool TxAdmission::ChargeSource(const string& source, unsigned cost, unsigned& retry_secs)
+{
+	// caller must hold m_admission_lock
+	// returns true if the source does not have enough tokens
+
+	const double rate = g_transact_service.source_rate;
+	const double burst = g_transact_service.source_burst;
+
+	auto ticks = ccticks();
+
+	Bucket key;
+	key.source = source;
+
+	auto it = lower_bound(m_buckets.begin(), m_buckets.end(), key);
+
+	if (it == m_buckets.end() || it->source != source)
+	{
+		if (m_buckets.size() >= TRANSACT_ADMIT_MAX_SOURCES)
+		{
+			m_buckets.erase(remove_if(m_buckets.begin(), m_buckets.end(), [&](const Bucket& b)
+				{
+					return b.tokens + ccticks_elapsed(b.ticks, ticks) * rate / CCTICKS_PER_SEC >= burst;
+				}), m_buckets.end());
+
+			if (m_buckets.size() >= TRANSACT_ADMIT_MAX_SOURCES)
+			{
+				BOOST_LOG_TRIVIAL(warning) << "TxAdmission::ChargeSource too many active sources; not rate limiting " << source;
+
+				return false;
+			}
+
+			it = lower_bound(m_buckets.begin(), m_buckets.end(), key);
+		}
+
+		key.tokens = burst;
+		key.ticks = ticks;
+
+		it = m_buckets.insert(it, key);
+	}
+
+	auto& bucket = *it;
+
+	bucket.tokens = min(burst, bucket.tokens + ccticks_elapsed(bucket.ticks, ticks) * rate / CCTICKS_PER_SEC);
+	bucket.ticks = ticks;
+
+	if (bucket.tokens < cost)
+	{
+		retry_secs = ceil((cost - bucket.tokens) / rate);
+
+		return true;
+	}
+
+	bucket.tokens -= cost;
+
+	return false;
+}
+
+int TxAdmission::Admit(TransactConnection *conn, unsigned tag, unsigned size, unsigned& retry_secs)
+{
+	auto lane = Lane(tag);
+	int rc = Admit_Run;
+
+	{
+		lock_guard<mutex> lock(m_admission_lock);
+
+		CCASSERT(conn->m_admit_lane == TxAdmitLane_None);
+		CCASSERT(!conn->m_admit_waiting);
+
+		const unsigned max_queries = g_transact_service.max_inconns - g_transact_service.submit_reserve_conns;
+		const unsigned nqueries = m_running[TxAdmitLane_Query] + m_running[TxAdmitLane_Heavy] + m_waiting.size();
+
+		if (!conn->m_source.empty() && g_transact_service.source_rate && ChargeSource(conn->m_source, Cost(tag), retry_secs))
+		{
+			++m_stats.rejected_rate;
+			rc = Admit_Busy;
+		}
+		else if (lane == TxAdmitLane_N)
+		{
+			++m_stats.admitted[lane];
+		}
+		else if (lane != TxAdmitLane_Submit && nqueries >= max_queries)
+		{
+			++m_stats.rejected_busy;
+			retry_secs = TRANSACT_ADMIT_BUSY_RETRY;
+			rc = Admit_Busy;
+		}
+		else if (lane == TxAdmitLane_Heavy && m_running[lane] >= (unsigned)g_transact_service.max_heavy_conns)
+		{
+			Waiter waiter;
+			waiter.conn = conn;
+			waiter.tag = tag;
+			waiter.size = size;
+
+			m_waiting.push_back(waiter);
+			conn->m_admit_waiting = true;
+
+			++m_stats.waited;
+			m_stats.peak_waiting = max(m_stats.peak_waiting, (unsigned)m_waiting.size());
+			rc = Admit_Wait;
+		}
+		else
+		{
+			++m_running[lane];
+			conn->m_admit_lane = lane;
+			++m_stats.admitted[lane];
+		}
+	}
+
+	if (rc == Admit_Busy)
+	{
+		if (TRACE_TRANSACT) BOOST_LOG_TRIVIAL(debug) << conn->Name() << " Conn " << conn->m_conn_index << " TxAdmission::Admit tag " << hex << tag << dec << " lane " << lane << " source " << conn->m_source << " busy retry " << retry_secs;
+
+		LogStats(true);
+	}
+
+	return rc;
+}
+
+void TxAdmission::Release(TransactConnection *conn)
+{
+	// called from FinishConnection, which holds conn's m_conn_lock
+
+	Waiter next;
+	next.conn = NULL;
+
+	{
+		lock_guard<mutex> lock(m_admission_lock);
+
+		if (conn->m_admit_waiting)
+		{
+			for (auto it = m_waiting.begin(); it != m_waiting.end(); ++it)
+			{
+				if (it->conn == conn)
+				{
+					m_waiting.erase(it);
+					break;
+				}
+			}
+
+			conn->m_admit_waiting = false;
+		}
+
+		if (conn->m_admit_lane != TxAdmitLane_None)
+		{
+			CCASSERT(m_running[conn->m_admit_lane]);
+
+			--m_running[conn->m_admit_lane];
+			conn->m_admit_lane = TxAdmitLane_None;
+		}
+
+		if (!m_waiting.empty() && m_running[TxAdmitLane_Heavy] < (unsigned)g_transact_service.max_heavy_conns)
+		{
+			next = m_waiting.front();
+			m_waiting.pop_front();
+
+			next.conn->m_admit_waiting = false;
+			next.conn->m_admit_lane = TxAdmitLane_Heavy;
+			++m_running[TxAdmitLane_Heavy];
+			++m_stats.admitted[TxAdmitLane_Heavy];
+		}
+	}
+
+	// a connection that is stopping will give up its lane when its own FinishConnection calls Release
+
+	if (next.conn)
+		next.conn->Post("TxAdmission::Release", boost::bind(&TransactConnection::HandleAdmitted, next.conn, next.tag, next.size, AutoCount(next.conn)));
+}
+
+void TxAdmission::LogStats(bool periodic)
+{
+	Stats stats;
+	array<unsigned, TxAdmitLane_N> running;
+	unsigned nwaiting;
+
+	{
+		lock_guard<mutex> lock(m_admission_lock);
+
+		auto ticks = ccticks();
+
+		if (periodic)
+		{
+			if (m_log_ticks && ccticks_elapsed(m_log_ticks, ticks) < TRANSACT_ADMIT_LOG_INTERVAL * CCTICKS_PER_SEC)
+				return;
+
+			if (m_stats.rejected_rate == m_logged_stats.rejected_rate && m_stats.rejected_busy == m_logged_stats.rejected_busy)
+				return;
+		}
+
+		m_log_ticks = ticks;
+		m_logged_stats = m_stats;
+
+		stats = m_stats;
+		running = m_running;
+		nwaiting = m_waiting.size();
+	}
+
+	BOOST_LOG_TRIVIAL(info) << "TxAdmission admitted submit " << stats.admitted[TxAdmitLane_Submit]
+		<< " query " << stats.admitted[TxAdmitLane_Query]
+		<< " heavy " << stats.admitted[TxAdmitLane_Heavy]
+		<< " watch " << stats.admitted[TxAdmitLane_N]
+		<< " waited " << stats.waited
+		<< " peak waiting " << stats.peak_waiting
+		<< " rejected rate " << stats.rejected_rate
+		<< " busy " << stats.rejected_busy
+		<< "; running submit " << running[TxAdmitLane_Submit]
+		<< " query " << running[TxAdmitLane_Query]
+		<< " heavy " << running[TxAdmitLane_Heavy]
+		<< " waiting " << nwaiting;
+}
@@ -13,22 +13,61 @@
 #include <ccserver/service.hpp>
 #include <ccserver/connection.hpp>
 
+#include <CCparams.h>
+#include <SpinLock.hpp>
+
 #include <boost/bind.hpp>
 
+class DbConn;
+
+enum TxAdmitLane
+{
+	TxAdmitLane_Submit,		// transactions and exchange requests
+	TxAdmitLane_Query,		// queries answered from a single index lookup
+	TxAdmitLane_Heavy,		// queries that read a snapshot or scan a range
+	TxAdmitLane_N,			// not scheduled, only charged to the source's token bucket
+
+	TxAdmitLane_None = -1
+};
+
 class TransactConnection : public CCServer::Connection
 {
+	friend class TxAdmission;
 
 public:
 	TransactConnection(class CCServer::ConnectionManagerBase& manager, boost::asio::io_service& io_service, const class CCServer::ConnectionFactoryBase& connfac)
-	:	CCServer::Connection(manager, io_service, connfac)
+	:	CCServer::Connection(manager, io_service, connfac),
+		m_watching(false),
+		m_watch_lock(__FILE__, __LINE__),
+		m_admit_lane(TxAdmitLane_None),
+		m_admit_waiting(false)
 	{ }
 
 	void HandleValidateDone(uint64_t level, uint32_t callback_id, int64_t result);
 
+	void QueueWatchNotify(const void *address);
+
 private:
+	// address watch subscription state
+
+	bool m_watching;
+	bool m_watch_sending;
+	bool m_watch_overflow;
+	vector<array<uint8_t, TX_ADDRESS_BYTES>> m_watch_pending;
+	FastSpinLock m_watch_lock;
+
+	string m_source;				// remote address, or empty if loopback (local wallets and Tor hidden service clients)
+
+	int m_admit_lane;				// guarded by TxAdmission's lock
+	bool m_admit_waiting;
+
 	void StartConnection();
+	void FinishConnection();
+	void HandleWrite(const boost::system::error_code& e, AutoCount pending_op_counter);
 	void HandleReadComplete();
 	void HandleMsgReadComplete(const boost::system::error_code& e, size_t bytes_transferred, SmartBuf smartobj, AutoCount pending_op_counter);
+	void HandleAdmitted(unsigned tag, unsigned size, AutoCount pending_op_counter);
+	void DispatchMsg(unsigned tag, unsigned size, SmartBuf smartobj);
 	void HandleTx(Process_Q_Priority priority, SmartBuf smartobj);
 	void SendValidateResult(int64_t result);
 	bool SetValidationTimer(uint32_t callback_id, unsigned sec);
@@ -41,10 +80,14 @@ private:
 	void HandleTxQueryXmatchreq(uint32_t tag, const char *msg, unsigned size);
 	void HandleTxQueryXmatch(const char *msg, unsigned size);
 	void HandleTxQueryXminingInfo(const char *msg, unsigned size);
+	void HandleTxQueryAddressWatch(const char *msg, unsigned size);
+	void HandleWatchNotify(AutoCount pending_op_counter);
+	void SendWatchNotify();
 	void SendReply(ostringstream& os);
 	void SendObjectNotValid();
 	void SendBlockchainNumberError();
 	void SendTooManyObjectsError();
+	void SendBusyError(unsigned retry_secs);
 	void SendNotConnectedError();
 	void SendServerError(unsigned line);
 	void SendServerUnknown(unsigned line);
@@ -63,12 +106,22 @@ public:
 		m_service(n),
 		max_net_sec(0),
 		max_block_sec(0),
-		query_work_difficulty(0)
+		query_work_difficulty(0),
+		max_watch_conns(0),
+		submit_reserve_conns(0),
+		max_heavy_conns(0),
+		source_rate(0),
+		source_burst(0)
 	{ }
 
 	int32_t  max_net_sec;
 	int32_t  max_block_sec;
 	uint64_t query_work_difficulty;
+	int max_watch_conns;
+	int submit_reserve_conns;
+	int max_heavy_conns;
+	int source_rate;
+	int source_burst;
 
 	void ConfigPostset()
 	{
@@ -81,12 +134,149 @@ public:
 
 	void Start();
 
+	// logs the connection counts of each reactor, if there is more than one
+	void LogStats()
+	{
+		if (m_service.GetNServers() > 1)
+			m_service.LogStats();
+	}
+
 	void StartShutdown();
 	void WaitForShutdown();
 };
 
+/*
+	TxAdmission decides whether each transaction server request runs now, waits for a slot, or is turned away with a
+	retryable "ERROR:server busy" reply.
+
+	Each remote source has a token bucket that refills at source_rate tokens per second up to source_burst, and each
+	request is charged its cost.  Loopback connections, which include all clients that arrive through the Tor hidden
+	service, can't be told apart and are not charged.
+
+	Queries may hold at most max_inconns - submit_reserve_conns connections, so that many connections are always left
+	for transaction submissions.  At most max_heavy_conns heavy queries run at once, and the rest wait in order for a
+	slot.  When a query finishes, a waiting heavy query is started if the heavy lane has room.
+*/
+
+class TxAdmission
+{
+	struct Bucket
+	{
+		string source;
+		double tokens;
+		uint32_t ticks;
+
+		bool operator< (const Bucket& other) const
+		{
+			return source < other.source;
+		}
+	};
+
+	struct Waiter
+	{
+		TransactConnection *conn;
+		unsigned tag;
+		unsigned size;
+	};
+
+	vector<Bucket> m_buckets;			// sorted by source
+	deque<Waiter> m_waiting;			// heavy queries waiting for a slot
+
+	array<unsigned, TxAdmitLane_N> m_running;
+
+	struct Stats
+	{
+		uint64_t admitted[TxAdmitLane_N + 1];
+		uint64_t waited;
+		uint64_t rejected_rate;
+		uint64_t rejected_busy;
+		unsigned peak_waiting;
+	};
+
+	Stats m_stats;
+	Stats m_logged_stats;
+	uint32_t m_log_ticks;
+
+	mutex m_admission_lock;
+
+	bool ChargeSource(const string& source, unsigned cost, unsigned& retry_secs);
+
+public:
+	TxAdmission()
+	 :	m_log_ticks(0)
+	{
+		m_running.fill(0);
+		memset(&m_stats, 0, sizeof(m_stats));
+		memset(&m_logged_stats, 0, sizeof(m_logged_stats));
+	}
+
+	enum
+	{
+		Admit_Run,
+		Admit_Wait,
+		Admit_Busy
+	};
+
+	static int Lane(unsigned tag);
+	static unsigned Cost(unsigned tag);
+
+	int Admit(TransactConnection *conn, unsigned tag, unsigned size, unsigned& retry_secs);
+	void Release(TransactConnection *conn);
+
+	void LogStats(bool periodic = false);
+};
+
+extern TxAdmission g_txadmission;
+
 class TransactThread : public CCThread
 {
 public:
 	void ThreadProc(boost::function<void()> threadproc);
 };
+
+/*
+	TxWatch indexes the addresses watched by transaction server connections.  While blocks are being made indelible,
+	BlockChain records the address of each new indexed output, and once the blocks have been committed, NotifyPending
+	matches those addresses against the index and notifies each connection watching a matched address.
+
+	Add and the matching in NotifyPending both run under m_txwatch_lock, so every output committed after Add is matched.
+	When a subscription passes a nonzero commitstart, Add also checks the database for outputs with commitnum >= commitstart,
+	so a wallet that resubscribes with the next_commitnum returned by its prior subscription does not miss any outputs.
+*/
+
+class TxWatch
+{
+	typedef array<uint8_t, TX_ADDRESS_BYTES> address_t;
+
+	struct Entry
+	{
+		address_t address;
+		TransactConnection *conn;
+
+		bool operator< (const Entry& other) const
+		{
+			return memcmp(address.data(), other.address.data(), TX_ADDRESS_BYTES) < 0;
+		}
+	};
+
+	vector<Entry> m_index;				// sorted by address
+	unsigned m_nconns;
+
+	vector<address_t> m_candidates;		// outputs in the blocks not yet committed; only accessed by the blockchain thread
+
+	mutex m_txwatch_lock;
+
+public:
+	TxWatch()
+	 :	m_nconns(0)
+	{ }
+
+	bool Add(TransactConnection *conn, DbConn *dbconn, const char *addresses, unsigned naddresses, uint64_t commitstart, uint64_t& next_commitnum, vector<address_t>& found);
+	void Remove(TransactConnection *conn);
+
+	void Match(const void *address);
+	void DiscardPending();
+	void NotifyPending();
+};
+
+extern TxWatch g_txwatch;
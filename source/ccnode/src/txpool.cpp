@@ -0,0 +1,306 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * txpool.cpp
+*/
+
+#include <CCdef.h>
+#include <CCboost.hpp>
+
+#include "txpool.hpp"
+
+#include <CCticks.hpp>
+#include <transaction.h>
+
+// This file doesn't depend on the rest of ccnode, so that ccbench can drive the same code.
+
+#define TXPOOL_MAX_RETRY	2000	// most tx's held for another decode attempt
+
+#define TRACE_TXPOOL	0
+
+void TxCandidatePool::Init(bool track_deletes)
+{
+	m_candidates.clear();
+	m_retry.clear();
+
+	{
+		lock_guard<FastSpinLock> lock(m_deleted_lock);
+
+		m_deleted.clear();
+	}
+
+	m_track_deletes = track_deletes;
+}
+
+// decodes a tx and saves the values needed to check it for a block
+// returns 0 on success, 1 if the tx can't be decoded yet but might be later, or -1 if it can never be added to a block
+
+int TxCandidatePool::Decode(SmartBuf smartobj, Candidate& candidate, TxCandidateSource& source)
+{
+	auto obj = (CCObject*)smartobj.data();
+	auto txwire = obj->ObjPtr();
+	auto txsize = obj->ObjSize();
+
+	// a plain txpay has no Xtx and every input has a serialnum, so its values are read directly from the wire
+
+	auto rc = m_txview.Init(txwire, txsize);
+	bool use_view = (!rc && m_txview.TagType() == CC_TYPE_TXPAY);
+
+	candidate.xtx.reset();
+
+	if (!use_view)
+	{
+		rc = tx_from_wire(m_txbuf, (char*)txwire, txsize);
+		if (rc)
+			return -1;
+
+		rc = source.ExtractXtx(m_txbuf, txwire, candidate.xtx);
+		if (rc)
+			return rc;
+	}
+
+	candidate.nin = (use_view ? m_txview.NIn() : m_txbuf.nin);
+	candidate.serialnums.resize(candidate.nin * TX_SERIALNUM_BYTES);
+
+	for (unsigned i = 0; i < candidate.nin; ++i)
+	{
+		auto serialnum = (use_view ? (const void*)m_txview.SerialnumPtr(i) : (const void*)&m_txbuf.inputs[i].S_serialnum);
+
+		memcpy(candidate.serialnums.data() + i * TX_SERIALNUM_BYTES, serialnum, TX_SERIALNUM_BYTES);
+	}
+
+	// donation = (mantissa + (exponent > 0)) * 10^exponent, the same as tx_amount_decode
+
+	auto donation_fp = (use_view ? m_txview.DonationFp() : m_txbuf.donation_fp);
+	unsigned exponent = donation_fp & TX_AMOUNT_EXPONENT_MASK;
+	double donation = ((donation_fp & TX_DONATION_MASK) >> TX_AMOUNT_EXPONENT_BITS) + (exponent > 0);
+	donation *= pow(10.0, exponent);
+
+	candidate.smartobj = smartobj;
+	candidate.donation_per_byte = donation / txsize;
+	candidate.param_level = (use_view ? m_txview.ParamLevel() : m_txbuf.param_level);
+	candidate.wire_tag = (use_view ? m_txview.WireTag() : m_txbuf.wire_tag);
+	candidate.block_size = obj->BodySize() + 2 * sizeof(uint32_t);				// need space for tag and size
+
+	return 0;
+}
+
+// decodes a tx fetched from the ValidObjs table and adds it to the pool, or holds it to be decoded again before the next block
+// returns 0 if the tx was added, 1 if it was held, or -1 if it was dropped
+
+int TxCandidatePool::Add(SmartBuf smartobj, int64_t seqnum, TxCandidateSource& source)
+{
+	Candidate candidate;
+
+	candidate.seqnum = seqnum;
+	candidate.arrival_ticks = ccticks();
+	candidate.block_genstamp = m_genstamp - 1;
+	candidate.drop = false;
+
+	auto rc = Decode(smartobj, candidate, source);
+
+	if (rc > 0)
+	{
+		if (m_retry.size() >= TXPOOL_MAX_RETRY)
+		{
+			BOOST_LOG_TRIVIAL(warning) << "TxCandidatePool::Add dropping tx seqnum " << seqnum << " that can't be decoded yet because " << m_retry.size() << " tx's are already held";
+
+			return -1;
+		}
+
+		if (TRACE_TXPOOL) BOOST_LOG_TRIVIAL(trace) << "TxCandidatePool::Add holding tx seqnum " << seqnum << " that can't be decoded yet";
+
+		candidate.smartobj = smartobj;
+
+		m_retry.push_back(move(candidate));
+	}
+	else if (!rc)
+		m_candidates.push_back(move(candidate));
+
+	return rc;
+}
+
+// decodes the held tx's again, and adds the ones that can now be decoded to the pool
+// returns the number of tx's added
+
+unsigned TxCandidatePool::Retry(TxCandidateSource& source)
+{
+	unsigned nadded = 0;
+
+	for (unsigned i = 0; i < m_retry.size(); )
+	{
+		auto& candidate = m_retry[i];
+
+		auto rc = Decode(candidate.smartobj, candidate, source);
+
+		if (rc > 0)
+		{
+			++i;
+
+			continue;
+		}
+
+		if (rc)
+			BOOST_LOG_TRIVIAL(info) << "TxCandidatePool::Retry dropping tx seqnum " << candidate.seqnum << " that can never be added to a block";
+		else
+		{
+			candidate.block_genstamp = m_genstamp - 1;
+
+			m_candidates.push_back(move(candidate));
+
+			++nadded;
+		}
+
+		if (i + 1 < m_retry.size())
+			m_retry[i] = move(m_retry.back());
+
+		m_retry.pop_back();
+	}
+
+	return nadded;
+}
+
+// called by the ValidObjs table when it deletes an object
+
+void TxCandidatePool::NotifyDeleted(SmartBuf smartobj)
+{
+	if (!m_track_deletes.load())
+		return;
+
+	auto obj = (CCObject*)smartobj.data();
+
+	if (obj->ObjType() == CC_TYPE_BLOCK)
+		return;
+
+	lock_guard<FastSpinLock> lock(m_deleted_lock);
+
+	m_deleted.push_back(*obj->OidPtr());
+}
+
+// a tx whose oid was deleted is confirmed with the ValidObjs table, since the same tx might have been added again
+
+bool TxCandidatePool::IsDeleted(const Candidate& candidate, TxCandidateSource& source)
+{
+	if (candidate.drop)
+		return true;
+
+	if (m_prune_oids.empty())
+		return false;
+
+	auto obj = (const CCObject*)candidate.smartobj.data();
+
+	if (!binary_search(m_prune_oids.begin(), m_prune_oids.end(), *obj->OidPtr()))
+		return false;
+
+	return !source.IsValidObj(candidate.smartobj);
+}
+
+// drops the tx's that were found in a persistent block, and the tx's that have been deleted from the ValidObjs table
+
+unsigned TxCandidatePool::Prune(TxCandidateSource& source)
+{
+	{
+		lock_guard<FastSpinLock> lock(m_deleted_lock);
+
+		m_prune_oids.swap(m_deleted);
+	}
+
+	sort(m_prune_oids.begin(), m_prune_oids.end());
+
+	auto end = remove_if(m_candidates.begin(), m_candidates.end(), [this, &source](const Candidate& candidate)
+	{
+		return IsDeleted(candidate, source);
+	});
+
+	unsigned ndropped = m_candidates.end() - end;
+
+	m_candidates.erase(end, m_candidates.end());
+
+	auto retry_end = remove_if(m_retry.begin(), m_retry.end(), [this, &source](const Candidate& candidate)
+	{
+		if (!IsDeleted(candidate, source))
+			return false;
+
+		BOOST_LOG_TRIVIAL(info) << "TxCandidatePool::Prune dropping tx seqnum " << candidate.seqnum << " deleted before it could be decoded";
+
+		return true;
+	});
+
+	ndropped += m_retry.end() - retry_end;
+
+	m_retry.erase(retry_end, m_retry.end());
+
+	m_prune_oids.clear();
+
+	return ndropped;
+}
+
+// sets order to the indexes of the tx's not yet offered to the current block, in the order they should be tried
+
+void TxCandidatePool::SelectOrder(vector<unsigned>& order, unsigned age_floor_secs, uint32_t age_share_bytes)
+{
+	order.clear();
+
+	auto rank_greater = [](const Rank& a, const Rank& b)
+	{
+		if (a.value != b.value)
+			return a.value > b.value;
+
+		return a.seqnum < b.seqnum;
+	};
+
+	if (age_floor_secs && age_share_bytes)
+	{
+		auto now = ccticks();
+		int32_t age_floor = age_floor_secs * CCTICKS_PER_SEC;
+
+		m_ranks.clear();
+
+		for (unsigned i = 0; i < m_candidates.size(); ++i)
+		{
+			auto& candidate = m_candidates[i];
+			auto age = ccticks_elapsed(candidate.arrival_ticks, now);
+
+			if (candidate.block_genstamp != m_genstamp && age >= age_floor)
+				m_ranks.push_back(Rank{(double)age, candidate.seqnum, i});
+		}
+
+		sort(m_ranks.begin(), m_ranks.end(), rank_greater);
+
+		uint32_t nbytes = 0;
+
+		for (auto& rank : m_ranks)
+		{
+			if (nbytes >= age_share_bytes)
+				break;
+
+			auto& candidate = m_candidates[rank.index];
+
+			nbytes += candidate.block_size;
+			candidate.block_genstamp = m_genstamp;
+
+			order.push_back(rank.index);
+		}
+	}
+
+	m_ranks.clear();
+
+	for (unsigned i = 0; i < m_candidates.size(); ++i)
+	{
+		auto& candidate = m_candidates[i];
+
+		if (candidate.block_genstamp != m_genstamp)
+			m_ranks.push_back(Rank{candidate.donation_per_byte, candidate.seqnum, i});
+	}
+
+	sort(m_ranks.begin(), m_ranks.end(), rank_greater);
+
+	for (auto& rank : m_ranks)
+	{
+		m_candidates[rank.index].block_genstamp = m_genstamp;
+
+		order.push_back(rank.index);
+	}
+}
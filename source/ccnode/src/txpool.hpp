@@ -0,0 +1,154 @@
+/*
+ * CredaCash (TM) cryptocurrency and blockchain
+ *
+ * Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+ *
+ * txpool.hpp
+*/
+
+#pragma once
+
+#include "seqnum.hpp"
+
+#include <CCobjects.hpp>
+#include <transaction.hpp>
+#include <txview.hpp>
+#include <SmartBuf.hpp>
+#include <SpinLock.hpp>
+
+class Xtx;
+
+/*
+
+TxCandidatePool keeps the valid tx's that are candidates for new blocks.
+
+Each tx is decoded once, when the witness fetches it from the ValidObjs table, and the pool keeps the values needed to
+check it against each new block: its param_level, its Xtx, and its serialnums (including pseudo serialnums).  A tx that is
+left out of one block is not decoded again for the next.
+
+A tx that can't be decoded yet but might be later (an Xpay whose Xmatch isn't in the database yet) is held and decoded
+again before each block, since the witness has already fetched past it in the ValidObjs table.
+
+Pool membership is tracked explicitly: the ValidObjs table reports the oid of each object it deletes, and the next call to
+Prune drops the tx's that are no longer in the table.  A tx is also dropped when one of its serialnums is found in a
+persistent block.
+
+Tx's are offered to a new block in order of donation per byte, highest first.  Tx's that have been pending for at least
+the age floor are offered first, oldest first, until they fill the age share of the block, so tx's with a low donation
+still clear while the witness has a backlog.
+
+The pool is only used by the witness thread, so apart from the list of deleted oids, it has no lock.
+
+*/
+
+// supplies the parts of decoding and pruning that need the database
+
+class TxCandidateSource
+{
+public:
+	virtual ~TxCandidateSource() { }
+
+	// extracts the Xtx of a tx that isn't a plain txpay, and sets its pseudo serialnum
+	// returns 0 on success, 1 if the tx can't be decoded yet but might be later, or -1 if it can never be added to a block
+	virtual int ExtractXtx(TxPay& txbuf, const void *txwire, shared_ptr<Xtx>& xtx) = 0;
+
+	// returns true if this object is still in the ValidObjs table
+	virtual bool IsValidObj(SmartBuf smartobj) = 0;
+};
+
+class TxCandidatePool
+{
+public:
+	struct Candidate
+	{
+		SmartBuf smartobj;
+		shared_ptr<Xtx> xtx;
+		vector<uint8_t> serialnums;		// nin serialnums of TX_SERIALNUM_BYTES each
+		double donation_per_byte;
+		int64_t seqnum;
+		uint64_t param_level;
+		uint32_t wire_tag;
+		uint32_t block_size;			// bytes used in a block, including the tag and size
+		uint32_t arrival_ticks;
+		uint32_t block_genstamp;		// pool genstamp of the last block this tx was checked for
+		uint16_t nin;
+		bool drop;
+	};
+
+private:
+	vector<Candidate> m_candidates;
+	vector<Candidate> m_retry;			// tx's that couldn't be decoded yet
+	int64_t m_next_seqnum[NSEQOBJ];
+	uint32_t m_genstamp;
+
+	TxView m_txview;
+	TxPay m_txbuf;
+
+	FastSpinLock m_deleted_lock;
+	vector<ccoid_t> m_deleted;			// oids deleted from the ValidObjs table since the last Prune; protected by m_deleted_lock
+	vector<ccoid_t> m_prune_oids;
+	atomic<bool> m_track_deletes;
+
+	struct Rank
+	{
+		double value;
+		int64_t seqnum;
+		unsigned index;
+	};
+
+	vector<Rank> m_ranks;
+
+	bool IsDeleted(const Candidate& candidate, TxCandidateSource& source);
+
+public:
+	TxCandidatePool()
+	 :	m_genstamp(0),
+		m_deleted_lock(__FILE__, __LINE__),
+		m_track_deletes(false)
+	{
+		memset(&m_next_seqnum, 0, sizeof(m_next_seqnum));
+	}
+
+	void Init(bool track_deletes = true);
+
+	int64_t& NextSeqnum(unsigned type)
+	{
+		CCASSERT(type < NSEQOBJ);
+
+		return m_next_seqnum[type];
+	}
+
+	size_t Size() const
+	{
+		return m_candidates.size();
+	}
+
+	size_t NRetry() const
+	{
+		return m_retry.size();
+	}
+
+	Candidate& Get(unsigned index)
+	{
+		return m_candidates[index];
+	}
+
+	int Decode(SmartBuf smartobj, Candidate& candidate, TxCandidateSource& source);
+	int Add(SmartBuf smartobj, int64_t seqnum, TxCandidateSource& source);
+	unsigned Retry(TxCandidateSource& source);
+
+	void NotifyDeleted(SmartBuf smartobj);
+
+	void NewBlock()
+	{
+		++m_genstamp;
+	}
+
+	uint32_t Genstamp() const
+	{
+		return m_genstamp;
+	}
+
+	unsigned Prune(TxCandidateSource& source);
+	void SelectOrder(vector<unsigned>& order, unsigned age_floor_secs, uint32_t age_share_bytes);
+};
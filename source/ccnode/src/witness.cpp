@@ -17,6 +17,7 @@
 #include "dbconn.hpp"
 
 #include <CCobjects.hpp>
+#include <CCthread.hpp>
 #include <CCcrypto.hpp>
 #include <CCmint.h>
 #include <transaction.h>
@@ -131,6 +132,10 @@
 #define TEST_WITNESS_LOSS				0	// don't test
 #endif
 
+#ifndef WITNESS_SKIP_SCORE_THREADS
+#define WITNESS_SKIP_SCORE_THREADS		4	// max threads used to score new blocks
+#endif
+
 Witness g_witness;
 atomic<unsigned> max_mint_level(0);
 
@@ -223,9 +228,55 @@ static unsigned FindBestMintTx(DbConn *dbconn, SmartBuf priorobj, uint64_t prior
 	}
 }
 
+// decodes the Xtx's of the tx pool candidates, and checks pool membership, using the witness's database connection
+
+class WitnessTxSource : public TxCandidateSource
+{
+	DbConn *m_dbconn;
+
+public:
+
+	WitnessTxSource(DbConn *dbconn)
+	 :	m_dbconn(dbconn)
+	{ }
+
+	int ExtractXtx(TxPay& txbuf, const void *txwire, shared_ptr<Xtx>& xtx)
+	{
+		xtx = ProcessTx::ExtractXtx(m_dbconn, txbuf);
+
+		if (!xtx && ProcessTx::ExtractXtxFailed(txbuf))
+		{
+			// an Xpay that can be parsed without the database failed only because its Xmatch wasn't found, which might be added later
+
+			if (Xtx::TypeIsXpay(txbuf.tag_type) && ProcessTx::ExtractXtx(NULL, txbuf))
+				return 1;
+
+			return -1;
+		}
+
+		BlockChain::CheckCreatePseudoSerialnum(txbuf, xtx, txwire);
+
+		return 0;
+	}
+
+	bool IsValidObj(SmartBuf smartobj)
+	{
+		auto obj = (CCObject*)smartobj.data();
+		SmartBuf validobj;
+
+		auto rc = m_dbconn->ValidObjsGetObj(*obj->OidPtr(), &validobj);
+		if (rc < 0)
+			return true;	// keep the tx on a database error; its serialnums are still checked when it's added to a block
+
+		return !rc && validobj.BasePtr() == smartobj.BasePtr();
+	}
+};
+
 Witness::Witness()
  :	m_pthread(NULL),
+	m_txsource(NULL),
 	m_score_genstamp(0),
+	m_skip_scores_genstamp(0),
 	m_waiting_on_block(false),
 	m_waiting_on_tx(false),
 	m_exchange_work_time(0),
@@ -236,9 +287,17 @@ Witness::Witness()
 	block_min_work_ms(1000),
 	block_max_time(20),
 	test_block_random_ms(0),
+	tx_age_floor_secs(60),
+	tx_age_share_pct(25),
 	test_mal(0)
 {
 	memset(&m_highest_witnessed_level, 0, sizeof(m_highest_witnessed_level));
+	memset(&m_template_stats, 0, sizeof(m_template_stats));
+	memset(&m_skip_score_stats, 0, sizeof(m_skip_score_stats));
+
+	m_template_bufpos = 0;
+	m_template_ticks = 0;
+	m_template_usec = 0;
 }
 
 void Witness::Init()
@@ -256,6 +315,16 @@ void Witness::Init()
 		m_dbconn = new DbConn;
 		CCASSERT(m_dbconn);
 
+		m_txsource = new WitnessTxSource(m_dbconn);
+		CCASSERT(m_txsource);
+
+		m_skip_score_pool.Init(min((unsigned)WITNESS_SKIP_SCORE_THREADS, thread::hardware_concurrency()), "witness");
+
+		m_txpool.Init();
+
+		for (unsigned i = 0; i < NSEQOBJ; ++i)
+			m_txpool.NextSeqnum(i) = g_seqnum[i][VALIDSEQ].seqmin;
+
 		if (TEST_WITNESS_LOSS > 0) BOOST_LOG_TRIVIAL(info) << "Witness::Init simulating witness loss with max witness " << WITNESS_TEST_LOSS_REQ_WITNESS << " at levels mod " << TEST_WITNESS_LOSS;
 
 		if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::Init launching ThreadProc";
@@ -278,6 +347,24 @@ void Witness::DeInit()
 		delete m_pthread;
 
 		m_pthread = NULL;
+
+		LogTemplateStats();
+		LogSkipScoreStats();
+	}
+
+	m_skip_score_pool.DeInit();
+
+	m_skip_scores.clear();
+	m_template = SmartBuf();
+	m_template_prior = SmartBuf();
+
+	m_txpool.Init(false);
+
+	if (m_txsource)
+	{
+		delete m_txsource;
+
+		m_txsource = NULL;
 	}
 
 	if (m_dbconn)
@@ -290,6 +377,8 @@ void Witness::DeInit()
 
 void Witness::ThreadProc()
 {
+	CCThreadRoles::Apply("witness");
+
 	BOOST_LOG_TRIVIAL(info) << "Witness::ThreadProc start m_dbconn " << (uintptr_t)m_dbconn;
 
 	SmartBuf last_indelible_block;
@@ -475,12 +564,25 @@ uint64_t Witness::FindBestOwnScore(SmartBuf last_indelible_block)
 	uint64_t bestscore = 0;
 	SmartBuf smartobj;
 
+	bool use_table = !m_test_ignore_order && !TEST_BUILD_ON_RANDOM;		// see UpdateSkipScores
+
 	if (m_test_ignore_order)
 		m_dbconn->ProcessQClearValidObjs(PROCESS_Q_TYPE_BLOCK);
 
 	for (unsigned offset = 0; ; ++offset)
 	{
-		m_dbconn->ProcessQGetNextValidObj(PROCESS_Q_TYPE_BLOCK, offset, &smartobj);
+		SkipScoreEntry *entry = NULL;
+
+		if (use_table)
+		{
+			if (offset >= m_skip_scores.size())
+				break;
+
+			entry = &m_skip_scores[offset];
+			smartobj = entry->smartobj;
+		}
+		else
+			m_dbconn->ProcessQGetNextValidObj(PROCESS_Q_TYPE_BLOCK, offset, &smartobj);
 
 		if (!smartobj)
 			break;
@@ -492,7 +594,13 @@ uint64_t Witness::FindBestOwnScore(SmartBuf last_indelible_block)
 		if (wire->witness != witness_index)
 			continue;
 
-		auto score = block->CalcSkipScore(-1, last_indelible_block, m_score_genstamp, m_test_ignore_order);
+		uint64_t score;
+
+		if (entry)
+			score = block->FinishSkipScore(-1, false, entry->score, entry->scorebits);
+		else
+			score = block->CalcSkipScore(-1, last_indelible_block, m_score_genstamp, m_test_ignore_order);
+
 		if (score > bestscore)
 			bestscore = score;
 
@@ -513,12 +621,25 @@ SmartBuf Witness::FindBestBuildingBlock(SmartBuf last_indelible_block, uint64_t
 
 	SmartBuf smartobj, bestobj;
 
+	bool use_table = !m_test_ignore_order && !TEST_BUILD_ON_RANDOM;		// see UpdateSkipScores
+
 	if (m_test_ignore_order || TEST_BUILD_ON_RANDOM)
 		m_dbconn->ProcessQRandomizeValidObjs(PROCESS_Q_TYPE_BLOCK);
 
 	for (unsigned offset = 0; ; ++offset)
 	{
-		m_dbconn->ProcessQGetNextValidObj(PROCESS_Q_TYPE_BLOCK, offset, &smartobj);
+		SkipScoreEntry *entry = NULL;
+
+		if (use_table)
+		{
+			if (offset >= m_skip_scores.size())
+				break;
+
+			entry = &m_skip_scores[offset];
+			smartobj = entry->smartobj;
+		}
+		else
+			m_dbconn->ProcessQGetNextValidObj(PROCESS_Q_TYPE_BLOCK, offset, &smartobj);
 
 		if (!smartobj)
 			break;
@@ -542,7 +663,22 @@ SmartBuf Witness::FindBestBuildingBlock(SmartBuf last_indelible_block, uint64_t
 			continue;
 		}
 
-		if (block->CheckBadSigOrder(witness_index))
+		bool bad_sig_order;
+
+		if (entry)
+		{
+			if (entry->sig_order_witness != witness_index)
+			{
+				entry->bad_sig_order = block->CheckBadSigOrder(witness_index);
+				entry->sig_order_witness = witness_index;
+			}
+
+			bad_sig_order = entry->bad_sig_order;
+		}
+		else
+			bad_sig_order = block->CheckBadSigOrder(witness_index);
+
+		if (bad_sig_order)
 		{
 			if (m_test_ignore_order)
 			{
@@ -556,7 +692,12 @@ SmartBuf Witness::FindBestBuildingBlock(SmartBuf last_indelible_block, uint64_t
 			}
 		}
 
-		auto score = block->CalcSkipScore(witness_index, last_indelible_block, m_score_genstamp, m_test_ignore_order);
+		uint64_t score;
+
+		if (entry)
+			score = block->FinishSkipScore(witness_index, false, entry->score, entry->scorebits);
+		else
+			score = block->CalcSkipScore(witness_index, last_indelible_block, m_score_genstamp, m_test_ignore_order);
 
 		if (bestscore >= score && !m_test_ignore_order)
 		{
@@ -601,6 +742,117 @@ SmartBuf Witness::FindBestBuildingBlock(SmartBuf last_indelible_block, uint64_t
 	return bestobj;
 }
 
+/*
+
+Refreshes the table of skip scores of the valid blocks used by FindBestOwnScore and FindBestBuildingBlock.
+
+The valid blocks are read from the process queue in one pass, and only the blocks that are not already in the table are
+scored.  The table is cleared when the last indelible block changes, since the scores are computed back to that block.
+The new blocks are scored by m_skip_score_pool in order of level, using the scores cached in the block aux data, so each
+block costs one step.  When many blocks are new, such as after a block sync or on a network with many forks, the pool's
+threads, which are started by Init, take part.
+
+The table is not used by the mal tests or TEST_BUILD_ON_RANDOM, since those randomize the queue order on every pass.
+
+*/
+
+void Witness::UpdateSkipScores(SmartBuf last_indelible_block)
+{
+	auto t0 = chrono::steady_clock::now();
+
+	++m_skip_score_stats.nupdates;
+
+	if (m_skip_scores_genstamp != m_score_genstamp)
+	{
+		if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::UpdateSkipScores witness " << witness_index << " genstamp " << m_score_genstamp << " clearing " << m_skip_scores.size() << " scores";
+
+		m_skip_scores.clear();
+		m_skip_scores_genstamp = m_score_genstamp;
+	}
+
+	vector<SmartBuf> objs;
+
+	if (m_dbconn->ProcessQGetValidObjs(PROCESS_Q_TYPE_BLOCK, objs))
+		objs.clear();	// an error leaves no candidates, the same as when ProcessQGetNextValidObj fails
+
+	// index the prior table by buffer pointer; the table holds a reference to each block, so a pointer can't be reused by
+	// another block while its entry is in the table
+
+	vector<pair<void*, unsigned>> prior_index(m_skip_scores.size());
+
+	for (unsigned i = 0; i < m_skip_scores.size(); ++i)
+		prior_index[i] = make_pair(m_skip_scores[i].smartobj.BasePtr(), i);
+
+	sort(prior_index.begin(), prior_index.end());
+
+	vector<SkipScoreEntry> entries(objs.size());
+	vector<unsigned> unscored;
+
+	for (unsigned i = 0; i < objs.size(); ++i)
+	{
+		auto it = lower_bound(prior_index.begin(), prior_index.end(), make_pair(objs[i].BasePtr(), 0U));
+
+		if (it != prior_index.end() && it->first == objs[i].BasePtr())
+		{
+			entries[i] = m_skip_scores[it->second];
+
+			++m_skip_score_stats.ncached;
+
+			continue;
+		}
+
+		auto& entry = entries[i];
+
+		entry.smartobj = objs[i];
+		entry.score = 0;
+		entry.scorebits = 0;
+		entry.sig_order_witness = -1;
+		entry.bad_sig_order = false;
+
+		unscored.push_back(i);
+	}
+
+	m_skip_score_work.resize(unscored.size());
+
+	for (unsigned i = 0; i < unscored.size(); ++i)
+		m_skip_score_work[i].smartobj = entries[unscored[i]].smartobj;
+
+	if (m_skip_score_pool.Run(m_skip_score_work, last_indelible_block, m_score_genstamp, SKIP_SCORE_PARALLEL_MIN))
+		++m_skip_score_stats.nparallel;
+
+	for (unsigned i = 0; i < unscored.size(); ++i)
+	{
+		auto& entry = entries[unscored[i]];
+		auto& work = m_skip_score_work[i];
+
+		entry.score = work.score;
+		entry.scorebits = work.scorebits;
+
+		work.smartobj = SmartBuf();
+	}
+
+	m_skip_score_stats.nscored += unscored.size();
+
+	m_skip_scores.swap(entries);
+
+	auto usec = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t0).count();
+
+	m_skip_score_stats.update_usec += usec;
+
+	if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::UpdateSkipScores witness " << witness_index << " blocks " << m_skip_scores.size() << " scored " << unscored.size() << " in " << usec << " usec";
+}
+
+void Witness::LogSkipScoreStats()
+{
+	auto& stats = m_skip_score_stats;
+
+	if (!stats.nupdates)
+		return;
+
+	BOOST_LOG_TRIVIAL(info) << "Witness::LogSkipScoreStats witness " << witness_index << " updates " << stats.nupdates << " blocks cached " << stats.ncached << " scored " << stats.nscored << " parallel updates " << stats.nparallel
+		<< " mean update usec " << stats.update_usec / stats.nupdates;
+}
+
 bool Witness::AttemptNewBlock()
 {
 	SmartBuf priorobj, bestblock;
@@ -655,6 +907,9 @@ bool Witness::AttemptNewBlock()
 					++m_score_genstamp;
 			}
 
+			if (!m_test_ignore_order && !TEST_BUILD_ON_RANDOM)
+				UpdateSkipScores(last_indelible_block);
+
 			auto bestscore = FindBestOwnScore(last_indelible_block);
 
 			bestblock = FindBestBuildingBlock(last_indelible_block, m_highest_witnessed_level[TEST_SIM_ALL_WITNESSES * witness_index], bestscore);
@@ -783,6 +1038,11 @@ bool Witness::AttemptNewBlock()
 			break;
 		}
 
+		// while waiting for this witness's turn, prepare the block so when the turn comes, it only needs to be timestamped and signed
+
+		if (ccticks_elapsed(ccticks(), min_time) > 0)
+			PrepareBlockTemplate(priorobj);
+
 		if (!WaitForWork(true, true, min_time, (m_newblock_bufpos ? min_time : max_time)))
 			break;
 
@@ -873,11 +1133,13 @@ void Witness::StartNewBlock()
 	m_block_start_time = ccticks();
 	m_newblock_bufpos = 0;
 
+	m_template = SmartBuf();
+	m_template_prior = SmartBuf();
+
 	for (unsigned i = 1; i < NSEQOBJ; ++i)
-	{
 		ResetWork(i, true);	// assume there are objects in the mempool
-		m_newblock_next_seqnum[i] = g_seqnum[i][VALIDSEQ].seqmin;
-	}
+
+	m_txpool.NewBlock();
 
 	m_test_ignore_order = false;
 	m_test_try_persistent_double_spend = false;
@@ -904,6 +1166,58 @@ void Witness::StartNewBlock()
 	m_dbconn->TempSerialnumClear((void*)TEMP_SERIALS_WITNESS_BLOCKP);
 }
 
+// decodes a tx and saves the values needed to check it for a block
+// returns 0 on success, 1 if the tx can't be decoded yet but might be later, or -1 if it can never be added to a block
+
+int Witness::DecodeCandidate(SmartBuf smartobj, TxCandidatePool::Candidate& candidate)
+{
+	return m_txpool.Decode(smartobj, candidate, *m_txsource);
+}
+
+// adds new tx's of the given type from the ValidObjs table to the tx pool
+// leaves the work flag set if there are more than max_fetch new tx's, so a large backlog doesn't hold up the block
+
+void Witness::FetchCandidates(unsigned type, unsigned max_fetch)
+{
+	if (!HaveWork(type))
+		return;
+
+	ResetWork(type);
+
+	const int TXARRAYSIZE = TEST_SMALL_BUFS ? 5 : 100;
+
+	#pragma pack(push, 1)
+	static array<DbConnValidObjs::ValidObjSeqnumObjPair, TXARRAYSIZE> txarray;	// static -> not thread safe
+	#pragma pack(pop)
+
+	unsigned nfetched = 0;
+
+	while (nfetched < max_fetch && !g_shutdown)
+	{
+		auto ntx = m_dbconn->ValidObjsFindNew(m_txpool.NextSeqnum(type), g_seqnum[type][VALIDSEQ].seqmax, TXARRAYSIZE, false, (uint8_t*)&txarray, TXARRAYSIZE);
+
+		if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::FetchCandidates witness " << witness_index << " fetched " << ntx << " potential tx's type " << type;
+
+		for (unsigned i = 0; i < ntx; ++i)
+		{
+			auto smartobj = txarray[i].smartobj;
+			txarray[i].smartobj.ClearRef();
+
+			auto rc = m_txpool.Add(smartobj, txarray[i].seqnum, *m_txsource);
+
+			if (rc < 0 && TRACE_WITNESS)
+				BOOST_LOG_TRIVIAL(trace) << "Witness::FetchCandidates witness " << witness_index << " skipping undecodable tx type " << type << " bufp " << (uintptr_t)smartobj.BasePtr();
+		}
+
+		nfetched += ntx;
+
+		if (ntx < TXARRAYSIZE)
+			return;
+	}
+
+	ResetWork(type, true);		// still more there
+}
+
 Witness::BuildNewBlockStatus Witness::BuildNewBlock(uint32_t& min_time, uint32_t max_time, SmartBuf priorobj, uint64_t priorlevel, unsigned nconfsigs, uint64_t last_indelible_level)
 {
 	if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock min_time " << min_time << " max_time " << max_time << " priorlevel " << priorlevel << " nconfsigs " << nconfsigs << " last_indelible_level " << last_indelible_level;
@@ -925,11 +1239,7 @@ Witness::BuildNewBlockStatus Witness::BuildNewBlock(uint32_t& min_time, uint32_t
 	const uint32_t bufsize = (TEST_SMALL_BUFS ? 4999 : CC_BLOCK_MAX_SIZE) - sizeof(CCObject::Header) - sizeof(BlockWireHeader);
 	CCASSERT(m_blockbuf.size() >= bufsize);
 
-	const int TXARRAYSIZE = TEST_SMALL_BUFS ? 5 : 100;
-
-	#pragma pack(push, 1)
-	static array<DbConnValidObjs::ValidObjSeqnumObjPair, TXARRAYSIZE> txarray;	// static -> not thread safe
-	#pragma pack(pop)
+	const unsigned MAX_FETCH = TEST_SMALL_BUFS ? 20 : 2000;
 
 	bool test_no_delete_persistent_txs = IsMalTest();
 
@@ -937,41 +1247,49 @@ Witness::BuildNewBlockStatus Witness::BuildNewBlock(uint32_t& min_time, uint32_t
 
 	auto prior_blocktime = ((Block*)priorobj.data())->WireData()->timestamp.GetValue();
 
+	uint32_t age_share_bytes = (uint64_t)bufsize * tx_age_share_pct / 100;
+
+	TxCandidatePool::Candidate mint_candidate;
+
 	while (priorlevel + 2 > m_first_allowed_tx_level && !g_shutdown)
 	{
 		//if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock checking for txs; priorlevel " << priorlevel << " m_first_allowed_tx_level " << m_first_allowed_tx_level;
 
 		unsigned ntx = 0;
-		unsigned type = 0;
 
 		if (is_ccmint)
-			ntx = FindBestMintTx(m_dbconn, priorobj, priorlevel, &txarray[0].smartobj);
-		else if (HaveWork(TXSEQ))
-			type = TXSEQ;
-		else if (HaveWork(XREQSEQ))
-			type = XREQSEQ;
-		else
-			break;
+		{
+			SmartBuf smartobj;
 
-		if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock level " << priorlevel + 1 << " checking for txs type " << type;
+			ntx = FindBestMintTx(m_dbconn, priorobj, priorlevel, &smartobj);
 
-		if (type)
+			if (ntx && DecodeCandidate(smartobj, mint_candidate))
+				ntx = 0;
+		}
+		else if (HaveWork(TXSEQ) || HaveWork(XREQSEQ))
 		{
-			ResetWork(type);
+			FetchCandidates(TXSEQ, MAX_FETCH);
+			FetchCandidates(XREQSEQ, MAX_FETCH);
+
+			auto ndropped = m_txpool.Prune(*m_txsource);
 
-			ntx = m_dbconn->ValidObjsFindNew(m_newblock_next_seqnum[type], g_seqnum[type][VALIDSEQ].seqmax, TXARRAYSIZE, false, (uint8_t*)&txarray, TXARRAYSIZE);
+			if (m_txpool.NRetry())
+				m_txpool.Retry(*m_txsource);
 
-			if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " fetched " << ntx << " potential tx's type " << type;
+			m_txpool.SelectOrder(m_txorder, tx_age_floor_secs, age_share_bytes);
 
-			if (ntx >= TXARRAYSIZE)
-				ResetWork(type, true);		// still more there
+			ntx = m_txorder.size();
+
+			if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " tx pool size " << m_txpool.Size() << " held " << m_txpool.NRetry() << " dropped " << ndropped << " offering " << ntx;
 		}
+		else
+			break;
 
 		for (unsigned i = 0; i < ntx; ++i)
 		{
-			auto smartobj = txarray[i].smartobj;
-			txarray[i].smartobj.ClearRef();
+			auto& candidate = (is_ccmint ? mint_candidate : m_txpool.Get(m_txorder[i]));
 
+			auto smartobj = candidate.smartobj;
 			auto bufp = smartobj.BasePtr();
 			auto obj = (CCObject*)smartobj.data();
 			auto type = obj->ObjType();
@@ -981,54 +1299,52 @@ Witness::BuildNewBlockStatus Witness::BuildNewBlock(uint32_t& min_time, uint32_t
 			if (Implement_CCMint(g_params.blockchain) && type == CC_TYPE_MINT && !is_ccmint)
 				continue;
 
-			auto txwire = obj->ObjPtr();
-			auto txsize = obj->ObjSize();
 			auto txbody = obj->BodyPtr();
 			auto bodysize = obj->BodySize();
-			uint32_t newsize = bodysize + 2 * sizeof(uint32_t);				// need space for tag and size
+			uint32_t newsize = candidate.block_size;
 
 			if (m_newblock_bufpos + newsize > bufsize)
 			{
+				// a smaller tx further down the order might still fit, but the block won't wait for any more tx's
+
 				build_status = BUILD_NEWBLOCK_STATUS_FULL;
 
 				if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " skipping tx bufp " << (uintptr_t)bufp << " because it doesn't fit ";
+
+				continue;
 			}
 
-			if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " checking tx bufp " << (uintptr_t)bufp << " size " << txsize;
+			if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " checking tx bufp " << (uintptr_t)bufp << " size " << obj->ObjSize() << " donation per byte " << candidate.donation_per_byte;
 
-			auto rc = tx_from_wire(m_txbuf, (char*)txwire, txsize);
-			if (rc)
-				continue;
+			auto param_level = candidate.param_level;
+			auto wire_tag = candidate.wire_tag;
 
-			if (m_txbuf.param_level > last_indelible_level)
+			if (param_level > last_indelible_level)
 			{
-				BOOST_LOG_TRIVIAL(error) << "Witness::BuildNewBlock level " << priorlevel + 1 << " tx found with param_level " << m_txbuf.param_level << " > last_indelible_level " << last_indelible_level << " type " << type << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
+				BOOST_LOG_TRIVIAL(error) << "Witness::BuildNewBlock level " << priorlevel + 1 << " tx found with param_level " << param_level << " > last_indelible_level " << last_indelible_level << " type " << type << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
 
 				g_blockchain.DebugStop("Witness got tx with future param level");
 			}
 
-			if (m_txbuf.param_level + nconfsigs - 1 > priorlevel || m_txbuf.param_level > last_indelible_level)
+			if (param_level + nconfsigs - 1 > priorlevel || param_level > last_indelible_level)
 			{
-				if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(debug) << "Witness::BuildNewBlock level " << priorlevel + 1 << " tx found with param_level " << m_txbuf.param_level << " - 1 + nconfsigs " << nconfsigs << " > priorlevel " << priorlevel << "; type " << type << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
+				if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(debug) << "Witness::BuildNewBlock level " << priorlevel + 1 << " tx found with param_level " << param_level << " - 1 + nconfsigs " << nconfsigs << " > priorlevel " << priorlevel << "; type " << type << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
 
-				// the tx param_level is not valid for this block, so don't include it
+				// the tx param_level is not valid for this block, so don't include it, and finish the block so the tx can go in the next one
 
 				build_status = BUILD_NEWBLOCK_STATUS_FULL;
-			}
 
-			if (build_status == BUILD_NEWBLOCK_STATUS_FULL)
-				break;	// don't add any more tx's to this block
+				continue;
+			}
 
 			//if (Xtx::TypeIsBuyer(m_txbuf.tag_type) && (priorlevel % 4)) continue;	// for testing, leave buy req's pending
 
-			auto xtx = ProcessTx::ExtractXtx(m_dbconn, m_txbuf);
-			if (!xtx && ProcessTx::ExtractXtxFailed(m_txbuf))
-				continue;
+			auto& xtx = candidate.xtx;
 
-			if (g_params.test1 && m_txbuf.wire_tag == CC_TAG_TX_XDOMAIN)
+			if (g_params.test1 && wire_tag == CC_TAG_TX_XDOMAIN)
 				continue;
 
-			if (Xtx::TypeIsXreq(m_txbuf.tag_type))
+			if (Xtx::TypeIsXreq(type))
 			{
 				if (TEST_DROP_SOME_XTXS && RandTest(4)) continue;
 
@@ -1077,7 +1393,7 @@ Witness::BuildNewBlockStatus Witness::BuildNewBlock(uint32_t& min_time, uint32_t
 					}
 				}
 			}
-			else if (Xtx::TypeIsXpay(m_txbuf.tag_type))
+			else if (Xtx::TypeIsXpay(type))
 			{
 				if (TEST_DROP_SOME_XTXS && RandTest(2)) continue;
 
@@ -1127,17 +1443,25 @@ Witness::BuildNewBlockStatus Witness::BuildNewBlock(uint32_t& min_time, uint32_t
 				continue;
 			}
 
-			BlockChain::CheckCreatePseudoSerialnum(m_txbuf, xtx, txwire);
+			unsigned nin = candidate.nin;
+
+			auto serialnum_ptr = [&](unsigned i) -> const void*
+			{
+				return candidate.serialnums.data() + i * TX_SERIALNUM_BYTES;
+			};
 
 			bool badserial = 0;
 
-			for (unsigned i = 0; i < m_txbuf.nin; ++i)
+			for (unsigned i = 0; i < nin; ++i)
 			{
-				auto rc = g_blockchain.CheckSerialnum(m_dbconn, priorobj, TEMP_SERIALS_WITNESS_BLOCKP, (test_no_delete_persistent_txs ? SmartBuf() : smartobj), &m_txbuf.inputs[i].S_serialnum, TX_SERIALNUM_BYTES);
+				auto rc = g_blockchain.CheckSerialnum(m_dbconn, priorobj, TEMP_SERIALS_WITNESS_BLOCKP, (test_no_delete_persistent_txs ? SmartBuf() : smartobj), serialnum_ptr(i), TX_SERIALNUM_BYTES);
 				if (rc)
 				{
 					badserial = rc;
 
+					if (rc == 4 && !test_no_delete_persistent_txs)
+						candidate.drop = true;		// already spent in a persistent block
+
 					if (rc == 4 && m_test_try_persistent_double_spend)
 					{
 						m_test_is_double_spend = true;
@@ -1162,22 +1486,22 @@ Witness::BuildNewBlockStatus Witness::BuildNewBlock(uint32_t& min_time, uint32_t
 
 			if (badserial && !m_test_is_double_spend)
 			{
-				if (TRACE_XPAYS && Xtx::TypeIsXpay(m_txbuf.tag_type)) BOOST_LOG_TRIVIAL(info) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " skipping tx type " << m_txbuf.tag_type << " with bad serialnum status " << badserial << " bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
-				else if (TRACE_WITNESS)                              BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " skipping tx type " << m_txbuf.tag_type << " with bad serialnum status " << badserial << " bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
+				if (TRACE_XPAYS && Xtx::TypeIsXpay(type)) BOOST_LOG_TRIVIAL(info) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " skipping tx type " << type << " with bad serialnum status " << badserial << " bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
+				else if (TRACE_WITNESS)                  BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " skipping tx type " << type << " with bad serialnum status " << badserial << " bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
 
 				continue;
 			}
 
 			int badinsert = 0;
 
-			for (unsigned i = 0; i < m_txbuf.nin; ++i)
+			for (unsigned i = 0; i < nin; ++i)
 			{
 				// if the witness accepts tx's with duplicate serialnums (which it does for maltest),
 				// we can end up with extra serialnums in the tempdb that were put there before the duplicate was detected and the tx rejected
 				// that can result in the later rejection of a valid block from another witness that contains the same serialnum so it appears to be a double-spend
 				// but the non-mal witnesses won't have this problem, and they will accept the valid block
 
-				auto rc = m_dbconn->TempSerialnumInsert(&m_txbuf.inputs[i].S_serialnum, TX_SERIALNUM_BYTES, (void*)TEMP_SERIALS_WITNESS_BLOCKP);
+				auto rc = m_dbconn->TempSerialnumInsert(serialnum_ptr(i), TX_SERIALNUM_BYTES, (void*)TEMP_SERIALS_WITNESS_BLOCKP);
 				if (rc)
 				{
 					badinsert = rc;
@@ -1194,8 +1518,8 @@ Witness::BuildNewBlockStatus Witness::BuildNewBlock(uint32_t& min_time, uint32_t
 
 			if (badinsert && !m_test_is_double_spend)
 			{
-				if (TRACE_XPAYS && Xtx::TypeIsXpay(m_txbuf.tag_type)) BOOST_LOG_TRIVIAL(info) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " skipping tx type " << m_txbuf.tag_type << " due to TempSerialnumInsert failure " << badinsert << " bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
-				else if (TRACE_WITNESS)                              BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " skipping tx type " << m_txbuf.tag_type << " due to TempSerialnumInsert failure " << badinsert << " bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
+				if (TRACE_XPAYS && Xtx::TypeIsXpay(type)) BOOST_LOG_TRIVIAL(info) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " skipping tx type " << type << " due to TempSerialnumInsert failure " << badinsert << " bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
+				else if (TRACE_WITNESS)                  BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock witness " << witness_index << " level " << priorlevel + 1 << " skipping tx type " << type << " due to TempSerialnumInsert failure " << badinsert << " bufp " << (uintptr_t)bufp << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
 
 				continue;
 			}
@@ -1232,8 +1556,8 @@ Witness::BuildNewBlockStatus Witness::BuildNewBlock(uint32_t& min_time, uint32_t
 
 			//cerr << "Witness txbuf wire tag " << hex << m_txbuf.wire_tag << " obj wire tag " << obj->ObjTag() << " new tag " << newtag << dec << endl;
 
-			if (TRACE_XPAYS && Xtx::TypeIsXpay(m_txbuf.tag_type)) BOOST_LOG_TRIVIAL(info) << "Witness::BuildNewBlock level " << priorlevel + 1 << " adding tx param_level " << m_txbuf.param_level << " type " << type << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
-			else if (TRACE_WITNESS)                              BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock level " << priorlevel + 1 << " adding tx param_level " << m_txbuf.param_level << " type " << type << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
+			if (TRACE_XPAYS && Xtx::TypeIsXpay(type)) BOOST_LOG_TRIVIAL(info) << "Witness::BuildNewBlock level " << priorlevel + 1 << " adding tx param_level " << param_level << " type " << type << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
+			else if (TRACE_WITNESS)                  BOOST_LOG_TRIVIAL(trace) << "Witness::BuildNewBlock level " << priorlevel + 1 << " adding tx param_level " << param_level << " type " << type << " oid " << buf2hex(obj->OidPtr(), CC_OID_TRACE_SIZE);
 
 			copy_to_buf(newsize, sizeof(newsize), m_newblock_bufpos, output, bufsize);
 			copy_to_buf(newtag, sizeof(newtag), m_newblock_bufpos, output, bufsize);
@@ -1246,6 +1570,9 @@ Witness::BuildNewBlockStatus Witness::BuildNewBlock(uint32_t& min_time, uint32_t
 			break;
 		}
 
+		if (build_status == BUILD_NEWBLOCK_STATUS_FULL)
+			break;
+
 		if (is_ccmint && ntx)
 			continue;
 
@@ -1269,9 +1596,19 @@ Witness::BuildNewBlockStatus Witness::BuildNewBlock(uint32_t& min_time, uint32_t
 	return build_status;
 }
 
-SmartBuf Witness::FinishNewBlock(SmartBuf priorobj)
+// builds everything in the new block except the timestamp and signature
+// if the template is already current, it is left as is
+// returns true on error
+
+bool Witness::PrepareBlockTemplate(SmartBuf priorobj)
 {
-	SmartBuf smartobj;
+	if (m_template && m_template_prior == priorobj && m_template_bufpos == m_newblock_bufpos)
+		return false;
+
+	auto t0 = chrono::steady_clock::now();
+
+	m_template = SmartBuf();
+	m_template_prior = SmartBuf();
 
 	auto priorblock = (Block*)priorobj.data();
 	CCASSERT(priorblock);
@@ -1279,27 +1616,23 @@ SmartBuf Witness::FinishNewBlock(SmartBuf priorobj)
 	auto priorwire = priorblock->WireData();
 	auto priorauxp = priorblock->AuxPtr();
 
-	if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::FinishNewBlock witness " << witness_index << " prior block level " << priorwire->level.GetValue() << " oid " << buf2hex(&priorauxp->oid, CC_OID_TRACE_SIZE);
+	if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::PrepareBlockTemplate witness " << witness_index << " prior block level " << priorwire->level.GetValue() << " oid " << buf2hex(&priorauxp->oid, CC_OID_TRACE_SIZE);
 
 	CCASSERT(witness_index >= 0);
 
 	if (witness_index >= priorauxp->blockchain_params.next_nwitnesses)
-	{
-		BOOST_LOG_TRIVIAL(info) << "Witness::FinishNewBlock skipping witness " << witness_index << " because it exceeds block prior block next_nwitnesses " << priorauxp->blockchain_params.next_nwitnesses;
-
-		return SmartBuf();
-	}
+		return true;	// logged by FinishNewBlock
 
 	// copy block to SmartBuf
 
 	auto objsize = m_newblock_bufpos + sizeof(CCObject::Header) + sizeof(BlockWireHeader);
 
-	smartobj = SmartBuf(objsize + sizeof(CCObject::Preamble));
+	SmartBuf smartobj(objsize + sizeof(CCObject::Preamble));
 	if (!smartobj)
 	{
-		BOOST_LOG_TRIVIAL(error) << "Witness::FinishNewBlock witness " << witness_index << " smartobj failed";
+		BOOST_LOG_TRIVIAL(error) << "Witness::PrepareBlockTemplate witness " << witness_index << " smartobj failed";
 
-		return SmartBuf();
+		return true;
 	}
 
 	auto block = (Block*)smartobj.data();
@@ -1310,28 +1643,14 @@ SmartBuf Witness::FinishNewBlock(SmartBuf priorobj)
 
 	auto wire = block->WireData();
 
-	auto level = priorwire->level.GetValue() + 1;
-
-	auto timestamp = unixtime();
-	auto prior_timestamp = priorwire->timestamp.GetValue();
-	int64_t delta = timestamp - prior_timestamp;
-	if (delta < 0)
-		timestamp = prior_timestamp;
-
-	if (TEST_DUPLICATE_TIMESTAMPS && level > 1 && RandTest(2)) timestamp = prior_timestamp;	// for testing
-
-	if (IsMalTest() && level % 100 < 10)
-		timestamp += 200;
-
 	memcpy(&wire->prior_oid, &priorauxp->oid, sizeof(ccoid_t));
-	wire->timestamp.SetValue(timestamp);
-	wire->level.SetValue(level);
+	wire->level.SetValue(priorwire->level.GetValue() + 1);
 	wire->witness = witness_index;
 
 	if (m_newblock_bufpos)
 	{
-		//if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::FinishNewBlock adding m_txbuf's at txdata " << (uintptr_t)block->TxData() << " size " << m_newblock_bufpos << " data " << buf2hex(output, 16);
-		if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::FinishNewBlock adding tx's size " << m_newblock_bufpos << " to block level " << wire->level.GetValue() << " bufp " << (uintptr_t)smartobj.BasePtr() << " prior bufp " << (uintptr_t)priorobj.BasePtr() << " prior oid " << buf2hex(&priorauxp->oid, CC_OID_TRACE_SIZE);
+		//if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::PrepareBlockTemplate adding m_txbuf's at txdata " << (uintptr_t)block->TxData() << " size " << m_newblock_bufpos << " data " << buf2hex(output, 16);
+		if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::PrepareBlockTemplate adding tx's size " << m_newblock_bufpos << " to block level " << wire->level.GetValue() << " bufp " << (uintptr_t)smartobj.BasePtr() << " prior bufp " << (uintptr_t)priorobj.BasePtr() << " prior oid " << buf2hex(&priorauxp->oid, CC_OID_TRACE_SIZE);
 
 		memcpy(block->TxData(), m_blockbuf.data(), m_newblock_bufpos);
 	}
@@ -1339,9 +1658,9 @@ SmartBuf Witness::FinishNewBlock(SmartBuf priorobj)
 	auto auxp = block->SetupAuxBuf(smartobj, true);
 	if (!auxp)
 	{
-		BOOST_LOG_TRIVIAL(error) << "Witness::FinishNewBlock witness " << witness_index << " SetupAuxBuf failed";
+		BOOST_LOG_TRIVIAL(error) << "Witness::PrepareBlockTemplate witness " << witness_index << " SetupAuxBuf failed";
 
-		return SmartBuf();
+		return true;
 	}
 
 	block->ChainToPriorBlock(priorobj);
@@ -1356,6 +1675,72 @@ SmartBuf Witness::FinishNewBlock(SmartBuf priorobj)
 	memcpy(&wire->witness_next_signing_public_key, &auxp->blockchain_params.signing_keys[witness_index], sizeof(wire->witness_next_signing_public_key));
 #endif
 
+	m_template = smartobj;
+	m_template_prior = priorobj;
+	m_template_bufpos = m_newblock_bufpos;
+	m_template_ticks = ccticks();
+	m_template_usec = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t0).count();
+
+	++m_template_stats.nbuilt;
+
+	if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::PrepareBlockTemplate witness " << witness_index << " level " << wire->level.GetValue() << " size " << objsize << " prepared in " << m_template_usec << " usec";
+
+	return false;
+}
+
+SmartBuf Witness::FinishNewBlock(SmartBuf priorobj)
+{
+	auto t0 = chrono::steady_clock::now();
+
+	auto priorblock = (Block*)priorobj.data();
+	CCASSERT(priorblock);
+
+	auto priorwire = priorblock->WireData();
+	auto priorauxp = priorblock->AuxPtr();
+
+	if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::FinishNewBlock witness " << witness_index << " prior block level " << priorwire->level.GetValue() << " oid " << buf2hex(&priorauxp->oid, CC_OID_TRACE_SIZE);
+
+	CCASSERT(witness_index >= 0);
+
+	if (witness_index >= priorauxp->blockchain_params.next_nwitnesses)
+	{
+		BOOST_LOG_TRIVIAL(info) << "Witness::FinishNewBlock skipping witness " << witness_index << " because it exceeds block prior block next_nwitnesses " << priorauxp->blockchain_params.next_nwitnesses;
+
+		return SmartBuf();
+	}
+
+	bool used_template = (m_template && m_template_prior == priorobj && m_template_bufpos == m_newblock_bufpos);
+	uint32_t template_age = ccticks_elapsed(m_template_ticks, ccticks());
+
+	if (PrepareBlockTemplate(priorobj))
+		return SmartBuf();
+
+	auto smartobj = m_template;
+
+	m_template = SmartBuf();
+	m_template_prior = SmartBuf();
+
+	auto block = (Block*)smartobj.data();
+	auto wire = block->WireData();
+	auto auxp = block->AuxPtr();
+
+	auxp->announce_ticks = ccticks();
+
+	auto level = wire->level.GetValue();
+
+	auto timestamp = unixtime();
+	auto prior_timestamp = priorwire->timestamp.GetValue();
+	int64_t delta = timestamp - prior_timestamp;
+	if (delta < 0)
+		timestamp = prior_timestamp;
+
+	if (TEST_DUPLICATE_TIMESTAMPS && level > 1 && RandTest(2)) timestamp = prior_timestamp;	// for testing
+
+	if (IsMalTest() && level % 100 < 10)
+		timestamp += 200;
+
+	wire->timestamp.SetValue(timestamp);
+
 	block_hash_t block_hash;
 	block->CalcHash(block_hash);
 	auxp->SetHash(block_hash);
@@ -1395,7 +1780,29 @@ SmartBuf Witness::FinishNewBlock(SmartBuf priorobj)
 		}
 	}
 
-	BOOST_LOG_TRIVIAL(info) << "Witness::FinishNewBlock built new block level " << wire->level.GetValue() << " timestamp " << timestamp << " witness " << (unsigned)wire->witness << " size " << block->ObjSize() << " oid " << buf2hex(&auxp->oid, CC_OID_TRACE_SIZE) << " prior oid " << buf2hex(&wire->prior_oid, CC_OID_TRACE_SIZE);
+	auto finish_usec = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t0).count();
+
+	m_template_stats.finish_usec += finish_usec;
+
+	if (used_template)
+	{
+		++m_template_stats.nused;
+		m_template_stats.saved_usec += m_template_usec;
+		m_template_stats.age_ms += template_age;
+	}
+	else
+		++m_template_stats.nstale;
+
+	BOOST_LOG_TRIVIAL(info) << "Witness::FinishNewBlock built new block level " << wire->level.GetValue() << " timestamp " << timestamp << " witness " << (unsigned)wire->witness << " size " << block->ObjSize() << " oid " << buf2hex(&auxp->oid, CC_OID_TRACE_SIZE) << " prior oid " << buf2hex(&wire->prior_oid, CC_OID_TRACE_SIZE) << " finished in " << finish_usec << " usec" << (used_template ? " from template age ms " + to_string(template_age) + " saved usec " + to_string(m_template_usec) : string(" without template"));
+
+	if (m_template_stats.nused + m_template_stats.nstale == 100)
+	{
+		LogTemplateStats();
+		LogSkipScoreStats();
+
+		memset(&m_template_stats, 0, sizeof(m_template_stats));
+		memset(&m_skip_score_stats, 0, sizeof(m_skip_score_stats));
+	}
 
 	if (m_test_is_double_spend)
 		BOOST_LOG_TRIVIAL(info) << "Witness::FinishNewBlock built double-spend test block level " << wire->level.GetValue() << " witness " << (unsigned)wire->witness << " size " << block->ObjSize() << " oid " << buf2hex(&auxp->oid, CC_OID_TRACE_SIZE) << " prior oid " << buf2hex(&wire->prior_oid, CC_OID_TRACE_SIZE);
@@ -1403,6 +1810,20 @@ SmartBuf Witness::FinishNewBlock(SmartBuf priorobj)
 	return smartobj;
 }
 
+void Witness::LogTemplateStats()
+{
+	auto& stats = m_template_stats;
+	auto nblocks = stats.nused + stats.nstale;
+
+	if (!nblocks)
+		return;
+
+	BOOST_LOG_TRIVIAL(info) << "Witness::LogTemplateStats witness " << witness_index << " blocks " << nblocks << " from template " << stats.nused << " without template " << stats.nstale << " templates prepared " << stats.nbuilt
+		<< " mean finish usec " << stats.finish_usec / nblocks
+		<< " mean template age ms " << (stats.nused ? stats.age_ms / stats.nused : 0)
+		<< " mean saved usec " << (stats.nused ? stats.saved_usec / stats.nused : 0);
+}
+
 bool Witness::IsSoleWitness() const
 {
 	if (witness_index)
@@ -1428,7 +1849,8 @@ void Witness::NotifyNewWork(unsigned type)
 
 	CCASSERT(type < NSEQOBJ);
 
-	lock_guard<mutex> lock(m_work_mutex);
+	// m_work_mutex is only taken when the witness thread is waiting, so the tx validation threads don't contend for it
+	// WaitForWork sets its waiting flags before it rechecks for work, so either it sees this work or this sees it waiting
 
 	m_have_new_work[type] = true;
 
@@ -1443,6 +1865,8 @@ void Witness::NotifyNewWork(unsigned type)
 			return;
 	}
 
+	lock_guard<mutex> lock(m_work_mutex);
+
 	m_work_condition_variable.notify_one();
 }
 
@@ -1480,7 +1904,7 @@ int Witness::WaitForWork(bool bwait4block, bool bwait4tx, uint32_t exchange_time
 
 		if (bwait4tx && (HaveWork(TXSEQ) || HaveWork(XREQSEQ)))
 		{
-			if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::WaitForWork tx HaveWork " << HaveWork(TXSEQ) << " next seqnum " << g_seqnum[TXSEQ][VALIDSEQ].Peek() << " m_newblock_next_seqnum " << m_newblock_next_seqnum[TXSEQ] << " ; xreq HaveWork " << HaveWork(XREQSEQ) << " next seqnum " << g_seqnum[XREQSEQ][VALIDSEQ].Peek() << " m_newblock_next_seqnum " << m_newblock_next_seqnum[XREQSEQ];
+			if (TRACE_WITNESS) BOOST_LOG_TRIVIAL(trace) << "Witness::WaitForWork tx HaveWork " << HaveWork(TXSEQ) << " next seqnum " << g_seqnum[TXSEQ][VALIDSEQ].Peek() << " pool next seqnum " << m_txpool.NextSeqnum(TXSEQ) << " ; xreq HaveWork " << HaveWork(XREQSEQ) << " next seqnum " << g_seqnum[XREQSEQ][VALIDSEQ].Peek() << " pool next seqnum " << m_txpool.NextSeqnum(XREQSEQ);
 
 			return 1;
 		}
@@ -1535,6 +1959,14 @@ int Witness::WaitForWork(bool bwait4block, bool bwait4tx, uint32_t exchange_time
 		m_waiting_on_block = bwait4block;
 		m_waiting_on_tx = bwait4tx;
 
+		if ((bwait4block && HaveWork(BLOCKSEQ)) || (bwait4tx && (HaveWork(TXSEQ) || HaveWork(XREQSEQ))))
+		{
+			m_waiting_on_block = false;
+			m_waiting_on_tx = false;
+
+			continue;		// work arrived before NotifyNewWork could see the waiting flags
+		}
+
 		#if CCTICKS_PER_SEC != 1000
 		#error fix wait: units != milliseconds
 		#endif
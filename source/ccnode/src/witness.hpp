@@ -9,8 +9,10 @@
 #pragma once
 
 #include "block.hpp"
+#include "blockscore.hpp"
 #include "dbconn.hpp"
 #include "seqnum.hpp"
+#include "txpool.hpp"
 
 #include <transaction.hpp>
 #include <SmartBuf.hpp>
@@ -27,7 +29,28 @@ class Witness
 
 	uint32_t m_block_start_time;
 	uint32_t m_newblock_bufpos;
-	int64_t m_newblock_next_seqnum[NSEQOBJ];
+
+	TxCandidatePool m_txpool;
+	TxCandidateSource *m_txsource;
+	vector<unsigned> m_txorder;
+
+	// block template prepared while waiting for this witness's turn
+
+	SmartBuf m_template;
+	SmartBuf m_template_prior;
+	uint32_t m_template_bufpos;
+	uint32_t m_template_ticks;
+	uint32_t m_template_usec;
+
+	struct TemplateStats
+	{
+		uint64_t nbuilt;				// templates prepared
+		uint64_t nused;					// blocks finished from a current template
+		uint64_t nstale;				// blocks that had to be prepared when finished
+		uint64_t saved_usec;			// prepare time of the templates used
+		uint64_t finish_usec;			// time to finish the blocks
+		uint64_t age_ms;				// time from preparing each template used to finishing its block
+	} m_template_stats;
 
 	bool m_test_ignore_order;
 	bool m_test_try_persistent_double_spend;
@@ -40,6 +63,31 @@ class Witness
 	SmartBuf m_last_last_indelible_block;
 	uint16_t m_score_genstamp = 0;
 
+	// skip scores of the valid blocks, kept from one block attempt to the next until the last indelible block changes
+
+	struct SkipScoreEntry
+	{
+		SmartBuf smartobj;
+		uint64_t score;				// score back to the last indelible block, before the top witness is added
+		unsigned scorebits;
+		int sig_order_witness;		// witness for which bad_sig_order was computed, or -1 if not yet computed
+		bool bad_sig_order;
+	};
+
+	vector<SkipScoreEntry> m_skip_scores;		// in the order the blocks are returned by ProcessQGetValidObjs
+	uint16_t m_skip_scores_genstamp;
+	SkipScorePool m_skip_score_pool;
+	vector<SkipScoreWork> m_skip_score_work;
+
+	struct SkipScoreStats
+	{
+		uint64_t nupdates;				// calls to UpdateSkipScores
+		uint64_t ncached;				// blocks whose score was already in the table
+		uint64_t nscored;				// blocks scored
+		uint64_t nparallel;				// updates that scored the new blocks in parallel
+		uint64_t update_usec;			// time spent in UpdateSkipScores
+	} m_skip_score_stats;
+
 	void ThreadProc();
 
 	uint32_t NextTurnTicks() const;
@@ -47,6 +95,8 @@ class Witness
 	bool AttemptNewBlock();
 	uint64_t FindBestOwnScore(SmartBuf last_indelible_block);
 	SmartBuf FindBestBuildingBlock(SmartBuf last_indelible_block, uint64_t m_highest_witnessed_level, uint64_t bestscore);
+	void UpdateSkipScores(SmartBuf last_indelible_block);
+	void LogSkipScoreStats();
 
 	enum BuildNewBlockStatus
 	{
@@ -56,8 +106,12 @@ class Witness
 	};
 
 	void StartNewBlock();
+	int DecodeCandidate(SmartBuf smartobj, TxCandidatePool::Candidate& candidate);
+	void FetchCandidates(unsigned type, unsigned max_fetch);
 	BuildNewBlockStatus BuildNewBlock(uint32_t& min_time, uint32_t max_time, SmartBuf priorobj, uint64_t priorlevel, unsigned nconfsigs, uint64_t last_indelible_level);
+	bool PrepareBlockTemplate(SmartBuf priorobj);
 	SmartBuf FinishNewBlock(SmartBuf priorobj);
+	void LogTemplateStats();
 
 	mutex m_work_mutex;
 	condition_variable m_work_condition_variable;
@@ -96,6 +150,8 @@ public:
 	int block_min_work_ms;
 	int block_max_time;
 	int test_block_random_ms;
+	int tx_age_floor_secs;
+	int tx_age_share_pct;
 	bool test_mal;
 
 	Witness();
@@ -120,6 +176,12 @@ public:
 
 	void NotifyNewWork(unsigned type);
 
+	// called by the ValidObjs table when it deletes an object
+	void NotifyValidObjDeleted(SmartBuf smartobj)
+	{
+		m_txpool.NotifyDeleted(smartobj);
+	}
+
 	void ResetExchangeWorkTime(bool freeze = false);
 	void UpdateExchangeWorkTime(uint64_t timestamp, bool bnotify = false);
 };
@@ -24,6 +24,7 @@
 #include <encode.h>
 
 #include <tor.h>
+#include <socks.hpp>
 
 #include <dblog.h>
 #include <sqlite/sqlite3.h>
@@ -39,6 +40,8 @@
 #define DEFAULT_TRACE_LEVEL	3
 #define TRACE_SHUTDOWN		0
 
+#define TRANSACT_TOR_POOL_IDLE	5	// must be well under the transaction server's connection timeout
+
 #define SECONDS_PP	(1)
 #define MINUTES_PP	(60 * SECONDS_PP)
 #define HOURS_PP	(60 * MINUTES_PP)
@@ -113,6 +116,7 @@ static void do_show_config()
 	cout << "   cleared confirmations = " << g_params.cleared_confirmations << endl;
 	cout << "   polled addresses per destination = " << g_params.polling_addresses << endl;
 	cout << "   polling threads = " << g_params.polling_threads << endl;
+	cout << "   address watch subscription = " << yesno(g_params.address_watch) << endl;
 	cout << "   exchange poll interval = " << g_params.exchange_poll_time << endl;
 	cout << endl;
 
@@ -251,6 +255,8 @@ static int process_options(int argc, char **argv)
 
 		("tx-polling-addresses", po::value<int>(&g_params.polling_addresses)->default_value(6), "Number of addresses to poll per receive destination.")
 		("tx-polling-threads", po::value<int>(&g_params.polling_threads)->default_value(10), "Transaction polling threads.")
+		("tx-address-watch", po::value<bool>(&g_params.address_watch)->default_value(0), "Keep a subscription open on the transaction server to be notified when the most often polled addresses receive payments,\n"
+				"instead of polling them; this reduces query load, but the server can link the watched addresses to each other.")
 
 		//TODO?: remove this and compute from target blockchain properies?:
 		("exchange-poll-interval", po::value<int>(&g_params.exchange_poll_time)->default_value(60), "Exchange match polling interval.")
@@ -383,7 +389,7 @@ static int process_options(int argc, char **argv)
 	else
 		expand_number_wide(g_params.transact_tor_hosts_file, g_params.blockchain);
 
-	g_lpc_service.max_outconns = 1 + g_params.polling_threads + g_params.tx_threads_max;
+	g_lpc_service.max_outconns = 1 + g_params.polling_threads + g_params.address_watch + g_params.tx_threads_max;
 
 	/* polling_table[secret type][last_receive>0][list elements][period/endtime]
 		#define SECRET_TYPE_SEND_ADDRESS			13	// + paynum if known
@@ -725,6 +731,9 @@ int main(int argc, char **argv)
 		auto rc = TxQuery::ReadHostsFile(g_params.transact_tor_hosts_file);
 		if (rc)
 			goto do_fatal;
+
+		if (!g_params.transact_tor_single_query)
+			g_sockspool.Start(g_params.torproxy_port, TRANSACT_TOR_POOL_IDLE);
 	}
 
 	g_lpc_service.Start();
@@ -875,6 +884,8 @@ do_fatal:
 
 	g_lpc_service.WaitForShutdown();
 
+	g_sockspool.Stop();
+
 	if (dbconn)
 	{
 			if (TRACE_SHUTDOWN) BOOST_LOG_TRIVIAL(info) << "shutdown 16...";
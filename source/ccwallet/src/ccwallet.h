@@ -76,6 +76,7 @@ DECLARE_EXTERN struct global_params_struct
 
 	int polling_addresses;
 	int polling_threads;
+	bool address_watch;
 
 	array<array<vector<pair<unsigned, unsigned>>, 2>, 7> polling_table;
 
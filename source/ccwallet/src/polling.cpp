@@ -20,6 +20,10 @@
 #include <BlockChainStatus.hpp>
 #include <dblog.h>
 #include <SpinLock.hpp>
+#include <CCticks.hpp>
+#include <socks.hpp>
+#include <txquery.h>
+#include <jsonutil.h>
 
 static FastSpinLock lastblocktime_lock(__FILE__, __LINE__);
 static atomic<uint64_t> lastblocktime;
@@ -39,6 +43,14 @@ static atomic<uint64_t> lastblocktime_update_time;
 
 #define TRACE_POLLING	(g_params.trace_polling)
 
+#define ADDRESS_WATCH_RESUBSCRIBE_SECS	60		// minimum seconds between resubscribing to add newly polled addresses
+#define ADDRESS_WATCH_REPLY_SECS		90		// maximum seconds to wait for the reply to a subscription
+#define ADDRESS_WATCH_RETRY_SECS		30		// seconds to wait after a subscription fails
+#define ADDRESS_WATCH_READ_WAIT			200		// milliseconds between checks for incoming notifications
+#define ADDRESS_WATCH_READ_MAX			200000
+
+static AddressWatch g_address_watch;
+
 uint64_t Polling::EstimatedBlocktime(uint64_t checktime, uint64_t *conservative_lastblocktime)
 {
 	lock_guard<FastSpinLock> lock(lastblocktime_lock);
@@ -69,6 +81,9 @@ void Polling::Start(unsigned nthreads)
 {
 	if (TRACE_POLLING) BOOST_LOG_TRIVIAL(info) << "Polling::Start nthreads " << nthreads;
 
+	if (g_params.address_watch && nthreads)
+		g_address_watch.Start();
+
 	m_pthreads.reserve(m_pthreads.size() + nthreads);
 
 	for (unsigned i = 0; i < nthreads; ++i)
@@ -87,6 +102,8 @@ void Polling::StartShutdown()
 
 	for (auto t = m_pthreads.rbegin(); t != m_pthreads.rend(); ++t)
 		(*t)->StartShutdown();
+
+	g_address_watch.StartShutdown();
 }
 
 void Polling::WaitForShutdown()
@@ -99,6 +116,8 @@ void Polling::WaitForShutdown()
 		m_pthreads.pop_back();
 	}
 
+	g_address_watch.WaitForShutdown();
+
 	if (TRACE_POLLING) BOOST_LOG_TRIVIAL(debug) << "Polling::WaitForShutdown done";
 }
 
@@ -325,6 +344,13 @@ int PollThread::DoPoll(uint64_t checktime)
 		finally.Clear();
 	}
 
+	if (poll_secret && g_params.address_watch && g_address_watch.CheckPoll(secret.value))
+	{
+		if (TRACE_POLLING) BOOST_LOG_TRIVIAL(trace) << "PollThread::DoPoll skipping address covered by address watch " << buf2hex(&secret.value, TX_ADDRESS_BYTES);
+
+		return 0;
+	}
+
 	unsigned jitter = rand() % 1000;	// for privacy, pause a random time before checking
 
 	wait_for_shutdown(jitter);
@@ -381,3 +407,474 @@ int PollThread::DoPoll(uint64_t checktime)
 
 	return !full_round;
 }
+
+void AddressWatch::Start()
+{
+	if (TRACE_POLLING) BOOST_LOG_TRIVIAL(info) << "AddressWatch::Start";
+
+	m_dbconn = new DbConn;
+	CCASSERT(m_dbconn);
+
+	m_txquery = g_lpc_service.GetConnection(false);
+	CCASSERT(m_txquery);
+
+	m_thread = new thread(&AddressWatch::ThreadProc, this);
+	CCASSERT(m_thread);
+}
+
+void AddressWatch::StartShutdown()
+{
+	if (TRACE_POLLING) BOOST_LOG_TRIVIAL(trace) << "AddressWatch::StartShutdown";
+
+	if (m_txquery)
+		m_txquery->Stop();
+}
+
+void AddressWatch::WaitForShutdown()
+{
+	if (TRACE_POLLING) BOOST_LOG_TRIVIAL(trace) << "AddressWatch::WaitForShutdown";
+
+	if (m_thread)
+	{
+		m_thread->join();
+		delete m_thread;
+		m_thread = NULL;
+	}
+
+	if (m_txquery)
+	{
+		m_txquery->Stop();
+		m_txquery->WaitForStopped();
+		m_txquery->FreeConnection();
+		m_txquery = NULL;
+	}
+
+	if (m_dbconn)
+	{
+		delete m_dbconn;
+		m_dbconn = NULL;
+	}
+}
+
+// caller must hold m_watch_lock
+
+AddressWatch::Entry* AddressWatch::FindEntry(const bigint_t& address)
+{
+	for (auto& e : m_entries)
+	{
+		if (e.address == address)
+			return &e;
+	}
+
+	return NULL;
+}
+
+// called by PollThread::DoPoll when an address is due to be polled
+// returns true if the address is covered by the subscription and the query can be skipped
+
+bool AddressWatch::CheckPoll(const bigint_t& address)
+{
+	lock_guard<mutex> lock(m_watch_lock);
+
+	++m_seq;
+
+	auto entry = FindEntry(address);
+
+	if (entry)
+	{
+		entry->check_seq = m_seq;
+
+		if (m_connected && entry->subscribed && !entry->notified && entry->poll_seq > entry->covered_seq)
+			return true;
+
+		entry->poll_seq = m_seq;
+		entry->notified = false;
+
+		return false;
+	}
+
+	if (m_entries.size() < TX_QUERY_WATCH_MAX_ADDRESSES)
+	{
+		m_entries.emplace_back();
+		entry = &m_entries.back();
+	}
+	else
+	{
+		// replace the address least recently due to be polled
+
+		entry = &m_entries[0];
+
+		for (auto& e : m_entries)
+		{
+			if (e.check_seq < entry->check_seq)
+				entry = &e;
+		}
+	}
+
+	entry->address = address;
+	entry->check_seq = m_seq;
+	entry->covered_seq = m_seq;
+	entry->poll_seq = m_seq;
+	entry->subscribed = false;
+	entry->notified = false;
+
+	m_changed = true;
+
+	return false;
+}
+
+void AddressWatch::ThreadProc()
+{
+	BOOST_LOG_TRIVIAL(info) << "AddressWatch::ThreadProc m_dbconn " << (uintptr_t)m_dbconn << " m_txquery " << (uintptr_t)m_txquery;
+
+	boost::asio::io_service io_service;
+
+	while (!g_shutdown)
+	{
+		bool empty;
+
+		{
+			lock_guard<mutex> lock(m_watch_lock);
+
+			empty = m_entries.empty();
+		}
+
+		if (empty)
+		{
+			wait_for_shutdown(1000);
+
+			continue;
+		}
+
+		boost::asio::ip::tcp::socket socket(io_service);
+
+		auto rc = Subscribe(socket);
+
+		boost::system::error_code e;
+		socket.close(e);
+
+		{
+			lock_guard<mutex> lock(m_watch_lock);
+
+			m_connected = false;
+		}
+
+		if (rc && !g_shutdown)
+		{
+			m_txquery->ClearHost();
+
+			wait_for_shutdown(ADDRESS_WATCH_RETRY_SECS * 1000);
+		}
+	}
+
+	BOOST_LOG_TRIVIAL(info) << "AddressWatch::ThreadProc done";
+}
+
+// returns 0 when the subscription should be renewed, or -1 on error
+
+int AddressWatch::Subscribe(boost::asio::ip::tcp::socket& socket)
+{
+	vector<bigint_t> addresses;
+	uint64_t commitstart;
+
+	{
+		lock_guard<mutex> lock(m_watch_lock);
+
+		for (auto& e : m_entries)
+			addresses.push_back(e.address);
+
+		commitstart = m_next_commitnum;
+
+		m_changed = false;
+	}
+
+	if (TRACE_POLLING) BOOST_LOG_TRIVIAL(debug) << "AddressWatch::Subscribe naddresses " << addresses.size() << " commitstart " << commitstart;
+
+	vector<char> querybuf;
+
+	auto rc = m_txquery->PrepareWatch(commitstart, addresses.data(), addresses.size(), querybuf);
+	if (rc)
+		return -1;
+
+	boost::system::error_code e;
+
+	if (g_params.transact_tor)
+		e = Socks::Connect(socket, g_params.torproxy_port, m_txquery->GetHost(), Socks::IsolationUser());	// a separate circuit, since the subscription links the addresses
+	else
+	{
+		auto addr = boost::asio::ip::address::from_string(g_params.transact_host, e);
+
+		if (!e)
+			socket.connect(boost::asio::ip::tcp::endpoint(addr, g_params.transact_port), e);
+	}
+
+	if (!e)
+		boost::asio::write(socket, boost::asio::buffer(querybuf.data(), *(uint32_t*)querybuf.data()), e);
+
+	if (!e)
+		socket.non_blocking(true, e);
+
+	if (e)
+	{
+		BOOST_LOG_TRIVIAL(info) << "AddressWatch::Subscribe connect error " << e << " " << e.message();
+
+		return -1;
+	}
+
+	auto t0 = ccticks();
+	bool have_reply = false;
+
+	string msgbuf;
+	char readbuf[4096];
+
+	while (!g_shutdown)
+	{
+		auto nbytes = socket.read_some(boost::asio::buffer(readbuf, sizeof(readbuf)), e);
+
+		if (e == boost::asio::error::would_block)
+		{
+			auto elapsed = ccticks_elapsed(t0, ccticks());
+
+			if (!have_reply && elapsed > ADDRESS_WATCH_REPLY_SECS * CCTICKS_PER_SEC)
+			{
+				BOOST_LOG_TRIVIAL(info) << "AddressWatch::Subscribe timeout waiting for reply";
+
+				return -1;
+			}
+
+			if (have_reply && elapsed > ADDRESS_WATCH_RESUBSCRIBE_SECS * CCTICKS_PER_SEC)
+			{
+				lock_guard<mutex> lock(m_watch_lock);
+
+				if (m_changed)
+					return 0;
+			}
+
+			wait_for_shutdown(ADDRESS_WATCH_READ_WAIT);
+
+			continue;
+		}
+
+		if (e == boost::asio::error::eof && have_reply)
+		{
+			if (TRACE_POLLING) BOOST_LOG_TRIVIAL(debug) << "AddressWatch::Subscribe subscription expired";
+
+			return 0;
+		}
+
+		if (e)
+		{
+			BOOST_LOG_TRIVIAL(info) << "AddressWatch::Subscribe read error " << e << " " << e.message();
+
+			return -1;
+		}
+
+		msgbuf.append(readbuf, nbytes);
+
+		while (true)
+		{
+			auto pos = msgbuf.find('\0');
+			if (pos == string::npos)
+				break;
+
+			rc = HandleMessage(msgbuf.c_str(), addresses, commitstart);
+			if (rc)
+				return -1;
+
+			have_reply = true;
+
+			msgbuf.erase(0, pos + 1);
+		}
+
+		if (msgbuf.size() > ADDRESS_WATCH_READ_MAX)
+		{
+			BOOST_LOG_TRIVIAL(info) << "AddressWatch::Subscribe message too large";
+
+			return -1;
+		}
+	}
+
+	return -1;
+}
+
+int AddressWatch::HandleMessage(const char *msg, const vector<bigint_t>& addresses, uint64_t commitstart)
+{
+	if (TRACE_POLLING) BOOST_LOG_TRIVIAL(debug) << "AddressWatch::HandleMessage " << msg;
+
+	if (msg[0] != '{')
+	{
+		BOOST_LOG_TRIVIAL(warning) << "AddressWatch::HandleMessage transaction server returned " << msg;
+
+		lock_guard<mutex> lock(m_watch_lock);
+
+		m_next_commitnum = 0;
+
+		return -1;
+	}
+
+	Json::Value root;
+
+	Json::CharReaderBuilder builder;
+	Json::CharReaderBuilder::strictMode(&builder.settings_);
+
+	auto reader = builder.newCharReader();
+
+	bool ok;
+
+	try
+	{
+		ok = reader->parse(msg, msg + strlen(msg), &root, NULL);
+	}
+	catch (...)
+	{
+		ok = false;
+	}
+
+	delete reader;
+
+	string fn, key;
+	Json::Value value;
+	bigint_t bigval;
+	char output[128] = {0};
+	uint32_t outsize = sizeof(output);
+
+	vector<bigint_t> notified;
+	bool poll_all = false;
+
+	try
+	{
+		if (!ok || root.size() != 1)
+			goto parse_error;
+
+		key = root.begin().name();
+		value = *root.begin();
+
+		if (key == "tx-address-watch-report")
+		{
+			key = "next-commitment-number";
+			if (!value.isMember(key))
+				goto parse_error;
+			auto rc = parse_int_value(fn, key, value[key].asString(), TX_COMMITNUM_BITS, 0UL, bigval, output, outsize);
+			if (rc) goto parse_error;
+
+			lock_guard<mutex> lock(m_watch_lock);
+
+			m_connected = true;
+			m_next_commitnum = BIG64(bigval);
+
+			// the coverage of an address that was in the prior subscription continues if commitstart was set
+
+			for (auto& e : m_entries)
+			{
+				bool sent = (find(addresses.begin(), addresses.end(), e.address) != addresses.end());
+
+				if (sent && !(commitstart && e.subscribed))
+					e.covered_seq = ++m_seq;
+
+				e.subscribed = sent;
+			}
+
+			if (TRACE_POLLING) BOOST_LOG_TRIVIAL(info) << "AddressWatch::HandleMessage watching " << addresses.size() << " addresses next commitnum " << m_next_commitnum;
+
+			return 0;
+		}
+
+		if (key != "tx-address-watch-notify")
+			goto parse_error;
+
+		poll_all = value.isMember("poll-all");
+
+		key = "addresses";
+		if (!value.isMember(key) || !value[key].isArray())
+			goto parse_error;
+
+		for (unsigned i = 0; i < value[key].size(); ++i)
+		{
+			auto rc = parse_int_value(fn, key, value[key][i].asString(), TX_ADDRESS_BITS, 0UL, bigval, output, outsize);
+			if (rc) goto parse_error;
+
+			notified.push_back(bigval);
+		}
+	}
+	catch (...)
+	{
+		goto parse_error;
+	}
+
+	{
+		lock_guard<mutex> lock(m_watch_lock);
+
+		if (poll_all)
+		{
+			notified.clear();
+
+			for (auto& e : m_entries)
+				notified.push_back(e.address);
+		}
+
+		for (auto& address : notified)
+		{
+			auto entry = FindEntry(address);
+			if (entry)
+				entry->notified = true;
+		}
+	}
+
+	if (TRACE_POLLING) BOOST_LOG_TRIVIAL(info) << "AddressWatch::HandleMessage notified of " << notified.size() << " addresses poll-all " << poll_all;
+
+	for (auto& address : notified)
+		SetPollNow(address);
+
+	return 0;
+
+parse_error:
+
+	BOOST_LOG_TRIVIAL(info) << "AddressWatch::HandleMessage error parsing key " << key << " in " << msg;
+
+	lock_guard<mutex> lock(m_watch_lock);
+
+	m_next_commitnum = 0;
+
+	return -1;
+}
+
+// sets the address's next poll time so a PollThread queries it right away
+
+void AddressWatch::SetPollNow(const bigint_t& address)
+{
+	auto dbconn = m_dbconn;
+
+	auto rc = dbconn->BeginWrite();
+	if (rc)
+	{
+		dbconn->DoDbFinishTx(-1);
+
+		return;
+	}
+
+	Finally finally(boost::bind(&DbConn::DoDbFinishTx, dbconn, 1));		// 1 = rollback
+
+	Secret secret;
+
+	rc = dbconn->SecretSelectSecret(&address, TX_ADDRESS_BYTES, secret);
+	if (rc || !secret.TypeIsAddress())
+		return;
+
+	secret.next_poll = 1;
+
+	rc = dbconn->SecretInsert(secret);
+	if (rc)
+		return;
+
+	rc = dbconn->Commit();
+	if (rc)
+	{
+		BOOST_LOG_TRIVIAL(fatal) << "AddressWatch::SetPollNow error committing db transaction";
+
+		return;
+	}
+
+	dbconn->DoDbFinishTx();
+
+	finally.Clear();
+}
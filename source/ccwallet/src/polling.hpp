@@ -8,6 +8,10 @@
 
 #pragma once
 
+#include <CCbigint.hpp>
+
+#include <boost/asio/ip/tcp.hpp>
+
 class PollThread;
 class DbConn;
 class TxQuery;
@@ -46,3 +50,60 @@ public:
 	void ThreadProc();
 	int DoPoll(uint64_t checktime);
 };
+
+/*
+	AddressWatch keeps a tx-address-watch subscription open on the transaction server for the addresses that are polled
+	most often.  While an address is covered by the subscription, PollThread skips its scheduled query, and when the server
+	sends a notification for the address, its next poll time is set so it is queried right away.  An address is covered only
+	after it has been polled once while subscribed.  Each resubscription passes the next-commitment-number from the prior
+	reply, so the server reports any output that arrived while the wallet was not subscribed.
+*/
+
+class AddressWatch
+{
+	struct Entry
+	{
+		snarkfront::bigint_t address;
+		uint64_t check_seq;			// last time DoPoll was scheduled to poll the address; the most recent are watched
+		uint64_t covered_seq;		// start of the current continuous subscription to the address
+		uint64_t poll_seq;			// last time the address was polled
+		bool subscribed;
+		bool notified;
+	};
+
+	vector<Entry> m_entries;
+	uint64_t m_seq;
+	uint64_t m_next_commitnum;		// from the last subscription reply, or zero if the prior subscription was lost
+	bool m_connected;
+	bool m_changed;
+
+	mutex m_watch_lock;
+
+	thread *m_thread;
+	DbConn *m_dbconn;
+	TxQuery *m_txquery;
+
+	Entry* FindEntry(const snarkfront::bigint_t& address);
+
+	void ThreadProc();
+	int Subscribe(boost::asio::ip::tcp::socket& socket);
+	int HandleMessage(const char *msg, const vector<snarkfront::bigint_t>& addresses, uint64_t commitstart);
+	void SetPollNow(const snarkfront::bigint_t& address);
+
+public:
+	AddressWatch()
+	 :	m_seq(0),
+		m_next_commitnum(0),
+		m_connected(false),
+		m_changed(false),
+		m_thread(NULL),
+		m_dbconn(NULL),
+		m_txquery(NULL)
+	{ }
+
+	void Start();
+	void StartShutdown();
+	void WaitForShutdown();
+
+	bool CheckPoll(const snarkfront::bigint_t& address);
+};
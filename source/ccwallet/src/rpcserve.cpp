@@ -319,8 +319,16 @@ void RpcConnection::HandleContentReadComplete(const boost::system::error_code& e
 
 	m_noclose = m_keepalive;
 
-	WriteAsync("RpcConnection::HandleContentReadComplete", boost::asio::buffer(m_writebuf.data(), bufp - m_writebuf.data()),
-			boost::bind(&RpcConnection::HandleWriteHeader, this, boost::asio::placeholders::error, rbuf, AutoCount(this)));
+	// send the headers and body in a single write
+
+	//if (rbuf->size() > 64*1024) sleep(1);	// for testing
+
+	auto buffers = make_shared<CCServer::WriteBuffers>();
+	buffers->Add(m_writebuf.data(), bufp - m_writebuf.data());
+	buffers->Add(rbuf->data(), rbuf->size());
+
+	WriteAsync("RpcConnection::HandleContentReadComplete", buffers,
+			boost::bind(&RpcConnection::HandleWriteResponse, this, boost::asio::placeholders::error, rbuf, AutoCount(this)));
 
 	// can't StartRead here because the client may have already half-closed the connection
 	// StartRead would then get an eof error and hard stop the connection before the response can be sent
@@ -332,7 +340,7 @@ void RpcConnection::HandleContentReadComplete(const boost::system::error_code& e
 	#endif
 }
 
-void RpcConnection::HandleWriteHeader(const boost::system::error_code& e, shared_ptr<string> buf, AutoCount pending_op_counter)
+void RpcConnection::HandleWriteResponse(const boost::system::error_code& e, shared_ptr<string> buf, AutoCount pending_op_counter)
 {
 	if (g_disable_malloc_logging)
 	{
@@ -346,19 +354,12 @@ void RpcConnection::HandleWriteHeader(const boost::system::error_code& e, shared
 
 	if (e) return Stop();
 
-	// Note: keep m_write_in_progress lock and call WriteAsync with already_own_mutex = true
-
-	if (TRACE_RPCSERVE) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " RpcConnection::HandleWriteHeader ok";
+	if (TRACE_RPCSERVE) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " RpcConnection::HandleWriteResponse ok";
 
 	if (!buf->size())
 		return Stop();
 
-	// write the response body
-
-	//if (buf->size() > 64*1024) sleep(1);	// for testing
-
-	WriteAsync("RpcConnection::HandleWriteHeader", boost::asio::buffer(buf->data(), buf->size()),
-			boost::bind(&Connection::HandleWriteString, this, boost::asio::placeholders::error, buf, AutoCount(this)), true);
+	Connection::HandleWrite(e, std::move(pending_op_counter));	// don't need to increment op count
 }
 
 void RpcConnection::SendServerError()
@@ -44,7 +44,7 @@ private:
 	void StartRead();
 	void HandleReadComplete();
 	void HandleContentReadComplete(const boost::system::error_code& e, size_t bytes_transferred, AutoCount pending_op_counter);
-	void HandleWriteHeader(const boost::system::error_code& e, shared_ptr<string> rbuf, AutoCount pending_op_counter);
+	void HandleWriteResponse(const boost::system::error_code& e, shared_ptr<string> rbuf, AutoCount pending_op_counter);
 
 	void SendServerError();
 	void SendBadRequest();
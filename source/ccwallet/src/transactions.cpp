@@ -58,6 +58,7 @@ When another wallet spends a bill in this wallet:
 #include <CCmint.h>
 #include <transaction.h>
 #include <transaction.hpp>
+#include <txcompact.hpp>
 #include <xtransaction-xreq.hpp>
 #include <xmatch.hpp>
 #include <encode.h>
@@ -3408,17 +3409,24 @@ int Transaction::FinishCreateTxPay(DbConn *dbconn, TxQuery& txquery, TxParams& t
 
 	if (RandTest(RTEST_CUZZ)) ccsleep(rand() & 3);
 
-	vector<TxPay> tx_structs(active_subtx_count);
+	// the subtx's are held in compact form between steps, and each is expanded into a single TxPay when it is worked on
+
+	vector<TxPayCompact> tx_structs(active_subtx_count);
+
+	unique_ptr<TxPay> ptx(new TxPay);
+	CCASSERT(ptx);
+
+	TxPay& ts = *ptx;
 
 	unsigned si = 0;
 	for (auto tx = tx_list.begin(); tx != tx_list.end(); ++tx)
 	{
 		if (tx->SubTxIsActive(need_intermediate_txs))
 		{
-			TxPay& ts = tx_structs[si++];
-
 			auto rc = tx->FillOutTx(dbconn, txquery, txparams, entry->dest_chain, ts);
 			if (rc) return rc;
+
+			tx_structs[si++].FromTxPay(ts);
 		}
 	}
 
@@ -3446,9 +3454,13 @@ int Transaction::FinishCreateTxPay(DbConn *dbconn, TxQuery& txquery, TxParams& t
 	{
 		if (tx->SubTxIsActive(need_intermediate_txs))
 		{
-			TxPay& ts = tx_structs[si++];
+			auto& tc = tx_structs[si++];
+
+			tc.ToTxPay(ts);
 
 			tx->SetAddresses(dbconn, entry->dest_chain, destination, ts);		// do this last to minimize chance of unused addresses
+
+			tc.FromTxPay(ts);
 		}
 	}
 
@@ -3472,7 +3484,7 @@ int Transaction::FinishCreateTxPay(DbConn *dbconn, TxQuery& txquery, TxParams& t
 					cerr << "Constructing a " << tx->TypeString() << " transaction...\n" << endl;
 			}
 
-			TxPay& ts = tx_structs[si++];
+			tx_structs[si++].ToTxPay(ts);
 
 			tx->FinishCreateTx(ts, txparams, entry);
 
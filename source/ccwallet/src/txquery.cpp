@@ -20,6 +20,7 @@
 #include <xtransaction-xreq.hpp>
 
 #include <ccserver/connection_manager.hpp>
+#include <socks.hpp>
 
 #define TRACE_TXQUERY	(g_params.trace_txquery)
 #define TRACE_TXPARAMS	(g_params.trace_txparams)
@@ -232,6 +233,20 @@ int TxQuery::PrepareQuery(PowType powtype, uint64_t expire_time, bool is_retry,
 	return 0;
 }
 
+// prepares a tx-address-watch message in querybuf, which the caller sends on its own connection
+
+int TxQuery::PrepareWatch(uint64_t commitstart, const bigint_t *addresses, unsigned naddresses, vector<char>& querybuf)
+{
+	if (TRACE_TXQUERY) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " TxQuery::PrepareWatch commitstart " << commitstart << " naddresses " << naddresses;
+
+	querybuf.resize(TXCONN_WRITE_MAX);
+
+	auto rc = tx_query_address_watch_create(string(), g_params.blockchain, commitstart, addresses, naddresses, querybuf.data(), querybuf.size());
+	CCASSERTZ(rc);
+
+	return PrepareQuery(PowType_Query, 0, false, &querybuf);
+}
+
 int TxQuery::TryQuery(PowType powtype, vector<char> *pquery)
 {
 	if (RandTest(RTEST_CUZZ)) ccsleep(rand() & 3);
@@ -275,6 +290,13 @@ int TxQuery::TryQuery(PowType powtype, vector<char> *pquery)
 			return -1;
 		}
 
+		if (g_params.transact_tor && !g_params.transact_tor_single_query)
+		{
+			// have a connection to this server ready for the next query
+
+			g_sockspool.Warm(GetHost(), GetHost());
+		}
+
 		if (TRACE_TXQUERY) BOOST_LOG_TRIVIAL(trace) << Name() << " Conn " << m_conn_index << " TxQuery::TryQuery query posted; m_stopping " << m_stopping.load();
 	}
 	else
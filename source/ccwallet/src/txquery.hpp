@@ -198,6 +198,7 @@ public:
 
 	int PrepareTx(TxPay& ts, uint64_t expire_time, vector<char>& wire);
 	int PrepareQuery(PowType powtype, uint64_t expire_time, bool is_retry, vector<char> *pquery = NULL);
+	int PrepareWatch(uint64_t commitstart, const snarkfront::bigint_t *addresses, unsigned naddresses, vector<char>& querybuf);
 
 	int SubmitTx(TxPay& ts, uint64_t expire_time, uint64_t& next_commitnum, bool debug = false);
 	int SubmitPreparedTx(uint64_t& next_commitnum, vector<char>& wire, bool debug = false);
@@ -0,0 +1,149 @@
+#!/usr/bin/env python2
+
+'''
+CredaCash(TM) Test Script
+
+Part of the CredaCash (TM) cryptocurrency and blockchain
+
+Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+
+This script tests the tx-address-watch subscription of a transaction server running on the local host
+
+It subscribes to the given addresses and prints each notification it receives, along with the results of querying
+each notified address. When the server closes the subscription, the script resubscribes with the next commitment
+number from the prior reply, so any output that arrived in between is still reported. Send payments to the addresses
+(for example, with wallet-burn.py) while it runs.
+
+When stopped with Ctrl-C, it reports the number of tx-address-query messages it sent, compared to the number a
+wallet polling the same addresses at the given interval would have sent over the same time.
+
+'''
+
+from cclib import *
+
+def Subscribe(addresses, commit_start):
+	jstr = '{"tx-query-create" :'
+	jstr += ' {"tx-address-watch" :'
+	jstr += ' {"blockchain" : "' + NetParams.blockchain + '"'
+	if commit_start:
+		jstr += ', "commitment-number-start" : "' + str(commit_start) + '"'
+	jstr += ', "addresses" : ["' + '","'.join(addresses) + '"]'
+	jstr += '}}}'
+	msg = DoJsonCmd(jstr, True)
+
+	nbytes = GetMsgSize(msg)
+	msg = AddProofOfWork(msg, NetParams.query_work_difficulty)
+	msg = msg[:nbytes]
+
+	sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+	sock.connect(('127.0.0.1', cclib.net_port))
+	sock.sendall(msg)
+	return sock
+
+def ReadMessages(sock):
+	buf = ''
+	while True:
+		data = sock.recv(4096)
+		if not data:
+			return
+		buf += data
+		while '\0' in buf:
+			msg, buf = buf.split('\0', 1)
+			yield msg
+
+class Stats:
+	start = time.time()
+	nqueries = 0
+
+def Report(naddresses, poll_interval):
+	elapsed = time.time() - Stats.start
+	npolls = int(elapsed / poll_interval) * naddresses
+	print
+	print 'elapsed %.0f seconds' % elapsed
+	print 'address queries with watch', Stats.nqueries
+	print 'address queries polling every', poll_interval, 'seconds', npolls
+
+def Watch(addresses):
+	commit_start = 0
+	nsubscriptions = 0
+
+	while True:
+		sock = Subscribe(addresses, commit_start)
+		nsubscriptions += 1
+		start = time.time()
+
+		for msg in ReadMessages(sock):
+			now = time.time()
+			if not msg.startswith('{'):
+				print 'server returned:', msg
+				return
+			try:
+				msg = json.loads(msg)
+			except:
+				print 'unexpected reply:', msg
+				return
+
+			if 'tx-address-watch-report' in msg:
+				report = msg['tx-address-watch-report']
+				print 'subscription', nsubscriptions, 'watching', report['addresses-watched'], 'addresses next commitnum', report['next-commitment-number'], 'expires in', report['expire-seconds'], 'seconds'
+				commit_start = report['next-commitment-number']
+				continue
+
+			notify = msg['tx-address-watch-notify']
+			print time.strftime('%H:%M:%S', time.localtime(int(now))), 'notified of', len(notify['addresses']), 'addresses', ('(poll-all)' if 'poll-all' in notify else '')
+			for address in notify['addresses']:
+				result = QueryAddress(address, 0)
+				Stats.nqueries += 1
+				if isinstance(result, basestring):
+					print '  ', address, result
+				else:
+					print '  ', address, len(result), 'outputs, last commitnum', result[-1]['commitment-number']
+
+		sock.close()
+		print 'subscription closed after %.1f seconds' % (time.time() - start)
+
+####################################################################################
+#
+# main
+#
+
+def main(argv):
+	if len(argv) < 3:
+		print
+		print 'Usage: python address-watch.py <port> [-i <poll_interval=60>] <address> [<address> ...]'
+		print
+		print ' port:'
+		print '       Tx server port of the node; a Tx server on localhost by default listens at port 9220'
+		print '       The node must be run with --transact-watch-conns greater than zero'
+		print
+		print ' poll_interval:'
+		print '       Polling interval in seconds used to estimate the query load without a watch'
+		print
+		print ' address:'
+		print '       Addresses to watch, in hex with a 0x prefix'
+
+		exit()
+
+	cclib.net_port = int(argv[1])
+	addresses = argv[2:]
+
+	poll_interval = 60
+	if addresses[0] == '-i' and len(addresses) > 2:
+		poll_interval = int(addresses[1])
+		addresses = addresses[2:]
+
+	cclib.use_tor_proxy = False
+
+	NetParams.Query()	# get network parameters
+
+	Stats.start = time.time()
+
+	try:
+		Watch(addresses)
+	except KeyboardInterrupt:
+		pass
+
+	Report(len(addresses), poll_interval)
+
+if __name__ == '__main__':
+	main(sys.argv)
@@ -0,0 +1,300 @@
+#!/usr/bin/env python2
+
+'''
+CredaCash(TM) Test Script
+
+Part of the CredaCash (TM) cryptocurrency and blockchain
+
+Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+
+This script stress tests the handling of conflicting transactions by a transaction server running on the local host
+
+Each round mints a bill, waits for it to clear, and then creates several transactions that all spend that bill to
+different destinations. The transactions, and a duplicate of each, are submitted at the same time from separate threads,
+so the validation threads of the server commit many conflicting and duplicate transactions concurrently. Once the
+serial number of the bill is indelible, the script checks that exactly one of the transactions is in the blockchain,
+and that resubmitting it is accepted while resubmitting any of the others is rejected as already spent.
+
+For more conflicts per second, run the node with tx-validation-threads set to the number of cores, compile it with
+TEST_SKIP_ZKPROOFS = 1, and set the *_work_difficulty values to 0.
+
+To detect problems, search the output for the substring "FAIL"
+
+'''
+
+import threading
+
+from cclib import *
+
+####################################################################################
+
+def GenerateSpendSecret(bits):
+	return hex(random.getrandbits(bits))
+
+def ComputeMonitorSecret(spend_secret):
+	jstr = '{"compute-monitor-secret" : '
+	jstr += '{"spend-secret" : "' + spend_secret + '"'
+	jstr += '}}'
+	result = DoJsonCmd(jstr)
+	result = json.loads(result)
+	return result['monitor-secret']
+
+def GenerateDestination(monitor_secret):
+	destnum = 0
+	while True:
+		jstr = '{"payspec-encode" :'
+		jstr += ' {"monitor-secrets" : ["' + monitor_secret + '"]'
+		jstr += ', "destination-number" : "' + hex(destnum) + '"'
+		jstr += '}}'
+		payspec = DoJsonCmd(jstr)
+
+		jstr = '{"payspec-decode" : ' + payspec + '}'
+		payspec = DoJsonCmd(jstr)
+		payspec = json.loads(payspec)
+		destination = payspec['payspec']['destination']
+
+		if HasAcceptanceRequired(destination):
+			destnum += 1
+			continue
+
+		destination_params = '"monitor-secrets" : ["' + monitor_secret + '"]'
+		destination_params += ', "destination-number" : "' + hex(destnum) + '"'
+
+		return destination, destination_params
+
+class Bill:
+	def __init__(self, monitor_secret, spend_secret, destination, destination_params, address, commitment, next_commitnum, paynum):
+		self.monitor_secret = monitor_secret
+		self.spend_secret = spend_secret
+		self.destination = destination
+		self.address = address
+		self.commitment = commitment
+		self.next_query_commitnum = next_commitnum
+		self.paynum = paynum
+		self.params = destination_params
+		self.params += ', "payment-number" : "' + hex(paynum) + '"'
+		self.params += ', "commitment" : "' + commitment + '"'
+
+	def WaitForCleared(self):
+		while not self.QueryCleared():
+			time.sleep(0.5)
+
+	def QueryCleared(self):
+		reply = QueryAddress(self.address, self.next_query_commitnum)
+		if isinstance(reply, basestring):
+			return False
+		for entry in reply:
+			commitnum = toint(entry['commitment-number'])
+			if toint(entry['commitment']) == toint(self.commitment):
+				DecryptAmount(entry, self.destination, self.paynum)
+				self.amount = Amounts.Decode(toint(entry['amount']), False)
+				self.commitnum = commitnum
+				self.params += ', "commitment-iv" : "' + entry['commitment-iv'] + '"'
+				self.params += ', "domain" : "' + hex(toint(entry['domain'])) + '"'
+				self.params += ', "asset" : "' + hex(toint(entry['asset'])) + '"'
+				self.params += ', "amount" : "' + hex(toint(entry['amount'])) + '"'
+				self.serialnum = ComputeSerialnum('monitor-secret', self.monitor_secret, self.commitment, commitnum)
+				return True
+		self.next_query_commitnum = commitnum + 1
+		return False
+
+def Mint():
+	spend_secret = GenerateSpendSecret(TX_INPUT_BITS)
+	monitor_secret = ComputeMonitorSecret(spend_secret)
+	destination, destination_params = GenerateDestination(monitor_secret)
+	paynum = 0
+
+	inputs = QueryInputs('')
+	inputs = json.dumps(inputs)
+	inputs = inputs[1:-1]	# strip off outer brackets
+	jstr = '{"tx-create" : {'
+	jstr += '"mint" : {'
+	jstr += inputs
+	jstr += ', "source-chain" : "' + NetParams.blockchain + '"'
+	jstr += ', "destination-chain" : "' + NetParams.blockchain + '"'
+	jstr += ', "donation" : "' + hex(Amounts.Encode(TX_CC_MINT_DONATION, 0, True)) + '"'
+	jstr += ', "outputs" : ['
+	jstr += '{"destination" : "' + destination + '"'
+	jstr += ', "payment-number" : "' + hex(paynum) + '"'
+	jstr += ', "amount" : "' + hex(Amounts.Encode(TX_CC_MINT_AMOUNT - TX_CC_MINT_DONATION, 0, False)) + '"'
+	jstr += ', "asset-mask" : 0'
+	jstr += ', "amount-mask" : 0'
+	jstr += '}]}}}'
+
+	output = SubmitTx(jstr)
+	if isinstance(output, basestring) or not output['tx-accepted']:
+		print 'FAIL: mint not accepted', output
+		raise Exception
+
+	next_commitnum = output['next-commitment-number']
+	output = output['outputs'][0]
+	return Bill(monitor_secret, spend_secret, destination, destination_params, output['address'], output['commitment'], next_commitnum, paynum)
+
+# Creates a tx that spends bill to a new destination, and returns the output address and the tx ready to send to the server
+
+def CreateSpend(bill, paynum):
+	destination, destination_params = GenerateDestination(ComputeMonitorSecret(GenerateSpendSecret(TX_INPUT_BITS)))
+
+	inputs = QueryInputs(str(bill.commitnum))
+	input = json.dumps(inputs['inputs'][0])
+	input = input[:-1]	# strip off trailing bracket
+	input += ', ' + bill.params
+	input += ', "spend-secret" : "' + bill.spend_secret + '"'
+	input += '}'
+	inputs['inputs'][0] = json.loads(input)
+	inputs = json.dumps(inputs)
+	inputs = inputs[1:-1]	# strip off outer brackets
+
+	est_txsize, donation = Amounts.ComputeDonation(1, 1)
+	while True:
+		output_amount = Amounts.Truncate(bill.amount - donation, 0, False)
+		donation = Amounts.Truncate(bill.amount - output_amount, 0, True)
+		if bill.amount == output_amount + donation:
+			break
+
+	jstr = '{"tx-create" : {'
+	jstr += '"tx-pay" : {'
+	jstr += inputs
+	jstr += ', "source-chain" : "' + NetParams.blockchain + '"'
+	jstr += ', "destination-chain" : "' + NetParams.blockchain + '"'
+	jstr += ', "donation" : "' + hex(Amounts.Encode(donation, 0, True)) + '"'
+	jstr += ', "outputs" : ['
+	jstr += '{"destination" : "' + destination + '"'
+	jstr += ', "payment-number" : "' + hex(paynum) + '"'
+	jstr += ', "amount" : "' + hex(Amounts.Encode(output_amount, 0, False)) + '"'
+	jstr += ', "asset-mask" : "' + hex((1 << Amounts.asset_bits) - 1) + '"'
+	jstr += ', "amount-mask" : "' + hex((1 << Amounts.amount_bits) - 1) + '"'
+	jstr += '}]}}}'
+	DoJsonCmd(jstr)
+
+	output = json.loads(DoJsonCmd('{"tx-to-json" : {}}'))
+	address = output['tx-pay']['outputs'][0]['address']
+
+	wire = DoJsonCmd('{"tx-to-wire" : {}}', True)
+	nbytes = GetMsgSize(wire)
+	wire = AddProofOfWork(wire, NetParams.tx_work_difficulty)
+
+	return address, wire[:nbytes]
+
+def SendAll(msgs):
+	replies = [None] * len(msgs)
+
+	def send(i):
+		try:
+			reply = SendServer(msgs[i])
+			replies[i] = reply.rstrip('\0')
+		except Exception as e:
+			replies[i] = 'EXCEPTION ' + str(e)
+
+	threads = [threading.Thread(target = send, args = (i,)) for i in range(len(msgs))]
+	for t in threads:
+		t.start()
+	for t in threads:
+		t.join()
+
+	return replies
+
+class Stats:
+	rounds = 0
+	failures = 0
+	submitted = 0
+	accepted = 0
+
+def Fail(*args):
+	print 'FAIL:', ' '.join(str(a) for a in args)
+	Stats.failures += 1
+
+def RunRound(ntxs):
+	bill = Mint()
+	bill.WaitForCleared()
+
+	spends = [CreateSpend(bill, i) for i in range(ntxs)]
+
+	# submit every tx twice, in random order, all at the same time
+
+	msgs = [wire for address, wire in spends] * 2
+	random.shuffle(msgs)
+
+	replies = SendAll(msgs)
+
+	Stats.submitted += len(replies)
+	Stats.accepted += sum(1 for r in replies if r.startswith('OK'))
+
+	for reply in replies:
+		if not (reply.startswith('OK') or reply == 'INVALID:already spent' or reply.startswith('ERROR:server busy')):
+			Fail('round', Stats.rounds, 'unexpected reply', reply)
+
+	while QuerySerialnum(bill.serialnum, True) is None:
+		time.sleep(0.5)
+
+	winners = []
+	for i in range(ntxs):
+		reply = QueryAddress(spends[i][0], 0)
+		if not isinstance(reply, basestring):
+			winners.append(i)
+
+	if len(winners) != 1:
+		Fail('round', Stats.rounds, len(winners), 'of', ntxs, 'conflicting txs are in the blockchain')
+
+	replies = SendAll([wire for address, wire in spends])
+
+	for i in range(ntxs):
+		reply = replies[i]
+		if i in winners:
+			if not reply.startswith('OK'):
+				Fail('round', Stats.rounds, 'resubmitted tx in blockchain returned', reply)
+		elif reply != 'INVALID:already spent':
+			Fail('round', Stats.rounds, 'resubmitted conflicting tx returned', reply)
+
+	Stats.rounds += 1
+
+	print 'round', Stats.rounds, 'txs', ntxs, 'winner', winners, 'submitted', Stats.submitted, 'accepted', Stats.accepted, 'failures', Stats.failures
+
+####################################################################################
+#
+# main
+#
+
+def main(argv):
+	if len(argv) < 2 or len(argv) > 4:
+		print
+		print 'Usage: python double-spend-burn.py <port> [<ntxs=20>] [<nrounds=0>]'
+		print
+		print ' port:'
+		print '       Tx server port of the node; a Tx server on localhost by default listens at port 9220'
+		print
+		print ' ntxs:'
+		print '       Number of conflicting transactions created in each round'
+		print
+		print ' nrounds:'
+		print '       Number of rounds to run (0 = until stopped)'
+
+		exit()
+
+	cclib.net_port = int(argv[1])
+
+	ntxs = 20
+	if len(argv) > 2:
+		ntxs = int(argv[2])
+
+	nrounds = 0
+	if len(argv) > 3:
+		nrounds = int(argv[3])
+
+	cclib.use_tor_proxy = False
+
+	NetParams.Query()	# get network parameters
+
+	try:
+		while not nrounds or Stats.rounds < nrounds:
+			RunRound(ntxs)
+	except KeyboardInterrupt:
+		pass
+
+	print
+	print 'rounds', Stats.rounds, 'failures', Stats.failures
+	if Stats.failures:
+		print 'FAIL'
+
+if __name__ == '__main__':
+	main(sys.argv)
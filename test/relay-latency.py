@@ -0,0 +1,111 @@
+#!/usr/bin/env python2
+
+'''
+CredaCash(TM) Test Script
+
+Part of the CredaCash (TM) cryptocurrency and blockchain
+
+Copyright (C) 2015-2025 Creda Foundation, Inc., or its contributors
+
+This script measures block propagation latency between two nodes running on the local host
+
+It polls the transaction server of each node for its highest indelible block level and reports how long after
+the first node reached each new level the second node reached the same level. Run the nodes with and without
+--relay-compact-blocks to compare full block relay to compact block relay.
+
+'''
+
+from cclib import *
+
+poll_interval = 0.05
+
+def QueryLevel(port):
+	cclib.net_port = port
+	jstr = '{"tx-query-create": {"tx-parameters-query": {}}}'
+	query = DoJsonCmd(jstr, True)
+	reply = TryServer('query', query, retry = False)
+	try:
+		reply = json.loads(reply)
+		return int(reply['tx-parameters-query-results']['blockchain-highest-indelible-level'])
+	except:
+		if cclib.show_activity:
+			print 'tx-parameters-query unexpected reply:', reply
+		return None
+
+def Report(lags):
+	lags = sorted(lags)
+	n = len(lags)
+	print 'levels', n, 'min lag %.3f' % lags[0], 'median lag %.3f' % lags[n/2], 'mean lag %.3f' % (sum(lags) / n), 'max lag %.3f' % lags[-1]
+
+####################################################################################
+#
+# main
+#
+
+def main(argv):
+	if len(argv) < 3 or len(argv) > 5:
+		print
+		print 'Usage: python relay-latency.py <port1> <port2> [<nlevels=20>] [<show_queries=0>]'
+		print
+		print ' port1, port2:'
+		print '       Tx server ports of the two nodes; a Tx server on localhost by default listens at port 9220'
+		print '       Lag is measured from the time the node at port1 reaches a level to the time the node at port2 reaches it'
+		print
+		print ' nlevels:'
+		print '       Number of new block levels to measure'
+		print
+		print ' show_queries:'
+		print '       0 = normal script output'
+		print '       1 = log messages to/from tx server/network'
+
+		exit()
+
+	port1 = int(argv[1])
+	port2 = int(argv[2])
+
+	nlevels = 20
+	if len(argv) > 3:
+		nlevels = int(argv[3])
+
+	if len(argv) > 4:
+		cclib.show_queries = int(argv[4])
+		cclib.show_activity = cclib.show_queries
+
+	cclib.use_tor_proxy = False
+
+	cclib.net_port = port1
+	NetParams.Query()	# get network parameters
+
+	first_seen = {}
+	lags = []
+
+	start_level = None
+	level2 = None
+
+	while len(lags) < nlevels:
+		level1 = QueryLevel(port1)
+		now1 = time.time()
+		if level1 is not None:
+			if start_level is None:
+				start_level = level1
+				print 'starting at level', start_level
+			if level1 > start_level and level1 not in first_seen:
+				first_seen[level1] = now1
+
+		level = QueryLevel(port2)
+		now2 = time.time()
+		if level is not None and start_level is not None and (level2 is None or level > level2):
+			level2 = level
+			for l in sorted(first_seen.keys()):
+				if l <= level2:
+					lag = max(now2 - first_seen[l], 0)
+					print 'level', l, 'lag %.3f' % lag
+					lags.append(lag)
+					del first_seen[l]
+
+		time.sleep(poll_interval)
+
+	Report(lags)
+
+if __name__ == '__main__':
+	main(sys.argv)